@@ -0,0 +1,377 @@
+/*
+ * File:
+ *   affinity.h
+ * Description:
+ *   Thread pinning and NUMA memory placement of the benchmark harnesses.
+ *
+ *   Pinning policies (thread i runs on the i-th CPU of the mapping,
+ *   wrapping around if there are more threads than CPUs):
+ *     none                     threads are not pinned
+ *     compact                  fill the cores of a node before the next
+ *                              node, SMT siblings last
+ *     scatter                  round-robin over the nodes, one thread per
+ *                              core before SMT siblings
+ *     <cpu list>               explicit list, e.g., 0,2,4-7
+ *
+ *   NUMA memory policies:
+ *     none                     default policy of the system
+ *     interleave               pages interleaved over all memory nodes
+ *     local                    pages allocated on the node of the thread
+ *                              touching them first
+ *     populate                 local, and the initial elements are inserted
+ *                              in equal chunks from the CPU of each thread,
+ *                              so that first-touch spreads the structure
+ *                              over the nodes the threads run on
+ *
+ *   Only the CPUs of the initial affinity mask of the process are used.
+ *   Affinity and memory policies rely on raw Linux system calls so that
+ *   no library is needed, they are ignored on other systems.
+ *
+ * affinity.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+#define DEFAULT_PIN                     "none"
+#define DEFAULT_NUMA                    "none"
+
+#define AFF_MAX_CPUS                    1024
+#define AFF_MAX_NODES                   64
+#define AFF_WORDS                       (AFF_MAX_CPUS / (8 * sizeof(unsigned long)))
+
+#define AFF_PIN_NONE                    0
+#define AFF_PIN_COMPACT                 1
+#define AFF_PIN_SCATTER                 2
+#define AFF_PIN_LIST                    3
+
+#define AFF_NUMA_NONE                   0
+#define AFF_NUMA_INTERLEAVE             1
+#define AFF_NUMA_LOCAL                  2
+#define AFF_NUMA_POPULATE               3
+
+/* Linux memory policy modes, see set_mempolicy(2) */
+#define AFF_MPOL_INTERLEAVE             3
+#define AFF_MPOL_LOCAL                  4
+
+typedef struct aff_cpu {
+	int cpu;
+	int node;
+	int pkg;
+	int core;
+	int smt;
+	int rank;
+} aff_cpu_t;
+
+typedef struct affinity {
+	int pin;
+	int numa;
+	int nb_threads;
+	int nb_nodes;
+	int nb_cpus;
+	/* Number of CPUs allowed at startup (entries of topo) */
+	int nb_avail;
+	/* Mapping thread index -> CPU (modulo nb_cpus) */
+	int cpus[AFF_MAX_CPUS];
+	/* CPUs allowed at startup, restored after populating */
+	unsigned long initial[AFF_WORDS];
+	aff_cpu_t topo[AFF_MAX_CPUS];
+	int last_chunk;
+} affinity_t;
+
+static inline int aff_read_int(const char *fmt, int cpu, int dflt) {
+	char path[128];
+	FILE *f;
+	int v;
+
+	snprintf(path, sizeof(path), fmt, cpu);
+	if ((f = fopen(path, "r")) == NULL)
+		return dflt;
+	if (fscanf(f, "%d", &v) != 1)
+		v = dflt;
+	fclose(f);
+	return v;
+}
+
+/* Parses a CPU list such as "0,2,4-7" into cpus, returns its length */
+static inline int aff_parse_list(const char *s, int *cpus, int max) {
+	int n = 0, a, b, c;
+	char *end;
+
+	while (*s != '\0') {
+		a = (int)strtol(s, &end, 10);
+		if (end == s || a < 0)
+			return -1;
+		b = a;
+		s = end;
+		if (*s == '-') {
+			b = (int)strtol(s + 1, &end, 10);
+			if (end == s + 1 || b < a)
+				return -1;
+			s = end;
+		}
+		for (c = a; c <= b && n < max; c++)
+			cpus[n++] = c;
+		if (*s == ',')
+			s++;
+		else if (*s != '\0')
+			return -1;
+	}
+	return n;
+}
+
+static inline int aff_set_self(const unsigned long *mask) {
+#ifdef __linux__
+	return (int)syscall(SYS_sched_setaffinity, 0, AFF_WORDS * sizeof(unsigned long), mask);
+#else
+	return 0;
+#endif /* __linux__ */
+}
+
+/* Pins the calling thread on cpu, does nothing if cpu < 0 */
+static inline void aff_pin_self(int cpu) {
+	unsigned long mask[AFF_WORDS];
+
+	if (cpu < 0)
+		return;
+	memset(mask, 0, sizeof(mask));
+	mask[cpu / (8 * sizeof(unsigned long))] |= 1UL << (cpu % (8 * sizeof(unsigned long)));
+	if (aff_set_self(mask) != 0) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+}
+
+/* Returns the CPU thread id should be pinned on, -1 if unpinned */
+static inline int aff_cpu(affinity_t *a, int id) {
+	if (a->pin == AFF_PIN_NONE)
+		return -1;
+	return a->cpus[id % a->nb_cpus];
+}
+
+/* Returns a CPU of the given node allowed at startup, -1 if none */
+static inline int aff_node_cpu(affinity_t *a, int node) {
+	int i;
+
+	for (i = 0; i < a->nb_avail; i++)
+		if (a->topo[i].node == node)
+			return a->topo[i].cpu;
+	return -1;
+}
+
+static inline int aff_cmp_compact(const void *x, const void *y) {
+	const aff_cpu_t *p = (const aff_cpu_t *)x, *q = (const aff_cpu_t *)y;
+
+	if (p->smt != q->smt) return p->smt - q->smt;
+	if (p->node != q->node) return p->node - q->node;
+	if (p->pkg != q->pkg) return p->pkg - q->pkg;
+	if (p->core != q->core) return p->core - q->core;
+	return p->cpu - q->cpu;
+}
+
+static inline int aff_cmp_scatter(const void *x, const void *y) {
+	const aff_cpu_t *p = (const aff_cpu_t *)x, *q = (const aff_cpu_t *)y;
+
+	if (p->smt != q->smt) return p->smt - q->smt;
+	if (p->rank != q->rank) return p->rank - q->rank;
+	if (p->node != q->node) return p->node - q->node;
+	return p->cpu - q->cpu;
+}
+
+/* Reads the topology of the CPUs allowed at startup into a->topo */
+static inline int aff_topology(affinity_t *a) {
+	int n = 0, cpu, i, j;
+
+#ifdef __linux__
+	if (syscall(SYS_sched_getaffinity, 0, sizeof(a->initial), a->initial) < 0) {
+		perror("sched_getaffinity");
+		exit(1);
+	}
+#else
+	memset(a->initial, 0xff, sizeof(a->initial));
+#endif /* __linux__ */
+	a->nb_nodes = 1;
+	for (cpu = 0; cpu < AFF_MAX_CPUS; cpu++) {
+		aff_cpu_t *t = &a->topo[n];
+		if (!(a->initial[cpu / (8 * sizeof(unsigned long))]
+		      & (1UL << (cpu % (8 * sizeof(unsigned long))))))
+			continue;
+		t->cpu = cpu;
+		t->pkg = aff_read_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu, 0);
+		t->core = aff_read_int("/sys/devices/system/cpu/cpu%d/topology/core_id", cpu, cpu);
+		t->node = 0;
+		for (i = 0; i < AFF_MAX_NODES; i++) {
+			char path[128];
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, i);
+			if (access(path, F_OK) == 0) {
+				t->node = i;
+				break;
+			}
+		}
+		if (t->node + 1 > a->nb_nodes)
+			a->nb_nodes = t->node + 1;
+		/* SMT siblings are ranked by increasing CPU number */
+		t->smt = 0;
+		for (j = 0; j < n; j++)
+			if (a->topo[j].pkg == t->pkg && a->topo[j].core == t->core)
+				t->smt++;
+		n++;
+	}
+	return n;
+}
+
+/* Applies a memory policy to the calling thread and the threads it creates */
+static inline void aff_mempolicy(affinity_t *a) {
+#ifdef __linux__
+	unsigned long nodes = 0;
+	int i;
+
+	if (a->numa == AFF_NUMA_INTERLEAVE) {
+		for (i = 0; i < AFF_MAX_NODES; i++) {
+			char path[64];
+			snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", i);
+			if (access(path, F_OK) == 0)
+				nodes |= 1UL << i;
+		}
+		if (nodes == 0)
+			nodes = 1;
+		if (syscall(SYS_set_mempolicy, AFF_MPOL_INTERLEAVE, &nodes, AFF_MAX_NODES + 1) != 0) {
+			perror("set_mempolicy");
+			exit(1);
+		}
+	} else if (a->numa != AFF_NUMA_NONE) {
+		if (syscall(SYS_set_mempolicy, AFF_MPOL_LOCAL, NULL, 0) != 0) {
+			perror("set_mempolicy");
+			exit(1);
+		}
+	}
+#endif /* __linux__ */
+}
+
+/*
+ * Parses the pinning and memory policies, computes the mapping of the
+ * nb_threads threads and applies the memory policy to the calling thread.
+ * Must be called before the structure is allocated.
+ */
+static inline void aff_init(affinity_t *a, const char *pin, const char *numa,
+			    int nb_threads) {
+	int n, i, j;
+
+	memset(a, 0, sizeof(affinity_t));
+	a->nb_threads = nb_threads;
+	a->last_chunk = -1;
+	n = a->nb_avail = aff_topology(a);
+
+	if (!strcmp(numa, "none")) a->numa = AFF_NUMA_NONE;
+	else if (!strcmp(numa, "interleave")) a->numa = AFF_NUMA_INTERLEAVE;
+	else if (!strcmp(numa, "local")) a->numa = AFF_NUMA_LOCAL;
+	else if (!strcmp(numa, "populate")) a->numa = AFF_NUMA_POPULATE;
+	else {
+		fprintf(stderr, "Unknown NUMA policy: %s\n", numa);
+		exit(1);
+	}
+
+	if (!strcmp(pin, "none")) a->pin = AFF_PIN_NONE;
+	else if (!strcmp(pin, "compact")) a->pin = AFF_PIN_COMPACT;
+	else if (!strcmp(pin, "scatter")) a->pin = AFF_PIN_SCATTER;
+	else a->pin = AFF_PIN_LIST;
+
+	if (a->pin == AFF_PIN_LIST) {
+		a->nb_cpus = aff_parse_list(pin, a->cpus, AFF_MAX_CPUS);
+		if (a->nb_cpus <= 0) {
+			fprintf(stderr, "Invalid CPU list: %s\n", pin);
+			exit(1);
+		}
+		for (i = 0; i < a->nb_cpus; i++) {
+			for (j = 0; j < n && a->topo[j].cpu != a->cpus[i]; j++);
+			if (j == n) {
+				fprintf(stderr, "CPU %d is not available\n", a->cpus[i]);
+				exit(1);
+			}
+		}
+	} else {
+		/* Populating without pinning spreads over the nodes anyway */
+		if (a->pin == AFF_PIN_SCATTER ||
+		    (a->pin == AFF_PIN_NONE && a->numa == AFF_NUMA_POPULATE)) {
+			/* Rank of each CPU among the CPUs of its node and SMT level */
+			qsort(a->topo, n, sizeof(aff_cpu_t), aff_cmp_compact);
+			for (i = 0; i < n; i++) {
+				a->topo[i].rank = 0;
+				for (j = 0; j < i; j++)
+					if (a->topo[j].node == a->topo[i].node
+					    && a->topo[j].smt == a->topo[i].smt)
+						a->topo[i].rank++;
+			}
+			qsort(a->topo, n, sizeof(aff_cpu_t), aff_cmp_scatter);
+		} else {
+			qsort(a->topo, n, sizeof(aff_cpu_t), aff_cmp_compact);
+		}
+		a->nb_cpus = n;
+		for (i = 0; i < n; i++)
+			a->cpus[i] = a->topo[i].cpu;
+	}
+
+	aff_mempolicy(a);
+}
+
+/*
+ * Called by the populating thread before inserting its i-th element out
+ * of n: with the populate policy, it moves to the CPU of the thread owning
+ * the current chunk of elements.
+ */
+static inline void aff_populate(affinity_t *a, int i, int n) {
+	int chunk;
+
+	if (a->numa != AFF_NUMA_POPULATE || n == 0)
+		return;
+	chunk = (int)((long)i * a->nb_threads / n);
+	if (chunk == a->last_chunk)
+		return;
+	a->last_chunk = chunk;
+	aff_pin_self(a->cpus[chunk % a->nb_cpus]);
+}
+
+/* Restores the initial affinity of the populating thread */
+static inline void aff_populate_done(affinity_t *a) {
+	if (a->numa != AFF_NUMA_POPULATE)
+		return;
+	if (aff_set_self(a->initial) != 0) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+}
+
+static inline void aff_print(affinity_t *a, const char *pin, const char *numa) {
+	int i;
+
+	printf("Pinning      : %s", pin);
+	if (a->pin != AFF_PIN_NONE) {
+		printf(" (cpus");
+		for (i = 0; i < a->nb_threads; i++)
+			printf(" %d", aff_cpu(a, i));
+		printf(")");
+	}
+	printf("\n");
+	printf("NUMA policy  : %s (%d node%s)\n", numa, a->nb_nodes,
+	       (a->nb_nodes > 1 ? "s" : ""));
+}
+
+#endif /* AFFINITY_H */
@@ -0,0 +1,59 @@
+/*
+ * File:
+ *   batch.h
+ * Description:
+ *   Batched lookups interleaving the traversals of several keys (AMAC,
+ *   asynchronous memory access chaining). A lookup is a small state
+ *   machine whose state is the next node to visit: each step examines a
+ *   node whose cache line was prefetched by the previous step, prefetches
+ *   the next node and moves on to another lookup of the batch. With
+ *   BATCH_WINDOW lookups in flight, the latency of a cache miss overlaps
+ *   with the work of the other lookups instead of stalling the core.
+ *
+ *   A structure provides a *_contains_batch(set, keys, n, results, ...)
+ *   operation that stores in results[i] what its contains operation
+ *   returns for keys[i] and returns the number of keys found. Lookups are
+ *   individually linearizable, not the batch as a whole. With -B n the
+ *   harnesses issue their contains operations by batches of n keys; the
+ *   latency of a batch is then recorded as that of one contains.
+ *
+ * batch.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Largest number of keys per batch issued by the harnesses */
+#define BATCH_MAX                       256
+/* Batching is off by default */
+#define DEFAULT_BATCH                   0
+/* Lookups in flight */
+#define BATCH_WINDOW                    16
+
+#define batch_prefetch(p)               __builtin_prefetch((const void *)(p), 0, 3)
+
+/* Parses the batch size of -B, 0 or 1 disables batching */
+static inline int batch_parse(const char *s) {
+	int n = atoi(s);
+
+	if (n < 0 || n > BATCH_MAX) {
+		fprintf(stderr, "Batch size must be between 0 and %d\n", BATCH_MAX);
+		exit(1);
+	}
+	return n;
+}
+
+#endif /* BATCH_H */
@@ -16,6 +16,31 @@
   char *s;                                                              \
   stm_init();                                                           \
   mod_mem_init();                                                       \
+  if ((s = getenv("STM_CLOCK")) != NULL && !stm_set_parameter("clock", s)) { \
+    fprintf(stderr, "Unknown STM clock: %s\n", s);                     \
+    exit(1);                                                            \
+  }                                                                     \
+  if (stm_get_parameter("clock", &s))                                   \
+    printf("STM clock    : %s\n", s);                                  \
+  if ((s = getenv("STM_CM")) != NULL && !stm_set_parameter("cm", s)) { \
+    fprintf(stderr, "Unknown STM contention manager: %s\n", s);        \
+    exit(1);                                                            \
+  }                                                                     \
+  if ((s = getenv("STM_CM_SERIAL")) != NULL) {                          \
+    int stm_serial = atoi(s);                                           \
+    if (!stm_set_parameter("cm_serial", &stm_serial)) {                 \
+      fprintf(stderr, "Invalid STM serial threshold: %s\n", s);        \
+      exit(1);                                                          \
+    }                                                                   \
+  }                                                                     \
+  if (stm_get_parameter("contention_manager", &s)) {                    \
+    int stm_serial = 0;                                                 \
+    stm_get_parameter("cm_serial", &stm_serial);                        \
+    if (stm_serial > 0)                                                 \
+      printf("STM CM       : %s (serial after %d retries)\n", s, stm_serial); \
+    else                                                                \
+      printf("STM CM       : %s\n", s);                                \
+  }                                                                     \
   if (stm_get_parameter("compile_flags", &s))                           \
     printf("STM flags    : %s\n", s)
 #  define TM_SHUTDOWN()                                                 \
@@ -26,6 +51,40 @@
     printf("#aborts     : %lu\n", u);                                   \
   if (stm_get_stats("global_max_retries", &u) != 0)                     \
     printf("Max retries : %lu\n", u);                                   \
+  if (stm_get_stats("global_nb_cm_waits", &u) != 0)                    \
+    printf("#cm waits     : %lu\n", u);                                 \
+  if (stm_get_stats("global_nb_serial_commits", &u) != 0)              \
+    printf("#serial txs   : %lu\n", u);                                 \
+  {                                                                     \
+    unsigned long stm_retries[STM_RETRY_BUCKETS];                       \
+    int stm_b;                                                          \
+    if (stm_get_stats("global_retries", stm_retries) != 0) {            \
+      printf("Retries/commit:");                                        \
+      for (stm_b = 0; stm_b < STM_RETRY_BUCKETS; stm_b++) {             \
+        if (stm_retries[stm_b] == 0)                                    \
+          continue;                                                     \
+        if (stm_b < 2)                                                  \
+          printf(" %d:%lu", stm_b, stm_retries[stm_b]);                 \
+        else if (stm_b == STM_RETRY_BUCKETS - 1)                        \
+          printf(" %d+:%lu", 1 << (stm_b - 1), stm_retries[stm_b]);     \
+        else                                                            \
+          printf(" %d-%d:%lu", 1 << (stm_b - 1), (1 << stm_b) - 1,      \
+                 stm_retries[stm_b]);                                   \
+      }                                                                 \
+      printf("\n");                                                     \
+    }                                                                   \
+  }                                                                     \
+  if (stm_get_stats("global_nb_read_lookups", &u) != 0)                 \
+    printf("#rset lookups : %lu (indexed)\n", u);                       \
+  if (stm_get_stats("global_nb_read_skipped", &u) != 0)                 \
+    printf("  #skipped    : %lu entries not scanned\n", u);             \
+  if (stm_get_stats("global_nb_read_duplicates", &u) != 0)              \
+    printf("#rset dups    : %lu reads not logged again\n", u);          \
+  if (stm_get_stats("global_nb_ro_commits", &u) != 0) {                \
+    unsigned long stm_fallbacks = 0;                                    \
+    stm_get_stats("global_nb_ro_fallbacks", &stm_fallbacks);            \
+    printf("#ro txs       : %lu (%lu fell back)\n", u, stm_fallbacks);  \
+  }                                                                     \
   stm_exit()
 #  define TM_THREAD_ENTER()              stm_init_thread()
 #  define TM_THREAD_EXIT()                                              \
@@ -0,0 +1,149 @@
+/*
+ * File:
+ *   fc.h
+ * Description:
+ *   Flat combining of the sequential data structures (STM=FC). A thread
+ *   publishes its operation in its own slot and waits for it to be
+ *   applied. The thread that gets the combiner lock scans the slots and
+ *   applies all the pending operations in a batch, its own included, so
+ *   that the structure stays in the cache of the combiner and the lock is
+ *   taken once per batch instead of once per operation.
+ *
+ *   An operation of a structure is wrapped by an adapter that takes the
+ *   set and up to FC_ARGS integer arguments:
+ *
+ *     if (!fc_combiner())
+ *       return fc_apply(fc_sl_add, set, val, transactional, 0, 0);
+ *
+ *   The operations called by the combiner, including those called from
+ *   another operation (e.g., the bucket operations of a hash table), run
+ *   unprotected. There is one combiner lock per process and slots are
+ *   registered on first use, defined as weak symbols like the counters
+ *   of memacct.h.
+ *
+ * fc.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef FC_H
+#define FC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FC_THREADS                      256
+#define FC_ARGS                         4
+/* Scans of the slots by a combiner that keeps finding requests */
+#define FC_PASSES                       4
+
+typedef int (*fc_fn_t)(void *set, long *args);
+
+typedef struct fc_slot {
+	/* Set by the owner to publish, cleared by the combiner */
+	volatile int pending;
+	int result;
+	fc_fn_t fn;
+	void *set;
+	long args[FC_ARGS];
+} __attribute__((aligned(64))) fc_slot_t;
+
+fc_slot_t fc_slots[FC_THREADS] __attribute__((weak));
+int fc_nb_slots __attribute__((weak));
+volatile int fc_lock __attribute__((weak));
+/* Updated by the combiner only */
+unsigned long fc_nb_batches __attribute__((weak));
+unsigned long fc_nb_combined __attribute__((weak));
+__thread fc_slot_t *fc_self __attribute__((weak));
+__thread int fc_combining __attribute__((weak));
+
+static inline void fc_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__("pause" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/* Whether the calling thread is the combiner applying operations */
+static inline int fc_combiner(void) {
+	return fc_combining;
+}
+
+static inline fc_slot_t *fc_slot(void) {
+	int id;
+
+	if (fc_self != NULL)
+		return fc_self;
+	if ((id = __sync_fetch_and_add(&fc_nb_slots, 1)) >= FC_THREADS) {
+		fprintf(stderr, "FC: more than %d threads\n", FC_THREADS);
+		exit(1);
+	}
+	fc_self = &fc_slots[id];
+	return fc_self;
+}
+
+/* Applies the pending operations, called with the combiner lock held */
+static inline void fc_combine(void) {
+	fc_slot_t *s;
+	int i, n, pass, served;
+
+	fc_combining = 1;
+	fc_nb_batches++;
+	for (pass = 0; pass < FC_PASSES; pass++) {
+		n = __atomic_load_n(&fc_nb_slots, __ATOMIC_ACQUIRE);
+		if (n > FC_THREADS)
+			n = FC_THREADS;
+		served = 0;
+		for (i = 0; i < n; i++) {
+			s = &fc_slots[i];
+			if (!__atomic_load_n(&s->pending, __ATOMIC_ACQUIRE))
+				continue;
+			s->result = s->fn(s->set, s->args);
+			__atomic_store_n(&s->pending, 0, __ATOMIC_RELEASE);
+			served++;
+		}
+		fc_nb_combined += served;
+		if (served == 0)
+			break;
+	}
+	fc_combining = 0;
+}
+
+static inline int fc_apply(fc_fn_t fn, void *set, long a0, long a1, long a2, long a3) {
+	fc_slot_t *s = fc_slot();
+
+	s->fn = fn;
+	s->set = set;
+	s->args[0] = a0;
+	s->args[1] = a1;
+	s->args[2] = a2;
+	s->args[3] = a3;
+	__atomic_store_n(&s->pending, 1, __ATOMIC_RELEASE);
+	while (__atomic_load_n(&s->pending, __ATOMIC_ACQUIRE)) {
+		if (fc_lock == 0 && __sync_bool_compare_and_swap(&fc_lock, 0, 1)) {
+			/* The request is pending until served by this batch */
+			fc_combine();
+			__atomic_store_n(&fc_lock, 0, __ATOMIC_RELEASE);
+		} else {
+			fc_pause();
+		}
+	}
+	return s->result;
+}
+
+static inline void fc_print(void) {
+	printf("Combining     : %lu batches, %.2f ops / batch\n", fc_nb_batches,
+	       fc_nb_batches ? (double)fc_nb_combined / fc_nb_batches : 0.0);
+}
+
+#endif /* FC_H */
@@ -3,6 +3,7 @@ __attribute__((tm_wrapping(malloc))) void *wlpdstm_icc_malloc(size_t size);
 __attribute__((tm_wrapping(free))) void wlpdstm_icc_free(void *ptr);
 #  define NL                             1
 #  define EL                             0
+#  define RO                             2
 #  define START                          __tm_atomic {
 #  define START_ID(ID)                   __tm_atomic {
 #  define START_RO                       __tm_atomic {
@@ -0,0 +1,338 @@
+/*
+ * File:
+ *   latency.h
+ * Description:
+ *   Per-thread latency histograms of the set operations.
+ *   One operation out of `period' is timed with the time-stamp counter and
+ *   recorded in a log-bucketed histogram (8 sub-buckets per power of two,
+ *   i.e., less than 12.5% relative error), kept per operation type and per
+ *   outcome. Histograms of all threads are merged at the end of the run
+ *   and printed as percentiles.
+ *
+ *   In open-loop mode, each thread issues its operations on a schedule of
+ *   constant or exponential (Poisson process) inter-arrival times instead
+ *   of back to back. The latency of an operation is then measured from
+ *   its intended start time, so that the queueing delay of the operations
+ *   delayed by a slow one is accounted for (no coordinated omission).
+ *
+ * latency.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_LATENCY                 0
+#define DEFAULT_RATE                    0
+#define DEFAULT_ARRIVAL                 "poisson"
+
+#define LAT_SUB_BITS                    3
+#define LAT_SUB                         (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS                     ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+/* Operation types */
+#define LAT_CONTAINS                    0
+#define LAT_ADD                         1
+#define LAT_REMOVE                      2
+#define LAT_RANGE                       3
+#define LAT_MOVE                        4
+#define LAT_SNAPSHOT                    5
+#define LAT_NB_OPS                      6
+
+typedef struct lat_hist {
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[LAT_BUCKETS];
+} lat_hist_t;
+
+typedef struct lat_stats {
+	unsigned long period;
+	unsigned long countdown;
+	/* Open loop: operations per second of the thread (0 = closed loop) */
+	double rate;
+	int poisson;
+	double gap;
+	uint64_t next;
+	uint64_t rng;
+	/* Start time of the operation timed by LAT_OP (0 = not sampled) */
+	uint64_t op_start;
+	/* [op][0] = not found/already present/absent, [op][1] = otherwise */
+	lat_hist_t hist[LAT_NB_OPS][2];
+} lat_stats_t;
+
+static inline uint64_t lat_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline int lat_bucket(uint64_t v) {
+	int e;
+
+	if (v < LAT_SUB)
+		return (int)v;
+	e = 63 - __builtin_clzll(v);
+	return (e - LAT_SUB_BITS + 1) * LAT_SUB
+		+ (int)((v >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+/* Largest value falling in bucket b */
+static inline uint64_t lat_bucket_max(int b) {
+	int e;
+
+	if (b < LAT_SUB)
+		return (uint64_t)b;
+	e = b / LAT_SUB + LAT_SUB_BITS - 1;
+	return (((uint64_t)(LAT_SUB + b % LAT_SUB + 1)) << (e - LAT_SUB_BITS)) - 1;
+}
+
+/* Time-stamp counter ticks per nanosecond, measured once over 50 ms */
+static inline double lat_ticks_per_ns(void) {
+	static double tpn = 0;
+	struct timespec s, e, d = { 0, 50000000 };
+	uint64_t t0, t1;
+
+	if (tpn > 0)
+		return tpn;
+	clock_gettime(CLOCK_MONOTONIC, &s);
+	t0 = lat_ticks();
+	nanosleep(&d, NULL);
+	t1 = lat_ticks();
+	clock_gettime(CLOCK_MONOTONIC, &e);
+	tpn = (double)(t1 - t0) /
+		((e.tv_sec - s.tv_sec) * 1e9 + (e.tv_nsec - s.tv_nsec));
+	return tpn;
+}
+
+/*
+ * Returns the statistics of a thread sampling one operation out of
+ * period, or NULL if period is 0 (latency measurement disabled).
+ */
+static inline lat_stats_t *lat_new(unsigned long period) {
+	lat_stats_t *l;
+
+	if (period == 0)
+		return NULL;
+	if ((l = (lat_stats_t *)calloc(1, sizeof(lat_stats_t))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	l->period = period;
+	l->countdown = period;
+	return l;
+}
+
+/* Parses the arrival process, exits with an error message if invalid */
+static inline int lat_poisson(const char *arrival) {
+	if (!strcmp(arrival, "poisson"))
+		return 1;
+	if (!strcmp(arrival, "constant"))
+		return 0;
+	fprintf(stderr, "Unknown arrival process: %s\n", arrival);
+	exit(1);
+}
+
+/*
+ * Switches the thread to open loop, issuing rate operations per second
+ * with Poisson (or constant if poisson is 0) arrivals.
+ */
+static inline void lat_open(lat_stats_t *l, double rate, int poisson,
+			    unsigned int seed) {
+	if (l == NULL || rate <= 0)
+		return;
+	l->rate = rate;
+	l->poisson = poisson;
+	/* Mean inter-arrival time in ticks */
+	l->gap = lat_ticks_per_ns() * 1e9 / rate;
+	l->next = 0;
+	l->rng = 0x9E3779B97F4A7C15ULL * (seed + 1);
+}
+
+/* Waits for the intended start time of the next operation and returns it */
+static inline uint64_t lat_schedule(lat_stats_t *l) {
+	struct timespec d;
+	uint64_t t = l->next, now = lat_ticks(), x;
+	double u, gap = l->gap, tpn = lat_ticks_per_ns();
+
+	if (t == 0)
+		t = now;
+	/*
+	 * Sleep if the next operation is more than 1 ms away, waking up early
+	 * enough to absorb the timer slack, then spin.
+	 */
+	if (t > now && (t - now) / tpn > 1000000) {
+		d.tv_sec = 0;
+		d.tv_nsec = (long)((t - now) / tpn) - 500000;
+		if (d.tv_nsec > 999999999L)
+			d.tv_nsec = 999999999L;
+		nanosleep(&d, NULL);
+	}
+	while (lat_ticks() < t);
+	if (l->poisson) {
+		x = l->rng;
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+		l->rng = x;
+		u = ((x * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+		gap = -log1p(-u) * l->gap;
+	}
+	/* Late operations keep their schedule, their delay is part of latency */
+	l->next = t + (uint64_t)gap;
+	return t;
+}
+
+/* Returns the start time of the operation if sampled, 0 otherwise */
+static inline uint64_t lat_start(lat_stats_t *l) {
+	uint64_t t;
+
+	if (l == NULL)
+		return 0;
+	if (l->rate > 0) {
+		t = lat_schedule(l);
+		if (--l->countdown != 0)
+			return 0;
+		l->countdown = l->period;
+		return t;
+	}
+	if (--l->countdown != 0)
+		return 0;
+	l->countdown = l->period;
+	return lat_ticks();
+}
+
+static inline void lat_end(lat_stats_t *l, uint64_t t0, int op, int outcome) {
+	lat_hist_t *h;
+	uint64_t t;
+
+	if (t0 == 0)
+		return;
+	t = lat_ticks() - t0;
+	h = &l->hist[op][outcome > 0];
+	h->count++;
+	h->buckets[lat_bucket(t)]++;
+	if (t > h->max)
+		h->max = t;
+}
+
+static inline void lat_op_start(lat_stats_t *l) {
+	uint64_t t0 = lat_start(l);
+
+	if (l != NULL)
+		l->op_start = t0;
+}
+
+static inline int lat_op_end(lat_stats_t *l, int op, int r) {
+	if (l != NULL)
+		lat_end(l, l->op_start, op, r);
+	return r;
+}
+
+/* Evaluates the operation expr, timing it if sampled. The comma operator
+ * starts the clock before expr is evaluated. */
+#define LAT_OP(l, op, expr)						\
+	(lat_op_start(l), lat_op_end(l, op, (expr)))
+
+static inline void lat_merge_hist(lat_hist_t *d, lat_hist_t *s) {
+	int b;
+
+	d->count += s->count;
+	if (s->max > d->max)
+		d->max = s->max;
+	for (b = 0; b < LAT_BUCKETS; b++)
+		d->buckets[b] += s->buckets[b];
+}
+
+static inline void lat_merge(lat_stats_t *dst, lat_stats_t *src) {
+	int op, o;
+
+	if (src == NULL)
+		return;
+	/* Offered rates of the threads add up */
+	dst->rate += src->rate;
+	for (op = 0; op < LAT_NB_OPS; op++)
+		for (o = 0; o < 2; o++)
+			lat_merge_hist(&dst->hist[op][o], &src->hist[op][o]);
+}
+
+static inline uint64_t lat_percentile(lat_hist_t *h, double p) {
+	uint64_t rank, sum = 0;
+	int b;
+
+	rank = (uint64_t)(p * h->count / 100.0);
+	if (rank >= h->count)
+		return h->max;
+	for (b = 0; b < LAT_BUCKETS; b++) {
+		sum += h->buckets[b];
+		if (sum > rank)
+			return (lat_bucket_max(b) < h->max ? lat_bucket_max(b) : h->max);
+	}
+	return h->max;
+}
+
+static inline void lat_print(lat_stats_t *l) {
+	static const char *names[LAT_NB_OPS][2] = {
+		{ "contains/missing", "contains/found" },
+		{ "add/present", "add/added" },
+		{ "remove/absent", "remove/removed" },
+		{ "range/empty", "range/keys" },
+		{ "move/failed", "move/moved" },
+		{ "snapshot/failed", "snapshot/taken" }
+	};
+	static const double pcts[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+	double tpn = lat_ticks_per_ns();
+	lat_hist_t all, *h;
+	int op, o, p;
+
+	/* All operations together */
+	memset(&all, 0, sizeof(all));
+	for (op = 0; op < LAT_NB_OPS; op++)
+		for (o = 0; o < 2; o++)
+			lat_merge_hist(&all, &l->hist[op][o]);
+
+	if (l->rate > 0)
+		printf("Latency (ns)  : open loop at %.0f ops/s from intended start,"
+		       " 1 op sampled out of %lu\n", l->rate, l->period);
+	else
+		printf("Latency (ns)  : 1 op sampled out of %lu\n", l->period);
+	printf("  %-16s %10s %9s %9s %9s %9s %9s %9s\n", "op/outcome",
+	       "#samples", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+	for (op = 0; op <= LAT_NB_OPS; op++) {
+		for (o = 1; o >= 0; o--) {
+			if (op == LAT_NB_OPS && o == 0)
+				continue;
+			h = (op == LAT_NB_OPS ? &all : &l->hist[op][o]);
+			if (h->count == 0)
+				continue;
+			printf("  %-16s %10lu", (h == &all ? "all" : names[op][o]),
+			       (unsigned long)h->count);
+			for (p = 0; p < sizeof(pcts) / sizeof(pcts[0]); p++)
+				printf(" %9.0f", lat_percentile(h, pcts[p]) / tpn);
+			printf(" %9.0f\n", h->max / tpn);
+		}
+	}
+}
+
+#endif /* LATENCY_H */
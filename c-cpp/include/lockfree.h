@@ -1,6 +1,7 @@
 
 #  define NL                             1
 #  define EL                             0
+#  define RO                             2
 #  define TX_START(type)                 /* nothing */
 #  define TX_LOAD(addr)                  (*(addr))
 #  define TX_STORE(addr, val)            (*(addr) = (val))
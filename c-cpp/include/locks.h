@@ -0,0 +1,421 @@
+/*
+ * File:
+ *   locks.h
+ * Description:
+ *   Lock library of the lock-based data structures. A structure declares
+ *   its locks as ptlock_t and uses INIT_LOCK, DESTROY_LOCK, LOCK and
+ *   UNLOCK. The implementation is selected at build time (LOCK= in the
+ *   Makefiles):
+ *
+ *   MUTEX   pthread mutex
+ *   SPIN    pthread spinlock (default)
+ *   TTAS    test-and-test-and-set with exponential backoff
+ *   TICKET  ticket lock with backoff proportional to the queue position
+ *   MCS     MCS queue lock, each waiter spins on its own queue node
+ *   CLH     CLH queue lock, each waiter spins on its predecessor's node
+ *   COHORT  NUMA cohort lock (C-TKT-TKT): a global ticket lock and one
+ *           ticket lock per NUMA node. The global lock is passed to a
+ *           waiter of the same node up to LOCK_COHORT_BATCH times in a
+ *           row before it is released to the other nodes.
+ *
+ *   The queue nodes of MCS and CLH are taken from a pool of the thread
+ *   and recycled, so a thread can hold several locks at once (e.g., hand
+ *   over hand locking). The lock records the queue node of its holder for
+ *   the release. LOCK and UNLOCK return 0 on success like their pthread
+ *   counterparts. A CLH lock owns one queue node while it is free, and a
+ *   cohort lock takes LOCK_COHORT_NODES local locks: these make the locks
+ *   embedded in the nodes of a structure larger.
+ *
+ * locks.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+/* Former selection of the lock-based structures */
+#if defined(MUTEX) && !defined(LOCK_MUTEX)
+#  define LOCK_MUTEX
+#endif
+
+#if !defined(LOCK_MUTEX) && !defined(LOCK_TTAS) && !defined(LOCK_TICKET) \
+	&& !defined(LOCK_MCS) && !defined(LOCK_CLH) && !defined(LOCK_COHORT)
+#  ifndef LOCK_SPIN
+#    define LOCK_SPIN
+#  endif
+#endif
+
+#define LOCK_BACKOFF_MIN                4
+#define LOCK_BACKOFF_MAX                1024
+/* Pauses per thread ahead in the queue of a ticket lock */
+#define LOCK_TICKET_PAUSE               16
+#define LOCK_COHORT_NODES               4
+/* Consecutive local hand-offs of a cohort lock */
+#define LOCK_COHORT_BATCH               64
+
+static inline void lock_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__("pause" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/* Waits for *b pauses and doubles *b up to LOCK_BACKOFF_MAX */
+static inline void lock_backoff(unsigned int *b) {
+	unsigned int i;
+
+	for (i = 0; i < *b; i++)
+		lock_pause();
+	if (*b < LOCK_BACKOFF_MAX)
+		*b <<= 1;
+}
+
+#if defined(LOCK_MCS) || defined(LOCK_CLH)
+
+typedef struct lock_qnode {
+	struct lock_qnode *volatile next;
+	volatile int locked;
+	/* Link in the pool of the thread */
+	struct lock_qnode *free;
+} __attribute__((aligned(64))) lock_qnode_t;
+
+__thread lock_qnode_t *lock_pool __attribute__((weak));
+
+static inline lock_qnode_t *lock_qnode_get(void) {
+	lock_qnode_t *n;
+	void *p;
+
+	if ((n = lock_pool) != NULL) {
+		lock_pool = n->free;
+		return n;
+	}
+	if (posix_memalign(&p, 64, sizeof(lock_qnode_t)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	return (lock_qnode_t *)p;
+}
+
+static inline void lock_qnode_put(lock_qnode_t *n) {
+	n->free = lock_pool;
+	lock_pool = n;
+}
+
+#endif /* LOCK_MCS || LOCK_CLH */
+
+#if defined(LOCK_MUTEX)
+
+#  define LOCK_NAME                     "MUTEX"
+typedef pthread_mutex_t ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	pthread_mutex_init(l, NULL);
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+	pthread_mutex_destroy(l);
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	return pthread_mutex_lock(l);
+}
+
+static inline int lock_release(ptlock_t *l) {
+	return pthread_mutex_unlock(l);
+}
+
+#elif defined(LOCK_SPIN)
+
+#  define LOCK_NAME                     "SPIN"
+typedef pthread_spinlock_t ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	pthread_spin_init(l, PTHREAD_PROCESS_PRIVATE);
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+	pthread_spin_destroy(l);
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	return pthread_spin_lock(l);
+}
+
+static inline int lock_release(ptlock_t *l) {
+	return pthread_spin_unlock(l);
+}
+
+#elif defined(LOCK_TTAS)
+
+#  define LOCK_NAME                     "TTAS"
+typedef struct {
+	volatile uint32_t held;
+} ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	l->held = 0;
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	unsigned int b = LOCK_BACKOFF_MIN;
+
+	for (;;) {
+		while (l->held)
+			lock_pause();
+		if (__sync_lock_test_and_set(&l->held, 1) == 0)
+			return 0;
+		lock_backoff(&b);
+	}
+}
+
+static inline int lock_release(ptlock_t *l) {
+	__sync_lock_release(&l->held);
+	return 0;
+}
+
+#elif defined(LOCK_TICKET) || defined(LOCK_COHORT)
+
+typedef struct {
+	volatile uint32_t next;
+	volatile uint32_t owner;
+} lock_ticket_t;
+
+static inline void lock_ticket_acquire(lock_ticket_t *l) {
+	uint32_t t = __sync_fetch_and_add(&l->next, 1);
+	uint32_t i, d;
+
+	while ((d = t - l->owner) != 0)
+		for (i = 0; i < d * LOCK_TICKET_PAUSE; i++)
+			lock_pause();
+	__sync_synchronize();
+}
+
+static inline void lock_ticket_release(lock_ticket_t *l) {
+	__atomic_store_n(&l->owner, l->owner + 1, __ATOMIC_RELEASE);
+}
+
+#  ifdef LOCK_TICKET
+
+#    define LOCK_NAME                   "TICKET"
+typedef lock_ticket_t ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	l->next = 0;
+	l->owner = 0;
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	lock_ticket_acquire(l);
+	return 0;
+}
+
+static inline int lock_release(ptlock_t *l) {
+	lock_ticket_release(l);
+	return 0;
+}
+
+#  else /* LOCK_COHORT */
+
+#    define LOCK_NAME                   "COHORT"
+typedef struct {
+	lock_ticket_t ticket;
+	/* Set when the global lock was passed within the node */
+	volatile uint32_t passed;
+	uint32_t batch;
+} lock_cohort_local_t;
+
+typedef struct {
+	lock_ticket_t global;
+	lock_cohort_local_t local[LOCK_COHORT_NODES];
+	int node;
+} ptlock_t;
+
+__thread int lock_node __attribute__((weak)) = -1;
+
+/* Returns the NUMA node of the calling thread, read once */
+static inline int lock_self_node(void) {
+	unsigned int cpu = 0, node = 0;
+
+	if (lock_node < 0) {
+#ifdef __linux__
+		if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+			node = 0;
+#endif /* __linux__ */
+		lock_node = node % LOCK_COHORT_NODES;
+	}
+	return lock_node;
+}
+
+static inline void lock_init(ptlock_t *l) {
+	int i;
+
+	l->global.next = 0;
+	l->global.owner = 0;
+	for (i = 0; i < LOCK_COHORT_NODES; i++) {
+		l->local[i].ticket.next = 0;
+		l->local[i].ticket.owner = 0;
+		l->local[i].passed = 0;
+		l->local[i].batch = 0;
+	}
+	l->node = 0;
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	int node = lock_self_node();
+	lock_cohort_local_t *c = &l->local[node];
+
+	lock_ticket_acquire(&c->ticket);
+	if (c->passed)
+		c->passed = 0;
+	else
+		lock_ticket_acquire(&l->global);
+	l->node = node;
+	return 0;
+}
+
+static inline int lock_release(ptlock_t *l) {
+	lock_cohort_local_t *c = &l->local[l->node];
+
+	/* Passes the global lock if another thread of the node waits */
+	if (c->ticket.next - c->ticket.owner > 1 && c->batch < LOCK_COHORT_BATCH) {
+		c->batch++;
+		c->passed = 1;
+	} else {
+		c->batch = 0;
+		lock_ticket_release(&l->global);
+	}
+	lock_ticket_release(&c->ticket);
+	return 0;
+}
+
+#  endif /* LOCK_COHORT */
+
+#elif defined(LOCK_MCS)
+
+#  define LOCK_NAME                     "MCS"
+typedef struct {
+	lock_qnode_t *volatile tail;
+	lock_qnode_t *holder;
+} ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	l->tail = NULL;
+	l->holder = NULL;
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	lock_qnode_t *n = lock_qnode_get(), *pred;
+
+	n->next = NULL;
+	n->locked = 1;
+	pred = __atomic_exchange_n(&l->tail, n, __ATOMIC_ACQ_REL);
+	if (pred != NULL) {
+		pred->next = n;
+		while (n->locked)
+			lock_pause();
+		__sync_synchronize();
+	}
+	l->holder = n;
+	return 0;
+}
+
+static inline int lock_release(ptlock_t *l) {
+	lock_qnode_t *n = l->holder;
+
+	if (n->next == NULL) {
+		if (__sync_bool_compare_and_swap(&l->tail, n, NULL)) {
+			lock_qnode_put(n);
+			return 0;
+		}
+		/* A successor is enqueuing itself */
+		while (n->next == NULL)
+			lock_pause();
+	}
+	__atomic_store_n(&n->next->locked, 0, __ATOMIC_RELEASE);
+	lock_qnode_put(n);
+	return 0;
+}
+
+#elif defined(LOCK_CLH)
+
+#  define LOCK_NAME                     "CLH"
+typedef struct {
+	lock_qnode_t *volatile tail;
+	lock_qnode_t *holder;
+	lock_qnode_t *pred;
+} ptlock_t;
+
+static inline void lock_init(ptlock_t *l) {
+	lock_qnode_t *n = lock_qnode_get();
+
+	n->locked = 0;
+	l->tail = n;
+	l->holder = NULL;
+	l->pred = NULL;
+}
+
+static inline void lock_destroy(ptlock_t *l) {
+	lock_qnode_put(l->tail);
+}
+
+static inline int lock_acquire(ptlock_t *l) {
+	lock_qnode_t *n = lock_qnode_get(), *pred;
+
+	n->locked = 1;
+	pred = __atomic_exchange_n(&l->tail, n, __ATOMIC_ACQ_REL);
+	while (pred->locked)
+		lock_pause();
+	__sync_synchronize();
+	l->holder = n;
+	l->pred = pred;
+	return 0;
+}
+
+static inline int lock_release(ptlock_t *l) {
+	lock_qnode_t *n = l->holder, *pred = l->pred;
+
+	__atomic_store_n(&n->locked, 0, __ATOMIC_RELEASE);
+	/* The node of the predecessor is no longer observed by anyone */
+	lock_qnode_put(pred);
+	return 0;
+}
+
+#endif
+
+#define INIT_LOCK(lock)                 lock_init((ptlock_t *)(lock))
+#define DESTROY_LOCK(lock)              lock_destroy((ptlock_t *)(lock))
+#define LOCK(lock)                      lock_acquire((ptlock_t *)(lock))
+#define UNLOCK(lock)                    lock_release((ptlock_t *)(lock))
+
+#endif /* LOCKS_H */
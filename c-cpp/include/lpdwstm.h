@@ -2,6 +2,7 @@
 #  include "stm.h"
 #  define NL                             1
 #  define EL                             0 
+#  define RO                             2
 #  define TX_START(type)                 BEGIN_TRANSACTION 
 #  define TX_LOAD(addr)                  wlpdstm_read_word((Word *)(addr)) 
 #  define TX_STORE(addr, val)            wlpdstm_write_word((Word *)addr, (Word)val) 
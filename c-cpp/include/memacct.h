@@ -0,0 +1,90 @@
+/*
+ * File:
+ *   memacct.h
+ * Description:
+ *   Memory footprint accounting of the data structures. The allocators of
+ *   a structure report the bytes they hand out (ma_alloc), free directly
+ *   (ma_free), retire to deferred reclamation (ma_retire) and eventually
+ *   reclaim or recycle (ma_reclaim). At the end of a run the harness
+ *   prints the live bytes, the bytes per element, the garbage retired but
+ *   not reclaimed yet and the peak resident set size of the process.
+ *
+ *   Counters are kept per thread in cache-line-sized slots so that
+ *   accounting does not add contention to the allocation paths. They are
+ *   defined as weak symbols so that every file of a benchmark including
+ *   this header shares the same counters without a separate object file.
+ *
+ * memacct.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef MEMACCT_H
+#define MEMACCT_H
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+#define MA_SLOTS                        256
+
+typedef struct ma_slot {
+	long live;
+	long garbage;
+	char padding[64 - 2 * sizeof(long)];
+} ma_slot_t;
+
+ma_slot_t ma_slots[MA_SLOTS] __attribute__((weak, aligned(64)));
+int ma_nb_slots __attribute__((weak));
+__thread ma_slot_t *ma_self __attribute__((weak));
+
+/* Returns the slot of the calling thread, shared modulo MA_SLOTS */
+static inline ma_slot_t *ma_slot(void) {
+	if (ma_self == NULL)
+		ma_self = &ma_slots[__sync_fetch_and_add(&ma_nb_slots, 1) % MA_SLOTS];
+	return ma_self;
+}
+
+static inline void ma_alloc(long size) {
+	__sync_fetch_and_add(&ma_slot()->live, size);
+}
+
+static inline void ma_free(long size) {
+	__sync_fetch_and_sub(&ma_slot()->live, size);
+}
+
+static inline void ma_retire(long size) {
+	ma_slot_t *s = ma_slot();
+
+	__sync_fetch_and_sub(&s->live, size);
+	__sync_fetch_and_add(&s->garbage, size);
+}
+
+static inline void ma_reclaim(long size) {
+	__sync_fetch_and_sub(&ma_slot()->garbage, size);
+}
+
+/* Prints the memory footprint of a structure of size elements */
+static inline void ma_print(long size) {
+	struct rusage ru;
+	long live = 0, garbage = 0;
+	int i;
+
+	for (i = 0; i < MA_SLOTS; i++) {
+		live += ma_slots[i].live;
+		garbage += ma_slots[i].garbage;
+	}
+	printf("Memory        : %ld bytes live (%.2f / element), %ld bytes garbage\n",
+	       live, (size > 0 ? (double)live / size : 0.0), garbage);
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		printf("  Peak RSS    : %ld kB\n", ru.ru_maxrss);
+}
+
+#endif /* MEMACCT_H */
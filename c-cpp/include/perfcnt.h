@@ -0,0 +1,207 @@
+/*
+ * File:
+ *   perfcnt.h
+ * Description:
+ *   Per-thread hardware performance counters of the benchmark harnesses.
+ *   Each worker thread opens its own counters with perf_event_open(2),
+ *   counting only the calling thread in user mode, enables them once it
+ *   crossed the start barrier and reads them when it leaves the benchmark
+ *   loop. Counters of all threads are summed and printed per operation.
+ *
+ *   The cross-core HITM count (loads hitting a modified line in another
+ *   core's cache) uses the Intel raw event MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM
+ *   (event 0xd2, umask 0x04), it can be changed by defining PC_HITM_RAW
+ *   and is reported as n/a on other processors. Counters that cannot be
+ *   opened (e.g., in virtual machines without a virtual PMU or when
+ *   /proc/sys/kernel/perf_event_paranoid is too restrictive) are also
+ *   reported as n/a. Counters multiplexed by the kernel are scaled.
+ *
+ * perfcnt.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PERFCNT_H
+#define PERFCNT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif /* __linux__ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define DEFAULT_COUNTERS                0
+
+#ifndef PC_HITM_RAW
+#define PC_HITM_RAW                     0x04d2
+#endif
+
+#define PC_CYCLES                       0
+#define PC_INSTRUCTIONS                 1
+#define PC_L1D_MISSES                   2
+#define PC_LLC_MISSES                   3
+#define PC_DTLB_MISSES                  4
+#define PC_BRANCH_MISSES                5
+#define PC_HITM                         6
+#define PC_NB_EVENTS                    7
+
+typedef struct pc_stats {
+	int fd[PC_NB_EVENTS];
+	/* Number of threads that measured each event */
+	int valid[PC_NB_EVENTS];
+	uint64_t value[PC_NB_EVENTS];
+} pc_stats_t;
+
+/* Returns the counters of a thread, or NULL if enabled is 0 */
+static inline pc_stats_t *pc_new(int enabled) {
+	pc_stats_t *pc;
+	int e;
+
+	if (!enabled)
+		return NULL;
+	if ((pc = (pc_stats_t *)calloc(1, sizeof(pc_stats_t))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	for (e = 0; e < PC_NB_EVENTS; e++)
+		pc->fd[e] = -1;
+	return pc;
+}
+
+static inline int pc_intel(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(0, &a, &b, &c, &d))
+		return 0;
+	/* "GenuineIntel" */
+	return (b == 0x756e6547 && d == 0x49656e69 && c == 0x6c65746e);
+#else
+	return 0;
+#endif
+}
+
+#ifdef __linux__
+static inline int pc_open_event(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#define PC_CACHE_MISS(cache)						\
+	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8)			\
+	 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#endif /* __linux__ */
+
+/* Opens the counters of the calling thread, disabled */
+static inline void pc_open(pc_stats_t *pc) {
+	if (pc == NULL)
+		return;
+#ifdef __linux__
+	pc->fd[PC_CYCLES] = pc_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	pc->fd[PC_INSTRUCTIONS] = pc_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	pc->fd[PC_L1D_MISSES] = pc_open_event(PERF_TYPE_HW_CACHE, PC_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D));
+	pc->fd[PC_LLC_MISSES] = pc_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	pc->fd[PC_DTLB_MISSES] = pc_open_event(PERF_TYPE_HW_CACHE, PC_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB));
+	pc->fd[PC_BRANCH_MISSES] = pc_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	if (pc_intel())
+		pc->fd[PC_HITM] = pc_open_event(PERF_TYPE_RAW, PC_HITM_RAW);
+#endif /* __linux__ */
+}
+
+/* Resets and enables the counters of the calling thread */
+static inline void pc_start(pc_stats_t *pc) {
+	int e;
+
+	if (pc == NULL)
+		return;
+#ifdef __linux__
+	for (e = 0; e < PC_NB_EVENTS; e++) {
+		if (pc->fd[e] < 0)
+			continue;
+		ioctl(pc->fd[e], PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif /* __linux__ */
+}
+
+/* Disables, reads and closes the counters of the calling thread */
+static inline void pc_stop(pc_stats_t *pc) {
+	uint64_t v[3];
+	int e;
+
+	if (pc == NULL)
+		return;
+	for (e = 0; e < PC_NB_EVENTS; e++) {
+		if (pc->fd[e] < 0)
+			continue;
+#ifdef __linux__
+		ioctl(pc->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+#endif /* __linux__ */
+		/* value, time enabled, time running */
+		if (read(pc->fd[e], v, sizeof(v)) == sizeof(v) && v[2] > 0) {
+			pc->value[e] = (uint64_t)((double)v[0] * v[1] / v[2]);
+			pc->valid[e] = 1;
+		}
+		close(pc->fd[e]);
+		pc->fd[e] = -1;
+	}
+}
+
+static inline void pc_merge(pc_stats_t *dst, pc_stats_t *src) {
+	int e;
+
+	if (src == NULL)
+		return;
+	for (e = 0; e < PC_NB_EVENTS; e++) {
+		dst->value[e] += src->value[e];
+		dst->valid[e] += src->valid[e];
+	}
+}
+
+static inline void pc_print(pc_stats_t *pc, unsigned long ops) {
+	static const char *names[PC_NB_EVENTS] = {
+		"cycles", "instructions", "L1D misses", "LLC misses",
+		"dTLB misses", "branch misses", "HITM"
+	};
+	int e;
+
+	printf("Counters/op   :");
+	for (e = 0; e < PC_NB_EVENTS; e++) {
+		if (pc->valid[e] == 0 || ops == 0)
+			printf(" %s n/a%s", names[e], (e < PC_NB_EVENTS - 1 ? "," : ""));
+		else
+			printf(" %s %.2f%s", names[e], (double)pc->value[e] / ops,
+			       (e < PC_NB_EVENTS - 1 ? "," : ""));
+	}
+	printf("\n");
+	if (pc->valid[PC_CYCLES] && pc->valid[PC_INSTRUCTIONS] && pc->value[PC_CYCLES])
+		printf("  IPC         : %.2f\n",
+		       (double)pc->value[PC_INSTRUCTIONS] / pc->value[PC_CYCLES]);
+}
+
+#endif /* PERFCNT_H */
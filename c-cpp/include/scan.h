@@ -0,0 +1,103 @@
+/*
+ * File:
+ *   scan.h
+ * Description:
+ *   Range scans of the ordered set benchmarks (skip lists and trees).
+ *   With -R p, p% of the operations collect the keys of [k;k+q-1], where
+ *   k is drawn from the key distribution and q is the scan length given
+ *   with -Q. Scans are drawn among the read operations, so that -u keeps
+ *   giving the percentage of updates, and they are timed as LAT_RANGE.
+ *
+ *   A structure provides range_count(lo, hi), range_collect(lo, hi,
+ *   keys, max) and successor(k) operations under its own naming, and -q
+ *   selects the one the scans run (collect by default). For successor
+ *   queries the keys per scan are the ratio of queries that found a key.
+ *   The operations are not linearizable but weakly consistent, like the
+ *   iterators of java.util.concurrent.ConcurrentSkipListMap: keys are
+ *   reported in increasing order and at most once, a key present during
+ *   the whole scan is reported, a key absent during the whole scan is
+ *   not, and a key inserted or removed during the scan may or may not be
+ *   reported. successor(k) returns the smallest key above k, with the
+ *   semantics of a scan of [k+1;max].
+ *
+ * scan.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+#define DEFAULT_SCAN                    0
+#define DEFAULT_SCAN_LENGTH             100
+#define DEFAULT_SCAN_OP                 "collect"
+
+/* Operations of a scan, selected with -q */
+#define SCAN_COLLECT                    0
+#define SCAN_COUNT                      1
+#define SCAN_SUCCESSOR                  2
+
+/* Checks -R and -Q against the update rate */
+static inline void scan_check(int update, int scan, int length) {
+	if (scan < 0 || scan > 100 - update) {
+		fprintf(stderr, "Range scan rate must be between 0 and 100 - update rate\n");
+		exit(1);
+	}
+	if (length < 1) {
+		fprintf(stderr, "Scan length must be positive\n");
+		exit(1);
+	}
+}
+
+static inline int scan_parse(const char *op) {
+	if (strcmp(op, "collect") == 0)
+		return SCAN_COLLECT;
+	if (strcmp(op, "count") == 0)
+		return SCAN_COUNT;
+	if (strcmp(op, "successor") == 0)
+		return SCAN_SUCCESSOR;
+	fprintf(stderr, "Unknown scan operation: %s (collect, count or successor)\n", op);
+	exit(1);
+}
+
+static inline const char *scan_name(int op) {
+	switch (op) {
+	case SCAN_COUNT:
+		return "count";
+	case SCAN_SUCCESSOR:
+		return "successor";
+	default:
+		return "collect";
+	}
+}
+
+/* Whether the next read operation is a range scan */
+static inline int scan_next(wl_thread_t *wl, int update, int scan) {
+	return scan > 0 && wl_rand_range(wl, 100 - update) - 1 < scan;
+}
+
+/* Highest key of the scan starting at lo, no key is above range */
+static inline long scan_hi(long lo, int length, long range) {
+	return (lo + length - 1 < range ? lo + length - 1 : range);
+}
+
+static inline void scan_print(unsigned long scans, unsigned long keys, int duration) {
+	printf("  #scans      : %lu (%f / s), %.1f keys / scan\n", scans,
+	       scans * 1000.0 / duration, scans ? (double)keys / scans : 0.0);
+}
+
+#endif /* SCAN_H */
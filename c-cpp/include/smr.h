@@ -0,0 +1,369 @@
+/*
+ * File:
+ *   smr.h
+ * Description:
+ *   Safe memory reclamation of the lock-free data structures. Nodes are
+ *   allocated with smr_alloc(), and a node unlinked from a structure is
+ *   handed to smr_retire() by the thread that unlinked it. It is freed
+ *   once no thread can hold a reference to it any more. Operations are
+ *   bracketed by smr_begin() and smr_end(), and the pointers followed by
+ *   a traversal are read with smr_protect(). The scheme is selected at
+ *   build time (SMR=EBR, HP or IBR in the Makefiles):
+ *
+ *   EBR  epoch-based reclamation: a thread announces the global epoch
+ *        when it starts an operation. A node retired at epoch r is freed
+ *        when all the threads in an operation announced an epoch above r.
+ *        Reads cost nothing but a stalled thread blocks all reclamation.
+ *   HP   hazard pointers: smr_protect() publishes each pointer in one of
+ *        SMR_HP_SLOTS slots of the thread, and a node is freed when no
+ *        slot holds it. Memory is bounded but every read is followed by
+ *        a fence.
+ *   IBR  interval-based reclamation (2GEIBR, a refinement of hazard
+ *        eras): each node carries its birth and retire eras, and each
+ *        thread reserves the interval of eras it may have observed since
+ *        the beginning of its operation. A node is freed when its
+ *        lifetime intersects no reserved interval. A stalled thread only
+ *        blocks the nodes that were alive during its operation.
+ *
+ *   With HP and IBR, a protected node is only guaranteed to be valid if it
+ *   was still linked when it was read: a traversal must not follow the
+ *   pointers of removed nodes, which requires structures that unlink
+ *   marked nodes one at a time and validate each link.
+ *
+ *   Without SMR, nodes are allocated with malloc() and retired nodes are
+ *   leaked as before. In every mode, allocations, retirements and frees
+ *   are reported to memacct.h so that the garbage backlog of a scheme can
+ *   be compared. Thread records are registered on first use and, like the
+ *   counters of memacct.h, defined as weak symbols.
+ *
+ * smr.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef SMR_H
+#define SMR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memacct.h"
+
+#if defined(SMR_EBR)
+#  define SMR_NAME                      "EBR"
+#elif defined(SMR_HP)
+#  define SMR_NAME                      "HP"
+#elif defined(SMR_IBR)
+#  define SMR_NAME                      "IBR"
+#endif
+
+#ifdef SMR_NAME
+#  define SMR_ENABLED
+#endif
+
+#define SMR_THREADS                     256
+#define SMR_HP_SLOTS                    4
+/* Nodes retired by a thread between two scans of its retired list */
+#define SMR_SCAN                        128
+/* Allocations of a thread between two increments of the era (IBR) */
+#define SMR_ERA_FREQ                    64
+/* Announced epoch or reserved era of a thread outside operations */
+#define SMR_IDLE                        UINT64_MAX
+
+#ifdef SMR_ENABLED
+
+/* Prepended to each node, keeps nodes 16-byte aligned (double-word CAS) */
+typedef struct smr_hdr {
+	struct smr_hdr *next;
+	size_t size;
+#ifndef SMR_HP
+	uint64_t retire;
+#endif
+#ifdef SMR_IBR
+	uint64_t birth;
+#endif
+} __attribute__((aligned(16))) smr_hdr_t;
+
+typedef struct smr_thread {
+	/* EBR: announced epoch, IBR: reserved interval [lower, upper] */
+	volatile uint64_t lower;
+	volatile uint64_t upper;
+	void *volatile hp[SMR_HP_SLOTS];
+	/* Private to the thread */
+	smr_hdr_t *retired;
+	unsigned long nb_retired;
+	unsigned long scan_at;
+	unsigned long nb_alloc;
+	unsigned long total_retired;
+	unsigned long total_reclaimed;
+} __attribute__((aligned(64))) smr_thread_t;
+
+smr_thread_t smr_threads[SMR_THREADS] __attribute__((weak));
+int smr_nb_threads __attribute__((weak));
+/* Global epoch (EBR) or era (IBR) */
+volatile uint64_t smr_era __attribute__((weak));
+__thread smr_thread_t *smr_self __attribute__((weak));
+
+/* Returns the record of the calling thread, registering it first */
+static inline smr_thread_t *smr_thread(void) {
+	smr_thread_t *t;
+	int id;
+
+	if (smr_self != NULL)
+		return smr_self;
+	if ((id = __sync_fetch_and_add(&smr_nb_threads, 1)) >= SMR_THREADS) {
+		fprintf(stderr, "SMR: more than %d threads\n", SMR_THREADS);
+		exit(1);
+	}
+	t = &smr_threads[id];
+	t->lower = SMR_IDLE;
+	t->upper = SMR_IDLE;
+	t->scan_at = SMR_SCAN;
+	smr_self = t;
+	return t;
+}
+
+static inline smr_hdr_t *smr_hdr(void *p) {
+	return (smr_hdr_t *)p - 1;
+}
+
+static inline void smr_begin(void) {
+#ifndef SMR_HP
+	smr_thread_t *t = smr_thread();
+
+	t->lower = smr_era;
+	t->upper = t->lower;
+	/* The announcement must be visible before the first read */
+	__sync_synchronize();
+#endif
+}
+
+static inline void smr_end(void) {
+	smr_thread_t *t = smr_thread();
+#ifdef SMR_HP
+	int i;
+
+	for (i = 0; i < SMR_HP_SLOTS; i++)
+		t->hp[i] = NULL;
+#else
+	t->lower = SMR_IDLE;
+	t->upper = SMR_IDLE;
+#endif
+}
+
+/*
+ * Reads the pointer at addr and protects the node it refers to in slot i
+ * until the end of the operation or the next protection in the slot. The
+ * two low bits of the pointer are ignored (marks).
+ */
+static inline void *smr_protect(int i, void *volatile *addr) {
+#if defined(SMR_HP)
+	smr_thread_t *t = smr_thread();
+	void *p = *addr, *q;
+
+	do {
+		q = p;
+		t->hp[i] = (void *)((uintptr_t)q & ~(uintptr_t)3);
+		__sync_synchronize();
+		p = *addr;
+	} while (p != q);
+	return p;
+#elif defined(SMR_IBR)
+	smr_thread_t *t = smr_thread();
+	void *p;
+	uint64_t e;
+
+	/* Extends the reserved interval up to the era of the read */
+	for (;;) {
+		p = *addr;
+		e = smr_era;
+		if (t->upper == e)
+			return p;
+		t->upper = e;
+		__sync_synchronize();
+	}
+#else
+	return *addr;
+#endif
+}
+
+/* Protects in slot dst the node protected in slot src */
+static inline void smr_copy(int dst, int src) {
+#ifdef SMR_HP
+	smr_thread_t *t = smr_thread();
+
+	t->hp[dst] = t->hp[src];
+#endif
+}
+
+static inline void *smr_alloc(size_t size) {
+	smr_hdr_t *h;
+#ifdef SMR_IBR
+	smr_thread_t *t = smr_thread();
+
+	if (++t->nb_alloc % SMR_ERA_FREQ == 0)
+		__sync_fetch_and_add(&smr_era, 1);
+#endif
+	if ((h = (smr_hdr_t *)malloc(sizeof(smr_hdr_t) + size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	h->size = sizeof(smr_hdr_t) + size;
+#ifdef SMR_IBR
+	h->birth = smr_era;
+#endif
+	ma_alloc(h->size);
+	return h + 1;
+}
+
+/* Frees a node that was never reachable by other threads */
+static inline void smr_free(void *p, size_t size) {
+	smr_hdr_t *h = smr_hdr(p);
+
+	ma_free(h->size);
+	free(h);
+}
+
+/* Frees the retired nodes of the calling thread that are safe */
+static inline void smr_scan(smr_thread_t *t) {
+	smr_hdr_t *h, *next, *keep = NULL;
+	unsigned long nb = 0;
+	int i, n, safe;
+#if defined(SMR_HP)
+	void *hp[SMR_THREADS * SMR_HP_SLOTS];
+	int j, nb_hp = 0;
+#elif defined(SMR_IBR)
+	uint64_t lower[SMR_THREADS], upper[SMR_THREADS];
+#else
+	uint64_t min, e;
+#endif
+
+	__sync_synchronize();
+	n = smr_nb_threads;
+	if (n > SMR_THREADS)
+		n = SMR_THREADS;
+#if defined(SMR_HP)
+	for (i = 0; i < n; i++)
+		for (j = 0; j < SMR_HP_SLOTS; j++)
+			if ((hp[nb_hp] = smr_threads[i].hp[j]) != NULL)
+				nb_hp++;
+#elif defined(SMR_IBR)
+	for (i = 0; i < n; i++) {
+		lower[i] = smr_threads[i].lower;
+		upper[i] = smr_threads[i].upper;
+	}
+#else
+	/* Moves the epoch forward and finds the oldest announced one */
+	min = __sync_add_and_fetch(&smr_era, 1);
+	for (i = 0; i < n; i++)
+		if ((e = smr_threads[i].lower) < min)
+			min = e;
+#endif
+	for (h = t->retired; h != NULL; h = next) {
+		next = h->next;
+		safe = 1;
+#if defined(SMR_HP)
+		for (j = 0; j < nb_hp && safe; j++)
+			safe = (hp[j] != (void *)(h + 1));
+#elif defined(SMR_IBR)
+		for (i = 0; i < n && safe; i++)
+			safe = (lower[i] == SMR_IDLE || lower[i] > h->retire
+				|| upper[i] < h->birth);
+#else
+		safe = (h->retire < min);
+#endif
+		if (safe) {
+			ma_reclaim(h->size);
+			free(h);
+			t->total_reclaimed++;
+		} else {
+			h->next = keep;
+			keep = h;
+			nb++;
+		}
+	}
+	t->retired = keep;
+	t->nb_retired = nb;
+	t->scan_at = nb + SMR_SCAN;
+}
+
+/* Retires a node unlinked by the calling thread */
+static inline void smr_retire(void *p, size_t size) {
+	smr_thread_t *t = smr_thread();
+	smr_hdr_t *h = smr_hdr(p);
+
+#ifndef SMR_HP
+	h->retire = smr_era;
+#endif
+	h->next = t->retired;
+	t->retired = h;
+	t->total_retired++;
+	ma_retire(h->size);
+	if (++t->nb_retired >= t->scan_at)
+		smr_scan(t);
+}
+
+static inline void smr_print(void) {
+	unsigned long retired = 0, reclaimed = 0;
+	int i;
+
+	for (i = 0; i < smr_nb_threads && i < SMR_THREADS; i++) {
+		retired += smr_threads[i].total_retired;
+		reclaimed += smr_threads[i].total_reclaimed;
+	}
+	printf("Reclamation   : %s, %lu nodes retired, %lu reclaimed\n",
+	       SMR_NAME, retired, reclaimed);
+}
+
+#else /* ! SMR_ENABLED */
+
+static inline void smr_begin(void) {
+}
+
+static inline void smr_end(void) {
+}
+
+static inline void *smr_protect(int i, void *volatile *addr) {
+	return *addr;
+}
+
+static inline void smr_copy(int dst, int src) {
+}
+
+static inline void *smr_alloc(size_t size) {
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	ma_alloc(size);
+	return p;
+}
+
+static inline void smr_free(void *p, size_t size) {
+	ma_free(size);
+	free(p);
+}
+
+/* Unlinked nodes are leaked, only accounted for as garbage */
+static inline void smr_retire(void *p, size_t size) {
+	ma_retire(size);
+}
+
+static inline void smr_print(void) {
+	printf("Reclamation   : none (unlinked nodes are leaked)\n");
+}
+
+#endif /* ! SMR_ENABLED */
+
+#endif /* SMR_H */
@@ -0,0 +1,103 @@
+/*
+ * File:
+ *   timeseries.h
+ * Description:
+ *   Time series of the throughput during a run. Instead of sleeping for
+ *   the whole duration, the main thread wakes up every interval (on an
+ *   absolute schedule, so that printing does not make samples drift),
+ *   sums the operation counters of the threads and prints the throughput
+ *   of the elapsed interval. Warm-up, maintenance bursts and reclamation
+ *   pauses thus show up as dips in the series.
+ *
+ * timeseries.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define DEFAULT_INTERVAL                0
+
+typedef struct ts {
+	long interval;
+	struct timespec start;
+	struct timespec next;
+	struct timespec end;
+	struct timespec last;
+	unsigned long last_ops;
+	int done;
+} ts_t;
+
+static inline long ts_diff_ns(struct timespec *a, struct timespec *b) {
+	return (a->tv_sec - b->tv_sec) * 1000000000L + (a->tv_nsec - b->tv_nsec);
+}
+
+static inline void ts_add_ms(struct timespec *t, long ms) {
+	t->tv_sec += ms / 1000;
+	t->tv_nsec += (ms % 1000) * 1000000L;
+	if (t->tv_nsec >= 1000000000L) {
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000L;
+	}
+}
+
+/* Starts a series of samples every interval ms over duration ms */
+static inline void ts_init(ts_t *ts, int interval, int duration) {
+	clock_gettime(CLOCK_MONOTONIC, &ts->start);
+	ts->interval = interval;
+	ts->last = ts->start;
+	ts->next = ts->start;
+	ts_add_ms(&ts->next, interval);
+	ts->end = ts->start;
+	ts_add_ms(&ts->end, duration);
+	ts->last_ops = 0;
+	ts->done = 0;
+	printf("Time series   : ops/s every %d ms\n", interval);
+}
+
+/*
+ * Sleeps until the next sample, returns 0 once the end of the run has
+ * been sampled.
+ */
+static inline int ts_wait(ts_t *ts) {
+	struct timespec *t;
+
+	if (ts->done)
+		return 0;
+	t = &ts->next;
+	if (ts_diff_ns(&ts->end, t) <= 0) {
+		t = &ts->end;
+		ts->done = 1;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, t, NULL) != 0);
+	return 1;
+}
+
+/* Records the total number of operations ops at the current sample */
+static inline void ts_sample(ts_t *ts, unsigned long ops) {
+	struct timespec now;
+	long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = ts_diff_ns(&now, &ts->last);
+	printf("  @%7.1f ms : %f / s\n", ts_diff_ns(&now, &ts->start) / 1e6,
+	       (ns > 0 ? (ops - ts->last_ops) * 1e9 / ns : 0.0));
+	fflush(stdout);
+	ts->last = now;
+	ts->last_ops = ops;
+	ts_add_ms(&ts->next, ts->interval);
+}
+
+#endif /* TIMESERIES_H */
@@ -10,6 +10,7 @@
 #  include "mod_stats.h"
 #  define NL                             1
 #  define EL                             0
+#  define RO                             2
 #  define TX_START(type)                 { sigjmp_buf *_e = stm_get_env(); sigsetjmp(*_e, 0); stm_start(_e, 0)
 #  define TX_LOAD(addr)                  stm_load((stm_word_t *)addr)
 #  define TX_STORE(addr, val)            stm_store((stm_word_t *)addr, (stm_word_t)val)
@@ -59,6 +60,7 @@
 #  include "mod_stats.h"
 #  define NL                             1
 #  define EL                             0
+#  define RO                             2
 #  define TX_START(type)                 { sigjmp_buf *_e = stm_get_env(); sigsetjmp(*_e, 0); stm_start(_e, 0)
 #  define TX_LOAD(addr)                  stm_load((stm_word_t *)addr)
 #  define TX_STORE(addr, val)            stm_store((stm_word_t *)addr, (stm_word_t)val)
@@ -112,6 +114,7 @@
 #  include "mod_stats.h"
 #  define NL                             1
 #  define EL                             0
+#  define RO                             2
 #  define TX_START(type)                 { sigjmp_buf *_e = stm_start(0); if (_e != NULL) sigsetjmp(*_e, 0);
 #  define TX_LOAD(addr)                  stm_load((stm_word_t *)addr)
 //#  define TX_UNIT_LOAD(addr)                  stm_load((stm_word_t *)addr)
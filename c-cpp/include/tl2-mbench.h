@@ -4,6 +4,7 @@
 //#  include "thread.h"
 #  define NL                            1
 #  define EL                            0
+#  define RO                            2
 #  define TX_START(type)                STM_BEGIN_WR()
 #  define TX_END                        STM_END()
 #  define MALLOC(size)                  malloc(size)
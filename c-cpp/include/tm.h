@@ -1,6 +1,8 @@
 
 #ifdef ESTM
 #  include "estm.h"
+#elif defined NOREC
+#  include "norec-tm.h"
 #elif defined(TINY100) || defined(TINY10B) || defined(TINY099) || defined(TINY098)
 #  include "tinystm.h"
 #elif defined WPLDSTM
@@ -13,4 +15,7 @@
 #  include "icc.h"
 #elif defined SEQUENTIAL
 #  include "sequential.h"
+#  ifdef FC
+#    include "fc.h"
+#  endif
 #endif
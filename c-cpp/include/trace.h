@@ -0,0 +1,296 @@
+/*
+ * File:
+ *   trace.h
+ * Description:
+ *   Binary operation traces of the benchmark harnesses. A trace is a
+ *   sequence of (key, thread, operation) records grouped in one stream
+ *   per recording thread:
+ *
+ *     tr_header_t                      magic, version, #streams, #records
+ *     uint64_t[#streams + 1]           index of the first record of each
+ *                                      stream, then #records
+ *     tr_rec_t[#records]               16-byte records
+ *
+ *   Records are written by tr_log() into per-thread buffers and saved at
+ *   the end of a run, or by any other program producing the same format
+ *   (e.g., from production logs). A trace is replayed zero-copy: the file
+ *   is mapped read-only and each replaying thread walks its streams
+ *   directly in the mapping. Thread i of n replays streams i, i+n, i+2n,
+ *   ... (stream i mod #streams if there are more threads than streams),
+ *   in a loop until the end of the run. Operation codes are those of
+ *   latency.h.
+ *
+ * trace.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* "SBTRACE1" */
+#define TR_MAGIC                        0x3145434152544253ULL
+#define TR_VERSION                      1
+#define TR_CHUNK                        (1 << 16)
+
+typedef struct tr_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t nb_streams;
+	uint64_t nb_recs;
+} tr_header_t;
+
+typedef struct tr_rec {
+	int64_t key;
+	uint32_t thread;
+	/* LAT_CONTAINS, LAT_ADD or LAT_REMOVE */
+	uint32_t op;
+} tr_rec_t;
+
+/* Operations recorded by a thread */
+typedef struct tr_stream {
+	uint32_t thread;
+	size_t nb;
+	size_t size;
+	tr_rec_t *recs;
+} tr_stream_t;
+
+/* Saves streams to a trace file */
+typedef struct tr_writer {
+	FILE *f;
+	const char *path;
+	uint32_t nb_streams;
+	uint32_t stream;
+	uint64_t nb_recs;
+} tr_writer_t;
+
+/* Mapped trace */
+typedef struct trace {
+	void *map;
+	size_t len;
+	tr_header_t *hdr;
+	const uint64_t *first;
+	const tr_rec_t *recs;
+} trace_t;
+
+/* Replay position of a thread */
+typedef struct tr_cursor {
+	const trace_t *tr;
+	const tr_rec_t *cur;
+	const tr_rec_t *end;
+	uint32_t stream;
+	uint32_t first_stream;
+	uint32_t stride;
+} tr_cursor_t;
+
+/* Returns the recording buffer of thread, or NULL if recording is off */
+static inline tr_stream_t *tr_stream_new(const char *path, uint32_t thread) {
+	tr_stream_t *s;
+
+	if (path == NULL)
+		return NULL;
+	if ((s = (tr_stream_t *)calloc(1, sizeof(tr_stream_t))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	s->thread = thread;
+	return s;
+}
+
+static inline void tr_log(tr_stream_t *s, int op, long key) {
+	tr_rec_t *r;
+
+	if (s == NULL)
+		return;
+	if (s->nb == s->size) {
+		s->size += TR_CHUNK;
+		if ((s->recs = (tr_rec_t *)realloc(s->recs, s->size * sizeof(tr_rec_t))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	r = &s->recs[s->nb++];
+	r->key = key;
+	r->thread = s->thread;
+	r->op = op;
+}
+
+static inline void tr_fwrite(const void *p, size_t size, size_t n,
+			     long off, FILE *f) {
+	if ((off >= 0 && fseek(f, off, SEEK_SET) != 0)
+	    || (n > 0 && fwrite(p, size, n, f) != n)) {
+		perror("fwrite");
+		exit(1);
+	}
+}
+
+/* Creates a trace of nb_streams streams at path */
+static inline void tr_create(tr_writer_t *w, const char *path,
+			     uint32_t nb_streams) {
+	tr_header_t hdr;
+	uint64_t first = 0;
+	uint32_t i;
+
+	if ((w->f = fopen(path, "wb")) == NULL) {
+		perror(path);
+		exit(1);
+	}
+	w->path = path;
+	w->nb_streams = nb_streams;
+	w->stream = 0;
+	w->nb_recs = 0;
+	memset(&hdr, 0, sizeof(hdr));
+	tr_fwrite(&hdr, sizeof(hdr), 1, -1, w->f);
+	for (i = 0; i <= nb_streams; i++)
+		tr_fwrite(&first, sizeof(first), 1, -1, w->f);
+}
+
+/* Appends the next stream to the trace and frees it */
+static inline void tr_append(tr_writer_t *w, tr_stream_t *s) {
+	long off = sizeof(tr_header_t) + w->stream * sizeof(uint64_t);
+
+	tr_fwrite(&w->nb_recs, sizeof(uint64_t), 1, off, w->f);
+	if (fseek(w->f, 0, SEEK_END) != 0) {
+		perror("fseek");
+		exit(1);
+	}
+	w->stream++;
+	if (s == NULL)
+		return;
+	tr_fwrite(s->recs, sizeof(tr_rec_t), s->nb, -1, w->f);
+	w->nb_recs += s->nb;
+	free(s->recs);
+	free(s);
+}
+
+/* Completes the header once all streams have been appended */
+static inline void tr_finish(tr_writer_t *w) {
+	tr_header_t hdr;
+	long off = sizeof(tr_header_t) + w->nb_streams * sizeof(uint64_t);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TR_MAGIC;
+	hdr.version = TR_VERSION;
+	hdr.nb_streams = w->nb_streams;
+	hdr.nb_recs = w->nb_recs;
+	tr_fwrite(&w->nb_recs, sizeof(uint64_t), 1, off, w->f);
+	tr_fwrite(&hdr, sizeof(hdr), 1, 0, w->f);
+	if (fclose(w->f) != 0) {
+		perror("fclose");
+		exit(1);
+	}
+	printf("Trace        : %lu operations in %u streams saved to %s\n",
+	       (unsigned long)w->nb_recs, w->nb_streams, w->path);
+}
+
+/* Maps the trace at path, exits with an error message if it is invalid */
+static inline void tr_open(trace_t *tr, const char *path) {
+	struct stat st;
+	size_t hlen;
+	uint32_t s;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		exit(1);
+	}
+	tr->len = st.st_size;
+	if (tr->len < sizeof(tr_header_t)) {
+		fprintf(stderr, "Truncated trace: %s\n", path);
+		exit(1);
+	}
+	/* Pre-fault the pages so that replay does not wait on the disk */
+	tr->map = mmap(NULL, tr->len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	if (tr->map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+	madvise(tr->map, tr->len, MADV_SEQUENTIAL);
+	tr->hdr = (tr_header_t *)tr->map;
+	if (tr->hdr->magic != TR_MAGIC || tr->hdr->version != TR_VERSION
+	    || tr->hdr->nb_streams == 0) {
+		fprintf(stderr, "Invalid trace: %s\n", path);
+		exit(1);
+	}
+	hlen = sizeof(tr_header_t) + (tr->hdr->nb_streams + 1) * sizeof(uint64_t);
+	tr->first = (const uint64_t *)((char *)tr->map + sizeof(tr_header_t));
+	tr->recs = (const tr_rec_t *)((char *)tr->map + hlen);
+	if (tr->len < hlen || (tr->len - hlen) / sizeof(tr_rec_t) < tr->hdr->nb_recs
+	    || tr->first[tr->hdr->nb_streams] != tr->hdr->nb_recs
+	    || tr->hdr->nb_recs == 0) {
+		fprintf(stderr, "Truncated trace: %s\n", path);
+		exit(1);
+	}
+	for (s = 0; s < tr->hdr->nb_streams; s++) {
+		if (tr->first[s] > tr->first[s + 1]) {
+			fprintf(stderr, "Invalid trace: %s\n", path);
+			exit(1);
+		}
+	}
+}
+
+static inline void tr_close(trace_t *tr) {
+	munmap(tr->map, tr->len);
+}
+
+static inline void tr_print(trace_t *tr, const char *path) {
+	printf("Trace        : %s (%lu operations in %u streams)\n", path,
+	       (unsigned long)tr->hdr->nb_recs, tr->hdr->nb_streams);
+}
+
+static inline void tr_seek(tr_cursor_t *c, uint32_t stream) {
+	c->stream = stream;
+	c->cur = c->tr->recs + c->tr->first[stream];
+	c->end = c->tr->recs + c->tr->first[stream + 1];
+}
+
+/* Positions thread id out of nb_threads on its first stream */
+static inline void tr_cursor_init(tr_cursor_t *c, const trace_t *tr,
+				  int id, int nb_threads) {
+	uint32_t s;
+	uint64_t nb = 0;
+
+	c->tr = tr;
+	c->first_stream = id % tr->hdr->nb_streams;
+	c->stride = (id < tr->hdr->nb_streams ? nb_threads : tr->hdr->nb_streams);
+	for (s = c->first_stream; s < tr->hdr->nb_streams; s += c->stride)
+		nb += tr->first[s + 1] - tr->first[s];
+	if (nb == 0) {
+		/* Empty streams, replay the whole trace */
+		c->first_stream = 0;
+		c->stride = 1;
+	}
+	tr_seek(c, c->first_stream);
+}
+
+/* Returns the next operation of the thread, in the mapping */
+static inline const tr_rec_t *tr_next(tr_cursor_t *c) {
+	uint32_t s;
+
+	while (c->cur == c->end) {
+		/* Next stream of the thread, or back to its first one */
+		s = c->stream + c->stride;
+		tr_seek(c, (s < c->tr->hdr->nb_streams ? s : c->first_stream));
+	}
+	return c->cur++;
+}
+
+#endif /* TRACE_H */
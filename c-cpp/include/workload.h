@@ -0,0 +1,283 @@
+/*
+ * File:
+ *   workload.h
+ * Description:
+ *   Key distributions of the benchmark harnesses, shared by all
+ *   synchronization techniques, and the per-thread pseudo-random number
+ *   generator behind them (xorshift64*, no division on the fast path).
+ *
+ *   The distribution is given as a string:
+ *     uniform                  keys uniformly drawn in [1;range]
+ *     zipf[:theta]             Zipfian ranks of exponent theta (default
+ *                              0.99) scattered over the key range
+ *     hotspot[:ops[:keys]]     ops% of the accesses (default 80) target
+ *                              the first keys% of the range (default 20)
+ *     latest[:theta[:shift]]   Zipfian ranks counted backwards from a head
+ *                              key that moves up by one every shift
+ *                              operations (default 1000) of a thread
+ *     sequential               monotonically increasing keys, threads
+ *                              interleaving so that they never collide
+ *
+ *   Zipfian ranks are generated by rejection-inversion, without any
+ *   O(range) precomputation:
+ *   "Rejection-Inversion to Generate Variates from Monotone Discrete
+ *   Distributions", W. Hormann and G. Derflinger, ACM TOMACS 6(3), 1996.
+ *
+ * workload.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_KEYDIST                 "uniform"
+
+#define WL_UNIFORM                      0
+#define WL_ZIPF                         1
+#define WL_HOTSPOT                      2
+#define WL_LATEST                       3
+#define WL_SEQUENTIAL                   4
+
+#define WL_DEFAULT_THETA                0.99
+#define WL_DEFAULT_HOT_OPS              80
+#define WL_DEFAULT_HOT_KEYS             20
+#define WL_DEFAULT_SHIFT                1000
+
+typedef struct workload {
+	int dist;
+	long range;
+	double theta;
+	int hot_ops;
+	long hot_size;
+	long shift;
+	/* Multiplier of the bijection scattering Zipfian ranks over the keys */
+	uint64_t scatter;
+	/* Rejection-inversion constants */
+	double h_x1;
+	double h_n;
+	double s;
+} workload_t;
+
+typedef struct wl_thread {
+	uint64_t rng;
+	const workload_t *wl;
+	/* Next key (sequential) or current head key (latest) */
+	long next;
+	long stride;
+	unsigned long ops;
+} wl_thread_t;
+
+static inline uint64_t wl_next(wl_thread_t *t) {
+	uint64_t x = t->rng;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	t->rng = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 wl_u128_t;
+#endif
+
+/* High 64 bits of the 128-bit product a * b */
+static inline uint64_t wl_mulhi(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+	return (uint64_t)(((wl_u128_t)a * b) >> 64);
+#else
+	uint64_t al = a & 0xffffffffULL, ah = a >> 32;
+	uint64_t bl = b & 0xffffffffULL, bh = b >> 32;
+	uint64_t lh = al * bh, hl = ah * bl;
+	uint64_t mid = ((al * bl) >> 32) + (lh & 0xffffffffULL) + (hl & 0xffffffffULL);
+
+	return ah * bh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+/* Returns a pseudo-random value in [1;r] */
+static inline long wl_rand_range(wl_thread_t *t, long r) {
+	return 1 + (long)wl_mulhi(wl_next(t), (uint64_t)r);
+}
+
+/* Returns a pseudo-random value in [0;1) */
+static inline double wl_rand_double(wl_thread_t *t) {
+	return (wl_next(t) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* log1p(x)/x and expm1(x)/x, accurate around 0 */
+static inline double wl_helper1(double x) {
+	return (fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x / 3.0));
+}
+
+static inline double wl_helper2(double x) {
+	return (fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0));
+}
+
+static inline double wl_h(const workload_t *wl, double x) {
+	return exp(-wl->theta * log(x));
+}
+
+static inline double wl_h_integral(const workload_t *wl, double x) {
+	double lx = log(x);
+	return wl_helper2((1.0 - wl->theta) * lx) * lx;
+}
+
+static inline double wl_h_integral_inv(const workload_t *wl, double x) {
+	double t = x * (1.0 - wl->theta);
+	if (t < -1.0)
+		t = -1.0;
+	return exp(wl_helper1(t) * x);
+}
+
+/* Returns a Zipfian rank in [1;n], rank 1 being the most frequent */
+static inline long wl_zipf(wl_thread_t *t, long n) {
+	const workload_t *wl = t->wl;
+	double u, x;
+	long k;
+
+	while (1) {
+		u = wl->h_n + wl_rand_double(t) * (wl->h_x1 - wl->h_n);
+		x = wl_h_integral_inv(wl, u);
+		k = (long)(x + 0.5);
+		if (k < 1)
+			k = 1;
+		else if (k > n)
+			k = n;
+		if (k - x <= wl->s || u >= wl_h_integral(wl, k + 0.5) - wl_h(wl, k))
+			return k;
+	}
+}
+
+/* Returns the key of the next operation, in [1;range] */
+static inline long wl_key(wl_thread_t *t) {
+	const workload_t *wl = t->wl;
+	long k;
+
+	switch (wl->dist) {
+	case WL_ZIPF:
+		k = wl_zipf(t, wl->range) - 1;
+		return (long)((k * wl->scatter) % (uint64_t)wl->range) + 1;
+	case WL_HOTSPOT:
+		if (wl_rand_range(t, 100) <= wl->hot_ops || wl->hot_size == wl->range)
+			return wl_rand_range(t, wl->hot_size);
+		return wl->hot_size + wl_rand_range(t, wl->range - wl->hot_size);
+	case WL_LATEST:
+		if (++t->ops % wl->shift == 0 && ++t->next > wl->range)
+			t->next = 1;
+		k = t->next - wl_zipf(t, wl->range);
+		return (k < 0 ? k + wl->range : k) + 1;
+	case WL_SEQUENTIAL:
+		k = t->next;
+		t->next += t->stride;
+		if (t->next > wl->range)
+			t->next = (t->next - 1) % wl->range + 1;
+		return k;
+	default:
+		return wl_rand_range(t, wl->range);
+	}
+}
+
+static inline uint64_t wl_gcd(uint64_t a, uint64_t b) {
+	uint64_t r;
+
+	while (b != 0) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/*
+ * Parses the key distribution spec over keys [1;range], exits with an
+ * error message if spec is invalid.
+ */
+static inline void wl_init(workload_t *wl, const char *spec, long range) {
+	const char *arg = strchr(spec, ':');
+	size_t len = (arg == NULL ? strlen(spec) : (size_t)(arg - spec));
+	double a1 = -1, a2 = -1;
+
+	memset(wl, 0, sizeof(workload_t));
+	wl->range = range;
+	if (arg != NULL && sscanf(arg, ":%lf:%lf", &a1, &a2) < 1) {
+		fprintf(stderr, "Invalid key distribution parameters: %s\n", spec);
+		exit(1);
+	}
+	if (len == 7 && !strncmp(spec, "uniform", len)) {
+		wl->dist = WL_UNIFORM;
+	} else if (len == 4 && !strncmp(spec, "zipf", len)) {
+		wl->dist = WL_ZIPF;
+	} else if (len == 7 && !strncmp(spec, "hotspot", len)) {
+		wl->dist = WL_HOTSPOT;
+		wl->hot_ops = (a1 < 0 ? WL_DEFAULT_HOT_OPS : (int)a1);
+		wl->hot_size = range * (a2 < 0 ? WL_DEFAULT_HOT_KEYS : a2) / 100;
+		if (wl->hot_ops > 100 || wl->hot_size < 1 || wl->hot_size > range) {
+			fprintf(stderr, "Invalid hotspot: %s\n", spec);
+			exit(1);
+		}
+	} else if (len == 6 && !strncmp(spec, "latest", len)) {
+		wl->dist = WL_LATEST;
+		wl->shift = (a2 < 0 ? WL_DEFAULT_SHIFT : (long)a2);
+		if (wl->shift < 1) {
+			fprintf(stderr, "Invalid shift: %s\n", spec);
+			exit(1);
+		}
+	} else if (len == 10 && !strncmp(spec, "sequential", len)) {
+		wl->dist = WL_SEQUENTIAL;
+	} else {
+		fprintf(stderr, "Unknown key distribution: %s\n", spec);
+		exit(1);
+	}
+
+	if (wl->dist == WL_ZIPF || wl->dist == WL_LATEST) {
+		wl->theta = (a1 < 0 ? WL_DEFAULT_THETA : a1);
+		if (wl->theta <= 0) {
+			fprintf(stderr, "Zipfian exponent must be positive: %s\n", spec);
+			exit(1);
+		}
+		wl->h_x1 = wl_h_integral(wl, 1.5) - 1.0;
+		wl->h_n = wl_h_integral(wl, range + 0.5);
+		wl->s = 2.0 - wl_h_integral_inv(wl, wl_h_integral(wl, 2.5) - wl_h(wl, 2.0));
+		/* Any multiplier coprime with range is a bijection of [0;range) */
+		wl->scatter = 2654435761UL % (uint64_t)range;
+		while (wl->scatter == 0 || wl_gcd(wl->scatter, (uint64_t)range) != 1)
+			wl->scatter++;
+	}
+}
+
+/* Initializes the generator of thread id out of nb_threads */
+static inline void wl_thread_init(wl_thread_t *t, const workload_t *wl,
+				  unsigned int seed, int id, int nb_threads) {
+	/* splitmix64 of the seed, so that close seeds give unrelated streams */
+	uint64_t z = (uint64_t)seed + 0x9E3779B97F4A7C15ULL * (id + 1);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	t->rng = (z == 0 ? 1 : z);
+	t->wl = wl;
+	t->ops = 0;
+	t->stride = nb_threads;
+	if (wl->dist == WL_SEQUENTIAL)
+		t->next = (id % wl->range) + 1;
+	else
+		t->next = wl->range;
+}
+
+#endif /* WORKLOAD_H */
@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Compares the inline bucket layout of the hash tables with the former
+# indirect layout (HTLAYOUT=INDIRECT): throughput and, when perf is
+# available, cache misses per operation.
+# Run from synchrobench/c-cpp.
+
+dir=.
+bin=${dir}/bin
+output=${dir}/output
+
+thread="1 4 8"
+size="4096 65535"
+writes="0 20"
+load="1"
+length="5000"
+iterations="3"
+
+benchs="lockfree-hashtable SPIN-hashtable"
+
+perfopt=""
+if which perf > /dev/null 2>&1; then
+  perfopt="perf stat -x, -e cache-misses,LLC-load-misses"
+fi
+
+###############################
+# builds both layouts
+###############################
+
+make clean-build
+for layout in "" INDIRECT; do
+  make "STM=LOCKFREE" "HTLAYOUT=${layout}" -C src/hashtables/lockfree-ht
+  make "LOCK=SPIN" "HTLAYOUT=${layout}" -C src/hashtables/lockbased-ht
+done
+
+mkdir -p ${output}/log
+
+###############################
+# records all benchmark outputs
+###############################
+
+printf "#%-28s %4s %8s %4s %16s %16s\n" bench t i u "ops/s" "misses/op"
+for bench in ${benchs}; do
+  for b in ${bench} `echo ${bench} | sed 's/-hashtable/-indirect-hashtable/'`; do
+    for write in ${writes}; do
+      for t in ${thread}; do
+        for i in ${size}; do
+          r=$((2 * i))
+          out=${output}/log/${b}-i${i}-u${write}-t${t}.log
+          rm -f ${out}
+          for (( j=1; j<=${iterations}; j++ )); do
+            ${perfopt} ${bin}/${b} -d ${length} -t ${t} -i ${i} -r ${r} -u ${write} -l ${load} >> ${out} 2>&1
+          done
+          ops=`grep "^#txs" ${out} | sed 's/.*(\(.*\) \/ s)/\1/' | awk '{ s += $1 } END { printf "%.0f", s / NR }'`
+          txs=`grep "^#txs" ${out} | awk '{ s += $3 } END { print s }'`
+          misses=`grep "cache-misses" ${out} | awk -F, '{ s += $1 } END { print s + 0 }'`
+          if [ -n "${perfopt}" ] && [ "${txs}" -gt 0 ]; then
+            mpo=`awk "BEGIN { printf \"%.3f\", ${misses} / ${txs} }"`
+          else
+            mpo="n/a"
+          fi
+          printf "%-29s %4d %8d %4d %16s %16s\n" ${b} ${t} ${i} ${write} ${ops} ${mpo}
+        done
+      done
+    done
+  done
+done
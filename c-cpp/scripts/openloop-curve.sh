@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# Latency-throughput curve of a benchmark under open-loop load: sweeps
+# the offered rate (-O) and reports the achieved throughput and the
+# latency percentiles of all operations, measured from their intended
+# start time. The knee of the curve is where the achieved throughput
+# stops following the offered rate and the tail latency explodes.
+# Run from synchrobench/c-cpp, e.g.:
+#   scripts/openloop-curve.sh lockfree-nohotspot-skiplist "-t 4 -i 1024 -r 2048 -u 10"
+
+dir=.
+bin=${dir}/bin
+output=${dir}/output
+
+bench=${1:-lockfree-nohotspot-skiplist}
+opts=${2:-""}
+rates=${3:-"10000 20000 50000 100000 200000 500000 1000000 2000000"}
+arrival="poisson"
+length="2000"
+sampling="1"
+
+mkdir -p ${output}/log
+
+###############################
+# records all benchmark outputs
+###############################
+
+printf "#%-28s %10s %14s %10s %10s %10s %10s\n" bench offered "achieved" p50 p99 p99.9 max
+for rate in ${rates}; do
+  out=${output}/log/${bench}-O${rate}.log
+  ${bin}/${bench} ${opts} -d ${length} -O ${rate} -E ${arrival} -L ${sampling} > ${out} 2>&1
+  ops=`grep "^#txs" ${out} | sed 's/.*(\(.*\) \/ s)/\1/' | awk '{ printf "%.0f", $1 }'`
+  lat=`grep "^  all " ${out} | awk '{ print $3, $5, $6, $8 }'`
+  printf "%-29s %10d %14s %10s %10s %10s %10s\n" ${bench} ${rate} ${ops} ${lat}
+done
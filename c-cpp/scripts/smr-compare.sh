@@ -0,0 +1,66 @@
+#!/bin/bash
+#
+# Compares the memory reclamation schemes of the lock-free structures
+# (SMR=EBR, HP, IBR, or none): throughput, live bytes, garbage backlog
+# and peak resident set size.
+# Run from synchrobench/c-cpp.
+
+dir=.
+bin=${dir}/bin
+output=${dir}/output
+
+thread="1 4 8"
+size="1024 65535"
+writes="20 50"
+load="1"
+length="5000"
+
+benchs="linkedlist hashtable split-ordered-hashtable bst"
+
+###############################
+# builds all schemes
+###############################
+
+make clean-build
+for smr in "" EBR HP IBR; do
+  make "STM=LOCKFREE" "SMR=${smr}" -C src/linkedlists/lockfree-list
+  make "STM=LOCKFREE" "SMR=${smr}" -C src/hashtables/lockfree-ht
+  make "STM=LOCKFREE" "SMR=${smr}" -C src/hashtables/split-ordered-ht
+done
+# the tree only supports epochs
+for smr in "" EBR; do
+  rm -f src/trees/lfbstree/test.o
+  make "STM=LOCKFREE" "SMR=${smr}" -C src/trees/lfbstree
+done
+rm -f src/trees/lfbstree/test.o
+
+mkdir -p ${output}/log
+
+###############################
+# records all benchmark outputs
+###############################
+
+printf "#%-36s %4s %8s %4s %12s %12s %12s %12s\n" bench t i u "ops/s" "live" "garbage" "rss(kB)"
+for bench in ${benchs}; do
+  for smr in "" -ebr -hp -ibr; do
+    b=lockfree${smr}-${bench}
+    [ -x ${bin}/${b} ] || continue
+    for write in ${writes}; do
+      for t in ${thread}; do
+        for i in ${size}; do
+          r=$((2 * i))
+          out=${output}/log/${b}-i${i}-u${write}-t${t}.log
+          # only the hash tables take a load factor
+          opt=""
+          case ${bench} in *hashtable) opt="-l ${load}";; esac
+          ${bin}/${b} -d ${length} -t ${t} -i ${i} -r ${r} -u ${write} ${opt} > ${out} 2>&1
+          ops=`grep "^#txs" ${out} | sed 's/.*(\(.*\) \/ s)/\1/' | awk '{ printf "%.0f", $1 }'`
+          live=`grep "^Memory" ${out} | awk '{ print $3 }'`
+          garbage=`grep "^Memory" ${out} | sed 's/.*, \([0-9]*\) bytes garbage/\1/'`
+          rss=`grep "Peak RSS" ${out} | awk '{ print $4 }'`
+          printf "%-37s %4d %8d %4d %12s %12s %12s %12s\n" ${b} ${t} ${i} ${write} ${ops} ${live} ${garbage} ${rss}
+        done
+      done
+    done
+  done
+done
@@ -25,15 +25,18 @@
  */
 
 #include "hashtable-lock.h"
+#include "memacct.h"
 
 unsigned int maxhtlength;
 
+#ifdef HT_INDIRECT
+
 void ht_delete(ht_intset_t *set) {
 	node_l_t *node, *next;
 	int i;
 	
 	for (i=0; i < maxhtlength; i++) {
-		node = set->buckets[i]->head;
+		node = HT_HEAD(set, i);
 		while (node != NULL) {
 			next = node->next;
       free(node);
@@ -44,13 +47,35 @@ void ht_delete(ht_intset_t *set) {
 	free(set);
 }
 
+#else /* ! HT_INDIRECT */
+
+void ht_delete(ht_intset_t *set) {
+	node_l_t *node, *next;
+	int i;
+	
+	for (i=0; i < maxhtlength; i++) {
+		node = set->buckets[i].next;
+		while (node != set->tail) {
+			next = node->next;
+			node_delete_l(node);
+			node = next;
+		}
+		DESTROY_LOCK(&set->buckets[i].lock);
+	}
+	node_delete_l(set->tail);
+	free(set->buckets);
+	free(set);
+}
+
+#endif /* ! HT_INDIRECT */
+
 int ht_size(ht_intset_t *set) {
 	int size = 0;
 	node_l_t *node;
 	int i;
 	
 	for (i=0; i < maxhtlength; i++) {
-		node = set->buckets[i]->head->next;
+		node = HT_HEAD(set, i)->next;
 		while (node->next) {
 			size++;
 			node = node->next;
@@ -71,6 +96,8 @@ int floor_log_2(unsigned int n) {
 	return ((n == 0) ? (-1) : pos);
 }
 
+#ifdef HT_INDIRECT
+
 ht_intset_t *ht_new() {
 	ht_intset_t *set;
 	int i;
@@ -85,34 +112,126 @@ ht_intset_t *ht_new() {
 	return set;
 }
 
+#else /* ! HT_INDIRECT */
+
+/*
+ * Rounds maxhtlength up to a power of two before allocating the inline
+ * bucket heads, all pointing to the shared tail.
+ */
+ht_intset_t *ht_new() {
+	ht_intset_t *set;
+	unsigned int length = 1;
+	int i;
+	
+	while (length < maxhtlength)
+		length <<= 1;
+	maxhtlength = length;
+
+	if ((set = (ht_intset_t *)malloc(sizeof(ht_intset_t))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}   
+	if (posix_memalign((void **)&set->buckets, CACHE_LINE_SIZE,
+			   maxhtlength * sizeof(node_l_t)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	ma_alloc(maxhtlength * sizeof(node_l_t));
+	set->tail = new_node_l(VAL_MAX, NULL, 0);
+
+	for (i=0; i < maxhtlength; i++) {
+		set->buckets[i].val = VAL_MIN;
+		set->buckets[i].next = set->tail;
+		INIT_LOCK(&set->buckets[i].lock);
+	}
+	return set;
+}
+
+#endif /* ! HT_INDIRECT */
+
 int ht_contains(ht_intset_t *set, int val, int transactional) {
+	intset_l_t bucket;
 	int addr;
 	
 	/* Get key */
-	addr = val % maxhtlength;
-	return set_contains_l(set->buckets[addr], val, transactional);
+	addr = HT_ADDR(val);
+	return set_contains_l(HT_BUCKET(set, addr, &bucket), val, transactional);
 }
 
 int ht_add(ht_intset_t *set, int val, int transactional) {
+	intset_l_t bucket;
 	int addr, result;
 	
 	/* Get key */
-	addr = val % maxhtlength;
-	result = set_add_l(set->buckets[addr], val, transactional);
+	addr = HT_ADDR(val);
+	result = set_add_l(HT_BUCKET(set, addr, &bucket), val, transactional);
 	return result;
 }
 
 int ht_remove(ht_intset_t *set, int val, int transactional) {
+	intset_l_t bucket;
 	int addr, result;
 	
 	/* Get key */
-	addr = val % maxhtlength;
-	result = set_remove_l(set->buckets[addr], val, transactional);
+	addr = HT_ADDR(val);
+	result = set_remove_l(HT_BUCKET(set, addr, &bucket), val, transactional);
 	
 	return result;
 }
 
 
+/*
+ * Batched lookups (see batch.h): with the lazy wait-free contains
+ * (transactional == 2), the traversals of the buckets of BATCH_WINDOW
+ * keys are interleaved, each step prefetching the next node of its
+ * bucket. The lock-coupling contains is called key by key.
+ */
+int ht_contains_batch(ht_intset_t *set, int *keys, int n, int *results, int transactional) {
+	node_l_t *node[BATCH_WINDOW];
+	int idx[BATCH_WINDOW];
+	int i, k, next = 0, active = 0, found = 0;
+
+	if (transactional != 2) {
+		for (i = 0; i < n; i++)
+			found += (results[i] = ht_contains(set, keys[i], transactional));
+		return found;
+	}
+
+	for (i = 0; i < BATCH_WINDOW; i++) {
+		if (next < n) {
+			idx[i] = next++;
+			node[i] = HT_HEAD(set, HT_ADDR(keys[idx[i]]));
+			batch_prefetch(node[i]);
+			active++;
+		} else {
+			idx[i] = -1;
+		}
+	}
+	while (active > 0) {
+		for (i = 0; i < BATCH_WINDOW; i++) {
+			if ((k = idx[i]) < 0)
+				continue;
+			if (node[i]->val < keys[k]) {
+				node[i] = node[i]->next;
+				batch_prefetch(node[i]);
+				continue;
+			}
+			/* Same outcome as parse_find() */
+			results[k] = (node[i]->val == keys[k] && !is_marked_ref((long) node[i]));
+			found += results[k];
+			if (next < n) {
+				idx[i] = next++;
+				node[i] = HT_HEAD(set, HT_ADDR(keys[idx[i]]));
+				batch_prefetch(node[i]);
+			} else {
+				idx[i] = -1;
+				active--;
+			}
+		}
+	}
+	return found;
+}
+
 /* 
  * Move an element in the hashtable (from one linked-list to another)
  */
@@ -127,16 +246,16 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 	if (val1 == val2) return 0;
 	
 	// records pred and succ of val1
-	addr1 = val1 % maxhtlength;
-	pred1 = set->buckets[addr1]->head;
+	addr1 = HT_ADDR(val1);
+	pred1 = HT_HEAD(set, addr1);
 	curr1 = pred1->next;
 	while (curr1->val < val1) {
 		pred1 = curr1;
 		curr1 = curr1->next;
 	}
 	// records pred and succ of val2 
-	addr2 = val2 % maxhtlength;
-	pred2 = set->buckets[addr2]->head;
+	addr2 = HT_ADDR(val2);
+	pred2 = HT_HEAD(set, addr2);
 	curr2 = pred2->next;
 	while (curr2->val < val2) {
 		pred2 = curr2;
@@ -148,15 +267,15 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 		return 0;
 	// acquire locks in order
 	if (addr1 < addr2 || (addr1 == addr2 && val1 < val2)) {
-		LOCK(&pred1->lock);
-		LOCK(&curr1->lock);
-		LOCK(&pred2->lock);
-		LOCK(&curr2->lock);
+		LOCK_NODE(pred1);
+		LOCK_NODE(curr1);
+		LOCK_NODE(pred2);
+		LOCK_NODE(curr2);
 	} else {
-		LOCK(&pred2->lock);
-		LOCK(&curr2->lock);
-		LOCK(&pred1->lock);
-		LOCK(&curr1->lock);
+		LOCK_NODE(pred2);
+		LOCK_NODE(curr2);
+		LOCK_NODE(pred1);
+		LOCK_NODE(curr1);
 	}
 	// remove val1 and insert val2 
 	result = (parse_validate(pred1, curr1) && (val1 == curr1->val) &&
@@ -164,14 +283,16 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 	if (result) {
 		set_mark((long) curr1);
 		pred1->next = curr1->next;
+		/* Never freed, as in the lazy list */
+		ma_retire(sizeof(node_l_t));
 		newnode = new_node_l(val2, curr2, 0);
 		pred2->next = newnode;
 	}
 	// release locks in order
-	UNLOCK(&pred2->lock);
-	UNLOCK(&pred1->lock);
-	UNLOCK(&curr2->lock);
-	UNLOCK(&curr1->lock);
+	UNLOCK_NODE(pred2);
+	UNLOCK_NODE(pred1);
+	UNLOCK_NODE(curr2);
+	UNLOCK_NODE(curr1);
 		
 	return result;
 }
@@ -186,20 +307,20 @@ int ht_snapshot_unmovable(ht_intset_t *set, int transactional) {
 	int sum = 0;
 	
 	for (i=0; i < maxhtlength; i++) {
-		curr = set->buckets[i]->head;
-		next = set->buckets[i]->head->next;
+		curr = HT_HEAD(set, i);
+		next = HT_HEAD(set, i)->next;
 		
   		//pthread_mutex_lock((pthread_mutex_t *) &next->lock);
-		LOCK(&next->lock);
+		LOCK_NODE(next);
 	    
 		while (next->next) {
-			UNLOCK(&next->lock);
+			UNLOCK_NODE(next);
 			curr = next;
 			if (!is_marked_ref((long) next)) sum += next->val;
 			next = curr->next;
-			LOCK(&next->lock);
+			LOCK_NODE(next);
 		}
-		UNLOCK(&next->lock);
+		UNLOCK_NODE(next);
 	}
 	
 	return sum;
@@ -218,15 +339,15 @@ int ht_snapshot(ht_intset_t *set, int transactional) {
 	
 	for (i=0; i < m; i++) {
 	  do {
-	    LOCK(&set->buckets[i]->head->lock);
-	    LOCK(&set->buckets[i]->head->next->lock);
-	    curr = set->buckets[i]->head;
-	    next = set->buckets[i]->head->next;
+	    LOCK_NODE(HT_HEAD(set, i));
+	    LOCK_NODE(HT_HEAD(set, i)->next);
+	    curr = HT_HEAD(set, i);
+	    next = HT_HEAD(set, i)->next;
 	  } while (!parse_validate(curr, next));
 
 	  while (next->next) {
 	    while(1) {
-	      LOCK(&next->next->lock);
+	      LOCK_NODE(next->next);
 	      curr = next;
 	      next = curr->next;
 	      if (parse_validate(curr, next)) {
@@ -240,15 +361,15 @@ int ht_snapshot(ht_intset_t *set, int transactional) {
 	}
 	
 	for (i=0; i < m; i++) {
-	  curr = set->buckets[i]->head;
-	  next = set->buckets[i]->head->next;
+	  curr = HT_HEAD(set, i);
+	  next = HT_HEAD(set, i)->next;
 	  
-	  UNLOCK(&curr->lock);
-	  UNLOCK(&next->lock);
+	  UNLOCK_NODE(curr);
+	  UNLOCK_NODE(next);
 	  while (next->next) {
 	    curr = next;
 	    next = curr->next;
-	    UNLOCK(&next->lock);
+	    UNLOCK_NODE(next);
 	  }
 	}
 	
@@ -25,6 +25,7 @@
  */
 
 #include "../linkedlists/lazy-list/intset.h"
+#include "batch.h"
 
 #define DEFAULT_MOVE                    0
 #define DEFAULT_SNAPSHOT                0
@@ -34,6 +35,7 @@
 #define DEFAULT_EFFECTIVE               1
 
 #define MAXHTLENGTH                     65536
+#define CACHE_LINE_SIZE                 64
 
 /* Hashtable length (# of buckets) */
 extern unsigned int maxhtlength;
@@ -42,10 +44,49 @@ extern unsigned int maxhtlength;
  * HASH TABLE
  * ################################################################### */
 
+#ifdef HT_INDIRECT
+
+/*
+ * Indirect layout: each bucket is a separately allocated list with its own
+ * head and tail sentinels, reached through an array of pointers.
+ */
 typedef struct ht_intset {
 	intset_l_t *buckets[MAXHTLENGTH];
 } ht_intset_t;
 
+#  define HT_ADDR(val)                  ((val) % maxhtlength)
+#  define HT_HEAD(set, addr)            ((set)->buckets[addr]->head)
+#  define HT_BUCKET(set, addr, tmp)     ((set)->buckets[addr])
+
+#else /* ! HT_INDIRECT */
+
+/*
+ * Inline layout: the head sentinels of all buckets are stored contiguously
+ * in a cache-line aligned array and all buckets end with the same tail
+ * sentinel, so reaching the first node of a bucket costs a single load.
+ * The number of buckets is a power of two indexed by a mixing hash.
+ */
+typedef struct ht_intset {
+	node_l_t *buckets;
+	node_l_t *tail;
+} ht_intset_t;
+
+/* Finalizer of MurmurHash3, spreads consecutive keys over all buckets */
+static inline unsigned int ht_hash(unsigned int h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+#  define HT_ADDR(val)                  (ht_hash(val) & (maxhtlength - 1))
+#  define HT_HEAD(set, addr)            (&(set)->buckets[addr])
+#  define HT_BUCKET(set, addr, tmp)     ((tmp)->head = HT_HEAD(set, addr), (tmp))
+
+#endif /* ! HT_INDIRECT */
+
 void ht_delete(ht_intset_t *set);
 int ht_size(ht_intset_t *set);
 int floor_log_2(unsigned int n);
@@ -53,6 +94,12 @@ ht_intset_t *ht_new();
 int ht_contains(ht_intset_t *set, int val, int transactional);
 int ht_add(ht_intset_t *set, int val, int transactional);
 int ht_remove(ht_intset_t *set, int val, int transactional);
+/*
+ * Looks up the n keys by interleaving their traversals (see batch.h),
+ * stores the outcome of each lookup in results and returns the number of
+ * keys found.
+ */
+int ht_contains_batch(ht_intset_t *set, int *keys, int n, int *results, int transactional);
 
 /* 
  * Move an element in the hashtable (from one linked-list to another)
@@ -26,6 +26,8 @@
 
 #include "hashtable.h"
 
+#ifdef HT_INDIRECT
+
 void ht_delete(ht_intset_t *set) {
   node_t *node, *next;
   int i;
@@ -34,7 +36,7 @@ void ht_delete(ht_intset_t *set) {
     node = set->buckets[i]->head;
     while (node != NULL) {
       next = node->next;
-      free(node);
+      free_node(node);
       node = next;
     }
     free(set->buckets[i]);
@@ -43,13 +45,34 @@ void ht_delete(ht_intset_t *set) {
   free(set);
 }
 
+#else /* ! HT_INDIRECT */
+
+void ht_delete(ht_intset_t *set) {
+  node_t *node, *next;
+  int i;
+  
+  for (i=0; i < maxhtlength; i++) {
+    node = set->buckets[i].next;
+    while (node != set->tail) {
+      next = node->next;
+      free_node(node);
+      node = next;
+    }
+  }
+  free_node(set->tail);
+  free(set->buckets);
+  free(set);
+}
+
+#endif /* ! HT_INDIRECT */
+
 int ht_size(ht_intset_t *set) {
 	int size = 0;
 	node_t *node;
 	int i;
 	
 	for (i=0; i < maxhtlength; i++) {
-		node = set->buckets[i]->head->next;
+		node = HT_HEAD(set, i)->next;
 		while (node->next) {
 			size++;
 			node = node->next;
@@ -71,6 +94,8 @@ int floor_log_2(unsigned int n) {
 	return ((n == 0) ? (-1) : pos);
 }
 
+#ifdef HT_INDIRECT
+
 ht_intset_t *ht_new() {
 	ht_intset_t *set;
 	int i;
@@ -89,3 +114,38 @@ ht_intset_t *ht_new() {
 	}
 	return set;
 }
+
+#else /* ! HT_INDIRECT */
+
+/*
+ * Rounds maxhtlength up to a power of two before allocating the inline
+ * bucket heads, all pointing to the shared tail.
+ */
+ht_intset_t *ht_new() {
+	ht_intset_t *set;
+	unsigned int length = 1;
+	int i;
+	
+	while (length < maxhtlength)
+		length <<= 1;
+	maxhtlength = length;
+
+	if ((set = (ht_intset_t *)malloc(sizeof(ht_intset_t))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}  
+	if (posix_memalign((void **)&set->buckets, CACHE_LINE_SIZE,
+			   maxhtlength * sizeof(node_t)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+	set->tail = new_node(VAL_MAX, NULL, 0);
+
+	for (i=0; i < maxhtlength; i++) {
+		set->buckets[i].val = VAL_MIN;
+		set->buckets[i].next = set->tail;
+	}
+	return set;
+}
+
+#endif /* ! HT_INDIRECT */
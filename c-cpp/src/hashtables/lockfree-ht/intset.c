@@ -23,36 +23,141 @@
 
 #include "intset.h"
 
+#ifdef FC
+/* Adapters of the operations applied by the combiner (see fc.h) */
+static int fc_ht_contains(void *set, long *a) {
+	return ht_contains((ht_intset_t *)set, (int)a[0], (int)a[1]);
+}
+
+static int fc_ht_add(void *set, long *a) {
+	return ht_add((ht_intset_t *)set, (int)a[0], (int)a[1]);
+}
+
+static int fc_ht_remove(void *set, long *a) {
+	return ht_remove((ht_intset_t *)set, (int)a[0], (int)a[1]);
+}
+
+static int fc_ht_move(void *set, long *a) {
+	return ht_move((ht_intset_t *)set, (int)a[0], (int)a[1], (int)a[2]);
+}
+
+static int fc_ht_snapshot(void *set, long *a) {
+	return ht_snapshot((ht_intset_t *)set, (int)a[0]);
+}
+#endif /* FC */
+
 int ht_contains(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
 	int addr;
 	
-	addr = val % maxhtlength;
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_ht_contains, set, val, transactional, 0, 0);
+#endif /* FC */
+
+	addr = HT_ADDR(val);
 	if (transactional == 5)
-	  return set_contains(set->buckets[addr], val, 4);
+	  return set_contains(HT_BUCKET(set, addr, &bucket), val, 4);
 	else
-	  return set_contains(set->buckets[addr], val, transactional);
+	  return set_contains(HT_BUCKET(set, addr, &bucket), val, transactional);
 }
 
 int ht_add(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
 	int addr;
 	
-	addr = val % maxhtlength;
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_ht_add, set, val, transactional, 0, 0);
+#endif /* FC */
+
+	addr = HT_ADDR(val);
 	if (transactional == 5)
-		return set_add(set->buckets[addr], val, 4);
+		return set_add(HT_BUCKET(set, addr, &bucket), val, 4);
 	else 
-		return set_add(set->buckets[addr], val, transactional);
+		return set_add(HT_BUCKET(set, addr, &bucket), val, transactional);
 }
 
 int ht_remove(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
 	int addr;
     
-	addr = val % maxhtlength;
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_ht_remove, set, val, transactional, 0, 0);
+#endif /* FC */
+
+	addr = HT_ADDR(val);
 	if (transactional == 5)
-		return set_remove(set->buckets[addr], val, 4);
+		return set_remove(HT_BUCKET(set, addr, &bucket), val, 4);
 	else
-		return set_remove(set->buckets[addr], val, transactional);
+		return set_remove(HT_BUCKET(set, addr, &bucket), val, transactional);
 }
 
+#if defined(LOCKFREE) && !defined(SMR_HP) && !defined(SMR_IBR)
+
+#define HT_UNMARKED(p)                  ((node_t *)((uintptr_t)(p) & ~(uintptr_t)1))
+#define HT_MARKED(p)                    ((uintptr_t)(p) & 1)
+
+/*
+ * Each lookup walks its bucket like a wait-free contains: it skips over
+ * the marks and stops at the first node whose value is not lower than
+ * the key, which holds the key if it is not marked. Hazard pointers and
+ * interval-based reclamation do not allow to walk through removed
+ * nodes, these builds look the keys up one after the other.
+ */
+int ht_contains_batch(ht_intset_t *set, int *keys, int n, int *results, int transactional) {
+	node_t *node[BATCH_WINDOW];
+	int idx[BATCH_WINDOW];
+	int i, k, next = 0, active = 0, found = 0;
+
+	smr_begin();
+	for (i = 0; i < BATCH_WINDOW; i++) {
+		if (next < n) {
+			idx[i] = next++;
+			node[i] = HT_HEAD(set, HT_ADDR(keys[idx[i]]));
+			batch_prefetch(node[i]);
+			active++;
+		} else
+			idx[i] = -1;
+	}
+	while (active > 0) {
+		for (i = 0; i < BATCH_WINDOW; i++) {
+			if ((k = idx[i]) < 0)
+				continue;
+			if (node[i]->val < keys[k]) {
+				node[i] = HT_UNMARKED(node[i]->next);
+				batch_prefetch(node[i]);
+				continue;
+			}
+			results[k] = (node[i]->val == keys[k] && !HT_MARKED(node[i]->next));
+			found += results[k];
+			if (next < n) {
+				idx[i] = next++;
+				node[i] = HT_HEAD(set, HT_ADDR(keys[idx[i]]));
+				batch_prefetch(node[i]);
+			} else {
+				idx[i] = -1;
+				active--;
+			}
+		}
+	}
+	smr_end();
+	return found;
+}
+
+#else
+
+int ht_contains_batch(ht_intset_t *set, int *keys, int n, int *results, int transactional) {
+	int i, found = 0;
+
+	for (i = 0; i < n; i++)
+		found += (results[i] = ht_contains(set, keys[i], transactional));
+	return found;
+}
+
+#endif /* LOCKFREE && ! SMR_HP && ! SMR_IBR */
+
 /* 
  * Move an element from one bucket to another.
  * It is equivalent to changing the key associated with some value.
@@ -66,12 +171,13 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 	
 #ifdef SEQUENTIAL
 	
+	intset_t bucket;
 	int addr1, addr2;
 		
-	addr1 = val1 % maxhtlength;
-	addr2 = val2 % maxhtlength;
-	result =  (set_remove(set->buckets[addr1], val1, transactional) && 
-			   set_add(set->buckets[addr2], val2, transactional));
+	addr1 = HT_ADDR(val1);
+	addr2 = HT_ADDR(val2);
+	result =  (set_remove(HT_BUCKET(set, addr1, &bucket), val1, transactional) && 
+			   set_add(HT_BUCKET(set, addr2, &bucket), val2, transactional));
 	
 #elif defined STM
 	
@@ -81,8 +187,8 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 	if (transactional > 1) {
 	  
 	  TX_START(EL);
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -96,8 +202,8 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 	    TX_STORE(&prev->next, n);
 	    FREE(next, sizeof(node_t));
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -116,8 +222,8 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 	} else { 
 
 	  TX_START(NL);
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -131,8 +237,8 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 	    TX_STORE(&prev->next, n);
 	    FREE(next, sizeof(node_t));
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -168,16 +274,22 @@ int ht_move_naive(ht_intset_t *set, int val1, int val2, int transactional) {
 int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
   int result = 0;
 
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_ht_move, set, val1, val2, transactional, 0);
+#endif /* FC */
+
 #ifdef SEQUENTIAL
 
+	intset_t bucket;
 	int addr1, addr2;
 		
-	addr1 = val1 % maxhtlength;
-	addr2 = val2 % maxhtlength;
+	addr1 = HT_ADDR(val1);
+	addr2 = HT_ADDR(val2);
 
-	if (set_remove(set->buckets[addr1], val1, 0)) 
+	if (set_remove(HT_BUCKET(set, addr1, &bucket), val1, 0)) 
 	  result = 1;
-	set_seq_add(set->buckets[addr2], val2, 0);
+	set_seq_add(HT_BUCKET(set, addr2, &bucket), val2, 0);
 	return result;
 
 #elif defined STM
@@ -189,8 +301,8 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 	
 	  TX_START(EL);
 	  result = 0;
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -202,8 +314,8 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 	  next1 = next;
 	  if (v == val1) {
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -228,8 +340,8 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 
 	  TX_START(NL);
 	  result = 0;
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -241,8 +353,8 @@ int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
 	  next1 = next;
 	  if (v == val1) {
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -285,11 +397,12 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 	
 #ifdef SEQUENTIAL
 
+	intset_t bucket;
 	int addr1, addr2;		
-	addr1 = val1 % maxhtlength;
-	addr2 = val2 % maxhtlength;
-	result =  (set_remove(set->buckets[addr1], val1, transactional) &&
-			   set_add(set->buckets[addr2], val2, transactional));
+	addr1 = HT_ADDR(val1);
+	addr2 = HT_ADDR(val2);
+	result =  (set_remove(HT_BUCKET(set, addr1, &bucket), val1, transactional) &&
+			   set_add(HT_BUCKET(set, addr2, &bucket), val2, transactional));
 	
 #elif defined STM
 
@@ -300,8 +413,8 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 
 	  TX_START(EL);
 	  result = 0;
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -316,8 +429,8 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 	    n = (node_t *)TX_LOAD(&next->next);
 	    TX_STORE(&prev->next, n);
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -341,8 +454,8 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 	  
 	  TX_START(NL);
 	  result = 0;
-	  addr1 = val1 % maxhtlength;
-	  prev = (node_t *)TX_LOAD(&set->buckets[addr1]->head);
+	  addr1 = HT_ADDR(val1);
+	  prev = HT_HEAD(set, addr1);
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while(1) {
 	    v = TX_LOAD(&next->val);
@@ -357,8 +470,8 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 	    n = (node_t *)TX_LOAD(&next->next);
 	    TX_STORE(&prev->next, n);
 	    /* Inserting */
-	    addr2 = val2 % maxhtlength;
-	    prev = (node_t *)TX_LOAD(&set->buckets[addr2]->head);
+	    addr2 = HT_ADDR(val2);
+	    prev = HT_HEAD(set, addr2);
 	    next = (node_t *)TX_LOAD(&prev->next);
 	    while(1) {
 	      v = TX_LOAD(&next->val);
@@ -401,13 +514,18 @@ int ht_move_orrollback(ht_intset_t *set, int val1, int val2, int transactional)
 int ht_snapshot(ht_intset_t *set, int transactional) {
   int result = 0; 
 	
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_ht_snapshot, set, transactional, 0, 0, 0);
+#endif /* FC */
+
 #ifdef SEQUENTIAL
 
 	int i, sum = 0;
 	node_t *next;
 	
 	for (i=0; i < maxhtlength; i++) {
-		next = set->buckets[i]->head->next;
+		next = HT_HEAD(set, i)->next;
 		while(next->next) {
 			sum += next->val;
 			next = next->next;
@@ -420,11 +538,11 @@ int ht_snapshot(ht_intset_t *set, int transactional) {
 	int i, sum = 0;
 	node_t *next;
 
-	// always a normal transaction
-	TX_START(NL);
+	// always a normal transaction, declared read-only
+	TX_START(RO);
 	result = 0;
 	for (i=0; i < maxhtlength; i++) {
-		next = (node_t *)TX_LOAD(&set->buckets[i]->head->next);
+		next = (node_t *)TX_LOAD(&HT_HEAD(set, i)->next);
 		while(next->next) {
 			sum += TX_LOAD(&next->val);
 			next = (node_t *)TX_LOAD(&next->next);
@@ -23,11 +23,19 @@
 
 
 #include "hashtable.h"
+#include "batch.h"
 
 int ht_contains(ht_intset_t *set, int val, int transactional);
 int ht_add(ht_intset_t *set, int val, int transactional);
 int ht_remove(ht_intset_t *set, int val, int transactional);
 
+/*
+ * Looks up the n keys by interleaving their traversals (see batch.h),
+ * stores the outcome of each lookup in results and returns the number of
+ * keys found.
+ */
+int ht_contains_batch(ht_intset_t *set, int *keys, int n, int *results, int transactional);
+
 /* 
  * Move an element from one bucket to another.
  * It is equivalent to changing the key associated with some value.
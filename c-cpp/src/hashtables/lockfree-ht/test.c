@@ -21,6 +21,13 @@
  * GNU General Public License for more details.
  */
 
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "timeseries.h"
+#include "trace.h"
+#include "batch.h"
 #include "intset.h"
 
 /* Hashtable length (# of buckets) */
@@ -105,6 +112,7 @@ typedef struct thread_data {
 	int unit_tx;
 	int alternate;
 	int effective;
+	int batch;
 	unsigned long nb_add;
 	unsigned long nb_added;
 	unsigned long nb_remove;
@@ -131,23 +139,35 @@ typedef struct thread_data {
 	ht_intset_t *set;
 	barrier_t *barrier;
 	unsigned long failures_because_contention;
+	lat_stats_t *lat;
+	wl_thread_t wl;
+	int cpu;
+	pc_stats_t *pc;
+	tr_stream_t *rec;
+	tr_cursor_t cursor;
 } thread_data_t;
 
 
 void *test(void *data) {
+	int keys[BATCH_MAX];
+	int results[BATCH_MAX], i;
 	int val2, numtx, r, last = -1;
 	val_t val = 0;
 	int unext, mnext, cnext;
 	
 	thread_data_t *d = (thread_data_t *)data;
 	
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
 	/* Create transaction */
 	TM_THREAD_ENTER();
 	/* Wait on barrier */
 	barrier_cross(d->barrier);
+	pc_start(d->pc);
 	
 	/* Is the first op an update, a move? */
-	r = rand_range_re(&d->seed, 100) - 1;
+	r = wl_rand_range(&d->wl, 100) - 1;
 	unext = (r < d->update);
 	mnext = (r < d->move);
 	cnext = (r >= d->update + d->snapshot);
@@ -162,10 +182,10 @@ void *test(void *data) {
 	    
 	    if (mnext) { // move
 	      
-	      if (last == -1) val = rand_range_re(&d->seed, d->range);
+	      if (last == -1) val = wl_key(&d->wl);
 	      else val = last;
-	      val2 = rand_range_re(&d->seed, d->range);
-	      if (ht_move(d->set, val, val2, TRANSACTIONAL)) {
+	      val2 = wl_key(&d->wl);
+	      if (LAT_OP(d->lat, LAT_MOVE, ht_move(d->set, val, val2, TRANSACTIONAL))) {
 					d->nb_moved++;
 					last = -1;
 	      }
@@ -173,8 +193,9 @@ void *test(void *data) {
 	      
 	    } else if (last < 0) { // add
 	      
-	      val = rand_range_re(&d->seed, d->range);
-	      if (ht_add(d->set, val, TRANSACTIONAL)) {
+	      val = wl_key(&d->wl);
+	      tr_log(d->rec, LAT_ADD, val);
+	      if (LAT_OP(d->lat, LAT_ADD, ht_add(d->set, val, TRANSACTIONAL))) {
 					d->nb_added++;
 					last = val;
 	      } 				
@@ -183,15 +204,17 @@ void *test(void *data) {
 	    } else { // remove
 	      
 	      if (d->alternate) { // alternate mode
-					if (ht_remove(d->set, last, TRANSACTIONAL)) {
+					tr_log(d->rec, LAT_REMOVE, last);
+					if (LAT_OP(d->lat, LAT_REMOVE, ht_remove(d->set, last, TRANSACTIONAL))) {
 						d->nb_removed++;
 						last = -1;
 					}
 	      } else {
 					/* Random computation only in non-alternated cases */
-					val = rand_range_re(&d->seed, d->range);
+					val = wl_key(&d->wl);
 					/* Remove one random value */
-					if (ht_remove(d->set, val, TRANSACTIONAL)) {
+					tr_log(d->rec, LAT_REMOVE, val);
+					if (LAT_OP(d->lat, LAT_REMOVE, ht_remove(d->set, val, TRANSACTIONAL))) {
 						d->nb_removed++;
 						/* Repeat until successful, to avoid size variations */
 						last = -1;
@@ -202,7 +225,17 @@ void *test(void *data) {
 	    
 	  } else { // reads
 	    
-	    if (cnext) { // contains (no snapshot)
+	    if (cnext && d->batch > 1 && !d->alternate) { // batch of contains
+
+	      for (i = 0; i < d->batch; i++) {
+	        keys[i] = wl_key(&d->wl);
+	        tr_log(d->rec, LAT_CONTAINS, keys[i]);
+	      }
+	      /* One latency sample for the whole batch */
+	      d->nb_found += LAT_OP(d->lat, LAT_CONTAINS, ht_contains_batch(d->set, keys, d->batch, results, TRANSACTIONAL));
+	      d->nb_contains += d->batch;
+
+	    } else if (cnext) { // contains (no snapshot)
 				
 	      if (d->alternate) {
 					if (d->update == 0) {
@@ -210,26 +243,27 @@ void *test(void *data) {
 							val = d->first;
 							last = val;
 						} else { // last >= 0
-							val = rand_range_re(&d->seed, d->range);
+							val = wl_key(&d->wl);
 							last = -1;
 						}
 					} else { // update != 0
 						if (last < 0) {
-							val = rand_range_re(&d->seed, d->range);
+							val = wl_key(&d->wl);
 							//last = val;
 						} else {
 							val = last;
 						}
 					}
-	      }	else val = rand_range_re(&d->seed, d->range);
+	      }	else val = wl_key(&d->wl);
 				
-	      if (ht_contains(d->set, val, TRANSACTIONAL)) 
+	      tr_log(d->rec, LAT_CONTAINS, val);
+	      if (LAT_OP(d->lat, LAT_CONTAINS, ht_contains(d->set, val, TRANSACTIONAL))) 
 					d->nb_found++;
 	      d->nb_contains++;
 	      
 	    } else { // snapshot
 	      
-	      if (ht_snapshot(d->set, TRANSACTIONAL))
+	      if (LAT_OP(d->lat, LAT_SNAPSHOT, ht_snapshot(d->set, TRANSACTIONAL)))
 		d->nb_snapshoted++;
 	      d->nb_snapshot++;
 	      
@@ -243,7 +277,7 @@ void *test(void *data) {
 	    mnext = ((100.0 * d->nb_moved) < (d->move * numtx));
 	    cnext = !((100.0 * d->nb_snapshoted) < (d->snapshot * numtx)); 
 	  } else { // remove/add (even failed) is considered as an update
-	    r = rand_range_re(&d->seed, 100) - 1;
+	    r = wl_rand_range(&d->wl, 100) - 1;
 	    unext = (r < d->update);
 	    mnext = (r < d->move);
 	    cnext = (r >= d->update + d->snapshot);
@@ -255,6 +289,7 @@ void *test(void *data) {
 	}
 #endif /* ICC */
 	
+	pc_stop(d->pc);
 	/* Free transaction */
 	TM_THREAD_EXIT();
 	
@@ -267,22 +302,27 @@ void *test2(void *data)
 	int val, newval, last, flag = 1;
 	thread_data_t *d = (thread_data_t *)data;
 	
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
 	/* Create transaction */
 	TM_THREAD_ENTER();
 	/* Wait on barrier */
 	barrier_cross(d->barrier);
+	pc_start(d->pc);
 	
 	last = 0; // to avoid warning
 	while (stop == 0) {
 		
-	  val = rand_range_re(&d->seed, 100) - 1;
+	  val = wl_rand_range(&d->wl, 100) - 1;
 	  /* added for HashTables */
 	  if (val < d->update) {
 	    if (val >= d->move) { /* update without move */
 	      if (flag) {
 					/* Add random value */
 					val = (rand_r(&d->seed) % d->range) + 1;
-					if (ht_add(d->set, val, TRANSACTIONAL)) {
+					tr_log(d->rec, LAT_ADD, val);
+					if (LAT_OP(d->lat, LAT_ADD, ht_add(d->set, val, TRANSACTIONAL))) {
 						d->nb_added++;
 						last = val;
 						flag = 0;
@@ -291,14 +331,16 @@ void *test2(void *data)
 	      } else {
 					if (d->alternate) {
 						/* Remove last value */
-						if (ht_remove(d->set, last, TRANSACTIONAL))  
+						tr_log(d->rec, LAT_REMOVE, last);
+						if (LAT_OP(d->lat, LAT_REMOVE, ht_remove(d->set, last, TRANSACTIONAL)))  
 							d->nb_removed++;
 						d->nb_remove++;
 						flag = 1;
 					} else {
 						/* Random computation only in non-alternated cases */
-						newval = rand_range_re(&d->seed, d->range);
-						if (ht_remove(d->set, newval, TRANSACTIONAL)) {  
+						newval = wl_key(&d->wl);
+						tr_log(d->rec, LAT_REMOVE, newval);
+						if (LAT_OP(d->lat, LAT_REMOVE, ht_remove(d->set, newval, TRANSACTIONAL))) {  
 							d->nb_removed++;
 							/* Repeat until successful, to avoid size variations */
 							flag = 1;
@@ -307,8 +349,8 @@ void *test2(void *data)
 					}
 	      } 
 	    } else { /* move */
-	      val = rand_range_re(&d->seed, d->range);
-	      if (ht_move(d->set, last, val, TRANSACTIONAL)) {
+	      val = wl_key(&d->wl);
+	      if (LAT_OP(d->lat, LAT_MOVE, ht_move(d->set, last, val, TRANSACTIONAL))) {
 					d->nb_moved++;
 					last = val;
 	      }
@@ -317,18 +359,20 @@ void *test2(void *data)
 	  } else {
 	    if (val >= d->update + d->snapshot) { /* read-only without snapshot */
 	      /* Look for random value */
-	      val = rand_range_re(&d->seed, d->range);
-	      if (ht_contains(d->set, val, TRANSACTIONAL))
+	      val = wl_key(&d->wl);
+	      tr_log(d->rec, LAT_CONTAINS, val);
+	      if (LAT_OP(d->lat, LAT_CONTAINS, ht_contains(d->set, val, TRANSACTIONAL)))
 					d->nb_found++;
 				d->nb_contains++;
 	    } else { /* snapshot */
-	      if (ht_snapshot(d->set, TRANSACTIONAL))
+	      if (LAT_OP(d->lat, LAT_SNAPSHOT, ht_snapshot(d->set, TRANSACTIONAL)))
 					d->nb_snapshoted++;
 	      d->nb_snapshot++;
 	    }
 	  }
 	}
 	
+	pc_stop(d->pc);
 	/* Free transaction */
 	TM_THREAD_EXIT();
 	return NULL;
@@ -349,18 +393,72 @@ void print_set(intset_t *set) {
 }
 
 void print_ht(ht_intset_t *set) {
+	intset_t bucket;
 	int i;
 	for (i=0; i < maxhtlength; i++) {
-		print_set(set->buckets[i]);
+		print_set(HT_BUCKET(set, i, &bucket));
 	}
 }
 
+/* Replays the operations of a trace instead of generating them */
+void *replay(void *data) {
+	const tr_rec_t *r;
+
+	thread_data_t *d = (thread_data_t *)data;
+
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
+	/* Create transaction */
+	TM_THREAD_ENTER();
+	/* Wait on barrier */
+	barrier_cross(d->barrier);
+	pc_start(d->pc);
+
+	while (stop == 0) {
+		r = tr_next(&d->cursor);
+		switch (r->op) {
+		case LAT_ADD:
+			if (LAT_OP(d->lat, LAT_ADD, ht_add(d->set, r->key, TRANSACTIONAL)))
+				d->nb_added++;
+			d->nb_add++;
+			break;
+		case LAT_REMOVE:
+			if (LAT_OP(d->lat, LAT_REMOVE, ht_remove(d->set, r->key, TRANSACTIONAL)))
+				d->nb_removed++;
+			d->nb_remove++;
+			break;
+		default:
+			if (LAT_OP(d->lat, LAT_CONTAINS, ht_contains(d->set, r->key, TRANSACTIONAL)))
+				d->nb_found++;
+			d->nb_contains++;
+		}
+	}
+
+	pc_stop(d->pc);
+	/* Free transaction */
+	TM_THREAD_EXIT();
+
+	return NULL;
+}
+
 int main(int argc, char **argv)
 {
 	struct option long_options[] = {
 		// These options don't set a flag
 		{"help",                      no_argument,       NULL, 'h'},
 		{"duration",                  required_argument, NULL, 'd'},
+		{"latency",                   required_argument, NULL, 'L'},
+		{"key-dist",                  required_argument, NULL, 'K'},
+		{"pin",                       required_argument, NULL, 'P'},
+		{"numa",                      required_argument, NULL, 'N'},
+		{"counters",                  required_argument, NULL, 'C'},
+		{"interval",                  required_argument, NULL, 'T'},
+		{"rate",                      required_argument, NULL, 'O'},
+		{"arrival",                   required_argument, NULL, 'E'},
+		{"batch",                     required_argument, NULL, 'B'},
+		{"record",                    required_argument, NULL, 'w'},
+		{"replay",                    required_argument, NULL, 'Y'},
 		{"initial-size",              required_argument, NULL, 'i'},
 		{"thread-num",                required_argument, NULL, 't'},
 		{"range",                     required_argument, NULL, 'r'},
@@ -388,6 +486,24 @@ int main(int argc, char **argv)
 	struct timeval start, end;
 	struct timespec timeout;
 	int duration = DEFAULT_DURATION;
+	int latency = DEFAULT_LATENCY;
+	char *keydist = DEFAULT_KEYDIST;
+	workload_t workload;
+	char *pin = DEFAULT_PIN;
+	char *numa = DEFAULT_NUMA;
+	affinity_t aff;
+	int counters = DEFAULT_COUNTERS;
+	int interval = DEFAULT_INTERVAL;
+	int rate = DEFAULT_RATE;
+	int batch = DEFAULT_BATCH;
+	char *arrival = DEFAULT_ARRIVAL;
+	int poisson;
+	char *record = NULL;
+	char *trace_file = NULL;
+	tr_writer_t writer;
+	trace_t trace;
+	unsigned long ops;
+	ts_t ts;
 	int initial = DEFAULT_INITIAL;
 	int nb_threads = DEFAULT_NB_THREADS;
 	long range = DEFAULT_RANGE;
@@ -403,7 +519,7 @@ int main(int argc, char **argv)
 	
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:a:s:l:x:", long_options, &i);
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:a:s:l:x:L:K:P:N:C:T:O:E:B:w:Y:", long_options, &i);
 		
 		if(c == -1)
 			break;
@@ -441,6 +557,29 @@ int main(int argc, char **argv)
 								 "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 								 "  -u, --update-rate <int>\n"
 								 "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+								 "  -L, --latency <int>\n"
+								 "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+								 "  -K, --key-dist <dist>\n"
+								 "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+								 "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+								 "  -P, --pin <policy>\n"
+								 "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+								 "  -N, --numa <policy>\n"
+								 "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+								 "  -C, --counters <int>\n"
+								 "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+								 "  -T, --interval <int>\n"
+								 "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+								 "  -O, --rate <int>\n"
+								 "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+								 "  -E, --arrival <process>\n"
+								 "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
+								 "  -B, --batch <int>\n"
+								 "        Issue lookups by batches of <int> keys interleaved with prefetching (0=off, default=" XSTR(DEFAULT_BATCH) ")\n"
+								 "  -w, --record <file>\n"
+								 "        Record the operations of the threads to a trace file\n"
+								 "  -Y, --replay <file>\n"
+								 "        Replay the operations of a trace file instead of generating them\n"
 								 "  -a , --move-rate <int>\n"
 								 "        Percentage of move transactions (default=" XSTR(DEFAULT_MOVE) ")\n"
 								 "  -s , --snapshot-rate <int>\n"
@@ -493,6 +632,39 @@ int main(int argc, char **argv)
 				case 'x':
 					unit_tx = atoi(optarg);
 					break;
+				case 'K':
+					keydist = optarg;
+					break;
+				case 'P':
+					pin = optarg;
+					break;
+				case 'N':
+					numa = optarg;
+					break;
+				case 'C':
+					counters = atoi(optarg);
+					break;
+				case 'T':
+					interval = atoi(optarg);
+					break;
+				case 'O':
+					rate = atoi(optarg);
+					break;
+				case 'E':
+					arrival = optarg;
+					break;
+				case 'B':
+					batch = batch_parse(optarg);
+					break;
+				case 'w':
+					record = optarg;
+					break;
+				case 'Y':
+					trace_file = optarg;
+					break;
+				case 'L':
+					latency = atoi(optarg);
+					break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -506,18 +678,40 @@ int main(int argc, char **argv)
 	assert(nb_threads > 0);
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 100);
+	wl_init(&workload, keydist, range);
+	aff_init(&aff, pin, numa, nb_threads);
+	poisson = lat_poisson(arrival);
+	if (rate > 0 && latency == 0)
+		latency = 1;
+	if (trace_file != NULL)
+		tr_open(&trace, trace_file);
 	assert(move >= 0 && move <= update);
 	assert(snapshot >= 0 && snapshot <= (100-update));
+#ifdef HT_INDIRECT
 	assert(initial < MAXHTLENGTH);
+#endif /* HT_INDIRECT */
 	assert(initial >= load_factor);
 	
+#ifdef HT_INDIRECT
+	printf("Set type     : lock-free hash table (indirect buckets)\n");
+#else
 	printf("Set type     : lock-free hash table\n");
+#endif /* HT_INDIRECT */
 	printf("Duration     : %d\n", duration);
 	printf("Initial size : %d\n", initial);
 	printf("Nb threads   : %d\n", nb_threads);
 	printf("Value range  : %ld\n", range);
 	printf("Seed         : %d\n", seed);
 	printf("Update rate  : %d\n", update);
+	printf("Latency      : %d\n", latency);
+	printf("Key dist.    : %s\n", keydist);
+	aff_print(&aff, pin, numa);
+	printf("Counters     : %d\n", counters);
+	printf("Interval     : %d\n", interval);
+	printf("Rate         : %d (%s)\n", rate, arrival);
+	printf("Batch size   : %d\n", batch);
+	if (trace_file != NULL)
+		tr_print(&trace, trace_file);
 	printf("Load factor  : %d\n", load_factor);
 	printf("Move rate    : %d\n", move);
 	printf("Snapshot rate: %d\n", snapshot);
@@ -560,14 +754,15 @@ int main(int argc, char **argv)
 	// Populate set 
 	printf("Adding %d entries to set\n", initial);
 	i = 0;
-	maxhtlength = (int) (initial / load_factor);
 	while (i < initial) {
+		aff_populate(&aff, i, initial);
 		val = rand_range(range);
 		if (ht_add(set, val, 0)) {
 		  last = val;
 		  i++;			
 		}
 	}
+	aff_populate_done(&aff);
 	size = ht_size(set);
 	printf("Set size     : %d\n", size);
 	printf("Bucket amount: %d\n", maxhtlength);
@@ -608,10 +803,19 @@ int main(int argc, char **argv)
 		data[i].nb_aborts_double_write = 0;
 		data[i].max_retries = 0;
 		data[i].seed = rand();
+		data[i].lat = lat_new(latency);
+		lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+		wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+		data[i].cpu = aff_cpu(&aff, i);
+		data[i].pc = pc_new(counters);
+		data[i].batch = batch;
+		data[i].rec = tr_stream_new(record, i);
+		if (trace_file != NULL)
+			tr_cursor_init(&data[i].cursor, &trace, i, nb_threads);
 		data[i].set = set;
 		data[i].barrier = &barrier;
 		data[i].failures_because_contention = 0;
-		if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+		if (pthread_create(&threads[i], &attr, (trace_file != NULL ? replay : test), (void *)(&data[i])) != 0) {
 			fprintf(stderr, "Error creating thread\n");
 			exit(1);
 		}
@@ -624,7 +828,17 @@ int main(int argc, char **argv)
 	printf("STARTING...\n");
 	gettimeofday(&start, NULL);
 	if (duration > 0) {
-		nanosleep(&timeout, NULL);
+		if (interval > 0) {
+			ts_init(&ts, interval, duration);
+			while (ts_wait(&ts)) {
+				for (ops = 0, i = 0; i < nb_threads; i++)
+					ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains
+						+ data[i].nb_move + data[i].nb_snapshot;
+				ts_sample(&ts, ops);
+			}
+		} else {
+			nanosleep(&timeout, NULL);
+		}
 	} else {
 		sigemptyset(&block_set);
 		sigsuspend(&block_set);
@@ -711,6 +925,15 @@ int main(int argc, char **argv)
 	printf("Set size      : %d (expected: %d)\n", ht_size(set), size);
 	printf("Duration      : %d (ms)\n", duration);
 	printf("#txs          : %lu (%f / s)\n", reads + updates + snapshots, (reads + updates + snapshots) * 1000.0 / duration);
+	if (counters) {
+		pc_stats_t *pc = pc_new(counters);
+		for (i = 0; i < nb_threads; i++) {
+			pc_merge(pc, data[i].pc);
+			free(data[i].pc);
+		}
+		pc_print(pc, reads + updates + snapshots);
+		free(pc);
+	}
 	
 	printf("#read txs     : ");
 	if (effective) {
@@ -741,6 +964,30 @@ int main(int argc, char **argv)
 	printf("  #dup-w      : %lu (%f / s)\n", aborts_double_write, aborts_double_write * 1000.0 / duration);
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
+#ifdef FC
+	fc_print();
+#endif /* FC */
+#ifdef LOCKFREE
+	ma_print(size);
+	smr_print();
+#endif /* LOCKFREE */
+	if (record != NULL) {
+		tr_create(&writer, record, nb_threads);
+		for (i = 0; i < nb_threads; i++)
+			tr_append(&writer, data[i].rec);
+		tr_finish(&writer);
+	}
+	if (trace_file != NULL)
+		tr_close(&trace);
+	if (latency > 0) {
+		lat_stats_t *lat = lat_new(latency);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(lat, data[i].lat);
+			free(data[i].lat);
+		}
+		lat_print(lat);
+		free(lat);
+	}
 	
 	// Delete set 
 	ht_delete(set);
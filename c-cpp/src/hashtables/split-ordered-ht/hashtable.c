@@ -0,0 +1,179 @@
+/*
+ * File:
+ *   hashtable.c
+ * Description:
+ *   Resizable lock-free hashtable based on split-ordered lists
+ *   "Split-Ordered Lists: Lock-Free Extensible Hash Tables"
+ *   O. Shalev and N. Shavit, J. ACM 53(3), p. 379-405, 2006.
+ *   All keys live in a single Harris linked list sorted by their
+ *   bit-reversed hash. Each bucket is a shortcut pointer to a dummy node
+ *   of that list, so that doubling the number of buckets never moves a
+ *   key: the new bucket is lazily initialized by inserting its dummy node
+ *   after the dummy node of its parent bucket.
+ *
+ * hashtable.c is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "hashtable.h"
+
+static inline uint32_t reverse32(uint32_t v) {
+	v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+	v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F) | ((v & 0x0F0F0F0F) << 4);
+	v = ((v >> 8) & 0x00FF00FF) | ((v & 0x00FF00FF) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+static inline int so_log2(unsigned long n) {
+	return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(n);
+}
+
+/*
+ * Regular keys have their lowest split-ordered bit set, dummy keys have it
+ * cleared, hence a dummy node always precedes the keys of its bucket.
+ */
+val_t so_regular_key(val_t val) {
+	return (val_t)reverse32((uint32_t)val | SO_HIBIT);
+}
+
+val_t so_dummy_key(unsigned long bucket) {
+	return (val_t)reverse32((uint32_t)bucket & ~SO_HIBIT);
+}
+
+/*
+ * Returns the directory slot of bucket, allocating its segment if needed.
+ */
+static node_t **so_bucket_slot(ht_intset_t *set, unsigned long bucket) {
+	node_t **seg;
+	unsigned long len, idx;
+	int s;
+
+	if (bucket == 0) {
+		s = 0;
+		len = 1;
+		idx = 0;
+	} else {
+		s = so_log2(bucket) + 1;
+		len = 1UL << (s - 1);
+		idx = bucket - len;
+	}
+	seg = set->segments[s];
+	if (seg == NULL) {
+		if ((seg = (node_t **)calloc(len, sizeof(node_t *))) == NULL) {
+			perror("calloc");
+			exit(1);
+		}
+		if (!ATOMIC_CAS_MB(&set->segments[s], NULL, seg)) {
+			free(seg);
+			seg = set->segments[s];
+		}
+	}
+	return &seg[idx];
+}
+
+/*
+ * Inserts the dummy node of key in the list, starting from start, and
+ * returns it. If another thread inserted it first, its node is returned.
+ */
+static node_t *so_insert_dummy(node_t *start, val_t key) {
+	intset_t from;
+	node_t *newnode, *right_node, *left_node;
+
+	from.head = start;
+	left_node = start;
+	smr_begin();
+	do {
+		right_node = harris_search(&from, key, &left_node);
+		if (right_node->val == key)
+			break;
+		newnode = new_node(key, right_node, 0);
+		/* mem-bar between node creation and insertion */
+		AO_nop_full();
+		if (ATOMIC_CAS_MB(&left_node->next, right_node, newnode)) {
+			right_node = newnode;
+			break;
+		}
+		free_node(newnode);
+	} while (1);
+	/* Dummy nodes are never removed, they remain valid after smr_end */
+	smr_end();
+	return right_node;
+}
+
+/*
+ * Returns the dummy node of bucket, initializing the bucket (and
+ * recursively its parents) the first time it is accessed. The parent of a
+ * bucket is the bucket obtained by clearing its most significant bit.
+ */
+node_t *so_get_bucket(ht_intset_t *set, unsigned long bucket) {
+	node_t **slot, *parent, *dummy;
+
+	slot = so_bucket_slot(set, bucket);
+	if ((dummy = *slot) != NULL)
+		return dummy;
+
+	parent = so_get_bucket(set, bucket & ~(1UL << so_log2(bucket)));
+	dummy = so_insert_dummy(parent, so_dummy_key(bucket));
+	/* Concurrent initializers all find the same dummy node */
+	ATOMIC_CAS_MB(slot, NULL, dummy);
+	return dummy;
+}
+
+unsigned long ht_buckets(ht_intset_t *set) {
+	return (unsigned long)AO_load_full(&set->size);
+}
+
+void ht_delete(ht_intset_t *set) {
+	node_t *node, *next;
+	int i;
+
+	node = set->head;
+	while (node != NULL) {
+		next = (node_t *)get_unmarked_ref((long)node->next);
+		free_node(node);
+		node = next;
+	}
+	for (i = 0; i < SO_SEGMENTS; i++)
+		free(set->segments[i]);
+	free(set);
+}
+
+int ht_size(ht_intset_t *set) {
+	int size = 0;
+	node_t *node;
+
+	node = (node_t *)get_unmarked_ref((long)set->head->next);
+	while (node->next) {
+		if ((node->val & 1) && !is_marked_ref((long)node->next))
+			size++;
+		node = (node_t *)get_unmarked_ref((long)node->next);
+	}
+	return size;
+}
+
+ht_intset_t *ht_new() {
+	ht_intset_t *set;
+	node_t *tail;
+
+	if ((set = (ht_intset_t *)calloc(1, sizeof(ht_intset_t))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	tail = new_node(SO_TAIL, NULL, 0);
+	set->head = new_node(so_dummy_key(0), tail, 0);
+	*so_bucket_slot(set, 0) = set->head;
+	set->size = SO_INIT_BUCKETS;
+	set->count = 0;
+
+	return set;
+}
@@ -0,0 +1,63 @@
+/*
+ * File:
+ *   hashtable.h
+ * Description:
+ *   Resizable lock-free hashtable based on split-ordered lists
+ *   "Split-Ordered Lists: Lock-Free Extensible Hash Tables"
+ *   O. Shalev and N. Shavit, J. ACM 53(3), p. 379-405, 2006.
+ *
+ * hashtable.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "../../linkedlists/lockfree-list/intset.h"
+
+#define DEFAULT_MOVE                    0
+#define DEFAULT_SNAPSHOT                0
+#define DEFAULT_LOAD                    2
+#define DEFAULT_ELASTICITY              4
+#define DEFAULT_ALTERNATE               0
+#define DEFAULT_EFFECTIVE               1
+
+/*
+ * Buckets are stored in a directory of segments, segment 0 holds bucket 0
+ * and segment s > 0 holds the 2^(s-1) buckets [2^(s-1), 2^s). Segments are
+ * allocated on demand so that the directory grows without ever being copied.
+ */
+#define SO_SEGMENTS                     32
+#define SO_MAX_BUCKETS                  (1UL << (SO_SEGMENTS - 1))
+#define SO_INIT_BUCKETS                 2
+
+/* Keys are split-ordered on 32 bits, the top bit distinguishes regular keys */
+#define SO_HIBIT                        0x80000000UL
+#define SO_KEY_MAX                      0x7FFFFFFF
+#define SO_TAIL                         LONG_MAX
+
+/* Maximum average number of keys per bucket before doubling */
+extern unsigned int so_load_factor;
+
+typedef struct ht_intset {
+	/* Bucket 0 dummy node, head of the whole split-ordered list */
+	node_t *head;
+	node_t **segments[SO_SEGMENTS];
+	volatile AO_t size;
+	volatile AO_t count;
+} ht_intset_t;
+
+val_t so_regular_key(val_t val);
+val_t so_dummy_key(unsigned long bucket);
+node_t *so_get_bucket(ht_intset_t *set, unsigned long bucket);
+
+void ht_delete(ht_intset_t *set);
+int ht_size(ht_intset_t *set);
+unsigned long ht_buckets(ht_intset_t *set);
+ht_intset_t *ht_new();
@@ -0,0 +1,71 @@
+/*
+ * File:
+ *   intset.c
+ * Description:
+ *   Integer set operations accessing the split-ordered hashtable.
+ *   Each operation jumps to the dummy node of the bucket of its key and
+ *   runs Harris' algorithm on the split-ordered key from there.
+ *
+ * intset.c is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "intset.h"
+
+static inline void so_bucket_set(ht_intset_t *set, int val, intset_t *bucket) {
+	unsigned long size = (unsigned long)AO_load_full(&set->size);
+
+	bucket->head = so_get_bucket(set, (unsigned long)val & (size - 1));
+}
+
+int ht_contains(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
+
+	so_bucket_set(set, val, &bucket);
+	return harris_find(&bucket, so_regular_key(val));
+}
+
+int ht_add(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
+	unsigned long size, count;
+
+	so_bucket_set(set, val, &bucket);
+	if (!harris_insert(&bucket, so_regular_key(val)))
+		return 0;
+
+	/* Double the bucket amount once the load factor is exceeded */
+	count = (unsigned long)AO_fetch_and_add_full(&set->count, 1) + 1;
+	size = (unsigned long)AO_load_full(&set->size);
+	if (count / size > so_load_factor && size < SO_MAX_BUCKETS)
+		ATOMIC_CAS_MB(&set->size, size, size << 1);
+	return 1;
+}
+
+int ht_remove(ht_intset_t *set, int val, int transactional) {
+	intset_t bucket;
+
+	so_bucket_set(set, val, &bucket);
+	if (!harris_delete(&bucket, so_regular_key(val)))
+		return 0;
+	AO_fetch_and_add_full(&set->count, (AO_t)-1);
+	return 1;
+}
+
+int ht_move(ht_intset_t *set, int val1, int val2, int transactional) {
+	printf("ht_move: No CAS-based implementation is available\n");
+	exit(1);
+}
+
+int ht_snapshot(ht_intset_t *set, int transactional) {
+	printf("ht_snapshot: No CAS-based implementation is available\n");
+	exit(1);
+}
@@ -32,26 +32,26 @@ int lockc_delete(intset_l_t *set, val_t val) {
 	node_l_t *curr, *next;
 	int found;
 	
-	LOCK(&set->head->lock);
+	LOCK_NODE(set->head);
 	curr = set->head;
-	LOCK(&curr->next->lock);
+	LOCK_NODE(curr->next);
 	next = curr->next;
 	
 	while (next->val < val) {
-		UNLOCK(&curr->lock);
+		UNLOCK_NODE(curr);
 		curr = next;
-		LOCK(&next->next->lock);
+		LOCK_NODE(next->next);
 		next = next->next;
 	}
 	found = (val == next->val);
 	if (found) {
 	  curr->next = next->next;
-	  UNLOCK(&next->lock);
+	  UNLOCK_NODE(next);
 	  node_delete_l(next);
-	  UNLOCK(&curr->lock);
+	  UNLOCK_NODE(curr);
 	} else {
-	  UNLOCK(&curr->lock);
-	  UNLOCK(&next->lock);
+	  UNLOCK_NODE(curr);
+	  UNLOCK_NODE(next);
 	}
 	return found;
 }
@@ -60,20 +60,20 @@ int lockc_find(intset_l_t *set, val_t val) {
 	node_l_t *curr, *next; 
 	int found;
 	
-	LOCK(&set->head->lock);
+	LOCK_NODE(set->head);
 	curr = set->head;
-	LOCK(&curr->next->lock);
+	LOCK_NODE(curr->next);
 	next = curr->next;
 	
 	while (next->val < val) {
-		UNLOCK(&curr->lock);
+		UNLOCK_NODE(curr);
 		curr = next;
-		LOCK(&next->next->lock);
+		LOCK_NODE(next->next);
 		next = curr->next;
 	}	
 	found = (val == next->val);
-	UNLOCK(&curr->lock);
-	UNLOCK(&next->lock);
+	UNLOCK_NODE(curr);
+	UNLOCK_NODE(next);
 	return found;
 }
 
@@ -81,16 +81,16 @@ int lockc_insert(intset_l_t *set, val_t val) {
 	node_l_t *curr, *next, *newnode;
 	int found;
 	
-	LOCK(&set->head->lock);
+	LOCK_NODE(set->head);
 	curr = set->head;
-	LOCK(&curr->next->lock);
+	LOCK_NODE(curr->next);
 	next = curr->next;
 	
 	while (next->val < val) {
 		
-		UNLOCK(&curr->lock);
+		UNLOCK_NODE(curr);
 		curr = next;
-		LOCK(&next->next->lock);
+		LOCK_NODE(next->next);
 		next = curr->next;
 		
 	}
@@ -99,7 +99,7 @@ int lockc_insert(intset_l_t *set, val_t val) {
 		newnode =  new_node_l(val, next, 0);
 		curr->next = newnode;
 	}
-	UNLOCK(&curr->lock);
-	UNLOCK(&next->lock);
+	UNLOCK_NODE(curr);
+	UNLOCK_NODE(next);
 	return !found;
 }
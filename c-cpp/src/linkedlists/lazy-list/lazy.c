@@ -25,6 +25,7 @@
  */
 
 #include "lazy.h"
+#include "memacct.h"
 
 inline int is_marked_ref(long i) {
 	return (int) (i &= LONG_MIN+1);
@@ -75,15 +76,15 @@ int parse_insert(intset_l_t *set, val_t val) {
 		pred = curr;
 		curr = curr->next;
 	}
-	LOCK(&pred->lock);
-	LOCK(&curr->lock);
+	LOCK_NODE(pred);
+	LOCK_NODE(curr);
 	result = (parse_validate(pred, curr) && (curr->val != val));
 	if (result) {
 		newnode = new_node_l(val, curr, 0);
 		pred->next = newnode;
 	} 
-	UNLOCK(&curr->lock);
-	UNLOCK(&pred->lock);
+	UNLOCK_NODE(curr);
+	UNLOCK_NODE(pred);
 	return result;
 }
 
@@ -106,14 +107,16 @@ int parse_delete(intset_l_t *set, val_t val) {
 		pred = curr;
 		curr = curr->next;
 	}
-	LOCK(&pred->lock);
-	LOCK(&curr->lock);
+	LOCK_NODE(pred);
+	LOCK_NODE(curr);
 	result = (parse_validate(pred, curr) && (val == curr->val));
 	if (result) {
 		set_mark((long) curr);
 		pred->next = curr->next;
+		/* Never freed, see above */
+		ma_retire(sizeof(node_l_t));
 	}
-	UNLOCK(&curr->lock);
-	UNLOCK(&pred->lock);
+	UNLOCK_NODE(curr);
+	UNLOCK_NODE(pred);
 	return result;
 }
@@ -22,6 +22,7 @@
  */
 
 #include "intset.h"
+#include "memacct.h"
 
 node_l_t *new_node_l(val_t val, node_l_t *next, int transactional)
 {
@@ -35,6 +36,7 @@ node_l_t *new_node_l(val_t val, node_l_t *next, int transactional)
   node_l->val = val;
   node_l->next = next;
   INIT_LOCK(&node_l->lock);	
+  ma_alloc(sizeof(node_l_t));
   return node_l;
 }
 
@@ -57,6 +59,7 @@ intset_l_t *set_new_l()
 void node_delete_l(node_l_t *node) {
    DESTROY_LOCK(&node->lock);
    free(node);
+   ma_free(sizeof(node_l_t));
 }
 
 void set_delete_l(intset_l_t *set)
@@ -68,6 +71,7 @@ void set_delete_l(intset_l_t *set)
     next = node->next;
     DESTROY_LOCK(&node->lock);
     free(node);
+    ma_free(sizeof(node_l_t));
     node = next;
   }
   free(set);
@@ -34,6 +34,8 @@
 
 #include <atomic_ops.h>
 
+#include "locks.h"
+
 #define DEFAULT_DURATION                10000
 #define DEFAULT_INITIAL                 256
 #define DEFAULT_NB_THREADS              1
@@ -59,19 +61,13 @@ typedef intptr_t val_t;
 #define VAL_MIN                         INT_MIN
 #define VAL_MAX                         INT_MAX
 
-#ifdef MUTEX
-typedef pthread_mutex_t ptlock_t;
-#  define INIT_LOCK(lock)				pthread_mutex_init((pthread_mutex_t *) lock, NULL);
-#  define DESTROY_LOCK(lock)			pthread_mutex_destroy((pthread_mutex_t *) lock)
-#  define LOCK(lock)					pthread_mutex_lock((pthread_mutex_t *) lock)
-#  define UNLOCK(lock)					pthread_mutex_unlock((pthread_mutex_t *) lock)
-#else
-typedef pthread_spinlock_t ptlock_t;
-#  define INIT_LOCK(lock)				pthread_spin_init((pthread_spinlock_t *) lock, PTHREAD_PROCESS_PRIVATE);
-#  define DESTROY_LOCK(lock)			pthread_spin_destroy((pthread_spinlock_t *) lock)
-#  define LOCK(lock)					pthread_spin_lock((pthread_spinlock_t *) lock)
-#  define UNLOCK(lock)					pthread_spin_unlock((pthread_spinlock_t *) lock)
-#endif
+/*
+ * The tail sentinel is never removed and its next pointer never changes,
+ * so it is not locked. This allows several lists (e.g., the buckets of
+ * the hash table) to share the same tail without contending on its lock.
+ */
+#define LOCK_NODE(node)			do { if ((node)->next) LOCK(&(node)->lock); } while (0)
+#define UNLOCK_NODE(node)		do { if ((node)->next) UNLOCK(&(node)->lock); } while (0)
 
 typedef struct node_l {
   val_t val;
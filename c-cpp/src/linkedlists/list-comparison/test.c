@@ -33,6 +33,10 @@
 #include <stdint.h>
 #include <stdatomic.h>
 
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
 #include "intset.h"
 
 #if defined SEQUENTIAL
@@ -169,14 +173,22 @@ typedef struct thread_data {
 	intset_t *set;
 	barrier_t *barrier;
 	unsigned long failures_because_contention;
+	lat_stats_t *lat;
+	wl_thread_t wl;
+	int cpu;
+	pc_stats_t *pc;
 } thread_data_t;
 
 void *test(void *data) {
 	// Read this locally to prevent possible cache effects.
 	thread_data_t d = *(thread_data_t *)data;
 
+	aff_pin_self(d.cpu);
+	pc_open(d.pc);
+
 	// Wait for all threads to become ready.
 	barrier_cross(d.barrier);
+	pc_start(d.pc);
 
 	// Last value to be inserted, or -ve if last action was remove.
 	// Start -ve here so that alternate mode will not hang.
@@ -193,21 +205,21 @@ void *test(void *data) {
 		if (d.effective)
 			do_update = (100 * (d.nb_added + d.nb_removed)) < (d.update * (d.nb_add + d.nb_remove + d.nb_contains));
 		else
-			do_update = rand_range_re(&d.seed, 100) - 1 < d.update;
+			do_update = wl_rand_range(&d.wl, 100) - 1 < d.update;
 		
 		// Value on which to operate. (may be modified later,
 		// if in alternate mode or bias mode)
-		int value = rand_range_re(&d.seed, d.range);
+		int value = wl_key(&d.wl);
 
 		// If we're in bias mode, restrict the range, and just choose adding or removing at random
 		if (d.bias_enabled) {
-			value = d.bias_offset + rand_range_re(&d.seed, d.bias_range) - 1;
-			last = (rand_range_re(&d.seed, 2) == 1) ? -1 : value;
+			value = d.bias_offset + wl_rand_range(&d.wl, d.bias_range) - 1;
+			last = (wl_rand_range(&d.wl, 2) == 1) ? -1 : value;
 		}
 
 		if (do_update && last < 0) {
 			// Add
-			if (set_insert(d.set, value)) {
+			if (LAT_OP(d.lat, LAT_ADD, set_insert(d.set, value))) {
 				d.nb_added++;
 				last = value;
 			}
@@ -217,11 +229,11 @@ void *test(void *data) {
 			
 			// If in alternate mode, remove the last item added.
 			if (d.alternate) {
-				if (set_remove(d.set, last))
+				if (LAT_OP(d.lat, LAT_REMOVE, set_remove(d.set, last)))
 					d.nb_removed++;
 				last = -1;
 			} else {
-				if (set_remove(d.set, value)) {
+				if (LAT_OP(d.lat, LAT_REMOVE, set_remove(d.set, value))) {
 					d.nb_removed++;
 					last = -1;
 				}
@@ -241,12 +253,13 @@ void *test(void *data) {
 				}
 			}
 
-			if (set_contains(d.set, value))
+			if (LAT_OP(d.lat, LAT_CONTAINS, set_contains(d.set, value)))
 				d.nb_found++;
 			d.nb_contains++;
 		}
 	}
 
+	pc_stop(d.pc);
 	*(thread_data_t *)data = d;
 	
 	return NULL;
@@ -261,6 +274,13 @@ int main(int argc, char **argv) {
 		// These options don't set a flag
 		{"help",                      no_argument,       NULL, 'h'},
 		{"duration",                  required_argument, NULL, 'd'},
+		{"latency",                   required_argument, NULL, 'L'},
+		{"key-dist",                  required_argument, NULL, 'K'},
+		{"pin",                       required_argument, NULL, 'P'},
+		{"numa",                      required_argument, NULL, 'N'},
+		{"counters",                  required_argument, NULL, 'C'},
+		{"rate",                      required_argument, NULL, 'O'},
+		{"arrival",                   required_argument, NULL, 'E'},
 		{"initial-size",              required_argument, NULL, 'i'},
 		{"thread-num",                required_argument, NULL, 't'},
 		{"range",                     required_argument, NULL, 'r'},
@@ -287,6 +307,16 @@ int main(int argc, char **argv) {
 	struct timeval start, end;
 	struct timespec timeout;
 	int duration = DEFAULT_DURATION;
+	int latency = DEFAULT_LATENCY;
+	char *keydist = DEFAULT_KEYDIST;
+	workload_t workload;
+	char *pin = DEFAULT_PIN;
+	char *numa = DEFAULT_NUMA;
+	affinity_t aff;
+	int counters = DEFAULT_COUNTERS;
+	int rate = DEFAULT_RATE;
+	char *arrival = DEFAULT_ARRIVAL;
+	int poisson;
 	int initial = DEFAULT_INITIAL;
 	int nb_threads = DEFAULT_NB_THREADS;
 	long range = DEFAULT_RANGE;
@@ -302,7 +332,7 @@ int main(int argc, char **argv) {
 	
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:b:B:x:", long_options, &i);
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:b:B:x:L:K:P:N:C:O:E:", long_options, &i);
 		
 		if(c == -1)
 			break;
@@ -340,6 +370,21 @@ int main(int argc, char **argv) {
 								 "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 								 "  -u, --update-rate <int>\n"
 								 "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+								 "  -L, --latency <int>\n"
+								 "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+								 "  -K, --key-dist <dist>\n"
+								 "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+								 "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+								 "  -P, --pin <policy>\n"
+								 "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+								 "  -N, --numa <policy>\n"
+								 "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+								 "  -C, --counters <int>\n"
+								 "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+								 "  -O, --rate <int>\n"
+								 "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+								 "  -E, --arrival <process>\n"
+								 "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
 								 "  -b, --bias-range <int>\n"
 								 "        If used, updates will take place in range [B, B+b)\n"
 								 "  -B, --bias-offset <int>\n"
@@ -388,6 +433,27 @@ int main(int argc, char **argv) {
 				case 'x':
 					unit_tx = atoi(optarg);
 					break;
+				case 'K':
+					keydist = optarg;
+					break;
+				case 'P':
+					pin = optarg;
+					break;
+				case 'N':
+					numa = optarg;
+					break;
+				case 'C':
+					counters = atoi(optarg);
+					break;
+				case 'O':
+					rate = atoi(optarg);
+					break;
+				case 'E':
+					arrival = optarg;
+					break;
+				case 'L':
+					latency = atoi(optarg);
+					break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -401,6 +467,11 @@ int main(int argc, char **argv) {
 	assert(nb_threads > 0);
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 100);
+	wl_init(&workload, keydist, range);
+	aff_init(&aff, pin, numa, nb_threads);
+	poisson = lat_poisson(arrival);
+	if (rate > 0 && latency == 0)
+		latency = 1;
 	if (bias_range != DEFAULT_BIAS_RANGE || bias_offset != DEFAULT_BIAS_OFFSET) {
 		bias_enabled = 1;
 		assert(bias_range >= 0);
@@ -417,6 +488,11 @@ int main(int argc, char **argv) {
 	}
 	printf("Seed         : %d\n", seed);
 	printf("Update rate  : %d\n", update);
+	printf("Latency      : %d\n", latency);
+	printf("Key dist.    : %s\n", keydist);
+	aff_print(&aff, pin, numa);
+	printf("Counters     : %d\n", counters);
+	printf("Rate         : %d (%s)\n", rate, arrival);
 	printf("Elasticity   : %d\n", unit_tx);
 	printf("Alternate    : %d\n", alternate);
 	printf("Effective    : %d\n", effective);
@@ -456,12 +532,14 @@ int main(int argc, char **argv) {
 	printf("Adding %d entries to set\n", initial);
 	i = 0;
 	while (i < initial) {
+		aff_populate(&aff, i, initial);
 		val = rand_range(range);
 		if (set_insert(set, val)) {
 			last = val;
 			i++;
 		}
 	}
+	aff_populate_done(&aff);
 	size = set_size(set);
 	printf("Set size     : %d\n", size);
 	
@@ -496,6 +574,11 @@ int main(int argc, char **argv) {
 		data[i].nb_aborts_double_write = 0;
 		data[i].max_retries = 0;
 		data[i].seed = rand();
+		data[i].lat = lat_new(latency);
+		lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+		wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+		data[i].cpu = aff_cpu(&aff, i);
+		data[i].pc = pc_new(counters);
 		data[i].set = set;
 		data[i].barrier = &barrier;
 		data[i].failures_because_contention = 0;
@@ -597,6 +680,15 @@ int main(int argc, char **argv) {
 	printf("Duration      : %d (ms)\n", duration);
 	printf("#txs          : %lu (%f / s)\n", reads + updates, 
 				 (reads + updates) * 1000.0 / duration);
+	if (counters) {
+		pc_stats_t *pc = pc_new(counters);
+		for (i = 0; i < nb_threads; i++) {
+			pc_merge(pc, data[i].pc);
+			free(data[i].pc);
+		}
+		pc_print(pc, reads + updates);
+		free(pc);
+	}
 	
 	printf("#read txs     : ");
 	if (effective) {
@@ -632,6 +724,15 @@ int main(int argc, char **argv) {
 				 aborts_double_write * 1000.0 / duration);
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
+	if (latency > 0) {
+		lat_stats_t *lat = lat_new(latency);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(lat, data[i].lat);
+			free(data[i].lat);
+		}
+		lat_print(lat);
+		free(lat);
+	}
 	
 	/* Delete set */
 	set_delete(set);
@@ -15,12 +15,25 @@ static inline int try_lock_at_version(node_t *node, vlock_t ver) {
   return atomic_compare_exchange_strong(&node->vlock, &ver, ver+1);
 }
 
-// TODO: employ a smarter locking here? Busy waiting is not ideal.
+#define VLOCK_BACKOFF_MIN 4
+#define VLOCK_BACKOFF_MAX 1024
+
+// Test-and-test-and-set with exponential backoff: waits for the lock bit
+// to clear before trying the CAS, and backs off after a failed CAS so
+// that the waiters do not keep stealing the cache line from the holder.
 static inline void lock_at_current_version(node_t *node) {
-  int success = 0;
-  while (!success) {
-    vlock_t ver = get_version(node);
-    success = atomic_compare_exchange_strong(&node->vlock, &ver, ver+1);
+  unsigned int backoff = VLOCK_BACKOFF_MIN, i;
+  vlock_t ver;
+
+  for (;;) {
+    while ((ver = atomic_load_explicit(&node->vlock, memory_order_relaxed)) & 1)
+      ;
+    if (atomic_compare_exchange_strong(&node->vlock, &ver, ver+1))
+      return;
+    for (i = 0; i < backoff; i++)
+      atomic_signal_fence(memory_order_seq_cst);
+    if (backoff < VLOCK_BACKOFF_MAX)
+      backoff <<= 1;
   }
 }
 static inline void unlock_and_increment(node_t *node) {
@@ -25,6 +25,7 @@
  */
 
 #include "lazy.h"
+#include "memacct.h"
 
 inline int is_marked_ref(long i) {
 	return (int) (i &= LONG_MIN+1);
@@ -112,6 +113,8 @@ int parse_delete(intset_l_t *set, val_t val) {
 	if (result) {
 		set_mark((long) curr);
 		pred->next = curr->next;
+		/* Never freed, see above */
+		ma_retire(sizeof(node_l_t));
 	}
 	UNLOCK(&curr->lock);
 	UNLOCK(&pred->lock);
@@ -55,6 +55,53 @@ inline long get_marked_ref(long w) {
 	return set_mark(w);
 }
 
+#ifdef SMR_ENABLED
+
+/*
+ * harris_search looks for value val, it
+ *  - returns right_node owning val (if present) or its immediately higher 
+ *    value present in the list (otherwise) and 
+ *  - sets the left_node to the node owning the value immediately lower than val. 
+ * With safe memory reclamation, encountered nodes that are marked as logically
+ * deleted are physically removed one at a time (M. Michael, "High Performance
+ * Dynamic Lock-Free Hash Tables and List-Based Sets", SPAA 2002) and retired
+ * by the thread that unlinked them, so that the traversal never goes through
+ * a node that may have been reclaimed. left_node and right_node remain 
+ * protected (slots 0 and 1) until the end of the operation.
+ */
+node_t *harris_search(intset_t *set, val_t val, node_t **left_node) {
+	node_t *left, *right, *next;
+	
+search_again:
+	left = set->head;
+	right = (node_t *) smr_protect(1, (void *volatile *) &left->next);
+	do {
+		next = (node_t *) smr_protect(2, (void *volatile *) &right->next);
+		/* Check that right_node is still linked after left_node */
+		if (*(node_t *volatile *) &left->next != right)
+			goto search_again;
+		
+		if (!is_marked_ref((long) next)) {
+			if (right->val >= val) {
+				*left_node = left;
+				return right;
+			}
+			left = right;
+			smr_copy(0, 1);
+		} else {
+			/* Remove one marked node */
+			next = (node_t *) get_unmarked_ref((long) next);
+			if (!ATOMIC_CAS_MB(&left->next, right, next))
+				goto search_again;
+			smr_retire(right, sizeof(node_t));
+		}
+		right = next;
+		smr_copy(1, 2);
+	} while (1);
+}
+
+#else /* ! SMR_ENABLED */
+
 /*
  * harris_search looks for value val, it
  *  - returns right_node owning val (if present) or its immediately higher 
@@ -64,7 +111,7 @@ inline long get_marked_ref(long w) {
  * from the list, yet not garbage collected.
  */
 node_t *harris_search(intset_t *set, val_t val, node_t **left_node) {
-	node_t *left_node_next, *right_node;
+	node_t *left_node_next, *right_node, *n;
 	left_node_next = set->head;
 	
 search_again:
@@ -95,6 +142,10 @@ search_again:
 		if (ATOMIC_CAS_MB(&(*left_node)->next, 
 						  left_node_next, 
 						  right_node)) {
+			/* Accounted for as garbage */
+			for (n = left_node_next; n != right_node; 
+				 n = (node_t *) get_unmarked_ref((long) n->next))
+				smr_retire(n, sizeof(node_t));
 			if (right_node->next && is_marked_ref((long) right_node->next))
 				goto search_again;
 			else return right_node;
@@ -103,53 +154,75 @@ search_again:
 	} while (1);
 }
 
+#endif /* ! SMR_ENABLED */
+
 /*
  * harris_find returns whether there is a node in the list owning value val.
  */
 int harris_find(intset_t *set, val_t val) {
 	node_t *right_node, *left_node;
+	int result;
 	left_node = set->head;
 	
+	smr_begin();
 	right_node = harris_search(set, val, &left_node);
-	if ((!right_node->next) || right_node->val != val)
-		return 0;
-	else 
-		return 1;
+	result = (right_node->next && right_node->val == val);
+	smr_end();
+	return result;
 }
 
 /*
  * harris_find inserts a new node with the given value val in the list
  * (if the value was absent) or does nothing (if the value is already present).
+ * The new node is allocated once and reused if the insertion has to retry.
  */
 int harris_insert(intset_t *set, val_t val) {
-	node_t *newnode, *right_node, *left_node;
+	node_t *newnode = NULL, *right_node, *left_node;
+	int result;
 	left_node = set->head;
 	
+	smr_begin();
 	do {
 		right_node = harris_search(set, val, &left_node);
-		if (right_node->val == val)
-			return 0;
-		newnode = new_node(val, right_node, 0);
+		if (right_node->val == val) {
+			result = 0;
+			break;
+		}
+		if (newnode == NULL)
+			newnode = new_node(val, right_node, 0);
+		else
+			newnode->next = right_node;
 		/* mem-bar between node creation and insertion */
 		AO_nop_full(); 
-		if (ATOMIC_CAS_MB(&left_node->next, right_node, newnode))
-			return 1;
+		if (ATOMIC_CAS_MB(&left_node->next, right_node, newnode)) {
+			newnode = NULL;
+			result = 1;
+			break;
+		}
 	} while(1);
+	smr_end();
+	if (newnode != NULL)
+		free_node(newnode);
+	return result;
 }
 
 /*
  * harris_find deletes a node with the given value val (if the value is present) 
  * or does nothing (if the value is already present).
  * The deletion is logical and consists of setting the node mark bit to 1.
+ * The thread whose CAS physically removes the node retires it.
  */
 int harris_delete(intset_t *set, val_t val) {
 	node_t *right_node, *right_node_next, *left_node;
 	left_node = set->head;
 	
+	smr_begin();
 	do {
 		right_node = harris_search(set, val, &left_node);
-		if (right_node->val != val)
+		if (right_node->val != val) {
+			smr_end();
 			return 0;
+		}
 		right_node_next = right_node->next;
 		if (!is_marked_ref((long) right_node_next))
 			if (ATOMIC_CAS_MB(&right_node->next, 
@@ -157,10 +230,10 @@ int harris_delete(intset_t *set, val_t val) {
 							  get_marked_ref((long) right_node_next)))
 				break;
 	} while(1);
-	if (!ATOMIC_CAS_MB(&left_node->next, right_node, right_node_next))
+	if (ATOMIC_CAS_MB(&left_node->next, right_node, right_node_next))
+		smr_retire(right_node, sizeof(node_t));
+	else
 		right_node = harris_search(set, right_node->val, &left_node);
+	smr_end();
 	return 1;
 }
-
-
-
@@ -11,10 +11,30 @@
 
 #include "intset.h"
 
+#ifdef FC
+/* Adapters of the operations applied by the combiner (see fc.h) */
+static int fc_set_contains(void *set, long *a) {
+	return set_contains((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_set_add(void *set, long *a) {
+	return set_add((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_set_remove(void *set, long *a) {
+	return set_remove((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+#endif /* FC */
+
 int set_contains(intset_t *set, val_t val, int transactional)
 {
 	int result;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_set_contains, set, val, transactional, 0, 0);
+#endif /* FC */
+
 #ifdef DEBUG
 	printf("++> set_contains(%d)\n", (int)val);
 	IO_FLUSH;
@@ -53,7 +73,7 @@ int set_contains(intset_t *set, val_t val, int transactional)
 	  
 	} else {
 
-	  TX_START(NL);
+	  TX_START(RO);
 	  prev = set->head;
 	  next = (node_t *)TX_LOAD(&prev->next);
 	  while (1) {
@@ -99,6 +119,11 @@ int set_add(intset_t *set, val_t val, int transactional)
 {
 	int result;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_set_add, set, val, transactional, 0, 0);
+#endif /* FC */
+
 #ifdef DEBUG
 	printf("++> set_add(%d)\n", (int)val);
 	IO_FLUSH;
@@ -170,6 +195,11 @@ int set_remove(intset_t *set, val_t val, int transactional)
 {
 	int result = 0;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_set_remove, set, val, transactional, 0, 0);
+#endif /* FC */
+
 #ifdef DEBUG
 	printf("++> set_remove(%d)\n", (int)val);
 	IO_FLUSH;
@@ -14,6 +14,10 @@ node_t *new_node(val_t val, node_t *next, int transactional)
 {
   node_t *node;
 
+#ifdef LOCKFREE
+  /* Lock-free nodes are retired through the reclamation scheme */
+  node = (node_t *)smr_alloc(sizeof(node_t));
+#else
   if (transactional) {
 	node = (node_t *)MALLOC(sizeof(node_t));
   } else {
@@ -23,6 +27,7 @@ node_t *new_node(val_t val, node_t *next, int transactional)
 	perror("malloc");
 	exit(1);
   }
+#endif
 
   node->val = val;
   node->next = next;
@@ -30,6 +35,15 @@ node_t *new_node(val_t val, node_t *next, int transactional)
   return node;
 }
 
+void free_node(node_t *node)
+{
+#ifdef LOCKFREE
+  smr_free(node, sizeof(node_t));
+#else
+  free(node);
+#endif
+}
+
 intset_t *set_new()
 {
   intset_t *set;
@@ -53,7 +67,7 @@ void set_delete(intset_t *set)
   node = set->head;
   while (node != NULL) {
     next = node->next;
-    free(node);
+    free_node(node);
     node = next;
   }
   free(set);
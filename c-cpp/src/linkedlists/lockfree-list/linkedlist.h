@@ -21,6 +21,7 @@
 #include <atomic_ops.h>
 
 #include "tm.h"
+#include "smr.h"
 
 #ifdef DEBUG
 #define IO_FLUSH                        fflush(NULL)
@@ -60,6 +61,7 @@ typedef struct intset {
 } intset_t;
 
 node_t *new_node(val_t val, node_t *next, int transactional);
+void free_node(node_t *node);
 intset_t *set_new();
 void set_delete(intset_t *set);
 int set_size(intset_t *set);
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <unistd.h>
@@ -10,11 +11,38 @@
 #include "background.h"
 
 void *bg_thread_fn(void *targs);
+void *bg_helper_fn(void *targs);
 
 // Background thread stuff
 pthread_t bg_thread;
 _Atomic(int) bg_shouldstop;
 
+// Parallel maintenance: each round, the current index is cut into one slice
+// of elements per helper. A helper measures the gaps between the elements of
+// its slice, then builds the elements of the next index for the keys of its
+// slice. The background thread is helper 0 and joins the slices.
+enum { BG_GAPS, BG_BUILD };
+
+struct bg_part {
+	intset_t *set;
+	idx_t *idx;		// the index being cut
+	int from, to;		// elements [from, to) of idx
+	int maxgap;		// result of BG_GAPS
+	idx_t *elems;		// result of BG_BUILD
+	pthread_t thread;
+} bg_parts[MAX_HELPERS];
+
+int bg_nb_helpers = 1;
+int bg_phase;
+int bg_helpers_stop;	// set by the background thread only
+pthread_barrier_t bg_round_start, bg_round_end;
+
+// Sets the number of threads maintaining the index, including the background
+// thread. Takes effect at the next bg_start.
+void bg_set_helpers(int nb_helpers) {
+	bg_nb_helpers = nb_helpers;
+}
+
 // Starts the background thread. num_threads is the number of threads performing
 // operations, the background thread's id will be num_threads.
 void bg_start(intset_t *set, int num_threads) {
@@ -34,6 +62,105 @@ void bg_stop(void) {
 	pthread_join(bg_thread, NULL);
 }
 
+// Measures the longest run of nodes between two elements of the slice.
+static void bg_gaps(struct bg_part *p) {
+	idx_t *idx = p->idx;
+	p->maxgap = 0;
+	for (int i = p->from; i < p->to; i++) {
+		node_t *curr = idx->elems[i].node;
+		node_t *stop = (i == idx->size-1) ? NULL : idx->elems[i+1].node;
+		int gap = 0;
+		while (curr != stop) {
+			gap++;
+			curr = curr->next;
+		}
+		if (gap > p->maxgap) p->maxgap = gap;
+	}
+}
+
+// Builds the elements of the next index for the keys of the slice, which end
+// at the first element of the next slice.
+static void bg_build(struct bg_part *p) {
+	idx_t *idx = p->idx;
+	idx_t *elems = p->elems;
+	int last = (p->to == idx->size);
+	key_t hi = last ? KEY_MAX : idx->elems[p->to].k;
+
+	elems->size = 0;
+	if (p->from == p->to)
+		return;
+
+	// Arrpos: next free slot in elems array.
+	int arrpos = 0;
+
+	// Listpos: position in linked list, only counting non-deleted elements.
+	int listpos = 0;
+
+	// We need to start past the head node, otherwise we'll try to
+	// physically remove it!
+	node_t *start = (p->from == 0) ? p->set->head->next : idx->elems[p->from].node;
+	for (node_t *curr = start; curr != NULL && (last || curr->k < hi); curr = curr->next) {
+		void *val = curr->v;
+
+		// Is the node logically removed? Try to delete it
+		if (val == NULL) {
+			try_mark_phys_remove(curr);
+			continue;
+		}
+
+		// Is the node physically removed? Ignore it.
+		if (val == curr)
+			continue;
+
+		// Now we have a present node.
+		listpos++;
+		if (listpos % IDX_GAP == 0) {
+			// Realloc space in array if needed
+			if (arrpos == elems->cap) {
+				elems->cap *= 2;
+				elems->elems = realloc(elems->elems, elems->cap * sizeof(idx_elem_t));
+			}
+
+			elems->elems[arrpos++] = (idx_elem_t) {
+				curr->k, curr
+			};
+		}
+	}
+	elems->size = arrpos;
+}
+
+// Runs the current phase on a slice.
+static void bg_work(struct bg_part *p) {
+	if (bg_phase == BG_GAPS)
+		bg_gaps(p);
+	else
+		bg_build(p);
+}
+
+// Runs the current phase on every slice, the background thread doing the
+// first one.
+static void bg_round(void) {
+	if (bg_nb_helpers > 1)
+		pthread_barrier_wait(&bg_round_start);
+	bg_work(&bg_parts[0]);
+	if (bg_nb_helpers > 1)
+		pthread_barrier_wait(&bg_round_end);
+}
+
+void *bg_helper_fn(void *targs) {
+	struct bg_part *p = (struct bg_part *) targs;
+
+	for (;;) {
+		pthread_barrier_wait(&bg_round_start);
+		if (bg_helpers_stop)
+			break;
+		bg_work(p);
+		pthread_barrier_wait(&bg_round_end);
+	}
+
+	return NULL;
+}
+
 void *bg_thread_fn(void *targs) {
 	struct bg_arg *arg = (struct bg_arg *) targs;
 	intset_t *set = arg->set;
@@ -45,6 +172,24 @@ void *bg_thread_fn(void *targs) {
 	idx_t *spareidx = new_idx(10);
 	int ntimes = 0;
 
+	// The helpers only read nodes and mark them, so unlike us they do not need
+	// to register with URCU: nodes are only freed by us, between two rounds.
+	for (int i = 0; i < bg_nb_helpers; i++) {
+		bg_parts[i].set = set;
+		bg_parts[i].elems = new_idx(10);
+	}
+	if (bg_nb_helpers > 1) {
+		bg_helpers_stop = 0;
+		pthread_barrier_init(&bg_round_start, NULL, bg_nb_helpers);
+		pthread_barrier_init(&bg_round_end, NULL, bg_nb_helpers);
+		for (int i = 1; i < bg_nb_helpers; i++) {
+			if (pthread_create(&bg_parts[i].thread, NULL, bg_helper_fn, &bg_parts[i]) != 0) {
+				perror("pthread_create");
+				exit(1);
+			}
+		}
+	}
+
 	while (atomic_load(&bg_shouldstop) == 0) {
 		usleep(250);
 		ntimes++;
@@ -52,64 +197,49 @@ void *bg_thread_fn(void *targs) {
 		// Seize the freelist, we'll free things after the next rcu_sync.
 		node_t *freelist = gc_cut();
 
+		// Cut the index into slices, some of them empty if it is small.
+		idx_t *idx = set->idx;
+		for (int i = 0; i < bg_nb_helpers; i++) {
+			bg_parts[i].idx = idx;
+			bg_parts[i].from = i * idx->size / bg_nb_helpers;
+			bg_parts[i].to = (i+1) * idx->size / bg_nb_helpers;
+		}
+
 		// At the moment, there should not be any physically deleted nodes.
 		// Let's measure how many elements exceed the index gap.
 		// TODO: Doing this check conditionally seems to speed things up on AMD
 		// and slow them down on intel. Investigate.
-		idx_t *idx = set->idx;
+		bg_phase = BG_GAPS;
+		bg_round();
 		int maxgap = 0;
-		for (int i = 0; i < idx->size; i++) {
-			node_t *curr = idx->elems[i].node;
-			node_t *stop = (i == idx->size-1) ? NULL : idx->elems[i+1].node;
-			int gap = 0;
-			while (curr != stop) {
-				gap++;
-				curr = curr->next;
-			}
-			if (gap > maxgap) maxgap = gap;
-		}
+		for (int i = 0; i < bg_nb_helpers; i++)
+			if (bg_parts[i].maxgap > maxgap) maxgap = bg_parts[i].maxgap;
 
 		if (maxgap > IDX_GAP * 10) {
-			// Start creating the next index. It needs to contain the list head:
+			bg_phase = BG_BUILD;
+			bg_round();
+
+			// Create the next index from the slices. It needs to contain the
+			// list head:
+			int size = 1;
+			for (int i = 0; i < bg_nb_helpers; i++)
+				if (bg_parts[i].from < bg_parts[i].to)
+					size += bg_parts[i].elems->size;
+			if (size > spareidx->cap) {
+				spareidx->cap = size;
+				spareidx->elems = realloc(spareidx->elems, spareidx->cap * sizeof(idx_elem_t));
+			}
 			spareidx->elems[0].k = set->head->k;
 			spareidx->elems[0].node = set->head;
-
-			// Arrpos: next free slot in elems array.
-			int arrpos = 1;
-
-			// Listpos: position in linked list, only counting non-deleted elements.
-			int listpos = 0;
-
-			// We need to start past the head node, otherwise we'll try to
-			// physically remove it!
-			for (node_t *curr = set->head->next; curr != NULL; curr = curr->next) {
-				void *val = curr->v;
-
-				// Is the node logically removed? Try to delete it
-				if (val == NULL) {
-					try_mark_phys_remove(curr);
-					continue;
-				}
-
-				// Is the node physically removed? Ignore it.
-				if (val == curr)
+			spareidx->size = 1;
+			for (int i = 0; i < bg_nb_helpers; i++) {
+				if (bg_parts[i].from == bg_parts[i].to)
 					continue;
-
-				// Now we have a present node.
-				listpos++;
-				if (listpos % IDX_GAP == 0) {
-					// Realloc space in array if needed
-					if (arrpos == spareidx->cap) {
-						spareidx->cap *= 2;
-						spareidx->elems = realloc(spareidx->elems, spareidx->cap * sizeof(idx_elem_t));
-					}
-
-					spareidx->elems[arrpos++] = (idx_elem_t) {
-						curr->k, curr
-					};
-				}
+				memcpy(spareidx->elems + spareidx->size, bg_parts[i].elems->elems,
+				       bg_parts[i].elems->size * sizeof(idx_elem_t));
+				spareidx->size += bg_parts[i].elems->size;
 			}
-			spareidx->size = arrpos;
+			idx_layout(spareidx);
 
 			// Swap the current index with the spare
 			idx_t *tmp = set->idx;
@@ -129,10 +259,22 @@ void *bg_thread_fn(void *targs) {
 
 	printf("Background thread looped %d times\n", ntimes);
 
+	// Stop the helpers. They cannot use bg_shouldstop, which may be set during
+	// a round.
+	if (bg_nb_helpers > 1) {
+		bg_helpers_stop = 1;
+		pthread_barrier_wait(&bg_round_start);
+		for (int i = 1; i < bg_nb_helpers; i++)
+			pthread_join(bg_parts[i].thread, NULL);
+		pthread_barrier_destroy(&bg_round_start);
+		pthread_barrier_destroy(&bg_round_end);
+	}
+	for (int i = 0; i < bg_nb_helpers; i++)
+		free_idx(bg_parts[i].elems);
+
 	free_idx(spareidx);
 	free(targs);
 	urcu_unregister();
 
 	return NULL;
 }
-
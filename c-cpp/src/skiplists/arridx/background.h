@@ -1,2 +1,6 @@
+// Threads maintaining the index in parallel, at most.
+#define MAX_HELPERS 64
+
+void bg_set_helpers(int nb_helpers);
 void bg_start(intset_t *set, int num_threads);
 void bg_stop(void);
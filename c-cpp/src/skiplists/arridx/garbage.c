@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdatomic.h>
 
+#include "memacct.h"
 #include "skiplist.h"
 #include "garbage.h"
 
@@ -49,6 +50,7 @@ void gc_register(int tid) {
 
 // Defer the collection of this node for later.
 void gc_defer(node_t *node) {
+	ma_retire(sizeof(node_t));
 	node->gcnext = gc_node->head;
 	gc_node->head = node;
 	if (gc_node->tail == NULL)
@@ -84,6 +86,7 @@ node_t *gc_cut(void) {
 void gc_free_list(node_t *head) {
 	while (head != NULL) {
 		node_t *next = head->gcnext;
+		ma_reclaim(sizeof(node_t));
 		free(head);
 		head = next;
 	}
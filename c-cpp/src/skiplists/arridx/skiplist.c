@@ -4,7 +4,11 @@
 #include <stdint.h>
 #include <stdatomic.h>
 #include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+#include "memacct.h"
 #include "urcu.h"
 #include "skiplist.h"
 #include "garbage.h"
@@ -48,20 +52,157 @@ void set_scanall(intset_t *set) {
 
 // use_idx returns the element in the index with the largest key less than or
 // equal to the given key.
+#if defined(IDX_EYTZINGER)
+// Eytzinger layout: keys[1..size] hold the keys in the breadth-first order of
+// an implicit binary search tree, where the children of j are 2j and 2j+1. The
+// IDX_B descendants of j four levels down share a cache line, which we prefetch
+// while comparing the next levels.
+static int eytzinger_fill(idx_t *idx, int i, int j) {
+	if (j <= idx->size) {
+		i = eytzinger_fill(idx, i, 2*j);
+		idx->keys[j] = idx->elems[i].k;
+		idx->nodes[j] = idx->elems[i].node;
+		i = eytzinger_fill(idx, i+1, 2*j+1);
+	}
+	return i;
+}
+
+static int layout_size(idx_t *idx) {
+	return idx->size + 1;
+}
+
+static void layout_build(idx_t *idx) {
+	eytzinger_fill(idx, 0, 1);
+}
+
 node_t *use_idx(intset_t *set, key_t k) {
 	// The index can be swapped out at any point by the background thread.
 	idx_t *idx = atomic_load(&set->idx);
 
-	// Binary search using inclusive bounds, answer should be lo.
-	int lo = 0, hi = idx->size-1, mid;
-	while (hi - lo > 1) {
-		mid = (hi + lo) / 2;
-		if (idx->elems[mid].k <= k) lo = mid;
-		else                        hi = mid-1;
+	// Going right appends a 1 to j, and going left a 0.
+	int j = 1;
+	while (j <= idx->size) {
+		__builtin_prefetch(idx->keys + IDX_B * j);
+		j = 2*j + (idx->keys[j] <= k);
+	}
+
+	// The answer is where we last went right: drop the left turns after it,
+	// then that right turn. The head has key KEY_MIN, so there is one.
+	j >>= __builtin_ffs(j);
+	return idx->nodes[j];
+}
+#elif defined(IDX_BTREE)
+// Static B+ tree layout: layer 0 holds the sorted keys, padded with KEY_MAX to
+// whole nodes of IDX_B keys. Node j of layer h > 0 has the nodes j*(IDX_B+1) to
+// j*(IDX_B+1)+IDX_B of layer h-1 as children, and its i-th key is the smallest
+// key under child i+1. Each node is one cache line, searched with SIMD.
+static int btree_blocks(int n) {
+	return (n + IDX_B - 1) / IDX_B;
+}
+
+// Number of keys in the layer above a layer of n keys.
+static int btree_prev_keys(int n) {
+	return (btree_blocks(n) + IDX_B) / (IDX_B + 1) * IDX_B;
+}
+
+static int layout_size(idx_t *idx) {
+	int n = idx->size, h = 0;
+	idx->offset[0] = 0;
+	for (;;) {
+		idx->offset[h+1] = idx->offset[h] + btree_blocks(n) * IDX_B;
+		h++;
+		if (n <= IDX_B)
+			break;
+		n = btree_prev_keys(n);
+	}
+	idx->height = h;
+	return idx->offset[h];
+}
+
+static void layout_build(idx_t *idx) {
+	int n = idx->size;
+	for (int i = 0; i < idx->offset[1]; i++) {
+		if (i < n) {
+			idx->keys[i] = idx->elems[i].k;
+			idx->nodes[i] = idx->elems[i].node;
+		} else {
+			idx->keys[i] = KEY_MAX;
+		}
+	}
+	for (int h = 1; h < idx->height; h++) {
+		for (int i = 0; i < idx->offset[h+1] - idx->offset[h]; i++) {
+			// Child i+1 of node j, then its leftmost node in layer 0.
+			long c = (long)(i / IDX_B) * (IDX_B + 1) + i % IDX_B + 1;
+			for (int l = 1; l < h; l++)
+				c *= IDX_B + 1;
+			idx->keys[idx->offset[h] + i] = (c * IDX_B < n) ? idx->keys[c * IDX_B] : KEY_MAX;
+		}
 	}
-	return idx->elems[lo].node;
 }
 
+// btree_rank counts the keys of a node which are less than or equal to k.
+static inline int btree_rank(const key_t *node, key_t k) {
+#ifdef __SSE2__
+	__m128i x = _mm_set1_epi32(k);
+	__m128i a = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)node), x);
+	__m128i b = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)node + 1), x);
+	__m128i c = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)node + 2), x);
+	__m128i d = _mm_cmpgt_epi32(_mm_load_si128((const __m128i *)node + 3), x);
+	__m128i abcd = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+	return IDX_B - __builtin_popcount(_mm_movemask_epi8(abcd));
+#else
+	int r = 0;
+	for (int i = 0; i < IDX_B; i++)
+		r += (node[i] <= k);
+	return r;
+#endif
+}
+
+node_t *use_idx(intset_t *set, key_t k) {
+	// The index can be swapped out at any point by the background thread.
+	idx_t *idx = atomic_load(&set->idx);
+
+	// Padding keys must compare greater than k.
+	if (k == KEY_MAX)
+		k--;
+
+	// j is the position of the current node in its layer.
+	int j = 0;
+	for (int h = idx->height - 1; h > 0; h--)
+		j = j * (IDX_B + 1) + btree_rank(idx->keys + idx->offset[h] + j, k) * IDX_B;
+
+	// The head has key KEY_MIN, so the leaf holds a key <= k.
+	return idx->nodes[j + btree_rank(idx->keys + j, k) - 1];
+}
+#else
+static int layout_size(idx_t *idx) {
+	return idx->size;
+}
+
+static void layout_build(idx_t *idx) {
+	for (int i = 0; i < idx->size; i++) {
+		idx->keys[i] = idx->elems[i].k;
+		idx->nodes[i] = idx->elems[i].node;
+	}
+}
+
+node_t *use_idx(intset_t *set, key_t k) {
+	// The index can be swapped out at any point by the background thread.
+	idx_t *idx = atomic_load(&set->idx);
+
+	// Branchless binary search: the answer is in [base, base+len), and the
+	// head has key KEY_MIN, so base[0] <= k.
+	const key_t *base = idx->keys;
+	int len = idx->size;
+	while (len > 1) {
+		int half = len / 2;
+		base = (base[half] <= k) ? base + half : base;
+		len -= half;
+	}
+	return idx->nodes[base - idx->keys];
+}
+#endif
+
 // do_operation consists of two steps: the search and the operation.
 // The search will use the index (if fast == 1), backtracking node.prev links,
 // and the help_remove function to find a pair of nodes (node, next) satisfying:
@@ -142,6 +283,7 @@ result_t finish_insert(key_t k, void *v, node_t *node, void *node_val, node_t *n
 		if (next != NULL) next->prev = newnode;
 		return RESULT_TRUE;
 	}
+	ma_free(sizeof(node_t));
 	free(newnode);
 
 	return RESULT_RETRY;
@@ -180,6 +322,7 @@ void help_remove(node_t *pred, node_t *node) {
 		n = node->next;
 	}
 	if (canfree) {
+		ma_free(sizeof(node_t));
 		free(newnode);
 	}
 	if (pred->next != node || pred->marked)
@@ -197,7 +340,7 @@ void help_remove(node_t *pred, node_t *node) {
 }
 
 // try_mark_phys_remove attempts to mark a logically deleted node for physical
-// removal. This should only be called by the background thread.
+// removal. This should only be called by the background thread or its helpers.
 void try_mark_phys_remove(node_t *node) {
 	void *expected = NULL;
 	atomic_compare_exchange_strong(&node->v, &expected, node);
@@ -224,6 +367,7 @@ intset_t *set_init(int num_threads) {
 	set->idx->elems[0] = (idx_elem_t) {
 		.k = KEY_MIN, .node = min
 	};
+	idx_layout(set->idx);
 
 	urcu_init(num_threads+1);
 	gc_init(num_threads+1);
@@ -259,10 +403,11 @@ void set_destroy(intset_t *set) {
 	while (NULL != curr) {
 		prev = curr;
 		curr = curr->next;
+		ma_free(sizeof(node_t));
 		free(prev);
 	}
 
-	free(set->idx);
+	free_idx(set->idx);
 	free(set);
 }
 
@@ -286,6 +431,7 @@ node_t *new_node(node_t *prev, node_t *next, key_t k, void *v) {
 		perror("malloc");
 		exit(1);
 	}
+	ma_alloc(sizeof(node_t));
 	node->prev = prev;
 	node->next = next;
 	node->k = k;
@@ -310,14 +456,41 @@ idx_t *new_idx(int cap) {
 	idx->cap = cap;
 	idx->size = 0;
 	idx->elems = elems;
+	idx->lcap = 0;
+	idx->keys = NULL;
+	idx->nodes = NULL;
+	idx->height = 0;
 	return idx;
 }
 
 void free_idx(idx_t *idx) {
+	free(idx->keys);
+	free(idx->nodes);
 	free(idx->elems);
 	free(idx);
 }
 
+// idx_layout builds the layout searched by use_idx from the sorted elements
+// of the index. The keys are aligned on a cache line.
+void idx_layout(idx_t *idx) {
+	int size = layout_size(idx);
+	if (size > idx->lcap) {
+		free(idx->keys);
+		free(idx->nodes);
+		if (posix_memalign((void **)&idx->keys, 64, sizeof(key_t) * size) != 0) {
+			perror("posix_memalign");
+			exit(1);
+		}
+		idx->nodes = malloc(sizeof(node_t *) * size);
+		if (idx->nodes == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		idx->lcap = size;
+	}
+	layout_build(idx);
+}
+
 // For debugging - use only on small lists!
 void set_print(intset_t *set) {
 	node_t *curr = set->head;
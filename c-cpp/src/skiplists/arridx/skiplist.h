@@ -3,6 +3,21 @@
 // What proportion of the list is indexed
 #define IDX_GAP (4)
 
+// Keys per 64-byte cache line, the size of a node of the B+ tree layout.
+#define IDX_B (16)
+#define IDX_MAX_HEIGHT (8)
+
+// Layout of the keys searched by use_idx, chosen at compile time: a sorted
+// array by default, Eytzinger order with -DIDX_EYTZINGER, or a static B+ tree
+// with -DIDX_BTREE.
+#if defined(IDX_EYTZINGER)
+#define IDX_LAYOUT "eytzinger"
+#elif defined(IDX_BTREE)
+#define IDX_LAYOUT "btree"
+#else
+#define IDX_LAYOUT "sorted"
+#endif
+
 typedef int key_t;
 #define KEY_MIN INT_MIN
 #define KEY_MAX INT_MAX
@@ -26,6 +41,17 @@ typedef struct idx_elem {
 typedef struct idx {
 	int size, cap;
 	idx_elem_t *elems;
+
+	// The layout searched by use_idx, built from elems by idx_layout. Keys
+	// and nodes are kept apart so that a cache line holds IDX_B keys.
+	int lcap;
+	key_t *keys;
+	node_t **nodes;
+
+	// B+ tree only: number of layers, and where each layer starts in keys.
+	// offset[height] is the end of the top layer.
+	int height;
+	int offset[IDX_MAX_HEIGHT+1];
 } idx_t;
 
 typedef struct intset {
@@ -56,3 +82,4 @@ void try_mark_phys_remove(node_t *node);
 
 idx_t *new_idx(int size);
 void free_idx(idx_t *idx);
+void idx_layout(idx_t *idx);
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include "portable_defns.h"
 #include "gc.h"
+#include "memacct.h"
 
 //#define MINIMAL_GC
 /*#define YIELD_TO_HELP_PROGRESS*/
@@ -326,8 +327,9 @@ static void gc_reclaim(void)
     ptst_t       *ptst, *first_ptst, *our_ptst = NULL;
     gc_t         *gc = NULL;
     unsigned long curr_epoch;
-    chunk_t      *ch, *t;
+    chunk_t      *ch, *t, *p;
     int           two_ago, three_ago, i, j;
+    long          n;
     
     /* Barrier to entering the reclaim critical section. */
     if ( gc_global.inreclaim || CASIO(&gc_global.inreclaim, 0, 1) ) return;
@@ -381,6 +383,11 @@ static void gc_reclaim(void)
             gc->garbage_tail[three_ago][i]->next = ch;
             gc->garbage_tail[three_ago][i] = t;
             t->next = t;
+            /* Blocks moving to the allocation list. */
+            n = 0;
+            p = ch;
+            do { n += p->i; } while ( (p = p->next) != ch );
+            ma_reclaim(n * gc_global.blk_sizes[i]);
             add_chunks_to_list(ch, gc_global.alloc[i]);
         }
 
@@ -437,6 +444,7 @@ void *gc_alloc(ptst_t *ptst, int alloc_id)
         }
     }
 
+    ma_alloc(gc_global.blk_sizes[alloc_id]);
     return ch->blk[--ch->i];
 }
 
@@ -462,6 +470,7 @@ static chunk_t *chunk_from_cache(gc_t *gc)
 
 void gc_free(ptst_t *ptst, void *p, int alloc_id) 
 {
+    ma_retire(gc_global.blk_sizes[alloc_id]);
 #ifndef MINIMAL_GC
     gc_t *gc = ptst->gc;
     chunk_t *prev, *new, *ch = gc->garbage[gc->epoch][alloc_id];
@@ -519,6 +528,7 @@ void gc_unsafe_free(ptst_t *ptst, void *p, int alloc_id)
     ch = gc->alloc[alloc_id];
     if ( ch->i < BLKS_PER_CHUNK )
     {
+        ma_free(gc_global.blk_sizes[alloc_id]);
         ch->blk[ch->i++] = p;
     }
     else
@@ -21,6 +21,8 @@
  * GNU General Public License for more details.
  */
 
+#include <stdlib.h>
+
 #include "intset.h"
 #include "set.h"
 
@@ -40,3 +42,19 @@ int sl_remove_old(set_t *set, setkey_t key)
 {
 	return set_remove(set, key);
 }
+
+int sl_range_collect_old(set_t *set, setkey_t lo, setkey_t hi, setkey_t *keys,
+                         int max)
+{
+        return set_range(set, lo, hi, keys, max);
+}
+
+int sl_range_count_old(set_t *set, setkey_t lo, setkey_t hi)
+{
+        return set_range(set, lo, hi, NULL, 0);
+}
+
+int sl_successor_old(set_t *set, setkey_t key, setkey_t *succ)
+{
+        return set_successor(set, key, succ);
+}
@@ -29,5 +29,9 @@
 int sl_contains_old(set_t *set, setkey_t key);
 int sl_add_old(set_t *set, setkey_t key);
 int sl_remove_old(set_t *set, setkey_t key);
+int sl_range_collect_old(set_t *set, setkey_t lo, setkey_t hi, setkey_t *keys,
+                         int max);
+int sl_range_count_old(set_t *set, setkey_t lo, setkey_t hi);
+int sl_successor_old(set_t *set, setkey_t key, setkey_t *succ);
 
 #endif /* INTSET_H_ */
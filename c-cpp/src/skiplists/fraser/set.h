@@ -27,6 +27,7 @@ typedef void         *setval_t;
  * key values 0 and 1, without knowing these have special meanings.
  */
 #define CALLER_TO_INTERNAL_KEY(_k) ((_k) + 2)
+#define INTERNAL_TO_CALLER_KEY(_k) ((_k) - 2)
 
 
 /*
@@ -96,6 +97,19 @@ set_t *set_alloc(void);
  */
 /*setval_t*/ int set_lookup(set_t *s, setkey_t k);
 
+/*
+ * Collect the keys of [@lo,@hi] in @keys, up to @max of them, and return
+ * their number. If @keys is NULL, count the keys of [@lo,@hi] instead.
+ * Scans are weakly consistent rather than linearizable (see scan.h).
+ */
+int set_range(set_t *s, setkey_t lo, setkey_t hi, setkey_t *keys, int max);
+
+/*
+ * Store in @succ the smallest key of @s above @k. Return 1 if there is
+ * one and 0 otherwise.
+ */
+int set_successor(set_t *s, setkey_t k, setkey_t *succ);
+
 void set_print(set_t *set);
 unsigned long set_count(set_t *set);
 void set_print_nodenums(set_t *set);
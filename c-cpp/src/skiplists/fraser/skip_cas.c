@@ -497,6 +497,56 @@ int set_lookup(set_t *l, setkey_t k)
     return(result);
 }
 
+/*
+ * Collect the keys of [@lo,@hi] in @keys (up to @max of them), or count
+ * them if @keys is NULL. Walks the bottom level from the predecessor of
+ * @lo, skipping the nodes whose value was cleared by set_remove(). The
+ * scan is weakly consistent: deleted nodes keep their forward pointers,
+ * so a node present during the whole scan is always reached.
+ */
+int set_range(set_t *l, setkey_t lo, setkey_t hi, setkey_t *keys, int max)
+{
+    setval_t   v;
+    ptst_t    *ptst;
+    sh_node_pt x, x_next;
+    setkey_t   x_k;
+    int        count = 0;
+
+    if ( (keys != NULL) && (max <= 0) ) return(0);
+    if ( hi > SENTINEL_KEYMAX - 3 ) hi = SENTINEL_KEYMAX - 3;
+    if ( lo > hi ) return(0);
+
+    lo = CALLER_TO_INTERNAL_KEY(lo);
+    hi = CALLER_TO_INTERNAL_KEY(hi);
+
+    ptst = critical_enter();
+
+    for ( x = weak_search_predecessors(l, lo, NULL, NULL); ; x = x_next )
+    {
+        READ_FIELD(x_k, x->k);
+        if ( x_k > hi ) break;
+        READ_FIELD(v, x->v);
+        if ( v != NULL )
+        {
+            if ( keys != NULL ) keys[count] = INTERNAL_TO_CALLER_KEY(x_k);
+            if ( ++count == max ) break;
+        }
+        READ_FIELD(x_next, x->next[0]);
+        x_next = get_unmarked_ref(x_next);
+    }
+
+    critical_exit(ptst);
+
+    return(count);
+}
+
+
+int set_successor(set_t *l, setkey_t k, setkey_t *succ)
+{
+    if ( k >= SENTINEL_KEYMAX - 3 ) return(0);
+    return(set_range(l, k + 1, SENTINEL_KEYMAX - 3, succ, 1));
+}
+
 void set_print(set_t *set)
 {
 	node_t *curr;
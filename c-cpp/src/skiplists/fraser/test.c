@@ -34,6 +34,13 @@
 
 #include <atomic_ops.h>
 
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "timeseries.h"
+#include "scan.h"
+#include "memacct.h"
 #include "tm.h"
 #include "ptst.h"
 #include "set.h"
@@ -154,12 +161,18 @@ typedef struct thread_data {
 	int unit_tx;
 	int alternate;
 	int effective;
+	int scan;
+	int scan_length;
+	int scan_op;
 	unsigned long nb_add;
 	unsigned long nb_added;
 	unsigned long nb_remove;
 	unsigned long nb_removed;
 	unsigned long nb_contains;
 	unsigned long nb_found;
+	unsigned long nb_scan;
+	unsigned long nb_scanned;
+	setkey_t *scan_keys;
 	unsigned long nb_aborts;
 	unsigned long nb_aborts_locked_read;
 	unsigned long nb_aborts_locked_write;
@@ -173,6 +186,10 @@ typedef struct thread_data {
 	struct sl_set *set;
 	barrier_t *barrier;
 	unsigned long failures_because_contention;
+	lat_stats_t *lat;
+	wl_thread_t wl;
+	int cpu;
+	pc_stats_t *pc;
 } thread_data_t;
 
 /*
@@ -204,13 +221,17 @@ void *test(void *data) {
 
 	thread_data_t *d = (thread_data_t *)data;
 
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
 	/* Create transaction */
 	TM_THREAD_ENTER();
 	/* Wait on barrier */
 	barrier_cross(d->barrier);
+	pc_start(d->pc);
 
 	/* Is the first op an update? */
-	unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+	unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 
 #ifdef ICC
 	while (stop == 0) {
@@ -223,8 +244,8 @@ void *test(void *data) {
 
 			if (last < 0) { // add
 
-				val = rand_range_re(&d->seed, d->range);
-				if (sl_add_old(d->set, val)) {
+				val = wl_key(&d->wl);
+				if (LAT_OP(d->lat, LAT_ADD, sl_add_old(d->set, val))) {
 					d->nb_added++;
 					last = val;
 				}
@@ -233,15 +254,15 @@ void *test(void *data) {
 			} else { // remove
 
 				if (d->alternate) { // alternate mode (default)
-					if (sl_remove_old(d->set, (setkey_t) last)) {
+					if (LAT_OP(d->lat, LAT_REMOVE, sl_remove_old(d->set, (setkey_t) last))) {
 						d->nb_removed++;
 					}
 					last = -1;
 				} else {
 					/* Random computation only in non-alternated cases */
-					val = rand_range_re(&d->seed, d->range);
+					val = wl_key(&d->wl);
 					/* Remove one random value */
-					if (sl_remove_old(d->set, val)) {
+					if (LAT_OP(d->lat, LAT_REMOVE, sl_remove_old(d->set, val))) {
 						d->nb_removed++;
 						/* Repeat until successful, to avoid size variations */
 						last = -1;
@@ -250,6 +271,21 @@ void *test(void *data) {
 				d->nb_remove++;
 			}
 
+		} else if (scan_next(&d->wl, d->update, d->scan)) { // range scan or successor query
+
+			val = wl_key(&d->wl);
+			switch (d->scan_op) {
+			case SCAN_COUNT:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_range_count_old(d->set, val, scan_hi(val, d->scan_length, d->range)));
+				break;
+			case SCAN_SUCCESSOR:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_successor_old(d->set, val, d->scan_keys));
+				break;
+			default:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_range_collect_old(d->set, val, scan_hi(val, d->scan_length, d->range), d->scan_keys, d->scan_length));
+			}
+			d->nb_scan++;
+
 		} else { // read
 
 			if (d->alternate) {
@@ -258,20 +294,20 @@ void *test(void *data) {
 						val = d->first;
 						last = val;
 					} else { // last >= 0
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						last = -1;
 					}
 				} else { // update != 0
 					if (last < 0) {
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						//last = val;
 					} else {
 						val = last;
 					}
 				}
-			}	else val = rand_range_re(&d->seed, d->range);
+			}	else val = wl_key(&d->wl);
 
-			if (sl_contains_old(d->set, val))
+			if (LAT_OP(d->lat, LAT_CONTAINS, sl_contains_old(d->set, val)))
 				d->nb_found++;
 			d->nb_contains++;
 
@@ -280,9 +316,9 @@ void *test(void *data) {
 		/* Is the next op an update? */
 		if (d->effective) { // a failed remove/add is a read-only tx
 			unext = ((100 * (d->nb_added + d->nb_removed))
-							 < (d->update * (d->nb_add + d->nb_remove + d->nb_contains)));
+							 < (d->update * (d->nb_add + d->nb_remove + d->nb_contains + d->nb_scan)));
 		} else { // remove/add (even failed) is considered as an update
-			unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+			unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 		}
 
 #ifdef ICC
@@ -291,6 +327,7 @@ void *test(void *data) {
 	}
 #endif /* ICC */
 
+	pc_stop(d->pc);
 	/* Free transaction */
         TM_THREAD_EXIT();
 
@@ -308,6 +345,17 @@ int main(int argc, char **argv)
 		// These options don't set a flag
 		{"help",                      no_argument,       NULL, 'h'},
 		{"duration",                  required_argument, NULL, 'd'},
+		{"latency",                   required_argument, NULL, 'L'},
+		{"key-dist",                  required_argument, NULL, 'K'},
+		{"pin",                       required_argument, NULL, 'P'},
+		{"numa",                      required_argument, NULL, 'N'},
+		{"counters",                  required_argument, NULL, 'C'},
+		{"interval",                  required_argument, NULL, 'T'},
+		{"rate",                      required_argument, NULL, 'O'},
+		{"arrival",                   required_argument, NULL, 'E'},
+		{"scan-rate",                 required_argument, NULL, 'R'},
+		{"scan-length",               required_argument, NULL, 'Q'},
+		{"scan-op",                   required_argument, NULL, 'q'},
 		{"initial-size",              required_argument, NULL, 'i'},
 		{"thread-num",                required_argument, NULL, 't'},
 		{"range",                     required_argument, NULL, 'r'},
@@ -323,6 +371,7 @@ int main(int argc, char **argv)
         unsigned long size;
 	setkey_t last = 0;
 	setkey_t val = 0;
+	unsigned long scans, scanned;
 	unsigned long reads, effreads, updates, effupds, aborts, aborts_locked_read, aborts_locked_write,
 	aborts_validate_read, aborts_validate_write, aborts_validate_commit,
 	aborts_invalid_memory, aborts_double_write, max_retries, failures_because_contention;
@@ -333,6 +382,22 @@ int main(int argc, char **argv)
 	struct timeval start, end;
 	struct timespec timeout;
 	int duration = DEFAULT_DURATION;
+	int latency = DEFAULT_LATENCY;
+	char *keydist = DEFAULT_KEYDIST;
+	workload_t workload;
+	char *pin = DEFAULT_PIN;
+	char *numa = DEFAULT_NUMA;
+	affinity_t aff;
+	int counters = DEFAULT_COUNTERS;
+	int interval = DEFAULT_INTERVAL;
+	int rate = DEFAULT_RATE;
+	int scan = DEFAULT_SCAN;
+	int scan_length = DEFAULT_SCAN_LENGTH;
+	int scan_op = scan_parse(DEFAULT_SCAN_OP);
+	char *arrival = DEFAULT_ARRIVAL;
+	int poisson;
+	unsigned long ops;
+	ts_t ts;
 	int initial = DEFAULT_INITIAL;
 	int nb_threads = DEFAULT_NB_THREADS;
 	long range = DEFAULT_RANGE;
@@ -346,7 +411,7 @@ int main(int argc, char **argv)
 
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:U:"
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:U:L:K:P:N:C:T:O:E:R:Q:q:"
 										, long_options, &i);
 
 		if(c == -1)
@@ -384,6 +449,29 @@ int main(int argc, char **argv)
 								 "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 								 "  -u, --update-rate <int>\n"
 								 "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+								 "  -L, --latency <int>\n"
+								 "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+								 "  -K, --key-dist <dist>\n"
+								 "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+								 "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+								 "  -P, --pin <policy>\n"
+								 "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+								 "  -N, --numa <policy>\n"
+								 "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+								 "  -C, --counters <int>\n"
+								 "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+								 "  -T, --interval <int>\n"
+								 "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+								 "  -O, --rate <int>\n"
+								 "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+								 "  -E, --arrival <process>\n"
+								 "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
+								 "  -R, --scan-rate <int>\n"
+								 "        Percentage of range scans (default=" XSTR(DEFAULT_SCAN) ")\n"
+								 "  -Q, --scan-length <int>\n"
+								 "        Number of keys of the range of a scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+								 "  -q, --scan-op <op>\n"
+								 "        Operation of a scan: collect, count or successor (default=" DEFAULT_SCAN_OP ")\n"
 					                         "  -U, --unbalance <int>\n"
 								 "        Percentage of skewness of the distribution of values (default=" XSTR(DEFAULT_UNBALANCED) ")\n"
 
@@ -416,6 +504,39 @@ int main(int argc, char **argv)
                                 case 'U':
                                         unbalanced = atoi(optarg);
                                         break;
+				case 'K':
+					keydist = optarg;
+					break;
+				case 'P':
+					pin = optarg;
+					break;
+				case 'N':
+					numa = optarg;
+					break;
+				case 'C':
+					counters = atoi(optarg);
+					break;
+				case 'T':
+					interval = atoi(optarg);
+					break;
+				case 'O':
+					rate = atoi(optarg);
+					break;
+				case 'E':
+					arrival = optarg;
+					break;
+				case 'R':
+					scan = atoi(optarg);
+					break;
+				case 'Q':
+					scan_length = atoi(optarg);
+					break;
+				case 'q':
+					scan_op = scan_parse(optarg);
+					break;
+				case 'L':
+					latency = atoi(optarg);
+					break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -429,6 +550,12 @@ int main(int argc, char **argv)
 	assert(nb_threads > 0);
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 100);
+	scan_check(update, scan, scan_length);
+	wl_init(&workload, keydist, range);
+	aff_init(&aff, pin, numa, nb_threads);
+	poisson = lat_poisson(arrival);
+	if (rate > 0 && latency == 0)
+		latency = 1;
 
 	printf("Set type     : skip list\n");
 	printf("Duration     : %d\n", duration);
@@ -437,6 +564,13 @@ int main(int argc, char **argv)
 	printf("Value range  : %ld\n", range);
 	printf("Seed         : %d\n", seed);
 	printf("Update rate  : %d\n", update);
+	printf("Latency      : %d\n", latency);
+	printf("Key dist.    : %s\n", keydist);
+	aff_print(&aff, pin, numa);
+	printf("Counters     : %d\n", counters);
+	printf("Interval     : %d\n", interval);
+	printf("Rate         : %d (%s)\n", rate, arrival);
+	printf("Scan rate    : %d (%s, length %d)\n", scan, scan_name(scan_op), scan_length);
 	printf("Elasticity   : %d\n", unit_tx);
 	printf("Alternate    : %d\n", alternate);
 	printf("Efffective   : %d\n", effective);
@@ -493,6 +627,7 @@ int main(int argc, char **argv)
 	i = 0;
 
 	while (i < initial) {
+		aff_populate(&aff, i, initial);
 		if (unbalanced)
                         val = rand_range_re(&global_seed, initial);
 	        else	
@@ -502,6 +637,7 @@ int main(int argc, char **argv)
 			i++;
 		}
 	}
+	aff_populate_done(&aff);
         printf("i = %d\n", i);
 	size = set_count(set);
 	printf("Set size     : %lu\n", size);
@@ -535,6 +671,20 @@ int main(int argc, char **argv)
 		data[i].nb_aborts_double_write = 0;
 		data[i].max_retries = 0;
 		data[i].seed = rand();
+		data[i].lat = lat_new(latency);
+		lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+		wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+		data[i].cpu = aff_cpu(&aff, i);
+		data[i].pc = pc_new(counters);
+		data[i].scan = scan;
+		data[i].scan_length = scan_length;
+		data[i].scan_op = scan_op;
+		data[i].nb_scan = 0;
+		data[i].nb_scanned = 0;
+		if ((data[i].scan_keys = (setkey_t *)malloc(scan_length * sizeof(setkey_t))) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
 		data[i].set = set;
 		data[i].barrier = &barrier;
 		data[i].failures_because_contention = 0;
@@ -559,7 +709,16 @@ int main(int argc, char **argv)
 	printf("STARTING...\n");
 	gettimeofday(&start, NULL);
 	if (duration > 0) {
-		nanosleep(&timeout, NULL);
+		if (interval > 0) {
+			ts_init(&ts, interval, duration);
+			while (ts_wait(&ts)) {
+				for (ops = 0, i = 0; i < nb_threads; i++)
+					ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains + data[i].nb_scan;
+				ts_sample(&ts, ops);
+			}
+		} else {
+			nanosleep(&timeout, NULL);
+		}
 	} else {
 		sigemptyset(&block_set);
 		sigsuspend(&block_set);
@@ -595,6 +754,8 @@ int main(int argc, char **argv)
 	aborts_double_write = 0;
 	failures_because_contention = 0;
 	reads = 0;
+	scans = 0;
+	scanned = 0;
 	effreads = 0;
 	updates = 0;
 	effupds = 0;
@@ -628,8 +789,10 @@ int main(int argc, char **argv)
 		aborts_invalid_memory += data[i].nb_aborts_invalid_memory;
 		aborts_double_write += data[i].nb_aborts_double_write;
 		failures_because_contention += data[i].failures_because_contention;
-		reads += data[i].nb_contains;
-		effreads += data[i].nb_contains +
+		scans += data[i].nb_scan;
+		scanned += data[i].nb_scanned;
+		reads += data[i].nb_contains + data[i].nb_scan;
+		effreads += data[i].nb_contains + data[i].nb_scan +
 		(data[i].nb_add - data[i].nb_added) +
 		(data[i].nb_remove - data[i].nb_removed);
 		updates += (data[i].nb_add + data[i].nb_remove);
@@ -641,12 +804,23 @@ int main(int argc, char **argv)
 	printf("Set size      : %lu (expected: %lu)\n", set_count(set), size);
 	printf("Duration      : %d (ms)\n", duration);
 	printf("#txs          : %lu (%f / s)\n", reads + updates, (reads + updates) * 1000.0 / duration);
+	if (counters) {
+		pc_stats_t *pc = pc_new(counters);
+		for (i = 0; i < nb_threads; i++) {
+			pc_merge(pc, data[i].pc);
+			free(data[i].pc);
+		}
+		pc_print(pc, reads + updates);
+		free(pc);
+	}
 
 	printf("#read txs     : ");
 	if (effective) {
 		printf("%lu (%f / s)\n", effreads, effreads * 1000.0 / duration);
-		printf("  #contains   : %lu (%f / s)\n", reads, reads * 1000.0 / duration);
+		printf("  #contains   : %lu (%f / s)\n", reads - scans, (reads - scans) * 1000.0 / duration);
 	} else printf("%lu (%f / s)\n", reads, reads * 1000.0 / duration);
+	if (scan > 0)
+		scan_print(scans, scanned, duration);
 
 	printf("#eff. upd rate: %f \n", 100.0 * effupds / (effupds + effreads));
 
@@ -667,6 +841,16 @@ int main(int argc, char **argv)
 	printf("  #dup-w      : %lu (%f / s)\n", aborts_double_write, aborts_double_write * 1000.0 / duration);
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
+	ma_print(size);
+	if (latency > 0) {
+		lat_stats_t *lat = lat_new(latency);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(lat, data[i].lat);
+			free(data[i].lat);
+		}
+		lat_print(lat);
+		free(lat);
+	}
 
         /*set_print(set);*/
         set_print_nodenums(set);
@@ -53,6 +53,34 @@ can interrupt other threads trying to traverse the list, as the background
 thread may cause cache invalidations in other threads and cause costly
 reads from memory to occur.
 
+The sleep time given to bg_start() is only an upper bound: after each
+traversal, bg_schedule() halves the sleep time if the index lags behind
+the node level (too few index levels for the number of nodes, or long
+runs of nodes without index items or long chains of deleted nodes on
+average), keeps it if many nodes were updated since the previous
+traversal, and doubles it otherwise. Worker threads that walk too many
+nodes at the node level wake the background thread up (bg_wakeup())
+rather than waiting for the sleep to end.
+
+On NUMA machines the index can be replicated with bg_replicate(): one
+helper thread per additional node keeps a copy of the index built by
+the background thread in the memory of its node, so that the worker
+threads of that node search their local replica (set_join_replica())
+and only reach remote memory at the node level, which all the replicas
+share. A helper copies the index again whenever the background thread
+has raised or lowered it. A replica may point to nodes that have since
+been removed, which searches already handle by following the prev
+pointers of removed nodes.
+
+On large skip lists the traversal can be shared by several helper
+threads (bg_set_helpers()). Each traversal splits the keys into one
+range per helper, at evenly spaced index nodes, and each helper
+removes, raises and unlinks the nodes and index nodes of its own
+range. Index nodes are linked with CAS, as the helpers of two
+neighbouring ranges can link index nodes after the same index node.
+Once all the helpers are done, the background thread raises the index
+nodes of the sparse upper levels and adds or removes index levels.
+
 */
 
 #include <stdlib.h>
@@ -60,12 +88,15 @@ reads from memory to occur.
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include "background.h"
 #include "skiplist.h"
 #include "garbagecoll.h"
 #include "ptst.h"
 #include "common.h"
+#include "memacct.h"
+#include "affinity.h"
 
 /* - Private variables - */
 
@@ -81,6 +112,7 @@ static struct bg_stats {
         int loops;
         int lowers;
         int delete_succeeds;
+        int copies;
 } bg_stats;
 
 /* to keep track of background state */
@@ -91,17 +123,82 @@ static int bg_running;
 static int bg_non_deleted;
 static int bg_tall_deleted;
 
-/* the amount of time the bg thread sleeps for each iteration */
+/* the amount of time the bg thread sleeps for each iteration, at most */
 static int bg_sleep_time;
 
+/* adaptive scheduling of the bg thread, see bg_schedule() */
+#define BG_MIN_SLEEP    100     /* shortest sleep time (us) */
+#define BG_SLICE        10000   /* longest uninterrupted sleep (us) */
+#define BG_MAX_RUN      4       /* mean run of short nodes tolerated */
+#define BG_MAX_CHAIN    4       /* mean chain of deleted nodes tolerated */
+#define BG_CHANGE_RATIO 16      /* 1/16 of the nodes updated is a burst */
+
+static struct bg_sched {
+        int sleep;              /* current sleep time (us) */
+        unsigned long hurries;  /* traversals followed by a shorter sleep */
+        unsigned long holds;    /* traversals followed by the same sleep */
+        unsigned long relaxes;  /* traversals followed by a longer sleep */
+        unsigned long wakeups;  /* sleeps interrupted by a worker */
+        unsigned long rate;     /* updates per second, last traversal */
+        int gap;                /* missing index levels, last traversal */
+        int max_run;            /* longest run of short nodes seen */
+        int max_chain;          /* longest chain of deleted nodes seen */
+} bg_sched;
+
+static VOLATILE int bg_wake;    /* set by workers, see bg_wakeup() */
+static int bg_deleted;          /* deleted nodes seen by the traversal */
+static int bg_run;              /* longest run of short nodes */
+static int bg_chain;            /* longest chain of deleted nodes */
+static int bg_short, bg_runs;   /* short nodes and runs of short nodes */
+static int bg_chains;           /* chains of deleted nodes */
+static int bg_prev_size;        /* non-deleted nodes at the last traversal */
+static struct timeval bg_prev_time;
+
+/* parallel maintenance, see bg_partition() */
+#define BG_SPLIT        16      /* index items per part to split a level */
+
+typedef struct bg_part bg_part_t;
+static struct bg_part {
+        sl_key_t lo, hi;                /* the keys of the part, [lo, hi) */
+        inode_t *inodes[MAX_LEVELS];    /* last index item before lo */
+        inode_t **next;                 /* inodes of the next part or NULL */
+        int raised;                     /* raised an item to the top level */
+        int changed;                    /* modified the index */
+        /* measures of the traversal, merged by bg_loop() */
+        int non_deleted, tall_deleted, deleted;
+        int run, chain, nshort, runs, chains;
+        pthread_t thread;
+} bg_parts[MAX_HELPERS];
+
+static int bg_nb_helpers = 1;
+static int bg_split;                    /* level the parts are split at */
+static pthread_barrier_t bg_round_start, bg_round_end;
+static VOLATILE int bg_helpers_stop;     /* set by bg_loop() only */
+
+/* index replicas, 0 is the index maintained by bg_loop() */
+static pthread_t bg_replica_threads[MAX_REPLICAS];
+static int bg_replica_cpus[MAX_REPLICAS];
+static int bg_replicating;
+static VOLATILE unsigned long bg_version; /* bumped on index changes */
+
 /* - Private Functions - */
 
 static void* bg_loop(void *args);
-static void bg_trav_nodes(ptst_t *ptst);
+static void bg_sleep(void);
+static void bg_schedule(void);
+static void* bg_helper_loop(void *args);
+static void bg_partition(inode_t **inodes, int height);
+static void bg_maintain(bg_part_t *p, int height, ptst_t *ptst);
+static void bg_merge(void);
+static void bg_trav_nodes(bg_part_t *p, ptst_t *ptst);
 static void bg_lower_ilevel(inode_t *new_low, ptst_t *ptst);
-static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst);
-static int bg_raise_ilevel(inode_t *iprev,inode_t *iprev_tall,
-                           int height, ptst_t *ptst);
+static void bg_link(inode_t **iprev, node_t *node, inode_t *down,
+                    ptst_t *ptst);
+static int bg_raise_nlevel(bg_part_t *p, ptst_t *ptst);
+static int bg_raise_ilevel(bg_part_t *p, int height, ptst_t *ptst);
+static void* bg_replica_loop(void *args);
+static inode_t* bg_copy_index(ptst_t *ptst);
+static void bg_free_index(inode_t *top, ptst_t *ptst);
 
 /**
  * bg_loop - loop for maintaining index levels
@@ -116,17 +213,32 @@ static void* bg_loop(void *args)
         inode_t *inew;
         inode_t *inodes[MAX_LEVELS];
         int raised = 0; /* keep track of if we raised index level */
+        int changed;    /* keep track of if we modified the index */
         int threshold;  /* for testing if we should lower index level */
-        int i;
+        int height, i;
         struct sl_ptst *ptst;
 
         assert(NULL != set);
 
+        /* start the helper threads, each maintaining its own part */
+        if (bg_nb_helpers > 1) {
+                bg_helpers_stop = 0;
+                pthread_barrier_init(&bg_round_start, NULL, bg_nb_helpers);
+                pthread_barrier_init(&bg_round_end, NULL, bg_nb_helpers);
+                for (i = 1; i < bg_nb_helpers; i++) {
+                        if (pthread_create(&bg_parts[i].thread, NULL,
+                                           bg_helper_loop, &bg_parts[i])) {
+                                perror("Failed to create a helper thread\n");
+                                exit(1);
+                        }
+                }
+        }
+
         while (1) {
                 if (bg_finished)
                         break;
 
-                usleep(bg_sleep_time);
+                bg_sleep();
 
                 #ifdef USE_GC
                 ptst = ptst_critical_enter();
@@ -139,46 +251,42 @@ static void* bg_loop(void *args)
                 ++bg_stats.loops;
                 #endif
 
-                bg_non_deleted = 0;
-                bg_tall_deleted = 0;
-
-                /* traverse the node level and do physical deletes */
-                bg_trav_nodes(ptst);
-
-                assert(set->head->level < MAX_LEVELS);
+                height = set->head->level;
+                assert(height < MAX_LEVELS);
 
                 /* get the first index node at each level */
                 inode = set->top;
-                for (i = set->head->level - 1; i >= 0; i--) {
+                for (i = height - 1; i >= 0; i--) {
                         inodes[i] = inode;
                         assert(NULL != inodes[i]);
                         inode = inode->down;
                 }
                 assert(NULL == inode);
 
-                /* raise bottom level nodes */
-                raised = bg_raise_nlevel(inodes[0], ptst);
-
-                if (raised && (1 == set->head->level)) {
-                        /* add a new index level */
-                        inew = inode_new(NULL, set->top, set->head, ptst);
-                        set->top = inew;
-                        ++set->head->level;
-                        assert(NULL == inodes[1]);
-                        inodes[1] = set->top;
-
-                        #ifdef BG_STATS
-                        ++bg_stats.raises;
-                        #endif
+                /* traverse the node level and do physical deletes, then
+                 * raise the nodes and index nodes, one part per helper */
+                bg_partition(inodes, height);
+                if (bg_nb_helpers > 1)
+                        pthread_barrier_wait(&bg_round_start);
+                bg_maintain(&bg_parts[0], height, ptst);
+                if (bg_nb_helpers > 1)
+                        pthread_barrier_wait(&bg_round_end);
+                bg_merge();
+
+                raised = 0;
+                changed = 0;
+                for (i = 0; i < bg_nb_helpers; i++) {
+                        raised |= bg_parts[i].raised;
+                        changed |= bg_parts[i].changed;
                 }
 
-                /* raise the index level nodes */
-                for (i = 0; i < (set->head->level - 1); i++) {
-                        assert(i < MAX_LEVELS-1);
-                        raised = bg_raise_ilevel(inodes[i],/* level raised */
-                                                 inodes[i + 1],/* level above */
-                                                 i + 1,/* current height */
-                                                 ptst);
+                /* raise the index nodes of the split level and above over
+                 * the whole skip list, the parts of these sparse levels
+                 * would be too short */
+                bg_parts[0].next = NULL;
+                for (i = bg_split; i < (height - 1); i++) {
+                        raised = bg_raise_ilevel(&bg_parts[0], i + 1, ptst);
+                        changed |= raised;
                 }
 
                 if (raised) {
@@ -198,6 +306,7 @@ static void* bg_loop(void *args)
                         if (NULL != inodes[1]) {
                                 bg_lower_ilevel(inodes[1],/* level above */
                                                 ptst);
+                                changed = 1;
 
                                 #ifdef BG_STATS
                                 ++bg_stats.lowers;
@@ -205,89 +314,523 @@ static void* bg_loop(void *args)
                         }
                 }
 
+                /* the replicas have to copy the new index */
+                if (changed)
+                        ++bg_version;
+
+                bg_schedule();
+
                 #ifdef USE_GC
                 ptst_critical_exit(ptst);
                 #endif
         }
 
+        /* end the helper threads, which cannot read bg_finished as it
+         * may be set during a round */
+        if (bg_nb_helpers > 1) {
+                bg_helpers_stop = 1;
+                pthread_barrier_wait(&bg_round_start);
+                for (i = 1; i < bg_nb_helpers; i++)
+                        pthread_join(bg_parts[i].thread, NULL);
+                pthread_barrier_destroy(&bg_round_start);
+                pthread_barrier_destroy(&bg_round_end);
+        }
+
+        return NULL;
+}
+
+/**
+ * bg_helper_loop - loop of a helper maintaining a part of the skip list
+ * @args: the part to maintain, as per pthread_create requirements
+ *
+ * Returns a void* value as per pthread_create requirements.
+ * Note: the rounds of the helpers are started and ended by bg_loop(),
+ * which splits the skip list into parts in between.
+ */
+static void* bg_helper_loop(void *args)
+{
+        bg_part_t *p = (bg_part_t *)args;
+        struct sl_ptst *ptst;
+
+        while (1) {
+                pthread_barrier_wait(&bg_round_start);
+                if (bg_helpers_stop)
+                        break;
+
+                #ifdef USE_GC
+                ptst = ptst_critical_enter();
+                #endif
+
+                bg_maintain(p, set->head->level, ptst);
+
+                #ifdef USE_GC
+                ptst_critical_exit(ptst);
+                #endif
+
+                pthread_barrier_wait(&bg_round_end);
+        }
+
+        return NULL;
+}
+
+/**
+ * bg_partition - split the skip list into one part per helper
+ * @inodes: the first index node at each level
+ * @height: the number of index levels
+ *
+ * Note: the boundaries are the keys of evenly spaced index nodes of the
+ * highest level that has BG_SPLIT index nodes per helper, the bottom
+ * index level otherwise. Each part starts from the last index node
+ * before its lowest key at each level, which is found by a search.
+ * The parts raise index nodes from the levels below this one, bg_loop()
+ * raises them from this level and the sparser levels above.
+ */
+static void bg_partition(inode_t **inodes, int height)
+{
+        bg_part_t *p;
+        inode_t *inode;
+        int n = 0, i, j, k, l;
+
+        for (l = 0; l < height; l++)
+                bg_parts[0].inodes[l] = inodes[l];
+        bg_parts[0].lo = 0;
+        bg_parts[0].next = NULL;
+        bg_split = height;
+        if (1 == bg_nb_helpers)
+                return;
+
+        /* find the highest index level with enough index nodes */
+        for (l = height - 1; l >= 0; l--) {
+                n = 0;
+                for (inode = inodes[l]->right; NULL != inode;
+                     inode = inode->right)
+                        ++n;
+                if (n >= BG_SPLIT * bg_nb_helpers)
+                        break;
+        }
+        if (l < 0)
+                l = 0;
+        bg_split = l;
+
+        /* the lowest key of each part, parts without keys are empty */
+        inode = inodes[l]->right;
+        for (j = 0, k = 1; k < bg_nb_helpers; k++) {
+                for (; NULL != inode && j < k * n / bg_nb_helpers; j++)
+                        inode = inode->right;
+                bg_parts[k].lo = (NULL == inode) ? ~0UL : inode->node->key;
+        }
+
+        for (k = 1; k < bg_nb_helpers; k++) {
+                p = &bg_parts[k];
+                inode = inodes[height - 1];
+                for (i = height - 1; i >= 0; i--) {
+                        while (NULL != inode->right &&
+                               inode->right->node->key < p->lo)
+                                inode = inode->right;
+                        p->inodes[i] = inode;
+                        inode = inode->down;
+                }
+                bg_parts[k - 1].hi = p->lo;
+                bg_parts[k - 1].next = p->inodes;
+                p->next = NULL;
+        }
+}
+
+/**
+ * bg_maintain - maintain a part of the skip list
+ * @p: the part to maintain
+ * @height: the number of index levels at the start of the round
+ * @ptst: per-thread state
+ */
+static void bg_maintain(bg_part_t *p, int height, ptst_t *ptst)
+{
+        int raised, i;
+
+        p->non_deleted = 0;
+        p->tall_deleted = 0;
+        p->deleted = 0;
+        p->run = 0;
+        p->chain = 0;
+        p->nshort = 0;
+        p->runs = 0;
+        p->chains = 0;
+
+        /* traverse the node level and do physical deletes */
+        bg_trav_nodes(p, ptst);
+
+        /* raise bottom level nodes */
+        raised = bg_raise_nlevel(p, ptst);
+        p->changed = raised;
+
+        /* raise the index level nodes */
+        for (i = 0; i < (height - 1) && i < bg_split; i++) {
+                assert(i < MAX_LEVELS-1);
+                raised = bg_raise_ilevel(p, i + 1, ptst);
+                p->changed |= raised;
+        }
+
+        /* the top level got a new index node */
+        p->raised = raised;
+}
+
+/**
+ * bg_merge - merge the measures of the traversals of the parts
+ */
+static void bg_merge(void)
+{
+        bg_part_t *p;
+        int i;
+
+        bg_non_deleted = 0;
+        bg_tall_deleted = 0;
+        bg_deleted = 0;
+        bg_run = 0;
+        bg_chain = 0;
+        bg_short = 0;
+        bg_runs = 0;
+        bg_chains = 0;
+        for (i = 0; i < bg_nb_helpers; i++) {
+                p = &bg_parts[i];
+                bg_non_deleted += p->non_deleted;
+                bg_tall_deleted += p->tall_deleted;
+                bg_deleted += p->deleted;
+                if (p->run > bg_run)
+                        bg_run = p->run;
+                if (p->chain > bg_chain)
+                        bg_chain = p->chain;
+                bg_short += p->nshort;
+                bg_runs += p->runs;
+                bg_chains += p->chains;
+        }
+}
+
+/**
+ * bg_sleep - sleep between two traversals
+ *
+ * Note: the sleep is cut into slices of at most BG_SLICE so that the
+ * thread notices bg_wakeup() and bg_stop() calls.
+ */
+static void bg_sleep(void)
+{
+        int left = bg_sched.sleep;
+
+        if (0 == left)
+                usleep(0);
+        while (left > 0 && !bg_finished && !bg_wake) {
+                usleep(left < BG_SLICE ? left : BG_SLICE);
+                left -= BG_SLICE;
+        }
+        if (bg_wake) {
+                bg_wake = 0;
+                ++bg_sched.wakeups;
+        }
+}
+
+/**
+ * bg_schedule - adapt the sleep time to the state of the skip list
+ *
+ * Note: called after each traversal, which measured the runs of short
+ * nodes, the chains of deleted nodes and the number of updates since
+ * the previous traversal.
+ */
+static void bg_schedule(void)
+{
+        struct timeval now;
+        unsigned long changes, elapsed;
+        int levels = 0, n;
+
+        gettimeofday(&now, NULL);
+        elapsed = (now.tv_sec - bg_prev_time.tv_sec) * 1000000UL +
+                  (now.tv_usec - bg_prev_time.tv_usec);
+        bg_prev_time = now;
+
+        /* nodes inserted or deleted since the previous traversal */
+        n = bg_non_deleted;
+        changes = bg_deleted +
+                  (n > bg_prev_size ? n - bg_prev_size : bg_prev_size - n);
+        bg_prev_size = n;
+        bg_sched.rate = (0 == elapsed) ? 0 : changes * 1000000UL / elapsed;
+
+        /* a balanced skip list has log2(n) index levels */
+        while (n > 1) {
+                n >>= 1;
+                ++levels;
+        }
+        bg_sched.gap = levels - (int)set->head->level;
+
+        if (bg_run > bg_sched.max_run)
+                bg_sched.max_run = bg_run;
+        if (bg_chain > bg_sched.max_chain)
+                bg_sched.max_chain = bg_chain;
+
+        if (bg_sched.gap >= 2 || bg_short > BG_MAX_RUN * bg_runs ||
+            bg_deleted > BG_MAX_CHAIN * bg_chains) {
+                /* the index lags behind */
+                bg_sched.sleep /= 2;
+                if (bg_sched.sleep < BG_MIN_SLEEP)
+                        bg_sched.sleep = BG_MIN_SLEEP;
+                ++bg_sched.hurries;
+        } else if (changes * BG_CHANGE_RATIO > (unsigned long)bg_non_deleted) {
+                /* the index keeps up but could soon lag behind */
+                ++bg_sched.holds;
+        } else {
+                bg_sched.sleep *= 2;
+                if (bg_sched.sleep < BG_MIN_SLEEP)
+                        bg_sched.sleep = BG_MIN_SLEEP;
+                ++bg_sched.relaxes;
+        }
+        if (bg_sched.sleep > bg_sleep_time)
+                bg_sched.sleep = bg_sleep_time;
+}
+
+/**
+ * bg_replica_loop - loop for maintaining an index replica
+ * @args: the replica number, as per pthread_create requirements
+ *
+ * Returns a void* value as per pthread_create requirements.
+ * Note: the thread runs on the node of the replica so that the
+ * index nodes it allocates are placed in the memory of that node.
+ */
+static void* bg_replica_loop(void *args)
+{
+        int r = (int)(long)args;
+        unsigned long version, seen = 0;
+        inode_t *old;
+        struct sl_ptst *ptst;
+
+        aff_pin_self(bg_replica_cpus[r]);
+
+        while (1) {
+                version = bg_version;
+                if (NULL == set->replicas[r] || version != seen) {
+                        #ifdef USE_GC
+                        ptst = ptst_critical_enter();
+                        #endif
+
+                        old = set->replicas[r];
+                        set->replicas[r] = bg_copy_index(ptst);
+                        seen = version;
+                        if (NULL != old)
+                                bg_free_index(old, ptst);
+
+                        #ifdef BG_STATS
+                        ++bg_stats.copies;
+                        #endif
+
+                        #ifdef USE_GC
+                        ptst_critical_exit(ptst);
+                        #endif
+                }
+
+                if (bg_finished)
+                        break;
+
+                usleep(bg_sched.sleep);
+        }
+
         return NULL;
 }
 
+/**
+ * bg_copy_index - copy the index maintained by the background thread
+ * @ptst: per-thread state
+ *
+ * Returns the top-left index node of the copy.
+ * Note: the index levels are copied from the bottom one, the down
+ * pointer of a copied item pointing to the copied item of the level
+ * below with the greatest key that does not exceed its own. Items of
+ * removed nodes are not copied.
+ */
+static inode_t* bg_copy_index(ptst_t *ptst)
+{
+        inode_t *inodes[MAX_LEVELS];
+        inode_t *inode, *below, *first, *last, *inew;
+        node_t *node;
+        int height = 0, i;
+
+        /* get the first index node at each level, top level first */
+        for (inode = set->top; NULL != inode; inode = inode->down) {
+                assert(height < MAX_LEVELS);
+                inodes[height++] = inode;
+        }
+
+        below = NULL;
+        for (i = height - 1; i >= 0; i--) {
+                first = last = inode_new(NULL, below, set->head, ptst);
+                for (inode = inodes[i]->right; NULL != inode;
+                     inode = inode->right) {
+                        node = inode->node;
+                        if (node == node->val)
+                                continue;
+                        while (NULL != below && NULL != below->right &&
+                               below->right->node->key <= node->key)
+                                below = below->right;
+                        inew = inode_new(NULL, below, node, ptst);
+                        last->right = inew;
+                        last = inew;
+                }
+                below = first;
+        }
+
+        /* publish the copy only once it is complete */
+        BARRIER();
+
+        return below;
+}
+
+/**
+ * bg_free_index - free an index replica
+ * @top: the top-left index node of the replica
+ * @ptst: per-thread state
+ */
+static void bg_free_index(inode_t *top, ptst_t *ptst)
+{
+        inode_t *inode, *inext;
+
+        while (NULL != top) {
+                inode = top;
+                top = top->down;
+                while (NULL != inode) {
+                        inext = inode->right;
+                        inode_delete(inode, ptst);
+                        inode = inext;
+                }
+        }
+}
+
+/* Returns 1 if @key is not above the keys of part @p */
+static inline int bg_before_end(bg_part_t *p, sl_key_t key)
+{
+        return NULL == p->next || key < p->hi;
+}
+
+/* Returns 1 if @inode is in part @p, or NULL and @p the last part */
+static inline int bg_owns(bg_part_t *p, inode_t *inode)
+{
+        if (NULL == inode)
+                return NULL == p->next;
+        return inode->node->key >= p->lo && bg_before_end(p, inode->node->key);
+}
+
 /**
  * bg_trav_nodes - traverse node level of skip list and maintain
+ * @p: the part of the skip list to traverse
  * @ptst: per-thread state
  * 
  * Note: this will try to remove each of the nodes in the list,
  * in order to extract nodes that have already been logically deleted
- * but that are still accessible.
+ * but that are still accessible. It also measures the runs of
+ * consecutive short nodes and the chains of consecutive deleted nodes.
+ * Removals use CAS and can run in parallel at the boundaries of parts.
  */
-static void bg_trav_nodes(ptst_t *ptst)
+static void bg_trav_nodes(bg_part_t *p, ptst_t *ptst)
 {
         node_t *prev, *node;
+        int run = 0, chain = 0;
 
         assert(NULL != set && NULL != set->head);
 
-        prev = set->head;
+        prev = p->inodes[0]->node;
         node = prev->next;
-        while (NULL != node) {
+        while (NULL != node && bg_before_end(p, node->key)) {
+                if (node->key < p->lo) {
+                        /* maintained by the previous part */
+                        prev = node;
+                        node = node->next;
+                        continue;
+                }
                 bg_remove(prev, node, ptst);
-                if (NULL != node->val && node != node->val)
-                        ++bg_non_deleted;
-                else if (node->level >= 1)
-                        ++bg_tall_deleted;
+                if (NULL != node->val && node != node->val) {
+                        ++p->non_deleted;
+                        chain = 0;
+                        if (0 == node->level) {
+                                if (0 == run)
+                                        ++p->runs;
+                                ++p->nshort;
+                                if (++run > p->run)
+                                        p->run = run;
+                        } else {
+                                run = 0;
+                        }
+                } else {
+                        ++p->deleted;
+                        if (0 == chain)
+                                ++p->chains;
+                        if (++chain > p->chain)
+                                p->chain = chain;
+                        if (node->level >= 1)
+                                ++p->tall_deleted;
+                }
                 prev = node;
                 node = node->next;
         }
 }
 
+/**
+ * bg_link - link a new index node into an index level
+ * @iprev: an index node before @node, set to the new index node
+ * @node: the node of the new index node
+ * @down: the index node below the new one
+ * @ptst: per-thread state
+ *
+ * Note: the helper of the previous part can link an index node after
+ * the same index node as us at the boundary of the parts, hence the
+ * CAS. Neither helper unlinks this index node (see bg_raise_ilevel()).
+ */
+static void bg_link(inode_t **iprev, node_t *node, inode_t *down,
+                    ptst_t *ptst)
+{
+        inode_t *prev = *iprev, *next, *inew;
+
+        inew = inode_new(NULL, down, node, ptst);
+        while (1) {
+                next = prev->right;
+                if (NULL != next && next->node->key < node->key) {
+                        prev = next;
+                        continue;
+                }
+                inew->right = next;
+                if (CAS(&prev->right, next, inew))
+                        break;
+        }
+        *iprev = inew;
+}
+
 /**
  * bg_raise_nlevel - raise level 0 nodes into index levels 
- * @inode: the index node at the start of the bottom index level
+ * @p: the part of the skip list to raise
  * @ptst: per-thread state
  *
  * Returns 1 if a node was raised and 0 otherwise.
  */
-static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
+static int bg_raise_nlevel(bg_part_t *p, ptst_t *ptst)
 {
         int raised = 0;
         node_t *prev, *node, *next;
-        inode_t *inew, *above, *above_prev;
+        inode_t *above_prev = p->inodes[0];
 
-        above = above_prev = inode;
+        assert(NULL != above_prev);
 
-        assert(NULL != inode);
-
-        prev = set->head;
-        node = set->head->next;
+        prev = above_prev->node;
+        node = prev->next;
 
         if (NULL == node)
                 return 0;
 
         next = node->next;
 
-        while (NULL != next) {
+        while (NULL != next && bg_before_end(p, node->key)) {
                 /* don't raise deleted nodes */
-                if (node != node->val) {
+                if (node != node->val && node->key >= p->lo) {
                         if (((prev->level == 0) &&
                              (node->level == 0)) &&
                              (next->level == 0)) {
 
                                 raised = 1;
 
-                                /* get the correct index above and behind */
-                                while (above && above->node->key < node->key) {
-                                        above = above->right;
-                                        if (above != inode->right)
-                                                above_prev = above_prev->right;
-                                }
-
-
                                 /* add a new index item above node */
-                                inew = inode_new(above_prev->right, NULL,
-                                                 node, ptst);
-                                above_prev->right = inew;
+                                bg_link(&above_prev, node, NULL, ptst);
                                 node->level = 1;
-                                above_prev = inode = above = inew;
                         }
                 }
                 prev = node;
@@ -300,35 +843,45 @@ static int bg_raise_nlevel(inode_t *inode, ptst_t *ptst)
 
 /**
  * bg_raise_ilevel - raise the index levels
- * @iprev: the first index node at this level
- * @iprev_tall: the first index node at the next highest level
+ * @p: the part of the skip list to raise
  * @height: the height of the level we are raising
  * @ptst: per-thread state
  *
  * Returns 1 if a node was raised and 0 otherwise.
+ * Note: the index nodes of deleted nodes are unlinked with CAS, except
+ * the ones the helper of the next part could link an index node after:
+ * the one it starts from and the ones followed by an index node of
+ * another part.
  */
-static int bg_raise_ilevel(inode_t *iprev, inode_t *iprev_tall,
-                           int height, ptst_t *ptst)
+static int bg_raise_ilevel(bg_part_t *p, int height, ptst_t *ptst)
 {
         int raised = 0;
-        inode_t *index, *inext, *inew, *above, *above_prev;
-
-        above = above_prev = iprev_tall;
+        inode_t *iprev = p->inodes[height - 1];
+        inode_t *above_prev = p->inodes[height];
+        inode_t *keep = (NULL == p->next) ? NULL : p->next[height - 1];
+        inode_t *index, *inext;
 
         assert(NULL != iprev);
-        assert(NULL != iprev_tall);
+        assert(NULL != above_prev);
 
         index = iprev->right;
 
-        while ((NULL != index) && (NULL != (inext = index->right))) {
-                while (index->node->val == index->node) {
-                        /* skip deleted nodes */
-                        iprev->right = inext;
-                        if (NULL == inext)
-                                break;
-
+        while (NULL != index && bg_before_end(p, index->node->key)) {
+                inext = index->right;
+                if (index->node->key < p->lo) {
+                        /* maintained by the previous part */
+                        iprev = index;
                         index = inext;
-                        inext = inext->right;
+                        continue;
+                }
+                if (index->node->val == index->node && index != keep &&
+                    bg_owns(p, inext)) {
+                        /* skip deleted nodes */
+                        if (CAS(&iprev->right, index, inext))
+                                index = inext;
+                        else
+                                index = iprev->right;
+                        continue;
                 }
                 if (NULL == inext)
                         break;
@@ -338,18 +891,8 @@ static int bg_raise_ilevel(inode_t *iprev, inode_t *iprev_tall,
 
                         raised = 1;
 
-                        /* get the correct index above and behind */
-                        while (above && above->node->key < index->node->key) {
-                                above = above->right;
-                                if (above != iprev_tall->right)
-                                        above_prev = above_prev->right;
-                        }
-
-                        inew = inode_new(above_prev->right, index,
-                                         index->node, ptst);
-                        above_prev->right = inew;
+                        bg_link(&above_prev, index->node, index, ptst);
                         index->node->level = height + 1;
-                        above_prev = above = iprev_tall = inew;
                 }
                 iprev = index;
                 index = inext;
@@ -400,11 +943,31 @@ void bg_init(set_t *s)
         bg_stats.raises = 0;
         bg_stats.lowers = 0;
         bg_stats.delete_succeeds = 0;
+        bg_stats.copies = 0;
+
+        bg_prev_size = 0;
+
+        bg_replicating = 0;
+        bg_version = 0;
+}
+
+/**
+ * bg_set_helpers - set the number of threads maintaining the skip list
+ * @nb_helpers: the number of threads, including the background thread
+ *
+ * Note: the skip list is split into one part per thread at each
+ * traversal. Takes effect at the next bg_start().
+ */
+void bg_set_helpers(int nb_helpers)
+{
+        assert(nb_helpers >= 1 && nb_helpers <= MAX_HELPERS);
+
+        bg_nb_helpers = nb_helpers;
 }
 
 /**
  * bg_start - start the background thread
- * @sleep_time: the time to sleep the bg thread per iteration
+ * @sleep_time: the longest time to sleep the bg thread per iteration
  *
  * Note: Only starts the background thread if it is not currently
  * running.
@@ -415,36 +978,117 @@ void bg_start(int sleep_time)
                 bg_running = 1;
                 bg_finished = 0;
                 bg_sleep_time = sleep_time;
+
+                /* the scheduling statistics are those of the last run */
+                bg_sched.sleep = sleep_time;
+                bg_sched.hurries = 0;
+                bg_sched.holds = 0;
+                bg_sched.relaxes = 0;
+                bg_sched.wakeups = 0;
+                bg_sched.rate = 0;
+                bg_sched.gap = 0;
+                bg_sched.max_run = 0;
+                bg_sched.max_chain = 0;
+                bg_wake = 0;
+                gettimeofday(&bg_prev_time, NULL);
                 pthread_create(&bg_thread, NULL, bg_loop, NULL);
         }
 }
 
+/**
+ * bg_replicate - replicate the index on several NUMA nodes
+ * @nb_replicas: the number of replicas, including the index itself
+ * @cpus: for each replica, the CPU of its helper thread (-1 if unpinned)
+ *
+ * Note: must be called after bg_start(), the helper threads use the
+ * same sleep time and are stopped by bg_stop(). Returns once every
+ * replica has been built.
+ */
+void bg_replicate(int nb_replicas, int *cpus)
+{
+        int r;
+
+        assert(bg_running && !bg_replicating);
+        assert(nb_replicas <= MAX_REPLICAS);
+
+        if (nb_replicas <= 1)
+                return;
+
+        bg_replicating = 1;
+        for (r = 1; r < nb_replicas; r++) {
+                bg_replica_cpus[r] = cpus[r];
+                if (pthread_create(&bg_replica_threads[r], NULL,
+                                   bg_replica_loop, (void *)(long)r) != 0) {
+                        perror("Failed to create a replica thread\n");
+                        exit(1);
+                }
+        }
+        for (r = 1; r < nb_replicas; r++) {
+                while (NULL == set->replicas[r])
+                        AO_nop_full();
+        }
+        set->nb_replicas = nb_replicas;
+}
+
 /**
  * bg_stop - stop the background thread
+ *
+ * Note: this also stops the helper threads of the replicas, which
+ * remain searchable until the set is deleted.
  */
 void bg_stop(void)
 {
+        int r;
+
         if (bg_running) {
                 bg_finished = 1;
                 pthread_join(bg_thread, NULL);
+                if (bg_replicating) {
+                        for (r = 1; r < set->nb_replicas; r++)
+                                pthread_join(bg_replica_threads[r], NULL);
+                        bg_replicating = 0;
+                }
                 BARRIER();
                 bg_running = 0;
         }
 }
 
+/**
+ * bg_wakeup - end the current sleep of the background thread
+ *
+ * Note: called by worker threads that find the index lagging behind.
+ */
+void bg_wakeup(void)
+{
+        if (!bg_wake)
+                bg_wake = 1;
+}
+
 /**
  * bg_print_stats - print background statistics
  *
- * Note: this is a noop if BG_STATS is not defined.
+ * Note: only the scheduling decisions are printed if BG_STATS is not
+ * defined.
  */
 void bg_print_stats(void)
 {
+        printf("Sleep = %i us (at most %i)\n", bg_sched.sleep, bg_sleep_time);
+        printf("Hurries = %lu\n", bg_sched.hurries);
+        printf("Holds = %lu\n", bg_sched.holds);
+        printf("Relaxes = %lu\n", bg_sched.relaxes);
+        printf("Wakeups = %lu\n", bg_sched.wakeups);
+        printf("Update Rate = %lu /s\n", bg_sched.rate);
+        printf("Level Gap = %i\n", bg_sched.gap);
+        printf("Max Short Run = %i\n", bg_sched.max_run);
+        printf("Max Deleted Chain = %i\n", bg_sched.max_chain);
+
         #ifdef BG_STATS
         printf("Loops = %i\n", bg_stats.loops);
         printf("Raises = %i\n", bg_stats.raises);
         printf("Levels = %i\n", set->head->level);
         printf("Lowers = %i\n", bg_stats.lowers);
         printf("Delete Succeeds = %i\n", bg_stats.delete_succeeds);
+        printf("Replica Copies = %i\n", bg_stats.copies);
         #endif
 }
 
@@ -464,10 +1108,7 @@ void bg_print_stats(void)
 void bg_help_remove(node_t *prev, node_t *node, ptst_t *ptst)
 {
         node_t *n, *new;
-
-        #ifdef BG_STATS 
         int retval;
-        #endif
 
         assert(NULL != prev);
         assert(NULL != node);
@@ -491,18 +1132,18 @@ void bg_help_remove(node_t *prev, node_t *node, ptst_t *ptst)
                 return;
 
         /* remove the nodes */
-        #ifdef BG_STATS
         retval = CAS(&prev->next, node, n->next);
-        #else
-        CAS(&prev->next, node, n->next);
-        #endif
 
         assert (prev->next != prev);
 
-        #ifdef BG_STATS
-        if (retval)
+        if (retval) {
+                /* the node and its marker are not freed */
+                ma_retire(2 * sizeof(node_t));
+
+                #ifdef BG_STATS
                 ++bg_stats.delete_succeeds;
-        #endif
+                #endif
+        }
 }
 
 /**
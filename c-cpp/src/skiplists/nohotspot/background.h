@@ -9,9 +9,18 @@
 #include "skiplist.h"
 #include "ptst.h"
 
+/* threads maintaining the skip list in parallel, at most */
+#define MAX_HELPERS 64
+
+/* nodes a worker walks at the node level before waking the bg thread up */
+#define BG_WAKE_STEPS 32
+
 void bg_init(set_t *s);
+void bg_set_helpers(int nb_helpers);
 void bg_start(int sleep_time);
+void bg_replicate(int nb_replicas, int *cpus);
 void bg_stop(void);
+void bg_wakeup(void);
 void bg_print_stats(void);
 void bg_remove(node_t *prev, node_t *node, ptst_t *ptst);
 void bg_help_remove(node_t *prev, node_t *node, ptst_t *ptst);
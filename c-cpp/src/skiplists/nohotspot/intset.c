@@ -41,3 +41,30 @@ int sl_remove_old(set_t *set, unsigned int key, int transactional)
 {
 	return sl_delete(set, (key_t) key);
 }
+
+int sl_contains_batch_old(set_t *set, unsigned int *keys, int n, int *results,
+                          int transactional)
+{
+        sl_key_t k[BATCH_MAX];
+        int i;
+
+        for (i = 0; i < n; i++)
+                k[i] = (sl_key_t) keys[i];
+        return sl_contains_batch(set, k, n, results);
+}
+
+int sl_range_collect_old(set_t *set, unsigned int lo, unsigned int hi,
+                         sl_key_t *keys, int max)
+{
+        return sl_range_collect(set, (sl_key_t) lo, (sl_key_t) hi, keys, max);
+}
+
+int sl_range_count_old(set_t *set, unsigned int lo, unsigned int hi)
+{
+        return sl_range_count(set, (sl_key_t) lo, (sl_key_t) hi);
+}
+
+int sl_successor_old(set_t *set, unsigned int key, sl_key_t *succ)
+{
+        return sl_successor(set, (sl_key_t) key, succ);
+}
@@ -25,9 +25,17 @@
 #define INTSET_T_
 
 #include "skiplist.h"
+#include "batch.h"
 
 int sl_contains_old(set_t *set, unsigned int key, int transactional);
 int sl_add_old(set_t *set, unsigned int key, int transactional);
 int sl_remove_old(set_t *set, unsigned int key, int transactional);
+int sl_range_collect_old(set_t *set, unsigned int lo, unsigned int hi,
+                         sl_key_t *keys, int max);
+int sl_range_count_old(set_t *set, unsigned int lo, unsigned int hi);
+int sl_successor_old(set_t *set, unsigned int key, sl_key_t *succ);
+/* Looks up keys[0..n) (n <= BATCH_MAX), see batch.h */
+int sl_contains_batch_old(set_t *set, unsigned int *keys, int n, int *results,
+                          int transactional);
 
 #endif /* INTSET_H_ */
@@ -60,6 +60,7 @@ finished.
 #include "background.h"
 #include "garbagecoll.h"
 #include "ptst.h"
+#include "batch.h"
 
 /* - Private Functions - */
 
@@ -201,7 +202,7 @@ int sl_do_operation(set_t *set, sl_optype_t optype, sl_key_t key, val_t val)
         inode_t *item = NULL, *next_item = NULL;
         node_t *node = NULL, *next = NULL;
         val_t node_val = NULL, *next_val = NULL;
-        int result = 0;
+        int result = 0, steps = 0;
         ptst_t *ptst;
 
         assert(NULL != set);
@@ -211,7 +212,7 @@ int sl_do_operation(set_t *set, sl_optype_t optype, sl_key_t key, val_t val)
 #endif
 
         /* find an entry-point to the node-level */
-        item = set->top;
+        item = SET_TOP(set);
         while (1) {
                 next_item = item->right;
                 if (NULL == next_item || next_item->node->key > key) {
@@ -221,7 +222,9 @@ int sl_do_operation(set_t *set, sl_optype_t optype, sl_key_t key, val_t val)
                                 break;
                         }
                 } else if (next_item->node->key == key) {
-                        node = item->node;
+                        /* start from the node itself, not a node of item's
+                         * level that can be far behind */
+                        node = next_item->node;
                         break;
                 }
                 item = next_item;
@@ -254,6 +257,9 @@ int sl_do_operation(set_t *set, sl_optype_t optype, sl_key_t key, val_t val)
                         continue;
                 }
                 node = next;
+                /* the index lags behind, no need to wait for the bg thread */
+                if (BG_WAKE_STEPS == ++steps)
+                        bg_wakeup();
         }
 
 #ifdef USE_GC
@@ -262,3 +268,243 @@ int sl_do_operation(set_t *set, sl_optype_t optype, sl_key_t key, val_t val)
 
         return result;
 }
+
+/* Steps of a lookup of sl_contains_batch() */
+enum sl_batch_phase {
+        BATCH_RIGHT,    /* read the right index item of item */
+        BATCH_RNODE,    /* read the node of the right item */
+        BATCH_RKEY,     /* compare the key of the right node */
+        BATCH_NODE,     /* examine node, skipping removed nodes */
+        BATCH_NEXT      /* examine the successor of node */
+};
+
+typedef struct sl_batch {
+        int idx;
+        enum sl_batch_phase phase;
+        inode_t *item, *right;
+        node_t *node, *next;
+        val_t node_val;
+} sl_batch_t;
+
+static void sl_batch_start(sl_batch_t *b, set_t *set, int idx)
+{
+        b->idx = idx;
+        b->phase = BATCH_RIGHT;
+        b->item = SET_TOP(set);
+        batch_prefetch(b->item);
+}
+
+static void sl_batch_down(sl_batch_t *b)
+{
+        inode_t *down = b->item->down;
+
+        if (NULL == down) {
+                b->node = b->item->node;
+                b->phase = BATCH_NODE;
+                batch_prefetch(b->node);
+        } else {
+                b->item = down;
+                b->phase = BATCH_RIGHT;
+                batch_prefetch(down);
+        }
+}
+
+/**
+ * sl_contains_batch - looks up several keys at once
+ * @set: the skip list set
+ * @keys: the search keys
+ * @n: the number of keys
+ * @results: the result of the contains operation for each key
+ *
+ * Runs the traversals of sl_do_operation() for BATCH_WINDOW keys at a
+ * time, each step of a traversal prefetching the node read by the next
+ * one (see batch.h). Returns the number of keys present.
+ */
+int sl_contains_batch(set_t *set, sl_key_t *keys, int n, int *results)
+{
+        sl_batch_t batch[BATCH_WINDOW], *b;
+        sl_key_t key;
+        int i, issued = 0, active = 0, found = 0;
+        ptst_t *ptst = NULL;
+
+        assert(NULL != set);
+
+#ifdef USE_GC
+        ptst = ptst_critical_enter();
+#endif
+
+        for (i = 0; i < BATCH_WINDOW; i++) {
+                if (issued < n) {
+                        sl_batch_start(&batch[i], set, issued++);
+                        active++;
+                } else {
+                        batch[i].idx = -1;
+                }
+        }
+        while (active > 0) {
+                for (i = 0; i < BATCH_WINDOW; i++) {
+                        b = &batch[i];
+                        if (b->idx < 0)
+                                continue;
+                        key = keys[b->idx];
+                        switch (b->phase) {
+                        case BATCH_RIGHT:
+                                b->right = b->item->right;
+                                if (NULL == b->right) {
+                                        sl_batch_down(b);
+                                } else {
+                                        b->phase = BATCH_RNODE;
+                                        batch_prefetch(b->right);
+                                }
+                                continue;
+                        case BATCH_RNODE:
+                                b->next = b->right->node;
+                                b->phase = BATCH_RKEY;
+                                batch_prefetch(b->next);
+                                continue;
+                        case BATCH_RKEY:
+                                if (b->next->key > key) {
+                                        sl_batch_down(b);
+                                } else if (b->next->key == key) {
+                                        b->node = b->next;
+                                        b->phase = BATCH_NODE;
+                                        batch_prefetch(b->node);
+                                } else {
+                                        b->item = b->right;
+                                        b->phase = BATCH_RIGHT;
+                                }
+                                continue;
+                        case BATCH_NODE:
+                                if (b->node == (b->node_val = b->node->val)) {
+                                        b->node = b->node->prev;
+                                        batch_prefetch(b->node);
+                                        continue;
+                                }
+                                b->next = b->node->next;
+                                if (NULL != b->next) {
+                                        b->phase = BATCH_NEXT;
+                                        batch_prefetch(b->next);
+                                        continue;
+                                }
+                                break;
+                        case BATCH_NEXT:
+                                if ((node_t *)b->next->val == b->next) {
+                                        bg_help_remove(b->node, b->next, ptst);
+                                        b->phase = BATCH_NODE;
+                                        continue;
+                                }
+                                if (b->next->key <= key) {
+                                        b->node = b->next;
+                                        b->phase = BATCH_NODE;
+                                        continue;
+                                }
+                                break;
+                        }
+                        /* node is the last node whose key is not above key */
+                        results[b->idx] = sl_finish_contains(key, b->node,
+                                                             b->node_val, ptst);
+                        found += results[b->idx];
+                        if (issued < n) {
+                                sl_batch_start(b, set, issued++);
+                        } else {
+                                b->idx = -1;
+                                active--;
+                        }
+                }
+        }
+
+#ifdef USE_GC
+        ptst_critical_exit(ptst);
+#endif
+
+        return found;
+}
+
+/**
+ * sl_range_collect - collects the keys of a range
+ * @set: the skip list set
+ * @lo: the lowest key of the range
+ * @hi: the highest key of the range
+ * @keys: where to store the keys (can be NULL)
+ * @max: the largest number of keys to store in @keys
+ *
+ * Walks the node level from the last node below @lo found through the
+ * index, reporting the nodes whose value is neither NULL (logically
+ * deleted) nor the node itself (removed or marker). The scan is weakly
+ * consistent (see scan.h): removed nodes keep their next pointer, so a
+ * node present during the whole scan is always reached.
+ *
+ * Returns the number of keys in the range, or the number of keys
+ * stored if @keys is not NULL.
+ */
+int sl_range_collect(set_t *set, sl_key_t lo, sl_key_t hi, sl_key_t *keys,
+                     int max)
+{
+        inode_t *item, *next_item;
+        node_t *node;
+        val_t node_val;
+        int count = 0;
+        ptst_t *ptst;
+
+        assert(NULL != set);
+
+        if (NULL != keys && max <= 0)
+                return 0;
+
+#ifdef USE_GC
+        ptst = ptst_critical_enter();
+#endif
+
+        item = SET_TOP(set);
+        while (1) {
+                next_item = item->right;
+                if (NULL == next_item || next_item->node->key >= lo) {
+                        next_item = item->down;
+                        if (NULL == next_item) {
+                                node = item->node;
+                                break;
+                        }
+                }
+                item = next_item;
+        }
+        while (node == node->val)
+                node = node->prev;
+
+        for (; NULL != node; node = node->next) {
+                node_val = node->val;
+                if (NULL == node_val || node == node_val)
+                        continue;
+                if (node->key > hi)
+                        break;
+                if (node->key < lo)
+                        continue;
+                if (NULL != keys) {
+                        keys[count] = node->key;
+                        if (++count == max)
+                                break;
+                } else {
+                        ++count;
+                }
+        }
+
+#ifdef USE_GC
+        ptst_critical_exit(ptst);
+#endif
+
+        return count;
+}
+
+/**
+ * sl_successor - finds the smallest key above a key
+ * @set: the skip list set
+ * @key: the search key
+ * @succ: where to store the successor of @key
+ *
+ * Returns 1 if @key has a successor and 0 otherwise.
+ */
+int sl_successor(set_t *set, sl_key_t key, sl_key_t *succ)
+{
+        if (key == ~0UL)
+                return 0;
+        return sl_range_collect(set, key + 1, ~0UL, succ, 1);
+}
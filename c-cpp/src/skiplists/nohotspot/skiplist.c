@@ -32,6 +32,10 @@ to implement this way.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "common.h"
 #include "skiplist.h"
@@ -41,6 +45,8 @@ to implement this way.
 
 static int gc_id[NUM_LEVELS];
 
+__thread int sl_replica = 0;
+
 /* - Public skiplist interface - */
 
 /**
@@ -123,6 +129,7 @@ void inode_delete(inode_t *inode, ptst_t *ptst)
 set_t* set_new(int start)
 {
         set_t *set;
+        int i;
 
         set = malloc(sizeof(set_t));
         if (!set) {
@@ -145,6 +152,10 @@ set_t* set_new(int start)
 
         set->raises = 0;
 
+        for (i = 0; i < MAX_REPLICAS; i++)
+                set->replicas[i] = NULL;
+        set->nb_replicas = 1;
+
         bg_init(set);
         if (start)
                 bg_start(0);
@@ -226,6 +237,26 @@ int set_size(set_t *set, int flag)
         return size;
 }
 
+/**
+ * set_join_replica - select the index replica of the calling thread
+ * @set: the set the calling thread is going to access
+ *
+ * Note: the thread searches the replica of the NUMA node it runs on,
+ * it should be called again if the thread moves to another node.
+ * Replica 0 is the index maintained by the background thread.
+ */
+void set_join_replica(set_t *set)
+{
+        unsigned int cpu = 0, node = 0;
+
+        sl_replica = 0;
+#ifdef __linux__
+        if (set->nb_replicas > 1 &&
+            0 == syscall(SYS_getcpu, &cpu, &node, NULL))
+                sl_replica = node % set->nb_replicas;
+#endif
+}
+
 /**
  * set_subsystem_init - initialise the set subsystem
  */
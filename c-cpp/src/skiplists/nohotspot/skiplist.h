@@ -15,6 +15,9 @@
 
 #define MAX_LEVELS 128
 
+/* one index replica per NUMA node at most */
+#define MAX_REPLICAS 64
+
 #define NUM_LEVELS 2
 #define NODE_LEVEL 0
 #define INODE_LEVEL 1
@@ -47,8 +50,16 @@ struct sl_set {
         inode_t *top;
         node_t  *head;
         int raises;
+        /* copies of the index for the other NUMA nodes, see bg_replicate() */
+        inode_t *replicas[MAX_REPLICAS];
+        int nb_replicas;
 };
 
+/* the index replica searched by the calling thread, see set_join_replica() */
+extern __thread int sl_replica;
+
+#define SET_TOP(_s) (0 == sl_replica ? (_s)->top : (_s)->replicas[sl_replica])
+
 node_t* node_new(sl_key_t key, val_t val, node_t *prev, node_t *next,
                  unsigned int level, ptst_t *ptst);
 
@@ -61,6 +72,7 @@ set_t* set_new(int bg_start);
 void set_delete(set_t *set);
 void set_print(set_t *set, int flag);
 int set_size(set_t *set, int flag);
+void set_join_replica(set_t *set);
 
 void set_subsystem_init(void);
 
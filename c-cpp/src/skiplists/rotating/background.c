@@ -41,6 +41,24 @@ the number of index nodes at level i is approx n*(2^-i)
 enforced deterministically, rather than probabilistically as is
 common with other multi-threaded skip list implementations.
 
+The sleep time given to bg_start() is only an upper bound: after each
+traversal, bg_schedule() halves the sleep time if the index lags behind
+the node level (too few index levels for the number of nodes, or long
+runs of nodes without index items or long chains of deleted nodes on
+average), keeps it if many nodes were updated since the previous
+traversal, and doubles it otherwise. Worker threads that walk too many
+nodes at the node level wake the background thread up (bg_wakeup())
+rather than waiting for the sleep to end.
+
+On large skip lists the traversal can be shared by several helper
+threads (bg_set_helpers()). Each traversal splits the keys into one
+range per helper, at evenly spaced index nodes, and each helper
+removes, raises and unlinks the nodes of its own range. Index nodes
+are linked with CAS, as the helpers of two neighbouring ranges can
+link index nodes after the same index node. Once all the helpers are
+done, the background thread raises the index nodes of the sparse upper
+levels and adds or removes index levels.
+
 */
 
 #include <stdlib.h>
@@ -48,6 +66,7 @@ common with other multi-threaded skip list implementations.
 #include <pthread.h>
 #include <assert.h>
 #include <stdio.h>
+#include <sys/time.h>
 
 #include "common.h"
 #include "background.h"
@@ -69,6 +88,7 @@ static struct sl_background_stats {
         unsigned long delete_attempts;
         unsigned long delete_succeeds;
         unsigned long should_delete;
+        unsigned long grows;
 } bg_stats;
 
 /* to keep track of background state */
@@ -80,24 +100,73 @@ static int bg_non_deleted;
 static int bg_deleted;
 static int bg_tall_deleted;
 
-static int bg_sleep_time;
+static int bg_sleep_time;      /* longest sleep time (us) */
 static int bg_counter;
 static int bg_go;
 
 int bg_should_delete;
 
+/* adaptive scheduling of the bg thread, see bg_schedule() */
+#define BG_MIN_SLEEP    100     /* shortest sleep time (us) */
+#define BG_SLICE        10000   /* longest uninterrupted sleep (us) */
+#define BG_MAX_RUN      4       /* mean run of short nodes tolerated */
+#define BG_MAX_CHAIN    4       /* mean chain of deleted nodes tolerated */
+#define BG_CHANGE_RATIO 16      /* 1/16 of the nodes updated is a burst */
+
+static struct bg_sched {
+        int sleep;              /* current sleep time (us) */
+        unsigned long hurries;  /* traversals followed by a shorter sleep */
+        unsigned long holds;    /* traversals followed by the same sleep */
+        unsigned long relaxes;  /* traversals followed by a longer sleep */
+        unsigned long wakeups;  /* sleeps interrupted by a worker */
+        unsigned long rate;     /* updates per second, last traversal */
+        int gap;                /* missing index levels, last traversal */
+        int max_run;            /* longest run of short nodes seen */
+        int max_chain;          /* longest chain of deleted nodes seen */
+} bg_sched;
+
+VOLATILE static int bg_wake;    /* set by workers, see bg_wakeup() */
+static int bg_run;              /* longest run of short nodes */
+static int bg_chain;            /* longest chain of deleted nodes */
+static int bg_short, bg_runs;   /* short nodes and runs of short nodes */
+static int bg_chains;           /* chains of deleted nodes */
+static int bg_prev_size;        /* non-deleted nodes at the last traversal */
+static struct timeval bg_prev_time;
+
+/* parallel maintenance, see bg_partition() */
+#define BG_SPLIT        16      /* index nodes per part to split a level */
+
+typedef struct bg_part bg_part_t;
+static struct bg_part {
+        unsigned long lo, hi;           /* the keys of the part, [lo, hi) */
+        node_t *preds[MAX_LEVELS];      /* last index node before lo */
+        node_t **next;                  /* preds of the next part or NULL */
+        int raised;                     /* raised a node to the top level */
+        /* measures of the traversal, merged by bg_loop() */
+        int non_deleted, tall_deleted, deleted;
+        int run, chain, nshort, runs, chains;
+        pthread_t thread;
+} bg_parts[MAX_HELPERS];
+
+static int bg_nb_helpers = 1;
+static int bg_split;                    /* level the parts are split at */
+static pthread_barrier_t bg_round_start, bg_round_end;
+static VOLATILE int bg_helpers_stop;     /* set by bg_loop() only */
+
 /* - Private Functions - */
 
 static void* bg_loop(void *args);
-static int bg_trav_nodes(ptst_t *ptst);
+static void bg_sleep(void);
+static void bg_schedule(void);
+static void* bg_helper_loop(void *args);
+static void bg_partition(int height, unsigned long zero);
+static void bg_maintain(bg_part_t *p, int height, ptst_t *ptst);
+static void bg_merge(void);
+static int bg_trav_nodes(bg_part_t *p, ptst_t *ptst);
 static void bg_lower_ilevel(ptst_t *ptst);
-static int bg_raise_ilevel(int height, ptst_t *ptst);
-static void get_index_above(node_t *head,
-                            node_t **prev,
-                            node_t **node,
-                            unsigned long i,
-                            unsigned long key,
-                            unsigned long zero);
+static int bg_raise_ilevel(bg_part_t *p, int height, ptst_t *ptst);
+static void bg_link(node_t **iprev, node_t *node, unsigned long i,
+                    unsigned long zero);
 
 /**
  * bg_loop - loop for maintaining index levels
@@ -111,7 +180,7 @@ static void* bg_loop(void *args)
         node_t  *head  = set->head;
         int raised = 0; /* keep track of if we raised index level */
         int threshold;  /* for testing if we should lower index level */
-        unsigned long i;
+        int height, i;
         ptst_t *ptst = NULL;
         unsigned long zero;
 
@@ -127,33 +196,63 @@ static void* bg_loop(void *args)
         bg_stats.lowers = 0;
         bg_stats.delete_attempts = 0;
         bg_stats.delete_succeeds = 0;
+        bg_stats.grows = 0;
         #endif
 
+        /* start the helper threads, each maintaining its own part */
+        if (bg_nb_helpers > 1) {
+                bg_helpers_stop = 0;
+                pthread_barrier_init(&bg_round_start, NULL, bg_nb_helpers);
+                pthread_barrier_init(&bg_round_end, NULL, bg_nb_helpers);
+                for (i = 1; i < bg_nb_helpers; i++) {
+                        if (pthread_create(&bg_parts[i].thread, NULL,
+                                           bg_helper_loop, &bg_parts[i])) {
+                                perror("Failed to create a helper thread\n");
+                                exit(1);
+                        }
+                }
+        }
+
         while (1) {
 
-                usleep(bg_sleep_time);
+                bg_sleep();
 
                 if (bg_finished)
                         break;
 
                 zero = sl_zero;
+                height = head->level;
 
                 #ifdef BG_STATS
                 ++(bg_stats.loops);
                 #endif
 
-                bg_non_deleted = 0;
-                bg_deleted = 0;
-                bg_tall_deleted = 0;
-
-                // traverse the node level and try deletes/raises
-                raised = bg_trav_nodes(ptst);
-
-                if (raised && (1 == head->level)) {
+                /* traverse the node level and try deletes/raises, then
+                 * raise the index level nodes, one part per helper */
+                bg_partition(height, zero);
+                if (bg_nb_helpers > 1)
+                        pthread_barrier_wait(&bg_round_start);
+                bg_maintain(&bg_parts[0], height, ptst);
+                if (bg_nb_helpers > 1)
+                        pthread_barrier_wait(&bg_round_end);
+                bg_merge();
+
+                raised = 0;
+                for (i = 0; i < bg_nb_helpers; i++)
+                        raised |= bg_parts[i].raised;
+
+                /* raise the index nodes of the split level and above over
+                 * the whole skip list, the parts of these sparse levels
+                 * would be too short */
+                bg_parts[0].next = NULL;
+                for (i = bg_split; (i+1) < height; i++)
+                        raised = bg_raise_ilevel(&bg_parts[0], i + 1, ptst);
+
+                if (raised && head->level < MAX_LEVELS) {
                         // add a new index level
 
                         // nullify BEFORE we increase the level
-                        head->succs[IDX(head->level, zero)] = NULL;
+                        SUCC(head, head->level, zero) = NULL;
                         BARRIER();
                         ++head->level;
 
@@ -162,26 +261,6 @@ static void* bg_loop(void *args)
                         #endif
                 }
 
-                // raise the index level nodes
-                for (i = 0; (i+1) < set->head->level; i++) {
-                        assert(i < MAX_LEVELS);
-                        raised = bg_raise_ilevel(i + 1, ptst);
-
-                        if ((((i+1) == (head->level-1)) && raised)
-                                        && head->level < MAX_LEVELS) {
-                                // add a new index level
-
-                                // nullify BEFORE we increase the level
-                                head->succs[IDX(head->level,zero)] = NULL;
-                                BARRIER();
-                                ++head->level;
-
-                                #ifdef BG_STATS
-                                ++(bg_stats.raises);
-                                #endif
-                        }
-                }
-
                 // if needed, remove the lowest index level
                 threshold = bg_non_deleted * 10;
                 if (bg_tall_deleted > threshold) {
@@ -202,47 +281,338 @@ static void* bg_loop(void *args)
                         bg_should_delete = 0;
                 }
                 BARRIER();
+
+                bg_schedule();
+        }
+
+        /* end the helper threads, which cannot read bg_finished as it
+         * may be set during a round */
+        if (bg_nb_helpers > 1) {
+                bg_helpers_stop = 1;
+                pthread_barrier_wait(&bg_round_start);
+                for (i = 1; i < bg_nb_helpers; i++)
+                        pthread_join(bg_parts[i].thread, NULL);
+                pthread_barrier_destroy(&bg_round_start);
+                pthread_barrier_destroy(&bg_round_end);
+        }
+
+        return NULL;
+}
+
+/**
+ * bg_helper_loop - loop of a helper maintaining a part of the skip list
+ * @args: the part to maintain, as per pthread_create requirements
+ *
+ * Returns a void* value as per pthread_create requirements.
+ * Note: the rounds of the helpers are started and ended by bg_loop(),
+ * which splits the skip list into parts in between.
+ */
+static void* bg_helper_loop(void *args)
+{
+        bg_part_t *p = (bg_part_t *)args;
+
+        while (1) {
+                pthread_barrier_wait(&bg_round_start);
+                if (bg_helpers_stop)
+                        break;
+
+                bg_maintain(p, set->head->level, NULL);
+
+                pthread_barrier_wait(&bg_round_end);
         }
 
         return NULL;
 }
 
+/**
+ * bg_partition - split the skip list into one part per helper
+ * @height: the number of levels of the head
+ * @zero: the index of the lowest index level
+ *
+ * Note: the boundaries are the keys of evenly spaced index nodes of the
+ * highest index level that has BG_SPLIT index nodes per helper, the
+ * lowest index level otherwise. Each part starts from the last index
+ * node before its lowest key at each level, which is found by a search.
+ * The parts raise index nodes from the levels below this one, bg_loop()
+ * raises them from this level and the sparser levels above.
+ */
+static void bg_partition(int height, unsigned long zero)
+{
+        node_t *head = set->head;
+        node_t *node;
+        bg_part_t *p;
+        int n = 0, i, j, k, l;
+
+        for (l = 0; l < height; l++)
+                bg_parts[0].preds[l] = head;
+        bg_parts[0].lo = 0;
+        bg_parts[0].next = NULL;
+        bg_split = height;
+        if (1 == bg_nb_helpers)
+                return;
+
+        /* find the highest index level with enough index nodes */
+        for (l = height - 1; l >= 0; l--) {
+                n = 0;
+                for (node = SUCC(head, l, zero); NULL != node;
+                     node = SUCC(node, l, zero))
+                        ++n;
+                if (n >= BG_SPLIT * bg_nb_helpers)
+                        break;
+        }
+        if (l < 0)
+                l = 0;
+        bg_split = l;
+
+        /* the lowest key of each part, parts without keys are empty */
+        node = SUCC(head, l, zero);
+        for (j = 0, k = 1; k < bg_nb_helpers; k++) {
+                for (; NULL != node && j < k * n / bg_nb_helpers; j++)
+                        node = SUCC(node, l, zero);
+                bg_parts[k].lo = (NULL == node) ? ~0UL : node->key;
+        }
+
+        for (k = 1; k < bg_nb_helpers; k++) {
+                p = &bg_parts[k];
+                node = head;
+                for (i = height - 1; i >= 0; i--) {
+                        while (NULL != SUCC(node, i, zero) &&
+                               SUCC(node, i, zero)->key < p->lo)
+                                node = SUCC(node, i, zero);
+                        p->preds[i] = node;
+                }
+                bg_parts[k - 1].hi = p->lo;
+                bg_parts[k - 1].next = p->preds;
+                p->next = NULL;
+        }
+}
+
+/**
+ * bg_maintain - maintain a part of the skip list
+ * @p: the part to maintain
+ * @height: the number of levels of the head at the start of the round
+ * @ptst: per-thread state
+ */
+static void bg_maintain(bg_part_t *p, int height, ptst_t *ptst)
+{
+        int raised, i;
+
+        p->non_deleted = 0;
+        p->tall_deleted = 0;
+        p->deleted = 0;
+        p->run = 0;
+        p->chain = 0;
+        p->nshort = 0;
+        p->runs = 0;
+        p->chains = 0;
+
+        // traverse the node level and try deletes/raises
+        raised = bg_trav_nodes(p, ptst);
+
+        // raise the index level nodes
+        for (i = 0; (i+1) < height && i < bg_split; i++) {
+                assert(i < MAX_LEVELS);
+                raised = bg_raise_ilevel(p, i + 1, ptst);
+        }
+
+        /* the top level got a new index node */
+        p->raised = raised;
+}
+
+/**
+ * bg_merge - merge the measures of the traversals of the parts
+ */
+static void bg_merge(void)
+{
+        bg_part_t *p;
+        int i;
+
+        bg_non_deleted = 0;
+        bg_deleted = 0;
+        bg_tall_deleted = 0;
+        bg_run = 0;
+        bg_chain = 0;
+        bg_short = 0;
+        bg_runs = 0;
+        bg_chains = 0;
+        for (i = 0; i < bg_nb_helpers; i++) {
+                p = &bg_parts[i];
+                bg_non_deleted += p->non_deleted;
+                bg_deleted += p->deleted;
+                bg_tall_deleted += p->tall_deleted;
+                if (p->run > bg_run)
+                        bg_run = p->run;
+                if (p->chain > bg_chain)
+                        bg_chain = p->chain;
+                bg_short += p->nshort;
+                bg_runs += p->runs;
+                bg_chains += p->chains;
+        }
+}
+
+/**
+ * bg_sleep - sleep between two traversals
+ *
+ * Note: the sleep is cut into slices of at most BG_SLICE so that the
+ * thread notices bg_wakeup() and bg_stop() calls.
+ */
+static void bg_sleep(void)
+{
+        int left = bg_sched.sleep;
+
+        if (0 == left)
+                usleep(0);
+        while (left > 0 && !bg_finished && !bg_wake) {
+                usleep(left < BG_SLICE ? left : BG_SLICE);
+                left -= BG_SLICE;
+        }
+        if (bg_wake) {
+                bg_wake = 0;
+                ++bg_sched.wakeups;
+        }
+}
+
+/**
+ * bg_schedule - adapt the sleep time to the state of the skip list
+ *
+ * Note: called after each traversal, which measured the runs of short
+ * nodes, the chains of deleted nodes and the number of updates since
+ * the previous traversal.
+ */
+static void bg_schedule(void)
+{
+        struct timeval now;
+        unsigned long changes, elapsed;
+        int levels = 0, n;
+
+        gettimeofday(&now, NULL);
+        elapsed = (now.tv_sec - bg_prev_time.tv_sec) * 1000000UL +
+                  (now.tv_usec - bg_prev_time.tv_usec);
+        bg_prev_time = now;
+
+        /* nodes inserted or deleted since the previous traversal */
+        n = bg_non_deleted;
+        changes = bg_deleted +
+                  (n > bg_prev_size ? n - bg_prev_size : bg_prev_size - n);
+        bg_prev_size = n;
+        bg_sched.rate = (0 == elapsed) ? 0 : changes * 1000000UL / elapsed;
+
+        /* a balanced skip list has log2(n) index levels */
+        while (n > 1) {
+                n >>= 1;
+                ++levels;
+        }
+        bg_sched.gap = levels - (int)set->head->level;
+
+        if (bg_run > bg_sched.max_run)
+                bg_sched.max_run = bg_run;
+        if (bg_chain > bg_sched.max_chain)
+                bg_sched.max_chain = bg_chain;
+
+        if (bg_sched.gap >= 2 || bg_short > BG_MAX_RUN * bg_runs ||
+            bg_deleted > BG_MAX_CHAIN * bg_chains) {
+                /* the index lags behind */
+                bg_sched.sleep /= 2;
+                if (bg_sched.sleep < BG_MIN_SLEEP)
+                        bg_sched.sleep = BG_MIN_SLEEP;
+                ++bg_sched.hurries;
+        } else if (changes * BG_CHANGE_RATIO > (unsigned long)bg_non_deleted) {
+                /* the index keeps up but could soon lag behind */
+                ++bg_sched.holds;
+        } else {
+                bg_sched.sleep *= 2;
+                if (bg_sched.sleep < BG_MIN_SLEEP)
+                        bg_sched.sleep = BG_MIN_SLEEP;
+                ++bg_sched.relaxes;
+        }
+        if (bg_sched.sleep > bg_sleep_time)
+                bg_sched.sleep = bg_sleep_time;
+}
+
+/* Returns 1 if @key is not above the keys of part @p */
+static inline int bg_before_end(bg_part_t *p, unsigned long key)
+{
+        return NULL == p->next || key < p->hi;
+}
+
+/* Returns 1 if @node is in part @p, or NULL and @p the last part */
+static inline int bg_owns(bg_part_t *p, node_t *node)
+{
+        if (NULL == node)
+                return NULL == p->next;
+        return node->key >= p->lo && bg_before_end(p, node->key);
+}
+
+/*
+ * Returns 1 if @node can be raised above level @h by part @p. A larger
+ * wheel must not replace one the helper of the next part may link an
+ * index node in: those of the nodes from its start at level h - 1 on.
+ */
+static inline int bg_can_grow(bg_part_t *p, node_t *node, int h)
+{
+        if (h <= (int)node->wheel->mask || NULL == p->next)
+                return 1;
+        return node->key < p->next[h-1]->key;
+}
+
 /**
  * bg_trav_nodes - traverse node level of skip list
+ * @p: the part of the skip list to traverse
  * @ptst: per-thread state
  *
  * Returns 1 if a raise was done and 0 otherwise.
  *
  * Note: this tries to raise non-deleted nodes, and finished deletions that
- * have been started but not completed.
+ * have been started but not completed. It also measures the runs
+ * of consecutive short nodes and the chains of consecutive deleted nodes.
+ * Removals use CAS and can run in parallel at the boundaries of parts.
  */
-static int bg_trav_nodes(ptst_t *ptst)
+static int bg_trav_nodes(bg_part_t *p, ptst_t *ptst)
 {
         node_t *prev, *node, *next;
-        node_t *above_head = set->head, *above_prev, *above_next;
+        node_t *above_prev = p->preds[0];
         unsigned long zero = sl_zero;
-        int raised = 0;
+        int raised = 0, run = 0, chain = 0;
 
         assert(NULL != set && NULL != set->head);
 
         ptst = ptst_critical_enter();
 
-        above_prev = above_next = above_head;
-        prev = set->head;
+        prev = p->preds[0];
         node = prev->next;
-        if (NULL == node)
+        if (NULL == node) {
+                ptst_critical_exit(ptst);
                 return 0;
+        }
         next = node->next;
 
-        while (NULL != next) {
+        while (NULL != next && bg_before_end(p, node->key)) {
 
-                if (NULL == node->val) {
+                if (node->key < p->lo) {
+                        /* maintained by the previous part */
+                }
+                else if (NULL == node->val) {
                         bg_remove(prev, node, ptst);
                         if (node->level >= 1)
-                                ++bg_tall_deleted;
-                        ++bg_deleted;
+                                ++p->tall_deleted;
+                        ++p->deleted;
+                        if (0 == chain)
+                                ++p->chains;
+                        if (++chain > p->chain)
+                                p->chain = chain;
                 }
                 else if (node->val != node) {
+                        chain = 0;
+                        if (0 == node->level) {
+                                if (0 == run)
+                                        ++p->runs;
+                                ++p->nshort;
+                                if (++run > p->run)
+                                        p->run = run;
+                        } else {
+                                run = 0;
+                        }
+
                         if ((((0 == prev->level
                                 && 0 == node->level)
                                 && 0 == next->level))
@@ -252,22 +622,13 @@ static int bg_trav_nodes(ptst_t *ptst)
 
                                 raised = 1;
 
-                                get_index_above(above_head, &above_prev,
-                                                &above_next, 0, node->key,
-                                                zero);
-
-                                // swap the pointers
-                                node->succs[IDX(0,zero)] = above_next;
-
-                                BARRIER(); // make sure above happens first
-
-                                above_prev->succs[IDX(0,zero)] = node;
-                                above_next = above_prev = above_head = node;
+                                bg_link(&above_prev, node, 0, zero);
                         }
                 }
 
-                if (NULL != node->val && node != node->val) {
-                        ++bg_non_deleted;
+                if (node->key >= p->lo &&
+                    NULL != node->val && node != node->val) {
+                        ++p->non_deleted;
                 }
                 prev = node;
                 node = next;
@@ -280,82 +641,100 @@ static int bg_trav_nodes(ptst_t *ptst)
 }
 
 /**
- * get_index_above - get the index node above for a raise
+ * bg_link - link a node into an index level
+ * @iprev: an index node before @node, set to @node
+ * @node: the node to link
+ * @i: the index level
+ * @zero: the index of the lowest index level
+ *
+ * Note: the helper of the previous part can link a node after the same
+ * index node as us at the boundary of the parts, hence the CAS. Neither
+ * helper unlinks this index node (see bg_raise_ilevel()).
  */
-static void get_index_above(node_t *above_head,
-                            node_t **above_prev,
-                            node_t **above_next,
-                            unsigned long i,
-                            unsigned long key,
-                            unsigned long zero)
+static void bg_link(node_t **iprev, node_t *node, unsigned long i,
+                    unsigned long zero)
 {
-        /* get the correct index node above */
-        while (*above_next && (*above_next)->key < key) {
-                *above_next = (*above_next)->succs[IDX(i,zero)];
-                if (*above_next != above_head->succs[IDX(i,zero)])
-                        *above_prev = (*above_prev)->succs[IDX(i,zero)];
+        node_t *prev = *iprev, *next;
+
+        while (1) {
+                next = SUCC(prev, i, zero);
+                if (NULL != next && next->key < node->key) {
+                        prev = next;
+                        continue;
+                }
+                SUCC(node, i, zero) = next;
+                BARRIER(); /* link node to next first */
+                if (CAS(&SUCC(prev, i, zero), next, node))
+                        break;
         }
+        *iprev = node;
 }
 
-
-
 /**
  * bg_raise_ilevel - raise the index levels
+ * @p: the part of the skip list to raise
  * @h: the height of the level we are raising
  * @ptst: per-thread state
  *
  * Returns 1 if a node was raised and 0 otherwise.
+ * Note: deleted index nodes are unlinked with CAS, except the ones the
+ * helper of the next part could link an index node after: the one it
+ * starts from and the ones followed by an index node of another part.
  */
-static int bg_raise_ilevel(int h, ptst_t *ptst)
+static int bg_raise_ilevel(bg_part_t *p, int h, ptst_t *ptst)
 {
         int raised = 0;
         unsigned long zero = sl_zero;
-        node_t *index, *inext, *iprev = set->head;
-        node_t *above_next, *above_prev, *above_head;
+        node_t *iprev = p->preds[h-1], *above_prev = p->preds[h];
+        node_t *keep = (NULL == p->next) ? NULL : p->next[h-1];
+        node_t *index, *inext;
 
         ptst = ptst_critical_enter();
 
-        above_next = above_prev = above_head = set->head;
-
-        index = iprev->succs[IDX(h-1,zero)];
-        if (NULL == index)
-                return raised;
-
-        while (NULL != (inext = index->succs[IDX(h-1,zero)])) {
-                while (index->val == index) {
-
-                        // skip deleted nodes
-                        iprev->succs[IDX(h-1,zero)] = inext;
-                        BARRIER(); // do removal before level decrementing
-                        --index->level;
+        index = SUCC(iprev, h-1, zero);
 
-                        if (NULL == inext)
-                                break;
+        while (NULL != index && bg_before_end(p, index->key)) {
+                inext = SUCC(index, h-1, zero);
+                if (index->key < p->lo) {
+                        /* maintained by the previous part */
+                        iprev = index;
                         index = inext;
-                        inext = inext->succs[IDX(h-1,zero)];
+                        continue;
+                }
+                if (index->val == index && index != keep &&
+                    bg_owns(p, inext)) {
+                        // skip deleted nodes
+                        if (CAS(&SUCC(iprev, h-1, zero), index, inext)) {
+                                BARRIER(); // do removal before level decrementing
+                                --index->level;
+                                index = inext;
+                        } else {
+                                index = SUCC(iprev, h-1, zero);
+                        }
+                        continue;
                 }
                 if (NULL == inext)
                         break;
                 if ( (((iprev->level <= h) && (index->level == h)) &&
-                    (inext->level <= h)) && (index->val != index && NULL != index->val) ) {
+                    (inext->level <= h)) && (index->val != index && NULL != index->val)
+                    && bg_can_grow(p, index, h) ) {
                         raised = 1;
 
-                        /* find the correct index node above */
-                        get_index_above(above_head, &above_prev, &above_next,
-                                        h, index->key, zero);
+                        /* make room for the level above */
+                        if (node_grow(index, h + 1, zero, ptst)) {
+                                #ifdef BG_STATS
+                                ADD_TO(bg_stats.grows, 1);
+                                #endif
+                        }
 
-                        /* fix the pointers and levels */
-                        index->succs[IDX(h,zero)] = above_next;
-                        BARRIER(); /* link index to above_next first */
-                        above_prev->succs[IDX(h,zero)] = index;
+                        /* link the index node above and fix its level */
+                        bg_link(&above_prev, index, h, zero);
                         ++index->level;
 
                         assert(index->level == h+1);
-
-                        above_next = above_prev = above_head = index;
                 }
                 iprev = index;
-                index = index->succs[IDX(h-1,zero)];
+                index = SUCC(index, h-1, zero);
         }
 
         ptst_critical_exit(ptst);
@@ -380,14 +759,14 @@ void bg_lower_ilevel(ptst_t *ptst)
         /* decrement the level of all nodes */
 
         while (node) {
-                node_next = node->succs[IDX(0,zero)];
+                node_next = SUCC(node, 0, zero);
                 if (!node->marker) {
                         if (node->level > 0) {
                                 if (1 == node->level && node->raise_or_remove)
                                         node->raise_or_remove = 0;
                                 //BARRIER();
                                 /* null out the ptr for level being removed */
-                                node->succs[IDX(0,zero)] = NULL;
+                                SUCC(node, 0, zero) = NULL;
                                 --node->level;
                         }
                 }
@@ -418,10 +797,28 @@ void bg_init(set_t *s)
         bg_stats.lowers = 0;
         bg_stats.delete_attempts = 0;
         bg_stats.delete_succeeds = 0;
+        bg_stats.grows = 0;
+
+        bg_prev_size = 0;
+}
+
+/**
+ * bg_set_helpers - set the number of threads maintaining the skip list
+ * @nb_helpers: the number of threads, including the background thread
+ *
+ * Note: the skip list is split into one part per thread at each
+ * traversal. Takes effect at the next bg_start().
+ */
+void bg_set_helpers(int nb_helpers)
+{
+        assert(nb_helpers >= 1 && nb_helpers <= MAX_HELPERS);
+
+        bg_nb_helpers = nb_helpers;
 }
 
 /**
  * bg_start - start the background thread
+ * @sleep_time: the longest time to sleep the bg thread per iteration
  *
  * Note: Only start the background thread if it is not currently
  * running.
@@ -431,6 +828,20 @@ void bg_start(int sleep_time)
         /* XXX not thread safe  XXX */
         if (!bg_running) {
                 bg_sleep_time = sleep_time;
+
+                /* the scheduling statistics are those of the last run */
+                bg_sched.sleep = sleep_time;
+                bg_sched.hurries = 0;
+                bg_sched.holds = 0;
+                bg_sched.relaxes = 0;
+                bg_sched.wakeups = 0;
+                bg_sched.rate = 0;
+                bg_sched.gap = 0;
+                bg_sched.max_run = 0;
+                bg_sched.max_chain = 0;
+                bg_wake = 0;
+                gettimeofday(&bg_prev_time, NULL);
+
                 bg_running = 1;
                 bg_finished = 0;
                 pthread_create(&bg_thread, NULL, bg_loop, NULL);
@@ -451,13 +862,35 @@ void bg_stop(void)
         }
 }
 
+/**
+ * bg_wakeup - end the current sleep of the background thread
+ *
+ * Note: called by worker threads that find the index lagging behind.
+ */
+void bg_wakeup(void)
+{
+        if (!bg_wake)
+                bg_wake = 1;
+}
+
 /**
  * bg_print_stats - print background statistics
  *
- * Note: this is a noop if BG_STATS is not defined.
+ * Note: only the scheduling decisions are printed if BG_STATS is not
+ * defined.
  */
 void bg_print_stats(void)
 {
+        printf("Sleep = %i us (at most %i)\n", bg_sched.sleep, bg_sleep_time);
+        printf("Hurries = %lu\n", bg_sched.hurries);
+        printf("Holds = %lu\n", bg_sched.holds);
+        printf("Relaxes = %lu\n", bg_sched.relaxes);
+        printf("Wakeups = %lu\n", bg_sched.wakeups);
+        printf("Update Rate = %lu /s\n", bg_sched.rate);
+        printf("Level Gap = %i\n", bg_sched.gap);
+        printf("Max Short Run = %i\n", bg_sched.max_run);
+        printf("Max Deleted Chain = %i\n", bg_sched.max_chain);
+
         #ifdef BG_STATS
         printf("Loops = %lu\n", bg_stats.loops);
         printf("Raises = %lu\n", bg_stats.raises);
@@ -466,6 +899,7 @@ void bg_print_stats(void)
         printf("Delete Attempts = %lu\n", bg_stats.delete_attempts);
         printf("Delete Succeeds = %lu\n", bg_stats.delete_succeeds);
         printf("Should delete = %lu\n", bg_stats.should_delete);
+        printf("Wheel Grows = %lu\n", bg_stats.grows);
         #endif
 }
 
@@ -25,6 +25,7 @@ http://www.cl.cam.ac.uk/research/srg/netos/lock-free
 #include "common.h"
 #include "ptst.h"
 #include "garbagecoll.h"
+#include "memacct.h"
 #include "skiplist.h"
 
 #define NUM_EPOCHS 3
@@ -270,8 +271,9 @@ static void gc_reclaim(void)
 {
         ptst_t *ptst, *first_ptst, *our_ptst = NULL;
         gc_st  *gc = NULL;
+        long n;
         unsigned long curr_epoch;
-        gc_chunk *ch, *t;
+        gc_chunk *ch, *t, *p;
         int /*two_ago,*/ three_ago, i, j;
 
         /* barrier to entering the reclaim critical section */
@@ -317,6 +319,13 @@ static void gc_reclaim(void)
                         gc->garbage_tail[three_ago][i]->next = ch;
                         gc->garbage_tail[three_ago][i] = t;
                         t->next = t;
+                        /* blocks moving to the allocation list */
+                        n = 0;
+                        p = ch;
+                        do {
+                                n += p->i;
+                        } while ((p = p->next) != ch);
+                        ma_reclaim(n * gc_global.blk_sizes[i]);
                         gc_add_chunks_to_list(ch, gc_global.alloc[i]);
                 }
 
@@ -404,6 +413,7 @@ void* gc_alloc(ptst_t *ptst, int alloc_id)
                 }
         }
 
+        ma_alloc(gc_global.blk_sizes[alloc_id]);
         return ch->blk[--ch->i];
 }
 
@@ -415,6 +425,7 @@ void* gc_alloc(ptst_t *ptst, int alloc_id)
  */
 void gc_free(ptst_t *ptst, void *p, int alloc_id)
 {
+        ma_retire(gc_global.blk_sizes[alloc_id]);
 #ifndef MINIMAL_GC
 
         gc_st *gc = ptst->gc;
@@ -482,9 +493,10 @@ void gc_unsafe_free(ptst_t *ptst, void *p, int alloc_id)
         gc_chunk *ch;
 
         ch = gc->alloc[alloc_id];
-        if (ch->i < BLKS_PER_CHUNK)
+        if (ch->i < BLKS_PER_CHUNK) {
+                ma_free(gc_global.blk_sizes[alloc_id]);
                 ch->blk[ch->i++] = p;
-        else
+        } else
                 gc_free(ptst, p, alloc_id);
 }
 
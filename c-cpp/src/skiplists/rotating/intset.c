@@ -41,3 +41,19 @@ int sl_remove_old(set_t *set, unsigned long key, int transactional)
 {
 	return sl_delete(set, key);
 }
+
+int sl_range_collect_old(set_t *set, unsigned long lo, unsigned long hi,
+                         unsigned long *keys, int max)
+{
+        return sl_range_collect(set, lo, hi, keys, max);
+}
+
+int sl_range_count_old(set_t *set, unsigned long lo, unsigned long hi)
+{
+        return sl_range_count(set, lo, hi);
+}
+
+int sl_successor_old(set_t *set, unsigned long key, unsigned long *succ)
+{
+        return sl_successor(set, key, succ);
+}
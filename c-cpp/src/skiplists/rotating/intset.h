@@ -29,5 +29,9 @@
 int sl_contains_old(set_t *set, unsigned long key, int transactional);
 int sl_add_old(set_t *set, unsigned long key, int transactional);
 int sl_remove_old(set_t *set, unsigned long key, int transactional);
+int sl_range_collect_old(set_t *set, unsigned long lo, unsigned long hi,
+                         unsigned long *keys, int max);
+int sl_range_count_old(set_t *set, unsigned long lo, unsigned long hi);
+int sl_successor_old(set_t *set, unsigned long key, unsigned long *succ);
 
 #endif /* INTSET_H_ */
@@ -209,7 +209,7 @@ int sl_do_operation(set_t *set, sl_optype_t optype, unsigned int key, void *val)
         node_t *node = NULL, *next = NULL;
         node_t *head = set->head;
         void *node_val = NULL, *next_val = NULL;
-        int result = 0;
+        int result = 0, steps = 0;
         ptst_t *ptst;
         unsigned long zero, i;
 
@@ -223,7 +223,7 @@ int sl_do_operation(set_t *set, sl_optype_t optype, unsigned int key, void *val)
         /* find an entry-point to the node-level */
         item = head;
         while (1) {
-                next_item = item->succs[IDX(i,zero)];
+                next_item = SUCC(item, i, zero);
 
                 if (NULL == next_item || next_item->key > key) {
 
@@ -269,9 +269,101 @@ int sl_do_operation(set_t *set, sl_optype_t optype, unsigned int key, void *val)
                         continue;
                 }
                 node = next;
+                /* the index lags behind, no need to wait for the bg thread */
+                if (BG_WAKE_STEPS == ++steps)
+                        bg_wakeup();
         }
 
         ptst_critical_exit(ptst);
 
         return result;
 }
+
+/**
+ * sl_range_collect - collects the keys of a range
+ * @set: the skip list set
+ * @lo: the lowest key of the range
+ * @hi: the highest key of the range
+ * @keys: where to store the keys (can be NULL)
+ * @max: the largest number of keys to store in @keys
+ *
+ * Walks the node level from the last node below @lo found through the
+ * index wheels, reporting the nodes whose value is neither NULL
+ * (logically deleted) nor the node itself (removed or marker). The scan
+ * is weakly consistent (see scan.h): removed nodes keep their next
+ * pointer, so a node present during the whole scan is always reached.
+ *
+ * Returns the number of keys in the range, or the number of keys
+ * stored if @keys is not NULL.
+ */
+int sl_range_collect(set_t *set, unsigned long lo, unsigned long hi,
+                     unsigned long *keys, int max)
+{
+        node_t *item, *next_item, *node;
+        void *node_val;
+        int count = 0;
+        ptst_t *ptst;
+        unsigned long zero, i;
+
+        assert(NULL != set);
+
+        if (NULL != keys && max <= 0)
+                return 0;
+
+        ptst = ptst_critical_enter();
+
+        zero = sl_zero;
+        i = set->head->level - 1;
+
+        item = set->head;
+        while (1) {
+                next_item = SUCC(item, i, zero);
+                if (NULL == next_item || next_item->key >= lo) {
+                        if (zero == i) {
+                                node = item;
+                                break;
+                        }
+                        --i;
+                        continue;
+                }
+                item = next_item;
+        }
+        while (node == node->val)
+                node = node->prev;
+
+        for (; NULL != node; node = node->next) {
+                node_val = node->val;
+                if (NULL == node_val || node == node_val)
+                        continue;
+                if (node->key > hi)
+                        break;
+                if (node->key < lo)
+                        continue;
+                if (NULL != keys) {
+                        keys[count] = node->key;
+                        if (++count == max)
+                                break;
+                } else {
+                        ++count;
+                }
+        }
+
+        ptst_critical_exit(ptst);
+
+        return count;
+}
+
+/**
+ * sl_successor - finds the smallest key above a key
+ * @set: the skip list set
+ * @key: the search key
+ * @succ: where to store the successor of @key
+ *
+ * Returns 1 if @key has a successor and 0 otherwise.
+ */
+int sl_successor(set_t *set, unsigned long key, unsigned long *succ)
+{
+        if (key == ~0UL)
+                return 0;
+        return sl_range_collect(set, key + 1, ~0UL, succ, 1);
+}
@@ -19,10 +19,14 @@ enum sl_optype {
 
 int sl_do_operation(set_t *set, sl_optype_t optype,
                     unsigned int key, void *val);
+int sl_range_collect(set_t *set, unsigned long lo, unsigned long hi,
+                     unsigned long *keys, int max);
+int sl_successor(set_t *set, unsigned long key, unsigned long *succ);
 
 /* these are macros instead of functions to improve performance */
 #define sl_contains(a, b) sl_do_operation((a), CONTAINS, (b), NULL);
 #define sl_delete(a, b) sl_do_operation((a), DELETE, (b), NULL);
 #define sl_insert(a, b, c) sl_do_operation((a), INSERT, (b), (c));
+#define sl_range_count(a, b, c) sl_range_collect((a), (b), (c), NULL, 0)
 
 #endif /* NOHOTSPOT_OPS_H_ */
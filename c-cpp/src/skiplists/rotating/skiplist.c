@@ -28,6 +28,13 @@ have these as separate structures to regular nodes. The reason for
 this is that the background maintenance method used here is much easier
 to implement this way.
 
+The index pointers of a node are kept in a wheel whose size is a power
+of two: every node has room for a single index level, which is all
+most nodes ever need, and node_grow() gives a node a larger wheel when
+the background thread raises it higher. The larger wheels come from
+their own garbage collected allocators, one per size, and the old wheel
+is reclaimed once no thread can be reading it.
+
 */
 
 #include <stdio.h>
@@ -39,8 +46,26 @@ to implement this way.
 #include "garbagecoll.h"
 #include "ptst.h"
 
-static int gc_id[NUM_SIZES];
+static int gc_id[NUM_NODE_SIZES];
 static int curr_id;
+static int wheel_gc_id[NUM_WHEELS];
+
+/* Returns the allocator of wheels holding 2^@c index levels, 0 < c */
+static int wheel_id(unsigned long c)
+{
+        assert(c > 0 && c < NUM_WHEELS);
+        return wheel_gc_id[c];
+}
+
+/* Returns log2 of the size of @wheel */
+static unsigned long wheel_class(wheel_t *wheel)
+{
+        unsigned long c = 0;
+
+        while ((1UL << c) <= wheel->mask)
+                ++c;
+        return c;
+}
 
 /* - Public skiplist interface - */
 
@@ -60,7 +85,6 @@ node_t* node_new(unsigned long key, void *val, node_t *prev,
                  node_t *next, unsigned int level, ptst_t *ptst)
 {
         node_t *node;
-        unsigned long i;
 
         node  = gc_alloc(ptst, gc_id[curr_id]);
 
@@ -72,8 +96,9 @@ node_t* node_new(unsigned long key, void *val, node_t *prev,
         node->marker    = 0;
         node->raise_or_remove = 0;
 
-        for (i = 0; i < MAX_LEVELS; i++)
-                node->succs[i] = NULL;
+        node->own_wheel.mask = 0;
+        node->own_wheel.succs[0] = NULL;
+        node->wheel = &node->own_wheel;
 
         assert (node->next != node);
 
@@ -89,7 +114,6 @@ node_t* node_new(unsigned long key, void *val, node_t *prev,
 node_t* marker_new(node_t *prev, node_t *next, ptst_t *ptst)
 {
         node_t *node;
-        unsigned long i;
 
         node  = gc_alloc(ptst, gc_id[curr_id]);
 
@@ -100,20 +124,66 @@ node_t* marker_new(node_t *prev, node_t *next, ptst_t *ptst)
         node->level     = 0;
         node->marker    = 1;
 
-        for (i = 0; i < MAX_LEVELS; i++)
-                node->succs[i] = NULL;
+        node->own_wheel.mask = 0;
+        node->own_wheel.succs[0] = NULL;
+        node->wheel = &node->own_wheel;
 
         assert (node->next != node);
 
         return node;
 }
 
+/**
+ * node_grow - make room for more index levels in a node
+ * @node: the node to grow
+ * @levels: the number of index levels @node needs room for
+ * @zero: the value of sl_zero the index levels are numbered from
+ * @ptst: the per-thread state
+ *
+ * Returns 1 if @node was given a larger wheel and 0 otherwise.
+ * Note: the index levels of @node are copied into the larger wheel
+ * before it is published, and searches still reading the old wheel see
+ * the same successors. Only the background thread changes the index
+ * levels of @node, so no successor changes during the copy.
+ */
+int node_grow(node_t *node, unsigned long levels, unsigned long zero,
+              ptst_t *ptst)
+{
+        wheel_t *old = node->wheel, *new;
+        unsigned long i, c = 0;
+
+        if (levels <= old->mask + 1)
+                return 0;
+        assert(levels <= MAX_WHEEL);
+
+        while ((1UL << c) < levels)
+                ++c;
+        new = gc_alloc(ptst, wheel_id(c));
+        new->mask = (1UL << c) - 1;
+        for (i = 0; i <= new->mask; i++)
+                new->succs[i] = NULL;
+        for (i = 0; i < node->level; i++)
+                new->succs[(zero + i) & new->mask] =
+                        old->succs[(zero + i) & old->mask];
+
+        BARRIER(); /* fill the new wheel before publishing it */
+        node->wheel = new;
+
+        if (old != &node->own_wheel)
+                gc_free(ptst, (void*)old, wheel_id(wheel_class(old)));
+
+        return 1;
+}
+
 /**
  * node_delete - delete a bottom-level node
  * @node: the node to delete
  */
 void node_delete(node_t *node, ptst_t *ptst)
 {
+        if (node->wheel != &node->own_wheel)
+                gc_free(ptst, (void*)node->wheel,
+                        wheel_id(wheel_class(node->wheel)));
         gc_free(ptst, (void*)node, gc_id[curr_id]);
 }
 
@@ -150,6 +220,7 @@ set_t* set_new(int start)
         }
 
         set->head = node_new(0, NULL, NULL, NULL, 1, ptst);
+        node_grow(set->head, MAX_LEVELS, sl_zero, ptst);
 
         bg_init(set);
         if (start)
@@ -190,7 +261,7 @@ void set_print(set_t *set, int flag)
                                 printf("%lu ", curr->key);
                         else if (!flag)
                                 printf("%lu ", curr->key);
-                        curr = curr->succs[IDX(i,zero)];
+                        curr = SUCC(curr, i, zero);
                 }
                 printf("\n");
                 curr = head;
@@ -238,10 +309,14 @@ int set_size(set_t *set, int flag)
 void set_subsystem_init(void)
 {
         int i;
-        for (i = 0; i < NUM_SIZES; i++) {
+        for (i = 0; i < NUM_NODE_SIZES; i++) {
                 gc_id[i] = gc_add_allocator(sizeof(node_t));
         }
-        curr_id = rand() % NUM_SIZES;
+        for (i = 1; i < NUM_WHEELS; i++) {
+                wheel_gc_id[i] = gc_add_allocator(sizeof(wheel_t) +
+                                ((1 << i) - 1) * sizeof(node_t*));
+        }
+        curr_id = rand() % NUM_NODE_SIZES;
 }
 
 /**
@@ -257,7 +332,7 @@ void set_print_nodenums(set_t *set, int flag)
                 while (curr) {
                         if ((flag && ((curr->val != curr) && (curr->val != NULL))) || !flag)
                                 ++count;
-                        curr = curr->succs[IDX(i, zero)];
+                        curr = SUCC(curr, i, zero);
                 }
                 printf("inodes at level %lu = %lu\n", i+1, count);
                 curr = head;
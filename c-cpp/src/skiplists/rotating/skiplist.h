@@ -15,12 +15,28 @@
 
 #define MAX_LEVELS 20
 
-#define NUM_SIZES 1
+#define NUM_NODE_SIZES 1
 #define NODE_SIZE 0
 
-#define IDX(_i, _z) ((_z) + (_i)) % MAX_LEVELS
+/* wheels hold a power of two of index levels, up to MAX_WHEEL */
+#define MAX_WHEEL 32
+#define NUM_WHEELS 6    /* wheel sizes 1, 2, 4, ..., MAX_WHEEL */
+#if MAX_LEVELS > MAX_WHEEL
+#error "the wheel of the head cannot hold MAX_LEVELS index levels"
+#endif
+
+/* allocators of the garbage collector: nodes, and wheels larger than 1 */
+#define NUM_SIZES (NUM_NODE_SIZES + NUM_WHEELS - 1)
+
 unsigned long sl_zero;
 
+/* the index levels of a node, see SUCC() */
+typedef VOLATILE struct sl_wheel wheel_t;
+struct sl_wheel {
+        unsigned long   mask;           /* the size of the wheel - 1 */
+        struct sl_node  *succs[1];      /* mask + 1 successors */
+};
+
 /* bottom-level nodes */
 typedef VOLATILE struct sl_node node_t;
 struct sl_node {
@@ -29,11 +45,28 @@ struct sl_node {
         struct sl_node  *next;
         unsigned long   key;
         void            *val;
-        struct sl_node  *succs[MAX_LEVELS];
+        struct sl_wheel *wheel;         /* own_wheel or a larger one */
         unsigned long   marker;
         unsigned long   raise_or_remove;
+        struct sl_wheel own_wheel;      /* room for a single index level */
 };
 
+/*
+ * The successor of @node at index level @i, where @zero is the value of
+ * sl_zero the caller started with. Index level i is kept in slot
+ * (zero + i) of the wheel modulo its size, so lowering the index
+ * (++sl_zero) moves no pointer whatever the size of the wheel.
+ */
+static inline node_t** node_succ(node_t *node, unsigned long i,
+                                 unsigned long zero)
+{
+        wheel_t *wheel = node->wheel;
+
+        return (node_t**)&wheel->succs[(zero + i) & wheel->mask];
+}
+
+#define SUCC(_n, _i, _z) (*node_succ((_n), (_i), (_z)))
+
 /* the skip list set */
 typedef struct sl_set set_t;
 struct sl_set {
@@ -45,6 +78,8 @@ node_t* node_new(unsigned long key, void *val, node_t *prev, node_t *next,
 
 node_t* marker_new(node_t *prev, node_t *next, ptst_t *ptst);
 
+int node_grow(node_t *node, unsigned long levels, unsigned long zero,
+              ptst_t *ptst);
 void node_delete(node_t *node, ptst_t *ptst);
 void marker_delete(node_t *node, ptst_t *ptst);
 
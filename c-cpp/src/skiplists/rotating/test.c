@@ -34,6 +34,13 @@
 
 #include <atomic_ops.h>
 
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "timeseries.h"
+#include "scan.h"
+#include "memacct.h"
 #include "tm.h"
 #include "ptst.h"
 #include "garbagecoll.h"
@@ -47,6 +54,7 @@
 #define DEFAULT_ELASTICITY              4
 #define DEFAULT_ALTERNATE               0
 #define DEFAULT_EFFECTIVE               1
+#define DEFAULT_BG_HELPERS              1
 #define DEFAULT_UNBALANCED              0
 
 #define XSTR(s)                         STR(s)
@@ -155,12 +163,18 @@ typedef struct thread_data {
 	int unit_tx;
 	int alternate;
 	int effective;
+	int scan;
+	int scan_length;
+	int scan_op;
 	unsigned long nb_add;
 	unsigned long nb_added;
 	unsigned long nb_remove;
 	unsigned long nb_removed;
 	unsigned long nb_contains;
 	unsigned long nb_found;
+	unsigned long nb_scan;
+	unsigned long nb_scanned;
+	unsigned long *scan_keys;
 	unsigned long nb_aborts;
 	unsigned long nb_aborts_locked_read;
 	unsigned long nb_aborts_locked_write;
@@ -174,6 +188,10 @@ typedef struct thread_data {
 	set_t *set;
 	barrier_t *barrier;
 	unsigned long failures_because_contention;
+	lat_stats_t *lat;
+	wl_thread_t wl;
+	int cpu;
+	pc_stats_t *pc;
 } thread_data_t;
 
 
@@ -205,13 +223,17 @@ void *test(void *data) {
 
 	thread_data_t *d = (thread_data_t *)data;
 
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
 	/* Create transaction */
 	TM_THREAD_ENTER();
 	/* Wait on barrier */
 	barrier_cross(d->barrier);
+	pc_start(d->pc);
 
 	/* Is the first op an update? */
-	unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+	unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 
 #ifdef ICC
 	while (stop == 0) {
@@ -224,8 +246,8 @@ void *test(void *data) {
 
 			if (last < 0) { // add
 
-				val = rand_range_re(&d->seed, d->range);
-				if (sl_add_old(d->set, val, TRANSACTIONAL)) {
+				val = wl_key(&d->wl);
+				if (LAT_OP(d->lat, LAT_ADD, sl_add_old(d->set, val, TRANSACTIONAL))) {
 					d->nb_added++;
 					last = val;
 				}
@@ -234,15 +256,15 @@ void *test(void *data) {
 			} else { // remove
 
 				if (d->alternate) { // alternate mode (default)
-					if (sl_remove_old(d->set, last, TRANSACTIONAL)) {
+					if (LAT_OP(d->lat, LAT_REMOVE, sl_remove_old(d->set, last, TRANSACTIONAL))) {
 						d->nb_removed++;
 					}
 					last = -1;
 				} else {
 					/* Random computation only in non-alternated cases */
-					val = rand_range_re(&d->seed, d->range);
+					val = wl_key(&d->wl);
 					/* Remove one random value */
-					if (sl_remove_old(d->set, val, TRANSACTIONAL)) {
+					if (LAT_OP(d->lat, LAT_REMOVE, sl_remove_old(d->set, val, TRANSACTIONAL))) {
 						d->nb_removed++;
 						/* Repeat until successful, to avoid size variations */
 						last = -1;
@@ -251,6 +273,21 @@ void *test(void *data) {
 				d->nb_remove++;
 			}
 
+		} else if (scan_next(&d->wl, d->update, d->scan)) { // range scan or successor query
+
+			val = wl_key(&d->wl);
+			switch (d->scan_op) {
+			case SCAN_COUNT:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_range_count_old(d->set, val, scan_hi(val, d->scan_length, d->range)));
+				break;
+			case SCAN_SUCCESSOR:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_successor_old(d->set, val, d->scan_keys));
+				break;
+			default:
+				d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, sl_range_collect_old(d->set, val, scan_hi(val, d->scan_length, d->range), d->scan_keys, d->scan_length));
+			}
+			d->nb_scan++;
+
 		} else { // read
 
 			if (d->alternate) {
@@ -259,20 +296,20 @@ void *test(void *data) {
 						val = d->first;
 						last = val;
 					} else { // last >= 0
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						last = -1;
 					}
 				} else { // update != 0
 					if (last < 0) {
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						//last = val;
 					} else {
 						val = last;
 					}
 				}
-			}	else val = rand_range_re(&d->seed, d->range);
+			}	else val = wl_key(&d->wl);
 
-			if (sl_contains_old(d->set, val, TRANSACTIONAL))
+			if (LAT_OP(d->lat, LAT_CONTAINS, sl_contains_old(d->set, val, TRANSACTIONAL)))
 				d->nb_found++;
 			d->nb_contains++;
 
@@ -281,9 +318,9 @@ void *test(void *data) {
 		/* Is the next op an update? */
 		if (d->effective) { // a failed remove/add is a read-only tx
 			unext = ((100 * (d->nb_added + d->nb_removed))
-							 < (d->update * (d->nb_add + d->nb_remove + d->nb_contains)));
+							 < (d->update * (d->nb_add + d->nb_remove + d->nb_contains + d->nb_scan)));
 		} else { // remove/add (even failed) is considered as an update
-			unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+			unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 		}
 
 #ifdef ICC
@@ -292,6 +329,7 @@ void *test(void *data) {
 	}
 #endif /* ICC */
 
+	pc_stop(d->pc);
 	/* Free transaction */
 	TM_THREAD_EXIT();
 
@@ -309,6 +347,18 @@ int main(int argc, char **argv)
 		// These options don't set a flag
 		{"help",                      no_argument,       NULL, 'h'},
 		{"duration",                  required_argument, NULL, 'd'},
+		{"latency",                   required_argument, NULL, 'L'},
+		{"key-dist",                  required_argument, NULL, 'K'},
+		{"pin",                       required_argument, NULL, 'P'},
+		{"numa",                      required_argument, NULL, 'N'},
+		{"counters",                  required_argument, NULL, 'C'},
+		{"interval",                  required_argument, NULL, 'T'},
+		{"rate",                      required_argument, NULL, 'O'},
+		{"arrival",                   required_argument, NULL, 'E'},
+		{"bg-helpers",                required_argument, NULL, 'H'},
+		{"scan-rate",                 required_argument, NULL, 'R'},
+		{"scan-length",               required_argument, NULL, 'Q'},
+		{"scan-op",                   required_argument, NULL, 'q'},
 		{"initial-size",              required_argument, NULL, 'i'},
 		{"thread-num",                required_argument, NULL, 't'},
 		{"range",                     required_argument, NULL, 'r'},
@@ -323,6 +373,7 @@ int main(int argc, char **argv)
 	int i, c, size;
 	unsigned int last = 0;
 	unsigned int val = 0;
+	unsigned long scans, scanned;
 	unsigned long reads, effreads, updates, effupds, aborts, aborts_locked_read, aborts_locked_write,
 	aborts_validate_read, aborts_validate_write, aborts_validate_commit,
 	aborts_invalid_memory, aborts_double_write, max_retries, failures_because_contention;
@@ -333,6 +384,23 @@ int main(int argc, char **argv)
 	struct timeval start, end;
 	struct timespec timeout;
 	int duration = DEFAULT_DURATION;
+	int latency = DEFAULT_LATENCY;
+	char *keydist = DEFAULT_KEYDIST;
+	workload_t workload;
+	char *pin = DEFAULT_PIN;
+	char *numa = DEFAULT_NUMA;
+	affinity_t aff;
+	int counters = DEFAULT_COUNTERS;
+	int interval = DEFAULT_INTERVAL;
+	int rate = DEFAULT_RATE;
+	int scan = DEFAULT_SCAN;
+	int scan_length = DEFAULT_SCAN_LENGTH;
+	int scan_op = scan_parse(DEFAULT_SCAN_OP);
+	char *arrival = DEFAULT_ARRIVAL;
+	int bg_helpers = DEFAULT_BG_HELPERS;
+	int poisson;
+	unsigned long ops;
+	ts_t ts;
 	int initial = DEFAULT_INITIAL;
 	int nb_threads = DEFAULT_NB_THREADS;
 	long range = DEFAULT_RANGE;
@@ -348,7 +416,7 @@ int main(int argc, char **argv)
 
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:U:", long_options, &i);
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:U:L:K:P:N:C:T:O:E:H:R:Q:q:", long_options, &i);
 
 		if(c == -1)
 			break;
@@ -385,6 +453,31 @@ int main(int argc, char **argv)
 								 "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 								 "  -u, --update-rate <int>\n"
 								 "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+								 "  -L, --latency <int>\n"
+								 "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+								 "  -K, --key-dist <dist>\n"
+								 "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+								 "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+								 "  -P, --pin <policy>\n"
+								 "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+								 "  -N, --numa <policy>\n"
+								 "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+								 "  -C, --counters <int>\n"
+								 "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+								 "  -T, --interval <int>\n"
+								 "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+								 "  -O, --rate <int>\n"
+								 "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+								 "  -E, --arrival <process>\n"
+								 "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
+								 "  -H, --bg-helpers <int>\n"
+								 "        Number of threads maintaining the index in the background (default=" XSTR(DEFAULT_BG_HELPERS) ")\n"
+								 "  -R, --scan-rate <int>\n"
+								 "        Percentage of range scans (default=" XSTR(DEFAULT_SCAN) ")\n"
+								 "  -Q, --scan-length <int>\n"
+								 "        Number of keys of the range of a scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+								 "  -q, --scan-op <op>\n"
+								 "        Operation of a scan: collect, count or successor (default=" DEFAULT_SCAN_OP ")\n"
 					       );
 					exit(0);
 				case 'A':
@@ -414,6 +507,42 @@ int main(int argc, char **argv)
 				case 'U':
                                         unbalanced = atoi(optarg);
                                         break;
+				case 'K':
+					keydist = optarg;
+					break;
+				case 'P':
+					pin = optarg;
+					break;
+				case 'N':
+					numa = optarg;
+					break;
+				case 'C':
+					counters = atoi(optarg);
+					break;
+				case 'T':
+					interval = atoi(optarg);
+					break;
+				case 'O':
+					rate = atoi(optarg);
+					break;
+				case 'E':
+					arrival = optarg;
+					break;
+				case 'H':
+					bg_helpers = atoi(optarg);
+					break;
+				case 'R':
+					scan = atoi(optarg);
+					break;
+				case 'Q':
+					scan_length = atoi(optarg);
+					break;
+				case 'q':
+					scan_op = scan_parse(optarg);
+					break;
+				case 'L':
+					latency = atoi(optarg);
+					break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -427,6 +556,13 @@ int main(int argc, char **argv)
 	assert(nb_threads > 0);
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 100);
+	assert(bg_helpers >= 1 && bg_helpers <= MAX_HELPERS);
+	scan_check(update, scan, scan_length);
+	wl_init(&workload, keydist, range);
+	aff_init(&aff, pin, numa, nb_threads);
+	poisson = lat_poisson(arrival);
+	if (rate > 0 && latency == 0)
+		latency = 1;
 
 	printf("Set type     : skip list\n");
 	printf("Duration     : %d\n", duration);
@@ -435,6 +571,14 @@ int main(int argc, char **argv)
 	printf("Value range  : %ld\n", range);
 	printf("Seed         : %d\n", seed);
 	printf("Update rate  : %d\n", update);
+	printf("Latency      : %d\n", latency);
+	printf("Key dist.    : %s\n", keydist);
+	aff_print(&aff, pin, numa);
+	printf("Counters     : %d\n", counters);
+	printf("Interval     : %d\n", interval);
+	printf("Rate         : %d (%s)\n", rate, arrival);
+	printf("Bg helpers   : %d\n", bg_helpers);
+	printf("Scan rate    : %d (%s, length %d)\n", scan, scan_name(scan_op), scan_length);
 	printf("Elasticity   : %d\n", unit_tx);
 	printf("Alternate    : %d\n", alternate);
 	printf("Efffective   : %d\n", effective);
@@ -467,6 +611,7 @@ int main(int argc, char **argv)
         ptst_subsystem_init();
         gc_subsystem_init();
         set_subsystem_init();
+        bg_set_helpers(bg_helpers);
         set = set_new(1);
 	stop = 0;
 
@@ -491,6 +636,7 @@ int main(int argc, char **argv)
 	i = 0;
 
 	while (i < initial) {
+                aff_populate(&aff, i, initial);
                 if (unbalanced)
 		        val = rand_range_re(&global_seed, initial);
 	        else
@@ -500,6 +646,7 @@ int main(int argc, char **argv)
 			i++;
 		}
 	}
+	aff_populate_done(&aff);
 	size = set_size(set, 1);
 	printf("Set size     : %d\n", size);
 	printf("Level max    : %d\n", levelmax);
@@ -510,21 +657,21 @@ int main(int argc, char **argv)
         top = set->head->level-1;
         for (i = 0; i <= top; i++) {
                 node_t *prev = set->head;
-                node_t *node = prev->succs[IDX(i,sl_zero)];
+                node_t *node = SUCC(prev, i, sl_zero);
                 while (node) {
-                        prev->succs[IDX(i,sl_zero)] = NULL;
+                        SUCC(prev, i, sl_zero) = NULL;
                         prev->level = 0;
                         prev->raise_or_remove = 0;
                         prev = node;
-                        node = node->succs[IDX(i, sl_zero)];
+                        node = SUCC(node, i, sl_zero);
                 }
         }
         */
         node = set->head;
         while (node) {
-                int i;
-                for (i = 0; i < MAX_LEVELS; i++)
-                        node->succs[i] = NULL;
+                unsigned long i;
+                for (i = 0; i <= node->wheel->mask; i++)
+                        node->wheel->succs[i] = NULL;
                 node->level = 0;
                 node->raise_or_remove = 0;
                 node = node->next;
@@ -569,6 +716,20 @@ int main(int argc, char **argv)
 		data[i].nb_aborts_double_write = 0;
 		data[i].max_retries = 0;
 		data[i].seed = rand();
+		data[i].lat = lat_new(latency);
+		lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+		wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+		data[i].cpu = aff_cpu(&aff, i);
+		data[i].pc = pc_new(counters);
+		data[i].scan = scan;
+		data[i].scan_length = scan_length;
+		data[i].scan_op = scan_op;
+		data[i].nb_scan = 0;
+		data[i].nb_scanned = 0;
+		if ((data[i].scan_keys = (unsigned long *)malloc(scan_length * sizeof(unsigned long))) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
 		data[i].set = set;
 		data[i].barrier = &barrier;
 		data[i].failures_because_contention = 0;
@@ -593,7 +754,16 @@ int main(int argc, char **argv)
 	printf("STARTING...\n");
 	gettimeofday(&start, NULL);
 	if (duration > 0) {
-		nanosleep(&timeout, NULL);
+		if (interval > 0) {
+			ts_init(&ts, interval, duration);
+			while (ts_wait(&ts)) {
+				for (ops = 0, i = 0; i < nb_threads; i++)
+					ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains + data[i].nb_scan;
+				ts_sample(&ts, ops);
+			}
+		} else {
+			nanosleep(&timeout, NULL);
+		}
 	} else {
 		sigemptyset(&block_set);
 		sigsuspend(&block_set);
@@ -629,6 +799,8 @@ int main(int argc, char **argv)
 	aborts_double_write = 0;
 	failures_because_contention = 0;
 	reads = 0;
+	scans = 0;
+	scanned = 0;
 	effreads = 0;
 	updates = 0;
 	effupds = 0;
@@ -662,8 +834,10 @@ int main(int argc, char **argv)
 		aborts_invalid_memory += data[i].nb_aborts_invalid_memory;
 		aborts_double_write += data[i].nb_aborts_double_write;
 		failures_because_contention += data[i].failures_because_contention;
-		reads += data[i].nb_contains;
-		effreads += data[i].nb_contains +
+		scans += data[i].nb_scan;
+		scanned += data[i].nb_scanned;
+		reads += data[i].nb_contains + data[i].nb_scan;
+		effreads += data[i].nb_contains + data[i].nb_scan +
 		(data[i].nb_add - data[i].nb_added) +
 		(data[i].nb_remove - data[i].nb_removed);
 		updates += (data[i].nb_add + data[i].nb_remove);
@@ -675,12 +849,23 @@ int main(int argc, char **argv)
 	printf("Set size      : %d (expected: %d)\n", set_size(set,1), size);
 	printf("Duration      : %d (ms)\n", duration);
 	printf("#txs          : %lu (%f / s)\n", reads + updates, (reads + updates) * 1000.0 / duration);
+	if (counters) {
+		pc_stats_t *pc = pc_new(counters);
+		for (i = 0; i < nb_threads; i++) {
+			pc_merge(pc, data[i].pc);
+			free(data[i].pc);
+		}
+		pc_print(pc, reads + updates);
+		free(pc);
+	}
 
 	printf("#read txs     : ");
 	if (effective) {
 		printf("%lu (%f / s)\n", effreads, effreads * 1000.0 / duration);
-		printf("  #contains   : %lu (%f / s)\n", reads, reads * 1000.0 / duration);
+		printf("  #contains   : %lu (%f / s)\n", reads - scans, (reads - scans) * 1000.0 / duration);
 	} else printf("%lu (%f / s)\n", reads, reads * 1000.0 / duration);
+	if (scan > 0)
+		scan_print(scans, scanned, duration);
 
 	printf("#eff. upd rate: %f \n", 100.0 * effupds / (effupds + effreads));
 
@@ -701,6 +886,16 @@ int main(int argc, char **argv)
 	printf("  #dup-w      : %lu (%f / s)\n", aborts_double_write, aborts_double_write * 1000.0 / duration);
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
+	ma_print(size);
+	if (latency > 0) {
+		lat_stats_t *lat = lat_new(latency);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(lat, data[i].lat);
+			free(data[i].lat);
+		}
+		lat_print(lat);
+		free(lat);
+	}
 
         bg_stop();
         bg_print_stats();
@@ -25,10 +25,30 @@
 
 #define MAXLEVEL    32
 
+#ifdef FC
+/* Adapters of the operations applied by the combiner (see fc.h) */
+static int fc_sl_contains(void *set, long *a) {
+	return sl_contains((sl_intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_sl_add(void *set, long *a) {
+	return sl_add((sl_intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_sl_remove(void *set, long *a) {
+	return sl_remove((sl_intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+#endif /* FC */
+
 int sl_contains(sl_intset_t *set, val_t val, int transactional)
 {
 	int result = 0;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_sl_contains, set, val, transactional, 0, 0);
+#endif /* FC */
+
 #ifdef SEQUENTIAL /* Unprotected */
 	
 	int i;
@@ -68,7 +88,7 @@ int sl_contains(sl_intset_t *set, val_t val, int transactional)
 
 	} else {
 
-	  TX_START(NL);
+	  TX_START(RO);
 	  node = set->head;
 	  for (i = node->toplevel-1; i >= 0; i--) {
 	    next = (sl_node_t *)TX_LOAD(&node->next[i]);
@@ -119,6 +139,11 @@ int sl_add(sl_intset_t *set, val_t val, int transactional)
 {
   int result = 0;
 	
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_sl_add, set, val, transactional, 0, 0);
+#endif /* FC */
+
   if (!transactional) {
 		
     result = sl_seq_add(set, val);
@@ -158,6 +183,8 @@ int sl_add(sl_intset_t *set, val_t val, int transactional)
 	    }
 	  }
 	  TX_END;
+	  if (result)
+	    ma_alloc(sizeof(sl_node_t) + l * sizeof(sl_node_t *));
 
 	} else {
 
@@ -181,6 +208,8 @@ int sl_add(sl_intset_t *set, val_t val, int transactional)
 	    }
 	  }
 	  TX_END;
+	  if (result)
+	    ma_alloc(sizeof(sl_node_t) + l * sizeof(sl_node_t *));
 	
 	}
 	
@@ -195,6 +224,11 @@ int sl_remove(sl_intset_t *set, val_t val, int transactional)
 {
 	int result = 0;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_sl_remove, set, val, transactional, 0, 0);
+#endif /* FC */
+
 #ifdef SEQUENTIAL
 	
 	int i;
@@ -224,6 +258,7 @@ int sl_remove(sl_intset_t *set, val_t val, int transactional)
 	sl_node_t *node, *next = NULL;
 	sl_node_t *preds[MAXLEVEL], *succs[MAXLEVEL];
 	val_t v;  
+	long size = 0;
 	
 	if (transactional > 3) {
 
@@ -245,9 +280,12 @@ int sl_remove(sl_intset_t *set, val_t val, int transactional)
 		TX_STORE(&preds[i]->next[i], (sl_node_t *)TX_LOAD(&succs[i]->next[i])); 
 	      }
 	    }
-	    FREE(next, sizeof(sl_node_t) + next->toplevel * sizeof(sl_node_t *));
+	    size = sizeof(sl_node_t) + next->toplevel * sizeof(sl_node_t *);
+	    FREE(next, size);
 	  }
 	  TX_END;
+	  if (result)
+	    ma_free(size);
 
 	} else {
 
@@ -269,9 +307,12 @@ int sl_remove(sl_intset_t *set, val_t val, int transactional)
 		TX_STORE(&preds[i]->next[i], (sl_node_t *)TX_LOAD(&succs[i]->next[i])); 
 	      }
 	    }
-	    FREE(next, sizeof(sl_node_t) + next->toplevel * sizeof(sl_node_t *));
+	    size = sizeof(sl_node_t) + next->toplevel * sizeof(sl_node_t *);
+	    FREE(next, size);
 	  }
 	  TX_END;
+	  if (result)
+	    ma_free(size);
 
 	}
 	
@@ -63,6 +63,11 @@ sl_node_t *sl_new_simple_node(val_t val, int toplevel, int transactional)
     exit(1);
     }
 
+  /* A transaction may abort after allocating: its caller accounts the
+   * node once the transaction has committed */
+  if (!transactional)
+    ma_alloc(sizeof(sl_node_t) + toplevel * sizeof(sl_node_t *));
+
   node->val = val;
   node->toplevel = toplevel;
   node->deleted = 0;
@@ -89,6 +94,7 @@ sl_node_t *sl_new_node(val_t val, sl_node_t *next, int toplevel, int transaction
 
 void sl_delete_node(sl_node_t *n)
 {
+  ma_free(sizeof(sl_node_t) + n->toplevel * sizeof(sl_node_t *));
   free(n);
 }
 
@@ -85,7 +85,7 @@ int optimistic_find(sl_intset_t *set, val_t val) {
  * Function unlock_levels is an helper function for the insert and delete 
  * functions.
  */ 
-inline void unlock_levels(sl_node_t **nodes, int highestlevel, int j) {
+static inline void unlock_levels(sl_node_t **nodes, int highestlevel, int j) {
   int i, r;
   sl_node_t *old = NULL;
 
@@ -243,6 +243,8 @@ int optimistic_delete(sl_intset_t *set, val_t val) {
 			
       for (i = (toplevel-1); i >= 0; i--) 
 	preds[i]->next[i] = node_todel->next[i];
+      /* Never freed: searches may still be traversing it */
+      ma_retire(sizeof(sl_node_t) + toplevel * sizeof(sl_node_t *));
       UNLOCK(&node_todel->lock);	
       unlock_levels(preds, highest_locked, 22);
       /* Freeing the previously allocated memory */
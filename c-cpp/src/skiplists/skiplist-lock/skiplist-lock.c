@@ -86,6 +86,7 @@ sl_node_t *sl_new_simple_node(val_t val, int toplevel, int transactional)
 	
 	node = (sl_node_t *)xmalloc(sizeof(sl_node_t));
 	node->next = (sl_node_t **)xmalloc(toplevel * sizeof(sl_node_t *));
+	ma_alloc(sizeof(sl_node_t) + toplevel * sizeof(sl_node_t *));
 	node->val = val;
 	node->toplevel = toplevel;
 	node->marked = 0;
@@ -116,6 +117,7 @@ void sl_delete_node(sl_node_t *n)
 	DESTROY_LOCK(&n->lock);
 	free(n->next);
 	free(n);
+	ma_free(sizeof(sl_node_t) + n->toplevel * sizeof(sl_node_t *));
 }
 
 sl_intset_t *sl_set_new()
@@ -4,9 +4,16 @@ int perform_one_insert_window_operation(thread_data_t* data, seekRecord_t * R, s
   node_t *newInt ;
 	node_t *newLeaf;
   if(data->recycledNodes.empty()){
+#ifdef SMR_ENABLED
+    // nodes are retired one by one
+    newInt = (node_t *)smr_alloc(sizeof(node_t));
+    newLeaf = (node_t *)smr_alloc(sizeof(node_t));
+#else
 	  node_t * allocedNodeArr =(node_t *)xmalloc(2*sizeof(node_t));
     newInt = &allocedNodeArr[0];
     newLeaf = &allocedNodeArr[1]; 
+    ma_alloc(2*sizeof(node_t));
+#endif
   }
   else{ 
     // reuse memory of previously allocated nodes.
@@ -63,6 +70,41 @@ int perform_one_insert_window_operation(thread_data_t* data, seekRecord_t * R, s
 
 /*************************************************************************************************/
 
+// Retires the nodes removed by a successful cas on the child of R->lum: the
+// chain of nodes from R->lumC down to the parent of pKeep, which replaced it,
+// and their other children, flagged leaves. All their edges are marked or
+// flagged, so the chain no longer changes once it has been removed.
+void retire_window(seekRecord_t * R, AO_t pKeep){
+  node_t * keep = (node_t *)get_addr(pKeep);
+  node_t * n = (node_t *)get_addr(R->lumC);
+  AO_t l, r;
+	
+  while(true){
+    l = n->child.AO_val1;
+    r = n->child.AO_val2;
+    smr_retire(n, sizeof(node_t));
+    if((node_t *)get_addr(l) == keep){
+      smr_retire((node_t *)get_addr(r), sizeof(node_t));
+      return;
+    }
+    if((node_t *)get_addr(r) == keep){
+      smr_retire((node_t *)get_addr(l), sizeof(node_t));
+      return;
+    }
+    // follow the marked edge, the other one leads to a flagged leaf
+    if(is_marked(l)){
+      smr_retire((node_t *)get_addr(r), sizeof(node_t));
+      n = (node_t *)get_addr(l);
+    }
+    else{
+      smr_retire((node_t *)get_addr(l), sizeof(node_t));
+      n = (node_t *)get_addr(r);
+    }
+  }
+}
+
+/*************************************************************************************************/
+
 int perform_one_delete_window_operation(thread_data_t* data, seekRecord_t * R, size_t key){
   
   AO_t pS;
@@ -71,11 +113,11 @@ int perform_one_delete_window_operation(thread_data_t* data, seekRecord_t * R, s
   if(R->isLeftL){
     // L is the left child of P
     mark_Node(&R->parent->child.AO_val2);
-    pS = R->parent->child.AO_val2;
+    pS = read_child(R->parent->child.AO_val2);
   }
   else{
     mark_Node(&R->parent->child.AO_val1);
-    pS = R->parent->child.AO_val1;
+    pS = read_child(R->parent->child.AO_val1);
   }
 	 	
   AO_t newWord;
@@ -96,6 +138,9 @@ int perform_one_delete_window_operation(thread_data_t* data, seekRecord_t * R, s
     result = atomic_cas_full(&R->lum->child.AO_val2, R->lumC, newWord);
   }
 
+  if(result == 1){
+    retire_window(R, pS);
+  }
   return result;	
 }
 
@@ -109,7 +154,7 @@ seekRecord_t * insseek(thread_data_t * data, size_t key, int op){
 	
 	
 	AO_t parentPointerWord = 0; // contents in gpar
-	AO_t leafPointerWord = par->child.AO_val1; // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
+	AO_t leafPointerWord = read_child(par->child.AO_val1); // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
 	AO_t leafchildPointerWord; // contents in leaf
 	
 	bool isparLC = false; // is par the left child of gpar
@@ -119,12 +164,12 @@ seekRecord_t * insseek(thread_data_t * data, size_t key, int op){
 	
 	leaf = (node_t *)get_addr(leafPointerWord);
 		if(key < leaf->key){
-			leafchildPointerWord = leaf->child.AO_val1;
+			leafchildPointerWord = read_child(leaf->child.AO_val1);
 			isleafchildLC = true;
 			
 		}
 		else{
-			leafchildPointerWord = leaf->child.AO_val2;
+			leafchildPointerWord = read_child(leaf->child.AO_val2);
 			isleafchildLC = false;
 		}
 	
@@ -147,11 +192,11 @@ seekRecord_t * insseek(thread_data_t * data, size_t key, int op){
 		
 		
 		if(key < leaf->key){
-			leafchildPointerWord = leaf->child.AO_val1;
+			leafchildPointerWord = read_child(leaf->child.AO_val1);
 			isleafchildLC = true;
 		}
 		else{
-			leafchildPointerWord = leaf->child.AO_val2;
+			leafchildPointerWord = read_child(leaf->child.AO_val2);
 			isleafchildLC = false;
 		}	
 		
@@ -190,7 +235,7 @@ seekRecord_t * delseek(thread_data_t * data, size_t key, int op){
 	
 	
 	AO_t parentPointerWord = 0; // contents in gpar
-	AO_t leafPointerWord = par->child.AO_val1; // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
+	AO_t leafPointerWord = read_child(par->child.AO_val1); // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
 	AO_t leafchildPointerWord; // contents in leaf
 	
 	bool isparLC = false; // is par the left child of gpar
@@ -200,12 +245,12 @@ seekRecord_t * delseek(thread_data_t * data, size_t key, int op){
 	
 	leaf = (node_t *)get_addr(leafPointerWord);
 		if(key < leaf->key){
-			leafchildPointerWord = leaf->child.AO_val1;
+			leafchildPointerWord = read_child(leaf->child.AO_val1);
 			isleafchildLC = true;
 			
 		}
 		else{
-			leafchildPointerWord = leaf->child.AO_val2;
+			leafchildPointerWord = read_child(leaf->child.AO_val2);
 			isleafchildLC = false;
 		}
 	
@@ -228,11 +273,11 @@ seekRecord_t * delseek(thread_data_t * data, size_t key, int op){
 		
 		
 		if(key < leaf->key){
-			leafchildPointerWord = leaf->child.AO_val1;
+			leafchildPointerWord = read_child(leaf->child.AO_val1);
 			isleafchildLC = true;
 		}
 		else{
-			leafchildPointerWord = leaf->child.AO_val2;
+			leafchildPointerWord = read_child(leaf->child.AO_val2);
 			isleafchildLC = false;
 		}	
 		
@@ -274,7 +319,7 @@ seekRecord_t * secondary_seek(thread_data_t * data, size_t key, seekRecord_t * s
 	node_t * leafchild;
 	
 	AO_t parentPointerWord = 0; // contents in gpar
-	AO_t leafPointerWord = par->child.AO_val1; // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
+	AO_t leafPointerWord = read_child(par->child.AO_val1); // contents in par. Tree has two imaginary keys \inf_{1} and \inf_{2} which are larger than all other keys. 
 	AO_t leafchildPointerWord; // contents in leaf
 	
 	bool isparLC = false; // is par the left child of gpar
@@ -284,11 +329,11 @@ seekRecord_t * secondary_seek(thread_data_t * data, size_t key, seekRecord_t * s
 	
 	leaf = (node_t *)get_addr(leafPointerWord);
 	if(key < leaf->key){
-	  leafchildPointerWord = leaf->child.AO_val1;
+	  leafchildPointerWord = read_child(leaf->child.AO_val1);
 		isleafchildLC = true;
 	}
 	else{
-		leafchildPointerWord = leaf->child.AO_val2;
+		leafchildPointerWord = read_child(leaf->child.AO_val2);
 		isleafchildLC = false;
 	}
 	
@@ -308,11 +353,11 @@ seekRecord_t * secondary_seek(thread_data_t * data, size_t key, seekRecord_t * s
 		leaf = leafchild;
 		
 		if(key < leaf->key){
-			leafchildPointerWord = leaf->child.AO_val1;
+			leafchildPointerWord = read_child(leaf->child.AO_val1);
 			isleafchildLC = true;
 		}
 		else{
-			leafchildPointerWord = leaf->child.AO_val2;
+			leafchildPointerWord = read_child(leaf->child.AO_val2);
 			isleafchildLC = false;
 		}	
 		
@@ -345,17 +390,96 @@ seekRecord_t * secondary_seek(thread_data_t * data, size_t key, seekRecord_t * s
 
 bool search(thread_data_t * data, size_t key){
 	
-	node_t * cur = (node_t *)get_addr(data->rootOfTree->child.AO_val1);
+	smr_begin();
+	node_t * cur = (node_t *)get_addr(read_child(data->rootOfTree->child.AO_val1));
 	size_t lastKey;	
 	while(cur != NULL){
 	  lastKey = cur->key;
-		cur = (key < lastKey? (node_t *)get_addr(cur->child.AO_val1): (node_t *)get_addr(cur->child.AO_val2));
+		cur = (key < lastKey? (node_t *)get_addr(read_child(cur->child.AO_val1)): (node_t *)get_addr(read_child(cur->child.AO_val2)));
 	}
+	smr_end();
 	
   return (key == lastKey);
 }
 
 
+// Finds the smallest key >= key in a leaf: the leaf reached by the search
+// for key, or else the leftmost leaf right of the last node where the
+// search turned left.
+bool ceiling(thread_data_t * data, size_t key, size_t * res){
+	
+	smr_begin();
+	node_t * cur = (node_t *)get_addr(read_child(data->rootOfTree->child.AO_val1));
+	node_t * alt = NULL;
+	node_t * next;
+	while((next = (node_t *)get_addr(read_child(cur->child.AO_val1))) != NULL){
+		if(key < (size_t)cur->key)
+			alt = cur;
+		else
+			next = (node_t *)get_addr(read_child(cur->child.AO_val2));
+		cur = next;
+	}
+	if((size_t)cur->key < key && alt != NULL){
+		cur = (node_t *)get_addr(read_child(alt->child.AO_val2));
+		while((next = (node_t *)get_addr(read_child(cur->child.AO_val1))) != NULL)
+			cur = next;
+	}
+	*res = cur->key;
+	smr_end();
+	
+	// Sentinel leaves are above the key range
+	return (*res >= key && *res <= (size_t)data->range);
+}
+
+bool successor(thread_data_t * data, size_t key, size_t * succ){
+	return ceiling(data, key + 1, succ);
+}
+
+// Collects the keys of [lo,hi] in keys (up to max of them), or counts them
+// if keys is NULL. The scan visits the subtrees overlapping the range
+// depth-first; removed internal nodes keep their child words, so a leaf
+// present during the whole scan is reached (see scan.h).
+long range_collect(thread_data_t * data, size_t lo, size_t hi, size_t * keys, long max){
+	
+	long count = 0;
+	if(keys != NULL && max <= 0)
+		return 0;
+	if(hi > (size_t)data->range)
+		hi = data->range;
+	std::vector<node_t *> & stack = data->scanStack;
+	size_t last = 0;
+	stack.clear();
+	smr_begin();
+	stack.push_back((node_t *)get_addr(read_child(data->rootOfTree->child.AO_val1)));
+	while(!stack.empty()){
+		node_t * cur = stack.back();
+		stack.pop_back();
+		node_t * left = (node_t *)get_addr(read_child(cur->child.AO_val1));
+		size_t ckey = cur->key;
+		if(left == NULL){
+			// Leaves are popped in increasing order of keys
+			if(ckey < lo || ckey > hi || (count > 0 && ckey <= last))
+				continue;
+			last = ckey;
+			if(keys != NULL)
+				keys[count] = ckey;
+			if(++count == max)
+				break;
+			continue;
+		}
+		if(hi >= ckey)
+			stack.push_back((node_t *)get_addr(read_child(cur->child.AO_val2)));
+		if(lo < ckey)
+			stack.push_back(left);
+	}
+	smr_end();
+	return count;
+}
+
+long range_count(thread_data_t * data, size_t lo, size_t hi){
+	return range_collect(data, lo, hi, NULL, 0);
+}
+
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -369,12 +493,12 @@ int help_conflicting_operation (thread_data_t * data, seekRecord_t * R){
 		if(R->isLeftL){
 			// L is the left child of P
 			mark_Node(&R->parent->child.AO_val2);
-			pS = R->parent->child.AO_val2;
+			pS = read_child(R->parent->child.AO_val2);
 			
 		}
 		else{
 			mark_Node(&R->parent->child.AO_val1);
-			pS = R->parent->child.AO_val1;
+			pS = read_child(R->parent->child.AO_val1);
 		}
 		
 		// 2. Execute cas on the last unmarked node to remove the 
@@ -397,6 +521,9 @@ int help_conflicting_operation (thread_data_t * data, seekRecord_t * R){
 			 result = atomic_cas_full(&R->lum->child.AO_val2, R->lumC, newWord);
 		}
 		
+		if(result == 1){
+			retire_window(R, pS);
+		}
 		return result; 
 		
 	}
@@ -422,6 +549,9 @@ int help_conflicting_operation (thread_data_t * data, seekRecord_t * R){
 			result = atomic_cas_full(&R->lum->child.AO_val2, R->lumC, newWord);
 		}
 		
+		if(result == 1){
+			retire_window(R, R->pL);
+		}
     return result; 
 	}	
 		
@@ -456,10 +586,12 @@ bool insert(thread_data_t * data, size_t key){
   int injectResult;
   int fasttry = 0;	
 	
+	smr_begin();
 	while(true){
 		seekRecord_t * R = insseek(data, key, INS);
 		fasttry++;
 		if(R == NULL){
+			smr_end();
 			if(fasttry == 1){
 				return false;
 			}
@@ -479,6 +611,7 @@ bool insert(thread_data_t * data, size_t key){
 		if(injectResult == 1){
 			// Operation injected and executed
 			
+			smr_end();
 			return true;
 		}
 		
@@ -489,10 +622,12 @@ bool insert(thread_data_t * data, size_t key){
 bool delete_node(thread_data_t * data, size_t key){
 	int injectResult;
 	
+	smr_begin();
 	while(true){
 		seekRecord_t * R = delseek(data, key, DEL);
 		
 		if(R == NULL){
+			smr_end();
 			return false;
 		}
 		
@@ -516,6 +651,7 @@ bool delete_node(thread_data_t * data, size_t key){
 			
 			if(res == 1){
 				// operation successfully executed.
+				smr_end();
 				return true;
 			}
 			else{
@@ -527,12 +663,14 @@ bool delete_node(thread_data_t * data, size_t key){
 					
 					if(R == NULL){
 						// flagged leaf not found. Operation has been executed by some other process.
+						smr_end();
 						return false;
 					}
 					
 					res = perform_one_delete_window_operation(data, R, key);
 					
 					if(res == 1){
+						smr_end();
 						return true;
 					}
 				}
@@ -28,6 +28,8 @@
 
 #include "wfrbt.h"
 #include "operations.h"
+#include "timeseries.h"
+#include "scan.h"
 
 #define DEFAULT_DURATION                1000
 #define DEFAULT_INITIAL                 256
@@ -136,10 +138,15 @@ void *test3(void *data) {
 	
   thread_data_t *d = (thread_data_t *)data;
 	
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   while (stop == 0) {;}
+  pc_stop(d->pc);
   return NULL;
 }
 
@@ -150,11 +157,15 @@ void *test(void *data) {
 
   thread_data_t *d = (thread_data_t *)data;
 
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   /* Is the first op an update? */
-  unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+  unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 
   //#ifdef ICC
   while (stop == 0) {
@@ -164,11 +175,11 @@ void *test(void *data) {
 		
     if (unext) { // update
 			
-      if (last < 0) { // add
+      if ((long)last < 0) { // add
 				
-	val = rand_range_re(&d->seed, d->range);
+	val = wl_key(&d->wl);
 	assert(val > 0);
-	if (insert(d,val)) {
+	if (LAT_OP(d->lat, LAT_ADD, insert(d,val))) {
 	  last = val;
 	} 				
 	d->nb_add++;
@@ -177,16 +188,16 @@ void *test(void *data) {
 				
 	if (d->alternate) { // alternate mode (default)
 					
-	  delete_node(d, last);
+	  LAT_OP(d->lat, LAT_REMOVE, delete_node(d, last));
 	  
 	  last = -1;
 					
 	} else {
 					
 	  // Random computation only in non-alternated cases 
-	  val = rand_range_re(&d->seed, d->range);
+	  val = wl_key(&d->wl);
 	  // Remove one random value 
-	  if (delete_node(d, val)) {
+	  if (LAT_OP(d->lat, LAT_REMOVE, delete_node(d, val))) {
 	    // Repeat until successful, to avoid size variations 
 	    last = -1;
 	  } 
@@ -195,34 +206,49 @@ void *test(void *data) {
 	d->nb_remove++;
       }
 			
+    } else if (scan_next(&d->wl, d->update, d->scan)) { // range scan or successor query
+
+      val = wl_key(&d->wl);
+      switch (d->scan_op) {
+      case SCAN_COUNT:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, range_count(d, val, scan_hi(val, d->scan_length, d->range)));
+	break;
+      case SCAN_SUCCESSOR:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, successor(d, val, d->scan_keys));
+	break;
+      default:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, range_collect(d, val, scan_hi(val, d->scan_length, d->range), d->scan_keys, d->scan_length));
+      }
+      d->nb_scan++;
+
     } else { // read
 			
 			
       if (d->alternate) {
 	if (d->update == 0) {
-	  if (last < 0) {
+	  if ((long)last < 0) {
 	    val = d->first;
 	    last = val;
 	  } else { // last >= 0
-	    val = rand_range_re(&d->seed, d->range);
+	    val = wl_key(&d->wl);
 	    last = -1;
 	  }
 	} else { // update != 0
-	  if (last < 0) {
-	    val = rand_range_re(&d->seed, d->range);
+	  if ((long)last < 0) {
+	    val = wl_key(&d->wl);
 	    //last = val;
 	  } else {
 	    val = last;
 	  }
 	}
-      }	else val = rand_range_re(&d->seed, d->range);
+      }	else val = wl_key(&d->wl);
 			
       /*if (d->effective && last)
 	val = last;
 	else 
-	val = rand_range_re(&d->seed, d->range);*/
+	val = wl_key(&d->wl);*/
 			
-      if (search(d, val)) 
+      if (LAT_OP(d->lat, LAT_CONTAINS, search(d, val))) 
 	      d->nb_found++;
       d->nb_contains++;
 			
@@ -231,9 +257,9 @@ void *test(void *data) {
     /* Is the next op an update? */
     if (d->effective) { // a failed remove/add is a read-only tx
       unext = ((100 * (d->nb_added + d->nb_removed))
-	       < (d->update * (d->nb_add + d->nb_remove + d->nb_contains)));
+	       < (d->update * (d->nb_add + d->nb_remove + d->nb_contains + d->nb_scan)));
     } else { // remove/add (even failed) is considered as an update
-      unext = ((rand_range_re(&d->seed, 100) - 1) < d->update);
+      unext = ((wl_rand_range(&d->wl, 100) - 1) < d->update);
     }
 		
     //#ifdef ICC
@@ -241,6 +267,7 @@ void *test(void *data) {
   //#else
   //	}
   //#endif /* ICC */
+  pc_stop(d->pc);
 	
   return NULL;
 }
@@ -257,8 +284,12 @@ void *test2(void *data)
   pthread_setspecific(rng_seed_key, &d->seed);
 #endif /* ! TLS */
 	
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   last = -1;
 	
@@ -268,27 +299,27 @@ void *test2(void *data)
     while (AO_load_full(&stop) == 0) {
 #endif /* ICC */
 			
-      val = rand_range_re(&d->seed, 100) - 1;
+      val = wl_rand_range(&d->wl, 100) - 1;
       if (val < d->update) {
-	if (last < 0) {
+	if ((long)last < 0) {
 	  /* Add random value */
-	  val = rand_range_re(&d->seed, d->range);
-	  if (insert(d, val)) {
+	  val = wl_key(&d->wl);
+	  if (LAT_OP(d->lat, LAT_ADD, insert(d, val))) {
 	    last = val;
 	  }
 	  d->nb_add++;
 	} else {
 	  if (d->alternate) {
 	    /* Remove last value */
-	    if (delete_node(d, last)) {
+	    if (LAT_OP(d->lat, LAT_REMOVE, delete_node(d, last))) {
 	      last = -1; 
 	    }
 	    d->nb_remove++;
 	  } else {
 	    /* Random computation only in non-alternated cases */
-	    newval = rand_range_re(&d->seed, d->range);
+	    newval = wl_key(&d->wl);
 	    /* Remove one random value */
-	    if (delete_node(d, newval)) {
+	    if (LAT_OP(d->lat, LAT_REMOVE, delete_node(d, newval))) {
 	      /* Repeat until successful, to avoid size variations */
 	      last = -1;
 	    }
@@ -297,13 +328,14 @@ void *test2(void *data)
 	}
       } else {
 	/* Look for random value */
-	val = rand_range_re(&d->seed, d->range);
-	if (search(d, val))
+	val = wl_key(&d->wl);
+	if (LAT_OP(d->lat, LAT_CONTAINS, search(d, val)))
 	  d->nb_found++;
 	d->nb_contains++;
       }
 			
     }
+    pc_stop(d->pc);
 		
     return NULL;
   }
@@ -316,6 +348,17 @@ void *test2(void *data)
       // These options don't set a flag
       {"help",                      no_argument,       NULL, 'h'},
       {"duration",                  required_argument, NULL, 'd'},
+      {"latency",                   required_argument, NULL, 'L'},
+      {"key-dist",                  required_argument, NULL, 'K'},
+      {"pin",                       required_argument, NULL, 'P'},
+      {"numa",                      required_argument, NULL, 'N'},
+      {"counters",                  required_argument, NULL, 'C'},
+      {"interval",                  required_argument, NULL, 'T'},
+      {"rate",                      required_argument, NULL, 'O'},
+      {"arrival",                   required_argument, NULL, 'E'},
+      {"scan-rate",                 required_argument, NULL, 'R'},
+      {"scan-length",               required_argument, NULL, 'Q'},
+      {"scan-op",                   required_argument, NULL, 'q'},
       {"initial-size",              required_argument, NULL, 'i'},
       {"thread-num",                required_argument, NULL, 't'},
       {"range",                     required_argument, NULL, 'r'},
@@ -330,6 +373,7 @@ void *test2(void *data)
     int i, c, size;
     val_t last = 0; 
     val_t val = 0;
+    unsigned long scans, scanned;
     unsigned long reads, effreads, updates, effupds, aborts, aborts_locked_read, 
       aborts_locked_write, aborts_validate_read, aborts_validate_write, 
       aborts_validate_commit, aborts_invalid_memory, max_retries;
@@ -340,6 +384,22 @@ void *test2(void *data)
     struct timeval start, end;
     struct timespec timeout;
     int duration = DEFAULT_DURATION;
+    int latency = DEFAULT_LATENCY;
+    const char *keydist = DEFAULT_KEYDIST;
+    workload_t workload;
+    const char *pin = DEFAULT_PIN;
+    const char *numa = DEFAULT_NUMA;
+    affinity_t aff;
+    int counters = DEFAULT_COUNTERS;
+    int interval = DEFAULT_INTERVAL;
+    int rate = DEFAULT_RATE;
+    int scan = DEFAULT_SCAN;
+    int scan_length = DEFAULT_SCAN_LENGTH;
+    int scan_op = scan_parse(DEFAULT_SCAN_OP);
+    const char *arrival = DEFAULT_ARRIVAL;
+    int poisson;
+    unsigned long ops;
+    ts_t ts;
     int initial = DEFAULT_INITIAL;
     int nb_threads = DEFAULT_NB_THREADS;
     long range = DEFAULT_RANGE;
@@ -352,7 +412,7 @@ void *test2(void *data)
 		
     while(1) {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:"
+      c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:L:K:P:N:C:T:O:E:R:Q:q:"
 		      , long_options, &i);
 			
       if(c == -1)
@@ -390,6 +450,29 @@ void *test2(void *data)
 	       "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 	       "  -u, --update-rate <int>\n"
 	       "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+	       "  -L, --latency <int>\n"
+	       "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+	       "  -K, --key-dist <dist>\n"
+	       "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+	       "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+	       "  -P, --pin <policy>\n"
+	       "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+	       "  -N, --numa <policy>\n"
+	       "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+	       "  -C, --counters <int>\n"
+	       "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+	       "  -T, --interval <int>\n"
+	       "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+	       "  -O, --rate <int>\n"
+	       "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+	       "  -E, --arrival <process>\n"
+	       "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
+	       "  -R, --scan-rate <int>\n"
+	       "        Percentage of range scans (default=" XSTR(DEFAULT_SCAN) ")\n"
+	       "  -Q, --scan-length <int>\n"
+	       "        Number of keys of the range of a scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+	       "  -q, --scan-op <op>\n"
+	       "        Operation of a scan: collect, count or successor (default=" DEFAULT_SCAN_OP ")\n"
 	       "  -x, --unit-tx (default=1)\n"
 	       "        Use unit transactions\n"
 	       "        0 = non-protected,\n"
@@ -428,6 +511,39 @@ void *test2(void *data)
       case 'x':
 	unit_tx = atoi(optarg);
 	break;
+      case 'K':
+	keydist = optarg;
+	break;
+      case 'P':
+	pin = optarg;
+	break;
+      case 'N':
+	numa = optarg;
+	break;
+      case 'C':
+	counters = atoi(optarg);
+	break;
+      case 'T':
+	interval = atoi(optarg);
+	break;
+      case 'O':
+	rate = atoi(optarg);
+	break;
+      case 'E':
+	arrival = optarg;
+	break;
+      case 'R':
+	scan = atoi(optarg);
+	break;
+      case 'Q':
+	scan_length = atoi(optarg);
+	break;
+      case 'q':
+	scan_op = scan_parse(optarg);
+	break;
+      case 'L':
+	latency = atoi(optarg);
+	break;
       case '?':
 	printf("Use -h or --help for help\n");
 	exit(0);
@@ -441,6 +557,12 @@ void *test2(void *data)
     assert(nb_threads > 0);
     assert(range > 0 && range >= initial);
     assert(update >= 0 && update <= 100);
+    scan_check(update, scan, scan_length);
+    wl_init(&workload, keydist, range);
+    aff_init(&aff, pin, numa, nb_threads);
+    poisson = lat_poisson(arrival);
+    if (rate > 0 && latency == 0)
+      latency = 1;
 		
     printf("Set type     : BST\n");
     printf("Duration     : %d\n", duration);
@@ -449,6 +571,13 @@ void *test2(void *data)
     printf("Value range  : %ld\n", range);
     printf("Seed         : %d\n", seed);
     printf("Update rate  : %d\n", update);
+    printf("Latency      : %d\n", latency);
+    printf("Key dist.    : %s\n", keydist);
+    aff_print(&aff, pin, numa);
+    printf("Counters     : %d\n", counters);
+    printf("Interval     : %d\n", interval);
+    printf("Rate         : %d (%s)\n", rate, arrival);
+    printf("Scan rate    : %d (%s, length %d)\n", scan, scan_name(scan_op), scan_length);
     printf("Lock alg.    : %d\n", unit_tx);
     printf("Alternate    : %d\n", alternate);
     printf("Effective    : %d\n", effective);
@@ -461,7 +590,7 @@ void *test2(void *data)
     timeout.tv_sec = duration / 1000;
     timeout.tv_nsec = (duration % 1000) * 1000000;
 		
-    data = (thread_data_t *)xmalloc(nb_threads * sizeof(thread_data_t));
+    data = new thread_data_t[nb_threads];
     threads = (pthread_t *)xmalloc(nb_threads * sizeof(pthread_t));
 		
     if (seed == 0)
@@ -477,6 +606,10 @@ void *test2(void *data)
  newRT->key = range+2;
  newLC->key = range+1;
  newRC->key = range+2;
+ newLC->child.AO_val1 = 0;
+ newLC->child.AO_val2 = 0;
+ newRC->child.AO_val1 = 0;
+ newRC->child.AO_val2 = 0;
  
  
  newRT->child.AO_val1 = create_child_word(newLC,UNMARK, UNFLAG);
@@ -505,6 +638,7 @@ void *test2(void *data)
     printf("Adding %d entries to set\n",initial);
     i = 0;
     while (i < initial) {
+      aff_populate(&aff, i, initial);
       val = rand_range_re(&global_seed, range);
       if (insert(&data[0], val)) {
 	last = val;
@@ -512,6 +646,7 @@ void *test2(void *data)
 	i++;
       }
     }
+    aff_populate_done(&aff);
     
     size = data[0].nb_added + 2; /// Add 2 for the 2 sentinel keys
     //size = sl_set_size(set);
@@ -539,6 +674,17 @@ void *test2(void *data)
       data[i].barrier = &barrier;
       data[i].rootOfTree = newRT;
       data[i].id = i;
+      data[i].lat = lat_new(latency);
+      lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+      wl_thread_init(&data[i].wl, &workload, rand(), i, nb_threads);
+      data[i].cpu = aff_cpu(&aff, i);
+      data[i].pc = pc_new(counters);
+      data[i].scan = scan;
+      data[i].scan_length = scan_length;
+      data[i].scan_op = scan_op;
+      data[i].nb_scan = 0;
+      data[i].nb_scanned = 0;
+      data[i].scan_keys = (size_t *)xmalloc(scan_length * sizeof(size_t));
       data[i].recycledNodes.reserve(RECYCLED_VECTOR_RESERVE);
       data[i].sr = new seekRecord_t;
       data[i].ssr = new seekRecord_t;
@@ -555,7 +701,16 @@ void *test2(void *data)
     printf("STARTING...\n");
     gettimeofday(&start, NULL);
     if (duration > 0) {
-      nanosleep(&timeout, NULL);
+      if (interval > 0) {
+        ts_init(&ts, interval, duration);
+        while (ts_wait(&ts)) {
+          for (ops = 0, i = 0; i < nb_threads; i++)
+            ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains + data[i].nb_scan;
+          ts_sample(&ts, ops);
+        }
+      } else {
+        nanosleep(&timeout, NULL);
+      }
     } else {
       sigemptyset(&block_set);
       sigsuspend(&block_set);
@@ -581,6 +736,8 @@ void *test2(void *data)
     duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - 
       (start.tv_sec * 1000 + start.tv_usec / 1000);
     reads = 0;
+    scans = 0;
+    scanned = 0;
     effreads = 0;
     updates = 0;
     effupds = 0;
@@ -593,8 +750,10 @@ void *test2(void *data)
       printf("    #removed  : %lu\n", data[i].nb_removed);
       printf("  #contains   : %lu\n", data[i].nb_contains);
       printf("  #found      : %lu\n", data[i].nb_found);
-      reads += data[i].nb_contains;
-      effreads += data[i].nb_contains + 
+      scans += data[i].nb_scan;
+      scanned += data[i].nb_scanned;
+      reads += data[i].nb_contains + data[i].nb_scan;
+      effreads += data[i].nb_contains + data[i].nb_scan + 
 	(data[i].nb_add - data[i].nb_added) + 
 	(data[i].nb_remove - data[i].nb_removed); 
       updates += (data[i].nb_add + data[i].nb_remove);
@@ -610,13 +769,24 @@ void *test2(void *data)
     printf("Duration      : %d (ms)\n", duration);
     printf("#txs          : %lu (%f / s)\n", reads + updates, 
 	   (reads + updates) * 1000.0 / duration);
+    if (counters) {
+      pc_stats_t *pc = pc_new(counters);
+      for (i = 0; i < nb_threads; i++) {
+        pc_merge(pc, data[i].pc);
+        free(data[i].pc);
+      }
+      pc_print(pc, reads + updates);
+      free(pc);
+    }
 		
     printf("#read txs     : ");
     if (effective) {
       printf("%lu (%f / s)\n", effreads, effreads * 1000.0 / duration);
-      printf("  #contains   : %lu (%f / s)\n", reads, reads * 1000.0 / 
+      printf("  #contains   : %lu (%f / s)\n", reads - scans, (reads - scans) * 1000.0 / 
 	     duration);
     } else printf("%lu (%f / s)\n", reads, reads * 1000.0 / duration);
+    if (scan > 0)
+      scan_print(scans, scanned, duration);
 		
     printf("#eff. upd rate: %f \n", 100.0 * effupds / (effupds + effreads));
 		
@@ -626,8 +796,20 @@ void *test2(void *data)
       printf("  #upd trials : %lu (%f / s)\n", updates, updates * 1000.0 / 
 	     duration);
     } else printf("%lu (%f / s)\n", updates, updates * 1000.0 / duration);
+    ma_print(size);
+    smr_print();
 		
 		
+    if (latency > 0) {
+      lat_stats_t *lat = lat_new(latency);
+      for (i = 0; i < nb_threads; i++) {
+	lat_merge(lat, data[i].lat);
+	free(data[i].lat);
+      }
+      lat_print(lat);
+      free(lat);
+    }
+		
     /* Delete set */
     //sl_set_delete(set);
 		
@@ -636,7 +818,7 @@ void *test2(void *data)
 #endif /* ! TLS */
 		
     free(threads);
-    free(data);
+    delete[] data;
 		
     return 0;
   }
@@ -9,6 +9,12 @@
 #include <vector>
 
 #include "atomic_ops.h"
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "smr.h"
+#include "scan.h"
 
 #define RECYCLED_VECTOR_RESERVE 5000000
 
@@ -55,6 +61,9 @@ typedef struct thread_data {
   int update;
   int alternate;
   int effective;
+  int scan;
+  int scan_length;
+  int scan_op;
   int id;
   unsigned long numThreads;
   unsigned long nb_add;
@@ -63,6 +72,9 @@ typedef struct thread_data {
   unsigned long nb_removed;
   unsigned long nb_contains;
   unsigned long nb_found;
+  unsigned long nb_scan;
+  unsigned long nb_scanned;
+  size_t *scan_keys;
   unsigned long ops;
   unsigned int seed;
   double search_frac;
@@ -72,8 +84,13 @@ typedef struct thread_data {
   node_t* rootOfTree;
   barrier_t *barrier;
   std::vector<node_t *> recycledNodes;
+  std::vector<node_t *> scanStack; // range_collect() traversal
   seekRecord_t * sr; // seek record
   seekRecord_t * ssr; // secondary seek record
+  lat_stats_t *lat;
+  wl_thread_t wl;
+  int cpu;
+  pc_stats_t *pc;
 
 } thread_data_t;
 
@@ -120,6 +137,8 @@ bool mark_Node(volatile AO_t * word){
 #define is_flagged(x) ( (x & 1 )  == 1 ? true:false)
 
 #define get_addr(x) (x >> 2)
+// Reads a child word, protecting the child with the reclamation scheme
+#define read_child(x) ((AO_t)smr_protect(0, (void *volatile *)&(x)))
 #define add_mark_bit(x) (x + 4UL)
 #define is_free(x) (((x) & 3) == 0? true:false)
 
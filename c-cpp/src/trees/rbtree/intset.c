@@ -58,11 +58,35 @@ int set_size(intset_t *set)
   return size;
 }
 
+#ifdef FC
+/* Adapters of the operations applied by the combiner (see fc.h) */
+int set_contains(intset_t *set, val_t val, int transactional);
+int set_add(intset_t *set, val_t val, int transactional);
+int set_remove(intset_t *set, val_t val, int transactional);
+
+static int fc_set_contains(void *set, long *a) {
+  return set_contains((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_set_add(void *set, long *a) {
+  return set_add((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+
+static int fc_set_remove(void *set, long *a) {
+  return set_remove((intset_t *)set, (val_t)a[0], (int)a[1]);
+}
+#endif /* FC */
+
 int set_contains(intset_t *set, val_t val, int transactional)
 {
 	int result = 0;
 	void *v;
 
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_set_contains, set, val, transactional, 0, 0);
+#endif /* FC */
+
 	v = (void *)val;
 	
 	switch(transactional) {
@@ -71,7 +95,7 @@ int set_contains(intset_t *set, val_t val, int transactional)
 			break;
 			
 		case 1: /* Normal transaction */	
-			TX_START(NL);
+			TX_START(RO);
 			result = TMrbtree_contains(set, (void *)val);
 			TX_END;
 			break;
@@ -101,6 +125,11 @@ int set_add(intset_t *set, val_t val, int transactional)
 {
   int result = 0;
 
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_set_add, set, val, transactional, 0, 0);
+#endif /* FC */
+
   switch(transactional) {
 	  case 0:
 		  result = rbtree_insert(set, (void *)val, (void *)val);
@@ -134,6 +163,11 @@ int set_remove(intset_t *set, val_t val, int transactional)
 	node_t *next;
 	void *v;
 	
+#ifdef FC
+	if (!fc_combiner())
+		return fc_apply(fc_set_remove, set, val, transactional, 0, 0);
+#endif /* FC */
+
 	next = NULL;
 	v = (void *) val;
 
@@ -30,10 +30,34 @@
 # define UNIT_LOAD(a)    TX_LOAD(a)
 #endif
 
+#ifdef FC
+/* Adapters of the operations applied by the combiner (see fc.h) */
+static int fc_avl_contains(void *set, long *a) {
+  return avl_contains((avl_intset_t *)set, (val_t)a[0], (int)a[1], (int)a[2]);
+}
+
+static int fc_avl_add(void *set, long *a) {
+  return avl_add((avl_intset_t *)set, (val_t)a[0], (int)a[1], (int)a[2]);
+}
+
+static int fc_avl_remove(void *set, long *a) {
+#if defined(MICROBENCH)
+  return avl_remove((avl_intset_t *)set, (val_t)a[0], (int)a[1], (int)a[2]);
+#else
+  return avl_remove((avl_intset_t *)set, (val_t)a[0], (int)a[1]);
+#endif
+}
+#endif /* FC */
+
 int avl_contains(avl_intset_t *set, val_t key, int transactional, int id)
 {
   int result = 0;
 
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_avl_contains, set, key, transactional, id, 0);
+#endif /* FC */
+
 #ifdef SEQUENTIAL /* Unprotected */	
   val_t val;
   avl_node_t *next;
@@ -107,6 +131,11 @@ int avl_add(avl_intset_t *set, val_t key, int transactional, int id)
 {
   int result = 0;
 
+#ifdef FC
+  if (!fc_combiner())
+    return fc_apply(fc_avl_add, set, key, transactional, id, 0);
+#endif /* FC */
+
   if (!transactional) {
 		
 #ifdef TFAVLSEQ
@@ -293,6 +322,15 @@ int avl_remove(avl_intset_t *set, val_t key, int transactional)
 {
   int result = 0;
 	
+#ifdef FC
+  if (!fc_combiner())
+#if defined(MICROBENCH)
+    return fc_apply(fc_avl_remove, set, key, transactional, id, 0);
+#else
+    return fc_apply(fc_avl_remove, set, key, transactional, 0, 0);
+#endif
+#endif /* FC */
+
 #ifdef SEQUENTIAL
 
 #ifdef TFAVLSEQ
@@ -363,6 +401,7 @@ int avl_req_seq_delete(avl_node_t *parent, avl_node_t *node, val_t key, int go_l
 	  }
 #endif
 	  free(node);
+	  ma_free(sizeof(avl_node_t));
 	  *success = 1;
 	  return 1;
 	} else if(node->right == NULL) {
@@ -400,6 +439,7 @@ int avl_req_seq_delete(avl_node_t *parent, avl_node_t *node, val_t key, int go_l
 	  }
 #endif
 	  free(node);
+	  ma_free(sizeof(avl_node_t));
 	  *success = 1;
 	  return 1;
 	} else {
@@ -443,6 +483,7 @@ int avl_req_seq_delete(avl_node_t *parent, avl_node_t *node, val_t key, int go_l
 	  }
 #endif
 	  free(node);
+	  ma_free(sizeof(avl_node_t));
 	  *success = 1;
 	  return avl_seq_propogate(parent, succs, go_left);
 	}
@@ -817,7 +858,7 @@ int avl_search(val_t key, const avl_intset_t *set) {
 #endif
 #endif
 
-  TX_START(NL);
+  TX_START(RO);
   place = set->root;
   done = 0;
   
@@ -986,6 +1027,10 @@ int avl_insert(val_t v, val_t key, const avl_intset_t *set) {
 
   TX_END;
 
+  /* Account the new node once, aborted attempts allocated it again */
+  if(ret == 2)
+    ma_alloc(sizeof(avl_node_t));
+
 #ifdef DEL_COUNT
   if(del_val > DEL_THRESHOLD) {
     if(set->active_del[id]) {
@@ -1149,6 +1194,10 @@ int avl_insert(val_t v, val_t key, const avl_intset_t *set) {
 
   TX_END;
 
+  /* Account the new node once, aborted attempts allocated it again */
+  if(ret == 2)
+    ma_alloc(sizeof(avl_node_t));
+
 #ifdef DEL_COUNT
 #ifndef MICROBENCH
   id = thread_getId();
@@ -1353,6 +1402,7 @@ int avl_delete(val_t key, const avl_intset_t *set) {
        //Should only do this if in a transaction
        TX_STORE(&free_list->next, free_item);
 #endif
+       ma_retire(sizeof(avl_node_t));
        
      }
      tmp = next;
@@ -1363,6 +1413,10 @@ int avl_delete(val_t key, const avl_intset_t *set) {
  }
 #endif
 
+/*
+ * Returns 2 if place was unlinked and freed. The caller accounts for it
+ * once the transaction has committed.
+ */
 int remove_node(avl_node_t *parent, avl_node_t *place) {
   avl_node_t *right_child, *left_child, *parent_child;
   int go_left;
@@ -1966,6 +2020,7 @@ int avl_propagate(avl_node_t *node, int left, int *should_rotate) {
 	   next_list_item = (free_list_item *)malloc(sizeof(free_list_item));
 	   next_list_item->next = NULL;
 	   next_list_item->to_free = next;
+	   ma_retire(sizeof(avl_node_t));
 	   free_list->next = next_list_item;
 	   free_list = next_list_item;	 
 	 }  
@@ -2249,6 +2304,7 @@ balance_node_t* check_expand(balance_node_t *node, int go_left) {
       next_list_item = (free_list_item *)malloc(sizeof(free_list_item));
       next_list_item->next = NULL;
       next_list_item->to_free = node->anode;
+      ma_retire(sizeof(avl_node_t));
       free_list->next = next_list_item;
       free_list = next_list_item;
 
@@ -2378,6 +2434,7 @@ balance_node_t* check_expand(balance_node_t *node, int go_left) {
     if((left == NULL && right == NULL) && del && parent != NULL) {
       rem_succs = remove_node(parent, node);
       if(rem_succs > 1) {
+	ma_free(sizeof(avl_node_t));
       	return 1;
       }
     }
@@ -2479,7 +2536,7 @@ val_t avl_get(val_t key, const avl_intset_t *set) {
 #endif
 #endif  
 
-  TX_START(NL);
+  TX_START(RO);
   place = set->root;
   done = 0;
   
@@ -2554,6 +2611,10 @@ int avl_update(val_t v, val_t key, const avl_intset_t *set) {
     ret = 2;
   }
   TX_END;
+
+  /* Account the new node once, aborted attempts allocated it again */
+  if(ret == 2)
+    ma_alloc(sizeof(avl_node_t));
   return ret;
 }
 
@@ -2897,6 +2958,7 @@ void do_maintenance(avl_intset_t *tree) {
     next = tree->free_list->next;
     while(next != NULL) {
       free(next->to_free);
+      ma_reclaim(sizeof(avl_node_t));
       tmp_item = next;
       next = next->next;
       free(tmp_item);
@@ -2909,6 +2971,7 @@ void do_maintenance(avl_intset_t *tree) {
     while(next != NULL) {
       if(next->to_free != NULL) {
 	free(next->to_free);
+	ma_reclaim(sizeof(avl_node_t));
       }
       tmp_item = next;
       next = next->next;
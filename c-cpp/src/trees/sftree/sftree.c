@@ -66,6 +66,11 @@ avl_node_t *avl_new_simple_node(val_t val, val_t key, int transactional)
   }
 #endif
 
+  /* A transaction may abort after allocating: its caller accounts the
+   * node once the transaction has committed */
+  if (!transactional)
+    ma_alloc(sizeof(avl_node_t));
+
   node->key = key;
   node->val = val;
   
@@ -143,6 +148,7 @@ void avl_delete_node_free(avl_node_t *node, int transactional)
 #endif
     free(node);
   }
+  ma_free(sizeof(avl_node_t));
 }
 
 avl_intset_t *avl_set_new() {
@@ -253,6 +259,8 @@ avl_intset_t *avl_set_new_alloc(int transactional, long nb_threads)
     
   //Should do the smart root like they do in that one paper from Stanford?
   root = avl_new_simple_node(VAL_MAX, VAL_MAX, transactional);
+  if (transactional)
+    ma_alloc(sizeof(avl_node_t));
 
 #ifdef SEPERATE_BALANCE2
   avl_new_balance_node(root, transactional);  
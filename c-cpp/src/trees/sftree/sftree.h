@@ -39,6 +39,7 @@
 //#define RBTREE_H 1
 
 #include "tm.h"
+#include "memacct.h"
 
 //#define MICROBENCH
 
@@ -120,7 +121,7 @@ typedef struct rbtree rbtree_t;
 #endif
 
 
-#ifdef ESTM
+#if defined(ESTM) || defined(NOREC)
 #define TINY10B
 #endif
 
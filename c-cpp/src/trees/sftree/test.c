@@ -23,6 +23,12 @@
  */
 
 #include <unistd.h>
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "timeseries.h"
+#include "memacct.h"
 #include "intset.h"
 
 //#define THROTTLE_NUM  1000
@@ -165,6 +171,10 @@ typedef struct thread_data {
 	unsigned long failures_because_contention;
         unsigned long nb_trans;
   //free_list_item *free_list;
+	lat_stats_t *lat;
+	wl_thread_t wl;
+	int cpu;
+	pc_stats_t *pc;
 } thread_data_t;
 
 typedef struct maintenance_thread_data {
@@ -257,13 +267,17 @@ void *test(void *data) {
 	increase = d->range;
 #endif
 
+	/* Pin thread */
+	aff_pin_self(d->cpu);
+	pc_open(d->pc);
 	/* Create transaction */
 	TM_THREAD_ENTER();
 	/* Wait on barrier */
 	barrier_cross(d->barrier);
+	pc_start(d->pc);
 	
 	/* Is the first op an update? */
-	unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+	unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 	
 #ifdef ICC
 	while (stop == 0) {
@@ -275,17 +289,17 @@ void *test(void *data) {
 			
 			if (last < 0) { // add
 				
-				val = rand_range_re(&d->seed, d->range);
+				val = wl_key(&d->wl);
 #ifdef BIAS_RANGE
-				if(rand_range_re(&d->seed, 1000) < 50) {
-				  increase += rand_range_re(&d->seed, 10);
+				if(wl_rand_range(&d->wl, 1000) < 50) {
+				  increase += wl_rand_range(&d->wl, 10);
 				  if(increase > d->range * 20) {
 				    increase = d->range;
 				  }
 				  val = increase;
 				}
 #endif
-				if ((result = avl_add(d->set, val, TRANSACTIONAL, id)) > 0) {
+				if ((result = LAT_OP(d->lat, LAT_ADD, avl_add(d->set, val, TRANSACTIONAL, id))) > 0) {
 					d->nb_added++;
 					if(result > 1) {
 					  d->nb_modifications++;
@@ -300,9 +314,9 @@ void *test(void *data) {
 				
 				if (d->alternate) { // alternate mode (default)
 #ifdef TINY10B
-				  if ((result = avl_remove(d->set, last, TRANSACTIONAL, id)) > 0) {
+				  if ((result = LAT_OP(d->lat, LAT_REMOVE, avl_remove(d->set, last, TRANSACTIONAL, id))) > 0) {
 #else
-				    if ((result = avl_remove(d->set, last, TRANSACTIONAL, 0)) > 0) {
+				    if ((result = LAT_OP(d->lat, LAT_REMOVE, avl_remove(d->set, last, TRANSACTIONAL, 0))) > 0) {
 #endif
 						d->nb_removed++;
 #ifdef REMOVE_LATER
@@ -316,18 +330,18 @@ void *test(void *data) {
 					last = -1;
 				} else {
 					/* Random computation only in non-alternated cases */
-					val = rand_range_re(&d->seed, d->range);
+					val = wl_key(&d->wl);
 					/* Remove one random value */
 #ifdef BIAS_RANGE
-					if(rand_range_re(&d->seed, 1000) < 300) {
-					  //val = d->range + rand_range_re(&d->seed, increase - d->range);
-					  val = increase - rand_range_re(&d->seed, 10);
+					if(wl_rand_range(&d->wl, 1000) < 300) {
+					  //val = d->range + wl_rand_range(&d->wl, increase - d->range);
+					  val = increase - wl_rand_range(&d->wl, 10);
 					}
 #endif
 #ifdef TINY10B
-					if ((result = avl_remove(d->set, val, TRANSACTIONAL, id)) > 0) {
+					if ((result = LAT_OP(d->lat, LAT_REMOVE, avl_remove(d->set, val, TRANSACTIONAL, id))) > 0) {
 #else
-					  if ((result = avl_remove(d->set, val, TRANSACTIONAL, 0)) > 0) {
+					  if ((result = LAT_OP(d->lat, LAT_REMOVE, avl_remove(d->set, val, TRANSACTIONAL, 0))) > 0) {
 #endif
 						d->nb_removed++;
 #ifdef REMOVE_LATER
@@ -354,25 +368,25 @@ void *test(void *data) {
 						val = d->first;
 						last = val;
 					} else { // last >= 0
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						last = -1;
 					}
 				} else { // update != 0
 					if (last < 0) {
-						val = rand_range_re(&d->seed, d->range);
+						val = wl_key(&d->wl);
 						//last = val;
 					} else {
 						val = last;
 					}
 				}
-			}	else val = rand_range_re(&d->seed, d->range);
+			}	else val = wl_key(&d->wl);
 			
 #ifdef BIAS_RANGE
-			if(rand_range_re(&d->seed, 1000) < 100) {
+			if(wl_rand_range(&d->wl, 1000) < 100) {
 			  val = increase;
 			}
 #endif
-			if (avl_contains(d->set, val, TRANSACTIONAL, id)) 
+			if (LAT_OP(d->lat, LAT_CONTAINS, avl_contains(d->set, val, TRANSACTIONAL, id))) 
 				d->nb_found++;
 			d->nb_trans++;
 			tloc[id]++;
@@ -385,7 +399,7 @@ void *test(void *data) {
 			unext = ((100 * (d->nb_added + d->nb_removed))
 							 < (d->update * (d->nb_add + d->nb_remove + d->nb_contains)));
 		} else { // remove/add (even failed) is considered as an update
-			unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+			unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 		}
 		
 #ifdef ICC
@@ -394,6 +408,7 @@ void *test(void *data) {
 	}
 #endif /* ICC */
 	
+	pc_stop(d->pc);
 	/* Free transaction */
 	TM_THREAD_EXIT();
 	
@@ -429,7 +444,7 @@ void *test_maintenance(void *data) {
   barrier_cross(d->barrier);
 	
   /* Is the first op an update? */
-  //unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+  //unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
   
 #ifdef ICC
   while (stop == 0) {
@@ -468,6 +483,14 @@ int main(int argc, char **argv)
 		// These options don't set a flag
 		{"help",                      no_argument,       NULL, 'h'},
 		{"duration",                  required_argument, NULL, 'd'},
+		{"latency",                   required_argument, NULL, 'L'},
+		{"key-dist",                  required_argument, NULL, 'K'},
+		{"pin",                       required_argument, NULL, 'P'},
+		{"numa",                      required_argument, NULL, 'N'},
+		{"counters",                  required_argument, NULL, 'C'},
+		{"interval",                  required_argument, NULL, 'T'},
+		{"rate",                      required_argument, NULL, 'O'},
+		{"arrival",                   required_argument, NULL, 'E'},
 		{"initial-size",              required_argument, NULL, 'i'},
 		{"thread-num",                required_argument, NULL, 't'},
 		{"range",                     required_argument, NULL, 'r'},
@@ -493,6 +516,19 @@ int main(int argc, char **argv)
 	struct timeval start, end;
 	struct timespec timeout;
 	int duration = DEFAULT_DURATION;
+	int latency = DEFAULT_LATENCY;
+	char *keydist = DEFAULT_KEYDIST;
+	workload_t workload;
+	char *pin = DEFAULT_PIN;
+	char *numa = DEFAULT_NUMA;
+	affinity_t aff;
+	int counters = DEFAULT_COUNTERS;
+	int interval = DEFAULT_INTERVAL;
+	int rate = DEFAULT_RATE;
+	char *arrival = DEFAULT_ARRIVAL;
+	int poisson;
+	unsigned long ops;
+	ts_t ts;
 	int initial = DEFAULT_INITIAL;
 	int nb_threads = DEFAULT_NB_THREADS;
 	int nb_maintenance_threads = DEFAULT_NB_MAINTENANCE_THREADS;
@@ -506,7 +542,7 @@ int main(int argc, char **argv)
 	
 	while(1) {
 		i = 0;
-		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:"
+		c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:L:K:P:N:C:T:O:E:"
 										, long_options, &i);
 		
 		if(c == -1)
@@ -544,6 +580,23 @@ int main(int argc, char **argv)
 								 "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 								 "  -u, --update-rate <int>\n"
 								 "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+								 "  -L, --latency <int>\n"
+								 "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+								 "  -K, --key-dist <dist>\n"
+								 "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+								 "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+								 "  -P, --pin <policy>\n"
+								 "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+								 "  -N, --numa <policy>\n"
+								 "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+								 "  -C, --counters <int>\n"
+								 "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+								 "  -T, --interval <int>\n"
+								 "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+								 "  -O, --rate <int>\n"
+								 "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+								 "  -E, --arrival <process>\n"
+								 "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
 								 "  -x, --elasticity (default=4)\n"
 								 "        Use elastic transactions\n"
 								 "        0 = non-protected,\n"
@@ -580,6 +633,30 @@ int main(int argc, char **argv)
 				case 'x':
 					unit_tx = atoi(optarg);
 					break;
+				case 'K':
+					keydist = optarg;
+					break;
+				case 'P':
+					pin = optarg;
+					break;
+				case 'N':
+					numa = optarg;
+					break;
+				case 'C':
+					counters = atoi(optarg);
+					break;
+				case 'T':
+					interval = atoi(optarg);
+					break;
+				case 'O':
+					rate = atoi(optarg);
+					break;
+				case 'E':
+					arrival = optarg;
+					break;
+				case 'L':
+					latency = atoi(optarg);
+					break;
 				case '?':
 					printf("Use -h or --help for help\n");
 					exit(0);
@@ -593,6 +670,11 @@ int main(int argc, char **argv)
 	assert(nb_threads > 0);
 	assert(range > 0 && range >= initial);
 	assert(update >= 0 && update <= 100);
+	wl_init(&workload, keydist, range);
+	aff_init(&aff, pin, numa, nb_threads);
+	poisson = lat_poisson(arrival);
+	if (rate > 0 && latency == 0)
+		latency = 1;
 	
 	printf("Set type     : avltree\n");
 	printf("Duration     : %d\n", duration);
@@ -602,6 +684,12 @@ int main(int argc, char **argv)
 	printf("Value range  : %ld\n", range);
 	printf("Seed         : %d\n", seed);
 	printf("Update rate  : %d\n", update);
+	printf("Latency      : %d\n", latency);
+	printf("Key dist.    : %s\n", keydist);
+	aff_print(&aff, pin, numa);
+	printf("Counters     : %d\n", counters);
+	printf("Interval     : %d\n", interval);
+	printf("Rate         : %d (%s)\n", rate, arrival);
 	printf("Elasticity   : %d\n", unit_tx);
 	printf("Alternate    : %d\n", alternate);
 	printf("Efffective   : %d\n", effective);
@@ -669,6 +757,7 @@ int main(int argc, char **argv)
 	i = 0;
 	
 	while (i < initial) {
+		aff_populate(&aff, i, initial);
 		val = rand_range_re(&global_seed, range);
 		//printf("Adding %d\n", val);
 		if (avl_add(set, val, 0, 0) > 0) {
@@ -679,6 +768,7 @@ int main(int argc, char **argv)
 			i++;
 		}
 	}
+	aff_populate_done(&aff);
 	size = avl_set_size(set);
 	tree_size = avl_tree_size(set);
 	printf("Set size     : %d\n", size);
@@ -715,6 +805,11 @@ int main(int argc, char **argv)
 		data[i].nb_aborts_double_write = 0;
 		data[i].max_retries = 0;
 		data[i].seed = rand();
+		data[i].lat = lat_new(latency);
+		lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+		wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+		data[i].cpu = aff_cpu(&aff, i);
+		data[i].pc = pc_new(counters);
 		data[i].set = set;
 		data[i].barrier = &barrier;
 		data[i].failures_because_contention = 0;
@@ -788,7 +883,16 @@ int main(int argc, char **argv)
 	printf("STARTING...\n");
 	gettimeofday(&start, NULL);
 	if (duration > 0) {
-		nanosleep(&timeout, NULL);
+		if (interval > 0) {
+			ts_init(&ts, interval, duration);
+			while (ts_wait(&ts)) {
+				for (ops = 0, i = 0; i < nb_threads; i++)
+					ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains;
+				ts_sample(&ts, ops);
+			}
+		} else {
+			nanosleep(&timeout, NULL);
+		}
 	} else {
 		sigemptyset(&block_set);
 		sigsuspend(&block_set);
@@ -916,6 +1020,15 @@ int main(int argc, char **argv)
 	printf("Tree size      : %d\n", avl_tree_size(set));
 	printf("Duration      : %d (ms)\n", duration);
 	printf("#txs          : %lu (%f / s)\n", reads + updates, (reads + updates) * 1000.0 / duration);
+	if (counters) {
+		pc_stats_t *pc = pc_new(counters);
+		for (i = 0; i < nb_threads; i++) {
+			pc_merge(pc, data[i].pc);
+			free(data[i].pc);
+		}
+		pc_print(pc, reads + updates);
+		free(pc);
+	}
 	
 	printf("#read txs     : ");
 	if (effective) {
@@ -942,6 +1055,19 @@ int main(int argc, char **argv)
 	printf("  #dup-w      : %lu (%f / s)\n", aborts_double_write, aborts_double_write * 1000.0 / duration);
 	printf("  #failures   : %lu\n",  failures_because_contention);
 	printf("Max retries   : %lu\n", max_retries);
+#ifdef FC
+	fc_print();
+#endif /* FC */
+	ma_print(size);
+	if (latency > 0) {
+		lat_stats_t *lat = lat_new(latency);
+		for (i = 0; i < nb_threads; i++) {
+			lat_merge(lat, data[i].lat);
+			free(data[i].lat);
+		}
+		lat_print(lat);
+		free(lat);
+	}
 	
 
 	//print_avltree(set);
@@ -3,6 +3,7 @@
 #include <pthread.h>
 #include "citrus.h" 
 #include "urcu.h"
+#include "memacct.h"
 
 /**
  * Copyright 2014 Maya Arbel (mayaarl [at] cs [dot] technion [dot] ac [dot] il).
@@ -47,9 +48,8 @@ node newNode(int key){
     new->child[1]=NULL;
     new->tag[0]=0;
     new->tag[1]=0;
-    if (pthread_mutex_init(&(new->lock), NULL) != 0){
-        printf("\n mutex init failed\n");
-    }
+    INIT_LOCK(&(new->lock));
+    ma_alloc(sizeof(struct node_t));
     return new;
 }
 
@@ -77,6 +77,123 @@ int contains(node root, int key ){
     return 1;
 }
 
+/*
+ * Looks up the n keys in one read-side critical section, interleaving
+ * the descents of BATCH_WINDOW keys (see batch.h). results[i] is what
+ * contains() returns for keys[i]; returns the number of keys found.
+ */
+int contains_batch(node root, int *keys, int n, int *results){
+    node curr[BATCH_WINDOW];
+    int idx[BATCH_WINDOW];
+    int i, k, next = 0, active = 0, found = 0;
+
+	urcu_read_lock();
+    for (i = 0; i < BATCH_WINDOW; i++) {
+        if (next < n) {
+            idx[i] = next++;
+            curr[i] = root->child[0];
+            batch_prefetch(curr[i]);
+            active++;
+        } else
+            idx[i] = -1;
+    }
+    while (active > 0) {
+        for (i = 0; i < BATCH_WINDOW; i++) {
+            if ((k = idx[i]) < 0)
+                continue;
+            if (curr[i] != NULL && curr[i]->key != keys[k]) {
+                curr[i] = curr[i]->child[curr[i]->key < keys[k]];
+                if (curr[i] != NULL)
+                    batch_prefetch(curr[i]);
+                continue;
+            }
+            results[k] = (curr[i] == NULL) ? -1 : 1;
+            found += (curr[i] != NULL);
+            if (next < n) {
+                idx[i] = next++;
+                curr[i] = root->child[0];
+            } else {
+                idx[i] = -1;
+                active--;
+            }
+        }
+    }
+	urcu_read_unlock();
+    return found;
+}
+
+/* Per-thread stack of the in-order traversals of range_collect() */
+static __thread node *scan_stack;
+static __thread int scan_depth;
+
+static void scan_push(int *top, node n){
+    if (*top == scan_depth) {
+        scan_depth = scan_depth ? 2 * scan_depth : 64;
+        scan_stack = (node *) realloc(scan_stack, scan_depth * sizeof(node));
+        if (scan_stack == NULL) {
+            printf("out of memory\n");
+            exit(1);
+        }
+    }
+    scan_stack[(*top)++] = n;
+}
+
+/*
+ * Collects the keys of [lo,hi] in keys (up to max of them), or counts
+ * them if keys is NULL, with an in-order traversal pruned to the range.
+ * The traversal is one read-side critical section: a delete that
+ * relocates the successor of a node waits for it before unlinking the
+ * old copy, so a key present during the whole scan is reported, and the
+ * copy met first in-order hides the other one. Marked nodes are skipped.
+ */
+int range_collect(node root, int lo, int hi, int *keys, int max){
+    node curr;
+    int top = 0, count = 0, last = 0, any = 0;
+
+    if (keys != NULL && max <= 0)
+        return 0;
+    if (hi >= infinity)
+        hi = infinity - 1;
+	urcu_read_lock();
+    curr = root->child[0];
+    while (true) {
+        while (curr != NULL) {
+            if (curr->key < lo) {
+                curr = curr->child[1];
+            } else {
+                scan_push(&top, curr);
+                curr = (curr->key > lo) ? curr->child[0] : NULL;
+            }
+        }
+        if (top == 0)
+            break;
+        curr = scan_stack[--top];
+        if (curr->key > hi)
+            break;
+        if (!curr->marked && (!any || curr->key > last)) {
+            last = curr->key;
+            any = 1;
+            if (keys != NULL)
+                keys[count] = curr->key;
+            if (++count == max)
+                break;
+        }
+        curr = curr->child[1];
+    }
+	urcu_read_unlock();
+    return count;
+}
+
+int range_count(node root, int lo, int hi){
+    return range_collect(root, lo, hi, NULL, 0);
+}
+
+bool successor(node root, int key, int *succ){
+    if (key >= infinity - 1)
+        return false;
+    return range_collect(root, key + 1, infinity - 1, succ, 1) == 1;
+}
+
 bool validate(node prev,int tag ,node curr, int direction){
 	bool result;     
 	if (curr==NULL){
@@ -112,15 +229,15 @@ bool insert(node root, int key, int value){
         tag = prev->tag[direction];
 		urcu_read_unlock();
         if (curr!=NULL) return false;
-        pthread_mutex_lock(&(prev->lock));
+        LOCK(&(prev->lock));
         if( validate(prev,tag,curr,direction) ){
             node new = newNode(key); 
 			prev->child[direction]=new;
 
-            pthread_mutex_unlock(&(prev->lock));
+            UNLOCK(&(prev->lock));
             return true;
         }
-        pthread_mutex_unlock(&(prev->lock));
+        UNLOCK(&(prev->lock));
     }
 }
 
@@ -150,11 +267,11 @@ bool delete(node root, int key){
             return false;
         }         
 		urcu_read_unlock();
-        pthread_mutex_lock(&(prev->lock));
-        pthread_mutex_lock(&(curr->lock));
+        LOCK(&(prev->lock));
+        LOCK(&(curr->lock));
         if( !validate(prev,0,curr,direction) ){
-            pthread_mutex_unlock(&(prev->lock));
-            pthread_mutex_unlock(&(curr->lock));
+            UNLOCK(&(prev->lock));
+            UNLOCK(&(curr->lock));
             continue;
         }
         if (curr->child[0] == NULL) {
@@ -163,8 +280,10 @@ bool delete(node root, int key){
             if(prev->child[direction] == NULL){
                 prev->tag[direction]++;
             }
-            pthread_mutex_unlock(&(prev->lock));
-            pthread_mutex_unlock(&(curr->lock));
+            UNLOCK(&(prev->lock));
+            UNLOCK(&(curr->lock));
+            /* Removed nodes are not reclaimed */
+            ma_retire(sizeof(struct node_t));
             return true;
         }
         if (curr->child[1] == NULL){
@@ -173,8 +292,10 @@ bool delete(node root, int key){
             if(prev->child[direction] == NULL){
                 prev->tag[direction]++;
             }
-            pthread_mutex_unlock(&(prev->lock));
-            pthread_mutex_unlock(&(curr->lock));
+            UNLOCK(&(prev->lock));
+            UNLOCK(&(curr->lock));
+            /* Removed nodes are not reclaimed */
+            ma_retire(sizeof(struct node_t));
             return true;
         }
 		node prevSucc = curr;
@@ -188,16 +309,16 @@ bool delete(node root, int key){
             }		
         int succDirection = 1; 
         if (prevSucc != curr){
-            pthread_mutex_lock(&(prevSucc->lock));
+            LOCK(&(prevSucc->lock));
             succDirection = 0;
         } 		
-        pthread_mutex_lock(&(succ->lock));
+        LOCK(&(succ->lock));
         if (validate(prevSucc,0,succ, succDirection) && validate(succ,succ->tag[0],NULL, 0)){
             curr->marked=true;
             node new = newNode(succ->key);
             new->child[0]=curr->child[0];
             new->child[1]=curr->child[1];
-            pthread_mutex_lock(&(new->lock)); 
+            LOCK(&(new->lock)); 
             prev->child[direction]=new;  
             urcu_synchronize();
             if(prev->child[direction] == NULL){
@@ -216,19 +337,21 @@ bool delete(node root, int key){
                     prevSucc->tag[1]++;
                 }
             }
-			pthread_mutex_unlock(&(prev->lock));
-            pthread_mutex_unlock(&(new->lock));            
-			pthread_mutex_unlock(&(curr->lock));  	
+			UNLOCK(&(prev->lock));
+            UNLOCK(&(new->lock));            
+			UNLOCK(&(curr->lock));  	
             if (prevSucc != curr)
-                pthread_mutex_unlock(&(prevSucc->lock));	
-            pthread_mutex_unlock(&(succ->lock));
+                UNLOCK(&(prevSucc->lock));	
+            UNLOCK(&(succ->lock));
+            /* curr replaced by a copy of succ */
+            ma_retire(2 * sizeof(struct node_t));
             return true; 
         }
-        pthread_mutex_unlock(&(prev->lock));
-        pthread_mutex_unlock(&(curr->lock));
+        UNLOCK(&(prev->lock));
+        UNLOCK(&(curr->lock));
         if (prevSucc != curr)
-            pthread_mutex_unlock(&(prevSucc->lock));				
-        pthread_mutex_unlock(&(succ->lock));
+            UNLOCK(&(prevSucc->lock));				
+        UNLOCK(&(succ->lock));
     }
 }
 
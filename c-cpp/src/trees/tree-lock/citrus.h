@@ -2,6 +2,9 @@
 #define _DICTIONARY_H_
 #include <stdbool.h>
 
+#include "locks.h"
+#include "batch.h"
+
 /**
  * Copyright 2014 Maya Arbel (mayaarl [at] cs [dot] technion [dot] ac [dot] il).
  * 
@@ -30,7 +33,7 @@
 typedef struct node_t {
   int key;
   struct node_t* child[2];
-  pthread_mutex_t lock;
+  ptlock_t lock;
   bool marked;
   int tag[2];
   int value;
@@ -41,6 +44,11 @@ typedef struct node_t* node;
 
 node init();
 int contains(node root, int key);
+int contains_batch(node root, int *keys, int n, int *results);
+/* Weakly consistent range scans (see scan.h) */
+int range_collect(node root, int lo, int hi, int *keys, int max);
+int range_count(node root, int lo, int hi);
+bool successor(node root, int key, int *succ);
 bool insert(node root, int key, int value);
 bool delete(node root, int key);
 
@@ -33,6 +33,15 @@
 #include <stdint.h>
 #include <atomic_ops.h>
 
+#include "latency.h"
+#include "workload.h"
+#include "affinity.h"
+#include "perfcnt.h"
+#include "timeseries.h"
+#include "scan.h"
+#include "trace.h"
+#include "batch.h"
+#include "memacct.h"
 #include "citrus.h"
 #include "tm.h"
 
@@ -89,21 +98,6 @@ typedef intptr_t val_t;
 #define VAL_MIN                         INT_MIN
 #define VAL_MAX                         INT_MAX
 
-#ifdef MUTEX
-typedef pthread_mutex_t ptlock_t;
-#  define INIT_LOCK(lock)               pthread_mutex_init(lock, NULL);
-#  define DESTROY_LOCK(lock)            pthread_mutex_destroy(lock)
-#  define LOCK(lock)                    pthread_mutex_lock(lock)
-#  define UNLOCK(lock)                  pthread_mutex_unlock(lock)
-#else
-typedef pthread_spinlock_t ptlock_t;
-#  define INIT_LOCK(lock)               pthread_spin_init(lock, PTHREAD_PROCESS_PRIVATE);
-#  define DESTROY_LOCK(lock)            pthread_spin_destroy(lock)
-#  define LOCK(lock)                    pthread_spin_lock(lock)
-#  define UNLOCK(lock)                  pthread_spin_unlock(lock)
-#endif
-
-
 volatile AO_t stop;
 unsigned int global_seed;
 #ifdef TLS
@@ -164,12 +158,19 @@ typedef struct thread_data {
   int unit_tx;
   int alternate;
   int effective;
+  int scan;
+  int scan_length;
+  int scan_op;
+  int batch;
   unsigned long nb_add;
   unsigned long nb_added;
   unsigned long nb_remove;
   unsigned long nb_removed;
   unsigned long nb_contains;
   unsigned long nb_found;
+  unsigned long nb_scan;
+  unsigned long nb_scanned;
+  int *scan_keys;
   unsigned long nb_aborts;
   unsigned long nb_aborts_locked_read;
   unsigned long nb_aborts_locked_write;
@@ -183,21 +184,34 @@ typedef struct thread_data {
   //sl_intset_t *set;
   barrier_t *barrier;
   int id;
+  lat_stats_t *lat;
+  wl_thread_t wl;
+  int cpu;
+  pc_stats_t *pc;
+  tr_stream_t *rec;
+  tr_cursor_t cursor;
 } thread_data_t;
 
 void *test3(void *data) {
 	
   thread_data_t *d = (thread_data_t *)data;
 	
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   while (stop == 0) {;}
+  pc_stop(d->pc);
   return NULL;
 }
 
 
 void *test(void *data) {
+  int keys[BATCH_MAX];
+  int results[BATCH_MAX], i;
   val_t last = -1;
   val_t val = 0;
   int unext; 
@@ -205,11 +219,15 @@ void *test(void *data) {
   thread_data_t *d = (thread_data_t *)data;
   urcu_register(d->id);
 
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   /* Is the first op an update? */
-  unext = (rand_range_re(&d->seed, 100) - 1 < d->update);
+  unext = (wl_rand_range(&d->wl, 100) - 1 < d->update);
 
   //#ifdef ICC
   while (stop == 0) {
@@ -221,8 +239,9 @@ void *test(void *data) {
 			
       if (last < 0) { // add
 				
-	val = rand_range_re(&d->seed, d->range);
-	if (insert(d->set, val, val)) {
+	val = wl_key(&d->wl);
+	tr_log(d->rec, LAT_ADD, val);
+	if (LAT_OP(d->lat, LAT_ADD, insert(d->set, val, val))) {
 	  d->nb_added++;
 	  last = val;
 	} 				
@@ -232,7 +251,8 @@ void *test(void *data) {
 				
 	if (d->alternate) { // alternate mode (default)
 					
-	  if (delete(d->set, last)) {
+	  tr_log(d->rec, LAT_REMOVE, last);
+	  if (LAT_OP(d->lat, LAT_REMOVE, delete(d->set, last))) {
 	    d->nb_removed++;
 	  }
 	  last = -1;
@@ -240,9 +260,10 @@ void *test(void *data) {
 	} else {
 					
 	  // Random computation only in non-alternated cases 
-	  val = rand_range_re(&d->seed, d->range);
+	  val = wl_key(&d->wl);
 	  // Remove one random value 
-	  if (delete(d->set, val)) {
+	  tr_log(d->rec, LAT_REMOVE, val);
+	  if (LAT_OP(d->lat, LAT_REMOVE, delete(d->set, val))) {
 	    d->nb_removed++;
 	    // Repeat until successful, to avoid size variations 
 	    last = -1;
@@ -252,6 +273,31 @@ void *test(void *data) {
 	d->nb_remove++;
       }
 			
+    } else if (scan_next(&d->wl, d->update, d->scan)) { // range scan or successor query
+
+      val = wl_key(&d->wl);
+      switch (d->scan_op) {
+      case SCAN_COUNT:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, range_count(d->set, val, scan_hi(val, d->scan_length, d->range)));
+	break;
+      case SCAN_SUCCESSOR:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, successor(d->set, val, d->scan_keys));
+	break;
+      default:
+	d->nb_scanned += LAT_OP(d->lat, LAT_RANGE, range_collect(d->set, val, scan_hi(val, d->scan_length, d->range), d->scan_keys, d->scan_length));
+      }
+      d->nb_scan++;
+
+    } else if (d->batch > 1 && !d->alternate) { // batch of contains
+
+      for (i = 0; i < d->batch; i++) {
+	keys[i] = wl_key(&d->wl);
+	tr_log(d->rec, LAT_CONTAINS, keys[i]);
+      }
+      /* One latency sample for the whole batch */
+      d->nb_found += LAT_OP(d->lat, LAT_CONTAINS, contains_batch(d->set, keys, d->batch, results));
+      d->nb_contains += d->batch;
+
     } else { // read
 			
 			
@@ -261,25 +307,26 @@ void *test(void *data) {
 	    val = d->first;
 	    last = val;
 	  } else { // last >= 0
-	    val = rand_range_re(&d->seed, d->range);
+	    val = wl_key(&d->wl);
 	    last = -1;
 	  }
 	} else { // update != 0
 	  if (last < 0) {
-	    val = rand_range_re(&d->seed, d->range);
+	    val = wl_key(&d->wl);
 	    //last = val;
 	  } else {
 	    val = last;
 	  }
 	}
-      }	else val = rand_range_re(&d->seed, d->range);
+      }	else val = wl_key(&d->wl);
 			
       /*if (d->effective && last)
 	val = last;
 	else 
-	val = rand_range_re(&d->seed, d->range);*/
+	val = wl_key(&d->wl);*/
 			
-      if (contains(d->set, val)) 
+      tr_log(d->rec, LAT_CONTAINS, val);
+      if (LAT_OP(d->lat, LAT_CONTAINS, contains(d->set, val))) 
 	d->nb_found++;
       d->nb_contains++;
 			
@@ -288,9 +335,9 @@ void *test(void *data) {
     /* Is the next op an update? */
     if (d->effective) { // a failed remove/add is a read-only tx
       unext = ((100 * (d->nb_added + d->nb_removed))
-	       < (d->update * (d->nb_add + d->nb_remove + d->nb_contains)));
+	       < (d->update * (d->nb_add + d->nb_remove + d->nb_contains + d->nb_scan)));
     } else { // remove/add (even failed) is considered as an update
-      unext = ((rand_range_re(&d->seed, 100) - 1) < d->update);
+      unext = ((wl_rand_range(&d->wl, 100) - 1) < d->update);
     }
 		
     //#ifdef ICC
@@ -298,6 +345,7 @@ void *test(void *data) {
   //#else
   //	}
   //#endif /* ICC */
+  pc_stop(d->pc);
 	
   return NULL;
 }
@@ -313,8 +361,12 @@ void *test2(void *data)
   pthread_setspecific(rng_seed_key, &d->seed);
 #endif /* ! TLS */
 	
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
   /* Wait on barrier */
   barrier_cross(d->barrier);
+  pc_start(d->pc);
 	
   last = -1;
 	
@@ -324,12 +376,13 @@ void *test2(void *data)
     while (AO_load_full(&stop) == 0) {
 #endif /* ICC */
 			
-      val = rand_range_re(&d->seed, 100) - 1;
+      val = wl_rand_range(&d->wl, 100) - 1;
       if (val < d->update) {
 	if (last < 0) {
 	  /* Add random value */
-	  val = rand_range_re(&d->seed, d->range);
-	  if (insert(d->set, val, val)) {
+	  val = wl_key(&d->wl);
+	  tr_log(d->rec, LAT_ADD, val);
+	  if (LAT_OP(d->lat, LAT_ADD, insert(d->set, val, val))) {
 	    d->nb_added++;
 	    last = val;
 	  }
@@ -337,16 +390,18 @@ void *test2(void *data)
 	} else {
 	  if (d->alternate) {
 	    /* Remove last value */
-	    if (delete(d->set, last)) {
+	    tr_log(d->rec, LAT_REMOVE, last);
+	    if (LAT_OP(d->lat, LAT_REMOVE, delete(d->set, last))) {
 	      d->nb_removed++;
 	      last = -1; 
 	    }
 	    d->nb_remove++;
 	  } else {
 	    /* Random computation only in non-alternated cases */
-	    newval = rand_range_re(&d->seed, d->range);
+	    newval = wl_key(&d->wl);
 	    /* Remove one random value */
-	    if (delete(d->set, newval)) {
+	    tr_log(d->rec, LAT_REMOVE, newval);
+	    if (LAT_OP(d->lat, LAT_REMOVE, delete(d->set, newval))) {
 	      d->nb_removed++;
 	      /* Repeat until successful, to avoid size variations */
 	      last = -1;
@@ -356,23 +411,78 @@ void *test2(void *data)
 	}
       } else {
 	/* Look for random value */
-	val = rand_range_re(&d->seed, d->range);
-	if (contains(d->set, val))
+	val = wl_key(&d->wl);
+	tr_log(d->rec, LAT_CONTAINS, val);
+	if (LAT_OP(d->lat, LAT_CONTAINS, contains(d->set, val)))
 	  d->nb_found++;
 	d->nb_contains++;
       }
 			
     }
+    pc_stop(d->pc);
 		
     return NULL;
   }
 	
+/* Replays the operations of a trace instead of generating them */
+void *replay(void *data) {
+  const tr_rec_t *r;
+
+  thread_data_t *d = (thread_data_t *)data;
+  urcu_register(d->id);
+
+  /* Pin thread */
+  aff_pin_self(d->cpu);
+  pc_open(d->pc);
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+  pc_start(d->pc);
+
+  while (stop == 0) {
+    r = tr_next(&d->cursor);
+    switch (r->op) {
+    case LAT_ADD:
+      if (LAT_OP(d->lat, LAT_ADD, insert(d->set, r->key, r->key)))
+	d->nb_added++;
+      d->nb_add++;
+      break;
+    case LAT_REMOVE:
+      if (LAT_OP(d->lat, LAT_REMOVE, delete(d->set, r->key)))
+	d->nb_removed++;
+      d->nb_remove++;
+      break;
+    default:
+      if (LAT_OP(d->lat, LAT_CONTAINS, contains(d->set, r->key)))
+	d->nb_found++;
+      d->nb_contains++;
+    }
+  }
+
+  pc_stop(d->pc);
+
+  return NULL;
+}
+
   int main(int argc, char **argv)
   {
     struct option long_options[] = {
       // These options don't set a flag
       {"help",                      no_argument,       NULL, 'h'},
       {"duration",                  required_argument, NULL, 'd'},
+      {"latency",                   required_argument, NULL, 'L'},
+      {"key-dist",                  required_argument, NULL, 'K'},
+      {"pin",                       required_argument, NULL, 'P'},
+      {"numa",                      required_argument, NULL, 'N'},
+      {"counters",                  required_argument, NULL, 'C'},
+      {"interval",                  required_argument, NULL, 'T'},
+      {"rate",                      required_argument, NULL, 'O'},
+      {"arrival",                   required_argument, NULL, 'E'},
+      {"scan-rate",                 required_argument, NULL, 'R'},
+      {"scan-length",               required_argument, NULL, 'Q'},
+      {"scan-op",                   required_argument, NULL, 'q'},
+      {"batch",                     required_argument, NULL, 'B'},
+      {"record",                    required_argument, NULL, 'w'},
+      {"replay",                    required_argument, NULL, 'Y'},
       {"initial-size",              required_argument, NULL, 'i'},
       {"thread-num",                required_argument, NULL, 't'},
       {"range",                     required_argument, NULL, 'r'},
@@ -387,6 +497,7 @@ void *test2(void *data)
     int i, c, size;
     val_t last = 0; 
     val_t val = 0;
+    unsigned long scans, scanned;
     unsigned long reads, effreads, updates, effupds, aborts, aborts_locked_read, 
       aborts_locked_write, aborts_validate_read, aborts_validate_write, 
       aborts_validate_commit, aborts_invalid_memory, max_retries;
@@ -397,6 +508,27 @@ void *test2(void *data)
     struct timeval start, end;
     struct timespec timeout;
     int duration = DEFAULT_DURATION;
+    int latency = DEFAULT_LATENCY;
+    char *keydist = DEFAULT_KEYDIST;
+    workload_t workload;
+    char *pin = DEFAULT_PIN;
+    char *numa = DEFAULT_NUMA;
+    affinity_t aff;
+    int counters = DEFAULT_COUNTERS;
+    int interval = DEFAULT_INTERVAL;
+    int rate = DEFAULT_RATE;
+    int scan = DEFAULT_SCAN;
+    int scan_length = DEFAULT_SCAN_LENGTH;
+    int scan_op = scan_parse(DEFAULT_SCAN_OP);
+    int batch = DEFAULT_BATCH;
+    char *arrival = DEFAULT_ARRIVAL;
+    int poisson;
+    char *record = NULL;
+    char *trace_file = NULL;
+    tr_writer_t writer;
+    trace_t trace;
+    unsigned long ops;
+    ts_t ts;
     int initial = DEFAULT_INITIAL;
     int nb_threads = DEFAULT_NB_THREADS;
     long range = DEFAULT_RANGE;
@@ -409,7 +541,7 @@ void *test2(void *data)
 		
     while(1) {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:"
+      c = getopt_long(argc, argv, "hAf:d:i:t:r:S:u:x:L:K:P:N:C:T:O:E:R:Q:q:B:w:Y:"
 		      , long_options, &i);
 			
       if(c == -1)
@@ -448,6 +580,35 @@ void *test2(void *data)
 	       "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
 	       "  -u, --update-rate <int>\n"
 	       "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+	       "  -L, --latency <int>\n"
+	       "        Sample one operation out of <int> for latency percentiles (0=off, default=" XSTR(DEFAULT_LATENCY) ")\n"
+	       "  -K, --key-dist <dist>\n"
+	       "        Key distribution: uniform, zipf[:theta], hotspot[:ops%%[:keys%%]],\n"
+	       "        latest[:theta[:shift]] or sequential (default=" DEFAULT_KEYDIST ")\n"
+	       "  -P, --pin <policy>\n"
+	       "        Thread pinning: none, compact, scatter or a CPU list such as 0,2,4-7 (default=" DEFAULT_PIN ")\n"
+	       "  -N, --numa <policy>\n"
+	       "        NUMA memory policy: none, interleave, local or populate (default=" DEFAULT_NUMA ")\n"
+	       "  -C, --counters <int>\n"
+	       "        Report hardware performance counters per operation (default=" XSTR(DEFAULT_COUNTERS) ")\n"
+	       "  -T, --interval <int>\n"
+	       "        Print the throughput every <int> milliseconds (0=off, default=" XSTR(DEFAULT_INTERVAL) ")\n"
+	       "  -O, --rate <int>\n"
+	       "        Open loop: issue <int> operations per second in total, latency from intended start (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+	       "  -E, --arrival <process>\n"
+	       "        Open-loop arrivals: poisson or constant (default=" DEFAULT_ARRIVAL ")\n"
+	       "  -R, --scan-rate <int>\n"
+	       "        Percentage of range scans (default=" XSTR(DEFAULT_SCAN) ")\n"
+	       "  -Q, --scan-length <int>\n"
+	       "        Number of keys of the range of a scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+	       "  -q, --scan-op <op>\n"
+	       "        Operation of a scan: collect, count or successor (default=" DEFAULT_SCAN_OP ")\n"
+	       "  -B, --batch <int>\n"
+	       "        Issue lookups by batches of <int> keys interleaved with prefetching (0=off, default=" XSTR(DEFAULT_BATCH) ")\n"
+	       "  -w, --record <file>\n"
+	       "        Record the operations of the threads to a trace file\n"
+	       "  -Y, --replay <file>\n"
+	       "        Replay the operations of a trace file instead of generating them\n"
 	       "  -x, --unit-tx (default=1)\n"
 	       "        Use unit transactions\n"
 	       "        0 = non-protected,\n"
@@ -486,6 +647,48 @@ void *test2(void *data)
       case 'x':
 	unit_tx = atoi(optarg);
 	break;
+      case 'K':
+	keydist = optarg;
+	break;
+      case 'P':
+	pin = optarg;
+	break;
+      case 'N':
+	numa = optarg;
+	break;
+      case 'C':
+	counters = atoi(optarg);
+	break;
+      case 'T':
+	interval = atoi(optarg);
+	break;
+      case 'O':
+	rate = atoi(optarg);
+	break;
+      case 'E':
+	arrival = optarg;
+	break;
+      case 'R':
+	scan = atoi(optarg);
+	break;
+      case 'Q':
+	scan_length = atoi(optarg);
+	break;
+      case 'q':
+	scan_op = scan_parse(optarg);
+	break;
+      case 'B':
+	batch = batch_parse(optarg);
+	break;
+      case 'w':
+	record = optarg;
+	break;
+      case 'Y':
+	trace_file = optarg;
+	break;
+      case 'L':
+	latency = atoi(optarg);
+	break;
       case '?':
 	printf("Use -h or --help for help\n");
 	exit(0);
@@ -499,14 +702,33 @@ void *test2(void *data)
     assert(nb_threads > 0);
     assert(range > 0 && range >= initial);
     assert(update >= 0 && update <= 100);
+    scan_check(update, scan, scan_length);
+    wl_init(&workload, keydist, range);
+    aff_init(&aff, pin, numa, nb_threads);
+    poisson = lat_poisson(arrival);
+    if (rate > 0 && latency == 0)
+      latency = 1;
+    if (trace_file != NULL)
+      tr_open(&trace, trace_file);
 		
     printf("Set type     : skip list\n");
+    printf("Lock type    : %s\n", LOCK_NAME);
     printf("Duration     : %d\n", duration);
     printf("Initial size : %d\n", initial);
     printf("Nb threads   : %d\n", nb_threads);
     printf("Value range  : %ld\n", range);
     printf("Seed         : %d\n", seed);
     printf("Update rate  : %d\n", update);
+    printf("Latency      : %d\n", latency);
+    printf("Key dist.    : %s\n", keydist);
+    aff_print(&aff, pin, numa);
+    printf("Counters     : %d\n", counters);
+    printf("Interval     : %d\n", interval);
+    printf("Rate         : %d (%s)\n", rate, arrival);
+    printf("Scan rate    : %d (%s, length %d)\n", scan, scan_name(scan_op), scan_length);
+    printf("Batch size   : %d\n", batch);
+    if (trace_file != NULL)
+      tr_print(&trace, trace_file);
     printf("Lock alg.    : %d\n", unit_tx);
     printf("Alternate    : %d\n", alternate);
     printf("Effective    : %d\n", effective);
@@ -550,15 +772,18 @@ void *test2(void *data)
     printf("Adding %d entries to set\n", initial);
     i = 0;
     while (i < initial) {
+      aff_populate(&aff, i, initial);
       val = rand_range_re(&global_seed, range);
       if (insert(set, val, 0)) {
 	last = val;
 	i++;
       }
     }
+    aff_populate_done(&aff);
     //size = sl_set_size(set);
     //printf("Set size     : %d\n", size);
     printf("Set size (TENTATIVE) : %d\n", initial);
+    size = initial;
     printf("Level max    : %d\n", levelmax);
 		
     /* Access set from all threads */
@@ -588,10 +813,28 @@ void *test2(void *data)
       data[i].nb_aborts_invalid_memory = 0;
       data[i].max_retries = 0;
       data[i].seed = rand();
+      data[i].lat = lat_new(latency);
+      lat_open(data[i].lat, (double)rate / nb_threads, poisson, i);
+      wl_thread_init(&data[i].wl, &workload, data[i].seed, i, nb_threads);
+      data[i].cpu = aff_cpu(&aff, i);
+      data[i].pc = pc_new(counters);
+      data[i].scan = scan;
+      data[i].scan_length = scan_length;
+      data[i].scan_op = scan_op;
+      data[i].nb_scan = 0;
+      data[i].nb_scanned = 0;
+      if ((data[i].scan_keys = (int *)malloc(scan_length * sizeof(int))) == NULL) {
+        perror("malloc");
+        exit(1);
+      }
+      data[i].batch = batch;
+      data[i].rec = tr_stream_new(record, i);
+      if (trace_file != NULL)
+        tr_cursor_init(&data[i].cursor, &trace, i, nb_threads);
       data[i].set = set;
       data[i].barrier = &barrier;
       data[i].id = i;
-      if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+      if (pthread_create(&threads[i], &attr, (trace_file != NULL ? replay : test), (void *)(&data[i])) != 0) {
 	fprintf(stderr, "Error creating thread\n");
 	exit(1);
       }
@@ -604,7 +847,16 @@ void *test2(void *data)
     printf("STARTING...\n");
     gettimeofday(&start, NULL);
     if (duration > 0) {
-      nanosleep(&timeout, NULL);
+      if (interval > 0) {
+        ts_init(&ts, interval, duration);
+        while (ts_wait(&ts)) {
+          for (ops = 0, i = 0; i < nb_threads; i++)
+            ops += data[i].nb_add + data[i].nb_remove + data[i].nb_contains + data[i].nb_scan;
+          ts_sample(&ts, ops);
+        }
+      } else {
+        nanosleep(&timeout, NULL);
+      }
     } else {
       sigemptyset(&block_set);
       sigsuspend(&block_set);
@@ -637,6 +889,8 @@ void *test2(void *data)
     aborts_validate_commit = 0;
     aborts_invalid_memory = 0;
     reads = 0;
+    scans = 0;
+    scanned = 0;
     effreads = 0;
     updates = 0;
     effupds = 0;
@@ -664,8 +918,10 @@ void *test2(void *data)
       aborts_validate_write += data[i].nb_aborts_validate_write;
       aborts_validate_commit += data[i].nb_aborts_validate_commit;
       aborts_invalid_memory += data[i].nb_aborts_invalid_memory;
-      reads += data[i].nb_contains;
-      effreads += data[i].nb_contains + 
+      scans += data[i].nb_scan;
+      scanned += data[i].nb_scanned;
+      reads += data[i].nb_contains + data[i].nb_scan;
+      effreads += data[i].nb_contains + data[i].nb_scan + 
 	(data[i].nb_add - data[i].nb_added) + 
 	(data[i].nb_remove - data[i].nb_removed); 
       updates += (data[i].nb_add + data[i].nb_remove);
@@ -678,13 +934,24 @@ void *test2(void *data)
     printf("Duration      : %d (ms)\n", duration);
     printf("#txs          : %lu (%f / s)\n", reads + updates, 
 	   (reads + updates) * 1000.0 / duration);
+    if (counters) {
+      pc_stats_t *pc = pc_new(counters);
+      for (i = 0; i < nb_threads; i++) {
+        pc_merge(pc, data[i].pc);
+        free(data[i].pc);
+      }
+      pc_print(pc, reads + updates);
+      free(pc);
+    }
 		
     printf("#read txs     : ");
     if (effective) {
       printf("%lu (%f / s)\n", effreads, effreads * 1000.0 / duration);
-      printf("  #contains   : %lu (%f / s)\n", reads, reads * 1000.0 / 
+      printf("  #contains   : %lu (%f / s)\n", reads - scans, (reads - scans) * 1000.0 / 
 	     duration);
     } else printf("%lu (%f / s)\n", reads, reads * 1000.0 / duration);
+    if (scan > 0)
+      scan_print(scans, scanned, duration);
 		
     printf("#eff. upd rate: %f \n", 100.0 * effupds / (effupds + effreads));
 		
@@ -710,6 +977,24 @@ void *test2(void *data)
     printf("  #inv-mem    : %lu (%f / s)\n", aborts_invalid_memory, 
 	   aborts_invalid_memory * 1000.0 / duration);
     printf("Max retries   : %lu\n", max_retries);
+    ma_print(size);
+    if (record != NULL) {
+      tr_create(&writer, record, nb_threads);
+      for (i = 0; i < nb_threads; i++)
+        tr_append(&writer, data[i].rec);
+      tr_finish(&writer);
+    }
+    if (trace_file != NULL)
+      tr_close(&trace);
+    if (latency > 0) {
+      lat_stats_t *lat = lat_new(latency);
+      for (i = 0; i < nb_threads; i++) {
+        lat_merge(lat, data[i].lat);
+        free(data[i].lat);
+      }
+      lat_print(lat);
+      free(lat);
+    }
 		
     /* Delete set */
     //sl_set_delete(set);
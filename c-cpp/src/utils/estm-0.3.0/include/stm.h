@@ -115,6 +115,10 @@ struct stm_tx *stm_current_tx();
 		
 #define EL								0
 #define NL								1
+/* Normal transaction declared read-only: its loads are only checked
+ * against the start time, without read set nor extension, and it
+ * restarts as a normal transaction on its first store */
+#define RO								2
 	
 /* ################################################################### *
  * TYPES
@@ -126,6 +130,13 @@ struct stm_tx *stm_current_tx();
  */
 typedef uintptr_t stm_word_t;
 
+/**
+ * Number of buckets of the "retries" statistics: commits after 0, 1,
+ * 2-3, 4-7, ... retries, the last bucket counting all the commits after
+ * 2^(STM_RETRY_BUCKETS-2) retries or more.
+ */
+#define STM_RETRY_BUCKETS               12
+
 /**
  * Transaction attributes specified by the application.
  */
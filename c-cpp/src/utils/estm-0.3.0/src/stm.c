@@ -24,9 +24,14 @@
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include <pthread.h>
 #include <sched.h>
+#include <time.h>
+#if defined(__x86_64__)
+# include <cpuid.h>
+#endif /* __x86_64__ */
 
 #include "stm.h"
 #include "atomic.h"
@@ -62,6 +67,10 @@
 # define RW_SET_SIZE                    4096                /* Initial size of read/write sets */
 #endif /* ! RW_SET_SIZE */
 
+#ifndef RO_RETRIES
+# define RO_RETRIES                     1                   /* Validation aborts before an RO tx falls back */
+#endif /* ! RO_RETRIES */
+
 #ifndef LOCK_ARRAY_LOG_SIZE
 # define LOCK_ARRAY_LOG_SIZE            20                  /* Size of lock array: 2^20 = 1M */
 #endif /* LOCK_ARRAY_LOG_SIZE */
@@ -89,10 +98,17 @@ typedef struct r_entry {                /* Read set entry */
   volatile stm_word_t *lock;            /* Pointer to lock (for fast access) */
 } r_entry_t;
 
+typedef struct r_slot {                 /* Read set index slot */
+  unsigned int stamp;                   /* Transaction that filled the slot */
+  int entry;                            /* Index of the entry in the read set */
+} r_slot_t;
+
 typedef struct r_set {                  /* Read set */
   r_entry_t *entries;                   /* Array of entries */
   int nb_entries;                       /* Number of entries */
   int size;                             /* Size of array */
+  r_slot_t *index;                      /* Open-addressing index by lock (2 * size slots) */
+  unsigned int stamp;                   /* Stamp of the slots of the current transaction */
 } r_set_t;
 
 typedef struct w_entry {                /* Write set entry */
@@ -104,6 +120,7 @@ typedef struct w_entry {                /* Write set entry */
       stm_word_t version;               /* Version overwritten */
       volatile stm_word_t *lock;        /* Pointer to lock (for fast access) */
       struct w_entry *next;             /* Next address covered by same lock (if any) */
+      struct stm_tx *tx;                /* Owner (for contention management) */
     };
   };
 } w_entry_t;
@@ -146,12 +163,41 @@ typedef struct stm_tx {                 /* Transaction descriptor */
   unsigned long aborts_reallocate;      /* Aborts due to write set reallocation (cumulative) */
   unsigned long aborts_rollover;        /* Aborts due to clock rolling over (cumulative) */
   unsigned long max_retries;            /* Maximum number of consecutive aborts (retries) */
+  unsigned long read_lookups;           /* Read set lookups answered by the index (cumulative) */
+  unsigned long read_skipped;           /* Entries a linear scan would have visited (cumulative) */
+  unsigned long read_duplicates;        /* Reads already in the read set, not logged again (cumulative) */
+  int ro_fallback;                      /* Run the next RO attempt as a normal transaction */
+  unsigned long ro_commits;             /* Commits without read set (cumulative) */
+  unsigned long ro_fallbacks;           /* RO transactions restarted as normal ones (cumulative) */
+  struct clock_slot *clock;             /* Per-thread clock (CLOCK_THREAD) */
+  int id;                               /* Thread index (registration order) */
+  volatile int cm_active;               /* Running a transaction (serial mode) */
+  int cm_serial;                        /* Running alone (serial mode) */
+  stm_word_t cm_ts;                     /* Time of the first attempt (GREEDY) */
+  unsigned long cm_karma;               /* Accesses of the aborted attempts (KARMA, POLKA) */
+  unsigned long cm_seed;                /* Random seed (BACKOFF) */
+  unsigned long cm_waits;               /* Conflicts waited for instead of aborting (cumulative) */
+  unsigned long cm_serial_commits;      /* Commits in serial mode (cumulative) */
+  unsigned long cm_retries[STM_RETRY_BUCKETS]; /* Commits by number of retries (cumulative) */
   int type;				/* Is this transaction normal (NL=1) or elastic (EL=0)? */
   stm_word_t *lastraddr[ELASTICITY];	/* Elastic rotating buffer, keep track of the last read values (if elastic) */
   int marker;                           /* Marker for the elastic rotating buffer */
 } stm_tx_t;
 
 static int nb_specific = 0;             /* Number of specific slots used (<= MAX_SPECIFIC) */
+static volatile stm_word_t nb_ids = 0;  /* Number of thread indexes handed out */
+
+/* Contention management statistics of the threads that have exited */
+static volatile unsigned long global_cm_waits;
+static volatile unsigned long global_cm_serial_commits;
+static volatile unsigned long global_cm_retries[STM_RETRY_BUCKETS];
+
+/* Read set index statistics of the threads that have exited */
+static volatile unsigned long global_read_lookups;
+static volatile unsigned long global_read_skipped;
+static volatile unsigned long global_read_duplicates;
+static volatile unsigned long global_ro_commits;
+static volatile unsigned long global_ro_fallbacks;
 
 /*
  * Transaction nesting is supported in a minimalist way (flat nesting):
@@ -278,12 +324,393 @@ static volatile stm_word_t locks[LOCK_ARRAY_SIZE];
  * CLOCK
  * ################################################################### */
 
+/*
+ * The time base gives the start timestamp of transactions and the
+ * commit timestamp of update transactions, the version installed in
+ * the locks they release. It is selected with stm_set_parameter("clock")
+ * before the threads start, the default being set at build time with
+ * STM_CLOCK (see Makefile.in):
+ * - GV1: the shared counter of TL2, incremented by each update commit.
+ * - GV4: an update commit tries once to increment the shared counter
+ *   and otherwise uses the value installed by the transaction that beat
+ *   it, so that concurrent commits share a timestamp.
+ * - GV5: an update commit uses the shared counter plus one without
+ *   incrementing it, and a transaction that reads a version above the
+ *   counter advances it before extending its snapshot.
+ * - THREAD: each thread publishes the last commit timestamp it used in
+ *   a slot of its own, the clock is the largest of them and a commit
+ *   uses the largest plus one.
+ * - TSC: the invariant time-stamp counter of the processor (64-bit x86
+ *   only, CLOCK_MONOTONIC elsewhere), synchronized across cores.
+ * All commit timestamps are taken once the transaction holds all its
+ * locks, so that a reader whose snapshot includes a timestamp sees the
+ * locations written with it locked or updated. Since only GV1 makes
+ * timestamps unique, the others always validate the read set on commit.
+ */
+#define CLOCK_GV1                       0
+#define CLOCK_GV4                       1
+#define CLOCK_GV5                       2
+#define CLOCK_THREAD                    3
+#define CLOCK_TSC                       4
+
+#ifndef DEFAULT_CLOCK
+# define DEFAULT_CLOCK                  CLOCK_GV1
+#endif /* ! DEFAULT_CLOCK */
+
+static const char *clock_names[] = { "gv1", "gv4", "gv5", "thread", "tsc" };
+static int clock_mode = DEFAULT_CLOCK;
+
 /* At least twice a cache line (512 bytes to be on the safe side) */
 static volatile stm_word_t gclock[1024 / sizeof(stm_word_t)];
 #define CLOCK                          (gclock[512 / sizeof(stm_word_t)])
 
-#define GET_CLOCK                       (ATOMIC_LOAD_ACQ(&CLOCK))
-#define FETCH_INC_CLOCK                 (ATOMIC_FETCH_INC_FULL(&CLOCK))
+/* Per-thread clocks (threads beyond CLOCK_SLOTS share slots) */
+#define CLOCK_SLOTS                     256
+
+typedef struct clock_slot {
+  volatile stm_word_t ts;
+  char padding[64 - sizeof(stm_word_t)];
+} clock_slot_t;
+
+static clock_slot_t clock_slots[CLOCK_SLOTS] __attribute__((aligned(64)));
+
+static inline stm_word_t clock_tsc()
+{
+#if defined(__x86_64__)
+  unsigned int lo, hi;
+
+  /* Ordered with the loads of the transaction on both sides */
+  __asm__ __volatile__("lfence; rdtsc; lfence" : "=a" (lo), "=d" (hi) : : "memory");
+  return (((stm_word_t)hi << 32) | lo) & VERSION_MAX;
+#else /* ! __x86_64__ */
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((stm_word_t)ts.tv_sec * 1000000000 + ts.tv_nsec) & VERSION_MAX;
+#endif /* ! __x86_64__ */
+}
+
+static inline stm_word_t clock_threads()
+{
+  stm_word_t n, max, ts;
+  int i;
+
+  n = ATOMIC_LOAD_ACQ(&nb_ids);
+  if (n > CLOCK_SLOTS)
+    n = CLOCK_SLOTS;
+  max = 0;
+  for (i = 0; i < n; i++) {
+    ts = ATOMIC_LOAD_ACQ(&clock_slots[i].ts);
+    if (ts > max)
+      max = ts;
+  }
+  return max;
+}
+
+/*
+ * Current time, the start timestamp of a transaction.
+ */
+static inline stm_word_t clock_get()
+{
+  switch (clock_mode) {
+  case CLOCK_THREAD:
+    return clock_threads();
+  case CLOCK_TSC:
+    return clock_tsc();
+  default:
+    return ATOMIC_LOAD_ACQ(&CLOCK);
+  }
+}
+
+/*
+ * Make the clock reach a version read (GV5), so that the snapshot of a
+ * transaction started or extended afterwards covers it.
+ */
+static inline void clock_advance(stm_word_t version)
+{
+  stm_word_t now;
+
+  while ((now = ATOMIC_LOAD_ACQ(&CLOCK)) < version) {
+    if (ATOMIC_CAS_FULL(&CLOCK, now, version) != 0)
+      break;
+  }
+}
+
+static inline void clock_reset()
+{
+  int i;
+
+  CLOCK = 0;
+  for (i = 0; i < CLOCK_SLOTS; i++)
+    clock_slots[i].ts = 0;
+}
+
+/*
+ * Commit timestamp of an update transaction holding all its locks.
+ * *validate is cleared when no transaction committed since it started.
+ */
+static inline stm_word_t clock_commit(stm_tx_t *tx, int *validate)
+{
+  stm_word_t t, now;
+  w_entry_t *w;
+  int i;
+
+  *validate = 1;
+  switch (clock_mode) {
+  case CLOCK_GV4:
+    now = ATOMIC_LOAD_ACQ(&CLOCK);
+    if (ATOMIC_CAS_FULL(&CLOCK, now, now + 1) != 0) {
+      *validate = (tx->start != now);
+      return now + 1;
+    }
+    /* Installed by a commit that started after we read the clock */
+    return ATOMIC_LOAD_ACQ(&CLOCK);
+  case CLOCK_GV5:
+    /* Versions may be above the clock: the new one must be above those it replaces */
+    t = ATOMIC_LOAD_ACQ(&CLOCK);
+    w = tx->w_set.entries;
+    for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+      if (w->version > t)
+        t = w->version;
+    }
+    return t + 1;
+  case CLOCK_THREAD:
+    t = clock_threads() + 1;
+    /* Slots only move forward, even when shared */
+    while ((now = ATOMIC_LOAD_ACQ(&tx->clock->ts)) < t) {
+      if (ATOMIC_CAS_FULL(&tx->clock->ts, now, t) != 0)
+        break;
+    }
+    return t;
+  case CLOCK_TSC:
+    return clock_tsc();
+  default:
+    t = ATOMIC_FETCH_INC_FULL(&CLOCK) + 1;
+    *validate = (tx->start != t - 1);
+    return t;
+  }
+}
+
+static int clock_select(const char *name)
+{
+  int i;
+
+  for (i = 0; i < sizeof(clock_names) / sizeof(clock_names[0]); i++) {
+    if (strcasecmp(clock_names[i], name) == 0) {
+      if (i == CLOCK_TSC && sizeof(stm_word_t) < 8)
+        return 0;
+#if defined(__x86_64__)
+      if (i == CLOCK_TSC) {
+        unsigned int a, b, c, d;
+        /* Invariant TSC: CPUID.80000007H:EDX[8] */
+        if (!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1 << 8)))
+          fprintf(stderr, "Warning: the time-stamp counter is not invariant\n");
+      }
+#endif /* __x86_64__ */
+      clock_mode = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* ################################################################### *
+ * CONTENTION MANAGEMENT
+ * ################################################################### */
+
+/*
+ * The contention manager decides what a transaction does when it finds
+ * a location locked by another transaction and after it aborts. It is
+ * selected with stm_set_parameter("cm") before the threads start:
+ * - NONE: abort and restart at once (the default).
+ * - BACKOFF: abort and wait, before restarting, for a random delay
+ *   whose bound doubles with each consecutive abort.
+ * - KARMA: the priority of a transaction is the number of locations it
+ *   accessed, accumulated over its aborted attempts. A transaction
+ *   waits for the owner of a lock if the owner has a higher priority,
+ *   at most once per unit of priority difference, and aborts otherwise.
+ * - POLKA: KARMA with waits that double after each attempt.
+ * - GREEDY: the priority is the time of the first attempt. A
+ *   transaction waits for an older owner and aborts otherwise.
+ * Transactions cannot abort each other here: where the original
+ * managers abort the owner of lower priority, the requester aborts
+ * itself and keeps its priority for its next attempt. Transactions
+ * only wait for owners of strictly higher priority, and for a bounded
+ * time, which cannot deadlock.
+ *
+ * Independently, with stm_set_parameter("cm_serial", &n), a transaction
+ * that aborted n times in a row runs its next attempts alone: it waits
+ * until the running transactions complete and no other starts until it
+ * commits, so that it cannot fail again on a conflict.
+ */
+#define CM_NONE                         0
+#define CM_BACKOFF                      1
+#define CM_KARMA                        2
+#define CM_POLKA                        3
+#define CM_GREEDY                       4
+
+#define CM_BACKOFF_UNIT                 64                  /* Pause loops */
+#define CM_BACKOFF_MAX                  10                  /* Largest delay: 2^10 units */
+#define CM_WAIT_UNIT                    64                  /* Pause loops */
+#define CM_WAIT_MAX                     32                  /* Waits per conflict */
+#define CM_THREADS                      1024
+
+static const char *cm_names[] = { "none", "backoff", "karma", "polka", "greedy" };
+static int cm_policy = CM_NONE;
+static int cm_serial_retries = 0;
+
+/* Set while a transaction runs in serial mode */
+static volatile stm_word_t cm_serial;
+static stm_tx_t *volatile cm_txs[CM_THREADS];
+
+static inline void cm_pause(unsigned long n)
+{
+  while (n-- > 0) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause" : : : "memory");
+#else /* ! (__x86_64__ || __i386__) */
+    __asm__ __volatile__("" : : : "memory");
+#endif /* ! (__x86_64__ || __i386__) */
+  }
+}
+
+static inline int cm_bucket(unsigned long retries)
+{
+  int b;
+
+  if (retries == 0)
+    return 0;
+  b = 8 * sizeof(unsigned long) - __builtin_clzl(retries);
+  return (b < STM_RETRY_BUCKETS ? b : STM_RETRY_BUCKETS - 1);
+}
+
+static inline unsigned long cm_karma(stm_tx_t *tx)
+{
+  return tx->cm_karma + tx->r_set.nb_entries + tx->w_set.nb_entries;
+}
+
+static inline int cm_older(stm_tx_t *tx, stm_tx_t *other)
+{
+  return tx->cm_ts < other->cm_ts || (tx->cm_ts == other->cm_ts && tx->id < other->id);
+}
+
+/*
+ * Conflict with the owner of a lock, found through the write set entry
+ * the lock points to (kept allocated by the GC while we run). Returns 1
+ * after waiting if the access should be tried again, 0 to abort.
+ */
+static inline int cm_conflict(stm_tx_t *tx, w_entry_t *w, int *attempt)
+{
+  stm_tx_t *owner;
+  long diff;
+  int shift;
+
+  if (cm_policy < CM_KARMA || *attempt >= CM_WAIT_MAX)
+    return 0;
+  owner = w->tx;
+  if (cm_policy == CM_GREEDY) {
+    if (!cm_older(owner, tx))
+      return 0;
+    shift = 0;
+  } else {
+    diff = (long)(cm_karma(owner) - cm_karma(tx));
+    if (diff <= *attempt)
+      return 0;
+    shift = (cm_policy == CM_POLKA ? (*attempt < CM_BACKOFF_MAX ? *attempt : CM_BACKOFF_MAX) : 0);
+  }
+  (*attempt)++;
+  tx->cm_waits++;
+  cm_pause((unsigned long)CM_WAIT_UNIT << shift);
+  return 1;
+}
+
+/*
+ * Start of an attempt: wait for a transaction running in serial mode,
+ * or enter serial mode after too many retries.
+ */
+static inline void cm_enter(stm_tx_t *tx)
+{
+  stm_word_t i, n;
+
+  if (cm_policy == CM_GREEDY && tx->retries == 0)
+    tx->cm_ts = clock_tsc();
+  if (cm_serial_retries == 0 || tx->cm_serial)
+    return;
+  if (tx->retries >= cm_serial_retries) {
+    while (ATOMIC_LOAD(&cm_serial) != 0 || ATOMIC_CAS_FULL(&cm_serial, 0, 1) == 0)
+      cm_pause(CM_WAIT_UNIT);
+    tx->cm_serial = 1;
+    /* Wait for the transactions that started before */
+    n = ATOMIC_LOAD_ACQ(&nb_ids);
+    for (i = 0; i < n && i < CM_THREADS; i++) {
+      if (cm_txs[i] != NULL && cm_txs[i] != tx) {
+        while (cm_txs[i] != NULL && cm_txs[i]->cm_active)
+          cm_pause(CM_WAIT_UNIT);
+      }
+    }
+    return;
+  }
+  while (1) {
+    tx->cm_active = 1;
+    ATOMIC_MB_FULL;
+    if (ATOMIC_LOAD_ACQ(&cm_serial) == 0)
+      return;
+    tx->cm_active = 0;
+    while (ATOMIC_LOAD_ACQ(&cm_serial) != 0)
+      cm_pause(CM_WAIT_UNIT);
+  }
+}
+
+/*
+ * Abort of an attempt (locks released).
+ */
+static inline void cm_abort(stm_tx_t *tx)
+{
+  unsigned long bound;
+  int shift;
+
+  tx->cm_karma += tx->r_set.nb_entries + tx->w_set.nb_entries;
+  if (cm_serial_retries > 0 && !tx->cm_serial)
+    ATOMIC_STORE_REL(&tx->cm_active, 0);
+  if (cm_policy == CM_BACKOFF) {
+    shift = (tx->retries < CM_BACKOFF_MAX ? tx->retries : CM_BACKOFF_MAX);
+    bound = 1UL << shift;
+    /* xorshift */
+    tx->cm_seed ^= tx->cm_seed << 13;
+    tx->cm_seed ^= tx->cm_seed >> 7;
+    tx->cm_seed ^= tx->cm_seed << 17;
+    cm_pause(CM_BACKOFF_UNIT * (tx->cm_seed & (bound - 1)));
+  }
+}
+
+/*
+ * Commit of a transaction, before its retries are reset.
+ */
+static inline void cm_commit(stm_tx_t *tx)
+{
+  tx->cm_retries[cm_bucket(tx->retries)]++;
+  tx->cm_karma = 0;
+  if (tx->cm_serial) {
+    tx->cm_serial = 0;
+    tx->cm_serial_commits++;
+    ATOMIC_STORE_REL(&cm_serial, 0);
+  } else if (cm_serial_retries > 0) {
+    ATOMIC_STORE_REL(&tx->cm_active, 0);
+  }
+}
+
+static int cm_select(const char *name)
+{
+  int i;
+
+  for (i = 0; i < sizeof(cm_names) / sizeof(cm_names[0]); i++) {
+    if (strcasecmp(cm_names[i], name) == 0) {
+      cm_policy = i;
+      return 1;
+    }
+  }
+  return 0;
+}
 
 /* ################################################################### *
  * STATIC
@@ -354,7 +781,7 @@ static inline void stm_rollover_exit(stm_tx_t *tx)
   if (tx_overflow != 0 && tx_count == 0) {
     /* Yes: reset clock */
     memset((void *)locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_word_t));
-    CLOCK = 0;
+    clock_reset();
     tx_overflow = 0;
     /* Reset GC */
     gc_reset();
@@ -381,7 +808,7 @@ static inline void stm_overflow(stm_tx_t *tx)
   if (tx_count == 0) {
     /* Yes: reset clock */
     memset((void *)locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_word_t));
-    CLOCK = 0;
+    clock_reset();
     tx_overflow = 0;
     /* Reset GC */
     gc_reset();
@@ -396,13 +823,58 @@ static inline void stm_overflow(stm_tx_t *tx)
   pthread_mutex_unlock(&tx_count_mutex);
 }
 
+/*
+ * The read set is indexed by lock with an open-addressing table of twice
+ * its size, so that finding whether a stripe was read does not scan the
+ * whole read set. Slots are stamped with the transaction that filled
+ * them: starting a transaction empties the table by changing the stamp.
+ */
+#define R_INDEX_HASH(tx, lock)          ((stm_word_t)((lock) - locks) & (2 * (tx)->r_set.size - 1))
+
+/*
+ * Find the slot of a stripe in the read set index: the slot of its
+ * latest entry if it was read, the free slot to fill otherwise.
+ */
+static inline r_slot_t *stm_index_find(stm_tx_t *tx, volatile stm_word_t *lock)
+{
+  r_slot_t *slot;
+  stm_word_t i, mask;
+
+  mask = 2 * tx->r_set.size - 1;
+  i = R_INDEX_HASH(tx, lock);
+  while (1) {
+    slot = &tx->r_set.index[i];
+    if (slot->stamp != tx->r_set.stamp || tx->r_set.entries[slot->entry].lock == lock)
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+static inline void stm_index_set(stm_tx_t *tx, r_slot_t *slot, int entry)
+{
+  slot->stamp = tx->r_set.stamp;
+  slot->entry = entry;
+}
+
+/*
+ * Empty the read set (and its index).
+ */
+static inline void stm_reset_rs(stm_tx_t *tx)
+{
+  tx->r_set.nb_entries = 0;
+  if (++tx->r_set.stamp == 0) {
+    /* Stamps wrapped around: clear the slots */
+    memset(tx->r_set.index, 0, 2 * tx->r_set.size * sizeof(r_slot_t));
+    tx->r_set.stamp = 1;
+  }
+}
+
 /*
  * Check if stripe has been read previously.
  */
 static inline r_entry_t *stm_has_read(stm_tx_t *tx, volatile stm_word_t *lock)
 {
-  r_entry_t *r;
-  int i;
+  r_slot_t *slot;
 
   PRINT_DEBUG("==> stm_has_read(%p[%lu-%lu],%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, lock);
 
@@ -410,14 +882,14 @@ static inline r_entry_t *stm_has_read(stm_tx_t *tx, volatile stm_word_t *lock)
   assert(tx->status == TX_ACTIVE);
 
   /* Look for read */
-  r = tx->r_set.entries;
-  for (i = tx->r_set.nb_entries; i > 0; i--, r++) {
-    if (r->lock == lock) {
-      /* Return first match*/
-      return r;
-    }
+  slot = stm_index_find(tx, lock);
+  tx->read_lookups++;
+  if (slot->stamp != tx->r_set.stamp) {
+    tx->read_skipped += tx->r_set.nb_entries;
+    return NULL;
   }
-  return NULL;
+  tx->read_skipped += slot->entry;
+  return &tx->r_set.entries[slot->entry];
 }
 
 /*
@@ -425,6 +897,8 @@ static inline r_entry_t *stm_has_read(stm_tx_t *tx, volatile stm_word_t *lock)
  */
 static inline void stm_allocate_rs_entries(stm_tx_t *tx, int extend)
 {
+  int i;
+
   if (extend) {
     /* Extend read set */
     tx->r_set.size *= 2;
@@ -433,6 +907,7 @@ static inline void stm_allocate_rs_entries(stm_tx_t *tx, int extend)
       perror("realloc");
       exit(1);
     }
+    free(tx->r_set.index);
   } else {
     /* Allocate read set */
     if ((tx->r_set.entries = (r_entry_t *)malloc(tx->r_set.size * sizeof(r_entry_t))) == NULL) {
@@ -440,6 +915,15 @@ static inline void stm_allocate_rs_entries(stm_tx_t *tx, int extend)
       exit(1);
     }
   }
+  /* Index (slots of stamp 0 are free) */
+  if ((tx->r_set.index = (r_slot_t *)calloc(2 * tx->r_set.size, sizeof(r_slot_t))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  tx->r_set.stamp = 1;
+  /* Reindex the entries, the latest entry of a stripe last */
+  for (i = 0; i < tx->r_set.nb_entries; i++)
+    stm_index_set(tx, stm_index_find(tx, tx->r_set.entries[i].lock), i);
 }
 
 /*
@@ -520,7 +1004,7 @@ static inline int stm_extend(stm_tx_t *tx)
   assert(tx->status == TX_ACTIVE);
 
   /* Get current time */
-  now = GET_CLOCK;
+  now = clock_get();
   if (now >= VERSION_MAX) {
     /* Clock overflow */
     return 0;
@@ -581,12 +1065,25 @@ static inline void stm_rollback(stm_tx_t *tx)
   /* Reset nesting level */
   tx->nesting = 0;
 
+  cm_abort(tx);
 
   /* Jump back to transaction start */
   if (tx->jmp != NULL)
     siglongjmp(*tx->jmp, 1);
 }
 
+/*
+ * Run the next attempt of a read-only transaction as a normal one, the
+ * current attempt being aborted.
+ */
+static inline void stm_ro_fallback(stm_tx_t *tx)
+{
+  if (!tx->ro_fallback) {
+    tx->ro_fallback = 1;
+    tx->ro_fallbacks++;
+  }
+}
+
 /*
  * Store a word-sized value (return write set entry or NULL).
  */
@@ -596,6 +1093,7 @@ static inline w_entry_t *stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_
   stm_word_t l, version;
   w_entry_t *w;
   w_entry_t *prev = NULL;
+  int attempt = 0;
 
   PRINT_DEBUG2("==> stm_write(t=%p[%lu-%lu],a=%p,d=%p-%lu,m=0x%lx)\n",
                tx, (unsigned long)tx->start, (unsigned long)tx->end, addr, (void *)value, (unsigned long)value, (unsigned long)mask);
@@ -604,9 +1102,10 @@ static inline w_entry_t *stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_
   assert(tx->status == TX_ACTIVE);
 
   if (tx->ro) {
-    /* Disable read-only and abort */
-    assert(tx->attr != NULL);
-    tx->attr->ro = 0;
+    /* Disable read-only and abort: the retry runs as a normal transaction */
+    if (tx->attr != NULL)
+      tx->attr->ro = 0;
+    stm_ro_fallback(tx);
     tx->aborts_ro++;
     stm_rollback(tx);
     return NULL;
@@ -663,7 +1162,9 @@ static inline w_entry_t *stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_
       w = &tx->w_set.entries[tx->w_set.nb_entries];
       goto do_write;
     }
-    /* Abort */
+    /* Wait for the owner or abort */
+    if (cm_conflict(tx, w, &attempt))
+      goto restart;
     tx->aborts_locked_write++;
     stm_rollback(tx);
     return NULL;
@@ -672,6 +1173,8 @@ static inline w_entry_t *stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_
     /* Handle write after reads (before CAS) */
     version = LOCK_GET_TIMESTAMP(l);
     if (version > tx->end) {
+      if (clock_mode == CLOCK_GV5)
+        clock_advance(version);
       /* We might have read an older version previously */
       if (!tx->can_extend || stm_has_read(tx, lock) != NULL) {
         /* Read version must be older (otherwise, tx->end >= version) */
@@ -717,6 +1220,7 @@ static inline w_entry_t *stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_
     }
   w->version = version;
   w->next = NULL;
+  w->tx = tx;
   if (prev != NULL) {
     /* Link new entry in list */
     prev->next = w;
@@ -774,7 +1278,7 @@ void stm_init()
   memset((void *)locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_word_t));
 
 
-  CLOCK = 0;
+  clock_reset();
   if (pthread_mutex_init(&tx_count_mutex, NULL) != 0) {
     fprintf(stderr, "Error creating mutex\n");
     exit(1);
@@ -864,6 +1368,27 @@ TXTYPE stm_init_thread()
   tx->aborts_reallocate = 0;
   tx->aborts_rollover = 0;
   tx->max_retries = 0;
+  tx->read_lookups = 0;
+  tx->read_skipped = 0;
+  tx->read_duplicates = 0;
+  tx->ro_fallback = 0;
+  tx->ro_commits = 0;
+  tx->ro_fallbacks = 0;
+  tx->id = ATOMIC_FETCH_INC_FULL(&nb_ids);
+  if (tx->id >= CM_THREADS) {
+    fprintf(stderr, "Error: more than %d transactional threads\n", CM_THREADS);
+    exit(1);
+  }
+  tx->clock = &clock_slots[tx->id % CLOCK_SLOTS];
+  tx->cm_active = 0;
+  tx->cm_serial = 0;
+  tx->cm_ts = 0;
+  tx->cm_karma = 0;
+  tx->cm_seed = 0x9E3779B97F4A7C15UL * (tx->id + 1);
+  tx->cm_waits = 0;
+  tx->cm_serial_commits = 0;
+  memset(tx->cm_retries, 0, sizeof(tx->cm_retries));
+  cm_txs[tx->id] = tx;
   /* Store as thread-local data */
 #ifdef TLS
   thread_tx = tx;
@@ -890,6 +1415,7 @@ TXTYPE stm_init_thread()
 void stm_exit_thread(TXPARAM)
 {
   stm_word_t t;
+  int i;
   TX_GET;
 
   PRINT_DEBUG("==> stm_exit_thread(%p[%lu-%lu])\n", tx, (unsigned long)tx->start, (unsigned long)tx->end);
@@ -903,8 +1429,20 @@ void stm_exit_thread(TXPARAM)
 
   stm_rollover_exit(tx);
 
-  t = GET_CLOCK;
+  cm_txs[tx->id] = NULL;
+  ATOMIC_FETCH_ADD_FULL(&global_cm_waits, tx->cm_waits);
+  ATOMIC_FETCH_ADD_FULL(&global_cm_serial_commits, tx->cm_serial_commits);
+  for (i = 0; i < STM_RETRY_BUCKETS; i++)
+    ATOMIC_FETCH_ADD_FULL(&global_cm_retries[i], tx->cm_retries[i]);
+  ATOMIC_FETCH_ADD_FULL(&global_read_lookups, tx->read_lookups);
+  ATOMIC_FETCH_ADD_FULL(&global_read_skipped, tx->read_skipped);
+  ATOMIC_FETCH_ADD_FULL(&global_read_duplicates, tx->read_duplicates);
+  ATOMIC_FETCH_ADD_FULL(&global_ro_commits, tx->ro_commits);
+  ATOMIC_FETCH_ADD_FULL(&global_ro_fallbacks, tx->ro_fallbacks);
+
+  t = clock_get();
   gc_free(tx->r_set.entries, t);
+  gc_free(tx->r_set.index, t);
   gc_free(tx->w_set.entries, t);
   gc_free(tx, t);
   gc_exit_thread();
@@ -934,9 +1472,10 @@ static inline void stm_elastic_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *at
   tx->ro = (attr == NULL ? 0 : attr->ro);
   /* Set status (no need for CAS or atomic op) */
   tx->status = TX_ACTIVE;
+  cm_enter(tx);
  start:
   /* Start timestamp */
-  tx->start = tx->end = GET_CLOCK; /* OPT: Could be delayed until first read/write */
+  tx->start = tx->end = clock_get(); /* OPT: Could be delayed until first read/write */
   /* Disallow extensions in elastic transactions */
   tx->can_extend = 0;
   if (tx->start >= VERSION_MAX) {
@@ -952,7 +1491,7 @@ static inline void stm_elastic_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *at
     tx->w_set.reallocate = 0;
   }
   tx->w_set.nb_entries = 0;
-  tx->r_set.nb_entries = 0;
+  stm_reset_rs(tx);
 	
   gc_set_epoch(tx->start);
 	
@@ -967,7 +1506,7 @@ static inline void stm_elastic_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *at
 /*
  * Called by the CURRENT thread to start a transaction.
  */
-static inline void stm_normal_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *attr)
+static inline void stm_normal_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *attr, int ro)
 {
   TX_GET;
   tx->type = NL;
@@ -983,11 +1522,15 @@ static inline void stm_normal_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *att
   /* Attributes */
   tx->attr = attr;
   tx->ro = (attr == NULL ? 0 : attr->ro);
+  /* Declared read-only (RO), unless a previous attempt had to fall back */
+  if (ro && !tx->ro_fallback)
+    tx->ro = 1;
   /* Set status (no need for CAS or atomic op) */
   tx->status = TX_ACTIVE;
+  cm_enter(tx);
  start:
   /* Start timestamp */
-  tx->start = tx->end = GET_CLOCK; /* OPT: Could be delayed until first read/write */
+  tx->start = tx->end = clock_get(); /* OPT: Could be delayed until first read/write */
   /* Allow extensions */
   tx->can_extend = 1;
   if (tx->start >= VERSION_MAX) {
@@ -1003,7 +1546,7 @@ static inline void stm_normal_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *att
     tx->w_set.reallocate = 0;
   }
   tx->w_set.nb_entries = 0;
-  tx->r_set.nb_entries = 0;
+  stm_reset_rs(tx);
 
   gc_set_epoch(tx->start);
 
@@ -1016,8 +1559,8 @@ static inline void stm_normal_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *att
 }
 
 void stm_start(TXPARAMS sigjmp_buf *env, stm_tx_attr_t *attr, int type) {
-  if (type == NL) stm_normal_start(env, attr);
-  else stm_elastic_start(env, attr);
+  if (type == EL) stm_elastic_start(env, attr);
+  else stm_normal_start(env, attr, type == RO);
 }
 
 /*
@@ -1036,6 +1579,7 @@ static inline int stm_elastic_commit(TXPARAM)
   if (--tx->nesting > 0)
     return 1;
 	
+  cm_commit(tx);
   tx->retries = 0;
 		
   /* Callbacks */
@@ -1058,7 +1602,7 @@ static inline int stm_normal_commit(TXPARAM)
 {
   w_entry_t *w;
   stm_word_t t;
-  int i;
+  int i, validate;
   TX_GET;
 
   PRINT_DEBUG("==> stm_normal_commit(%p[%lu-%lu])\n", tx, (unsigned long)tx->start, (unsigned long)tx->end);
@@ -1075,7 +1619,7 @@ static inline int stm_normal_commit(TXPARAM)
 
 
     /* Get commit timestamp */
-    t = FETCH_INC_CLOCK + 1;
+    t = clock_commit(tx, &validate);
     if (t >= VERSION_MAX) {
       /* Abort: will reset the clock on next transaction start or delete */
       tx->aborts_rollover++;
@@ -1084,7 +1628,7 @@ static inline int stm_normal_commit(TXPARAM)
     }
 
     /* Try to validate (only if a concurrent transaction has committed since tx->start) */
-    if (tx->start != t - 1 && !stm_validate(tx)) {
+    if (validate && !stm_validate(tx)) {
       /* Cannot commit */
       tx->aborts_validate_commit++;
       stm_rollback(tx);
@@ -1103,12 +1647,15 @@ static inline int stm_normal_commit(TXPARAM)
       PRINT_DEBUG2("==> write(t=%p[%lu-%lu],a=%p,d=%p-%d,v=%d)\n",
                    tx, (unsigned long)tx->start, (unsigned long)tx->end, w->addr, (void *)w->value, (int)w->value, (int)w->version);
     }
+  } else if (tx->ro) {
+    /* Read-only: all reads were consistent with tx->start */
+    tx->ro_commits++;
   }
+  tx->ro_fallback = 0;
 
+  cm_commit(tx);
   tx->retries = 0;
 
-
-
   /* Callbacks */
   if (nb_commit_cb != 0) {
     int cb;
@@ -1233,6 +1780,8 @@ static inline stm_word_t stm_elastic_load(TXPARAMS volatile stm_word_t *x)
       if ((y=tx->lastraddr[i])) {
 	stm_vervalver(y, &ts_y);
 	if (ts_y > tx->start) {
+	  if (clock_mode == CLOCK_GV5)
+	    clock_advance(ts_y);
 	  tx->aborts_ro++;
 	  stm_rollback(tx);
 	  return 0;
@@ -1259,7 +1808,9 @@ static inline stm_word_t stm_normal_load(TXPARAMS volatile stm_word_t *addr)
   volatile stm_word_t *lock;
   stm_word_t l, l2, value, version;
   r_entry_t *r;
+  r_slot_t *slot;
   w_entry_t *w;
+  int attempt = 0;
   TX_GET;
 
   PRINT_DEBUG2("==> stm_normal_load(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
@@ -1300,7 +1851,11 @@ static inline stm_word_t stm_normal_load(TXPARAMS volatile stm_word_t *addr)
                    tx, (unsigned long)tx->start, (unsigned long)tx->end, addr, lock, (unsigned long)l, (void *)value, (unsigned long)value);
       return value;
     }
-    /* Abort */
+    /* Wait for the owner or abort */
+    if (cm_conflict(tx, w, &attempt)) {
+      l = ATOMIC_LOAD_ACQ(lock);
+      goto restart_no_load;
+    }
     tx->aborts_locked_read++;
     stm_rollback(tx);
     return 0;
@@ -1316,9 +1871,14 @@ static inline stm_word_t stm_normal_load(TXPARAMS volatile stm_word_t *addr)
     version = LOCK_GET_TIMESTAMP(l);
     /* Valid version? */
     if (version > tx->end) {
+      if (clock_mode == CLOCK_GV5)
+        clock_advance(version);
       /* No: try to extend first (except for read-only transactions: no read set) */
       if (tx->ro || !tx->can_extend || !stm_extend(tx)) {
-        /* Not much we can do: abort */
+        /* Not much we can do: abort (RO transactions that keep failing
+         * fall back to a normal one, which can extend) */
+        if (tx->ro && tx->retries + 1 >= RO_RETRIES)
+          stm_ro_fallback(tx);
         tx->aborts_validate_read++;
         stm_rollback(tx);
         return 0;
@@ -1337,12 +1897,21 @@ static inline stm_word_t stm_normal_load(TXPARAMS volatile stm_word_t *addr)
   /* We have a good version: add to read set (update transactions) and return value */
 
   if (!tx->ro) {
-    /* Add address and version to read set */
-    if (tx->r_set.nb_entries == tx->r_set.size)
-      stm_allocate_rs_entries(tx, 1);
-    r = &tx->r_set.entries[tx->r_set.nb_entries++];
-    r->version = version;
-    r->lock = lock;
+    slot = stm_index_find(tx, lock);
+    if (slot->stamp == tx->r_set.stamp && tx->r_set.entries[slot->entry].version == version) {
+      /* Stripe already read with this version: nothing more to validate */
+      tx->read_duplicates++;
+    } else {
+      /* Add address and version to read set */
+      if (tx->r_set.nb_entries == tx->r_set.size) {
+        stm_allocate_rs_entries(tx, 1);
+        slot = stm_index_find(tx, lock);
+      }
+      r = &tx->r_set.entries[tx->r_set.nb_entries];
+      r->version = version;
+      r->lock = lock;
+      stm_index_set(tx, slot, tx->r_set.nb_entries++);
+    }
   }
 
   PRINT_DEBUG2("==> stm_normal_load(t=%p[%lu-%lu],a=%p,l=%p,*l=%lu,d=%p-%lu,v=%lu)\n",
@@ -1401,6 +1970,8 @@ static inline int stm_elastic_store(volatile stm_word_t *addr, stm_word_t value,
       /* The read address of the rotating buffer has been seen unlocked */
       ts_x = (stm_word_t)LOCK_GET_TIMESTAMP(l);
       if (ts_x > tx->start) {
+	if (clock_mode == CLOCK_GV5)
+	  clock_advance(ts_x);
 	/* The read address of the rotating buffer has changed */
 	tx->aborts_validate_write++;
 	stm_rollback(tx);
@@ -1494,6 +2065,40 @@ int stm_get_stats(TXPARAMS const char *name, void *val)
 {
   TX_GET;
 
+  /* Totals over the threads that have exited */
+  if (strcmp("global_nb_cm_waits", name) == 0) {
+    *(unsigned long *)val = global_cm_waits;
+    return 1;
+  }
+  if (strcmp("global_nb_serial_commits", name) == 0) {
+    *(unsigned long *)val = global_cm_serial_commits;
+    return 1;
+  }
+  if (strcmp("global_retries", name) == 0) {
+    memcpy(val, (void *)global_cm_retries, sizeof(global_cm_retries));
+    return 1;
+  }
+  if (strcmp("global_nb_read_lookups", name) == 0) {
+    *(unsigned long *)val = global_read_lookups;
+    return 1;
+  }
+  if (strcmp("global_nb_read_skipped", name) == 0) {
+    *(unsigned long *)val = global_read_skipped;
+    return 1;
+  }
+  if (strcmp("global_nb_read_duplicates", name) == 0) {
+    *(unsigned long *)val = global_read_duplicates;
+    return 1;
+  }
+  if (strcmp("global_nb_ro_commits", name) == 0) {
+    *(unsigned long *)val = global_ro_commits;
+    return 1;
+  }
+  if (strcmp("global_nb_ro_fallbacks", name) == 0) {
+    *(unsigned long *)val = global_ro_fallbacks;
+    return 1;
+  }
+
   if (strcmp("read_set_size", name) == 0) {
     *(unsigned int *)val = tx->r_set.size;
     return 1;
@@ -1562,6 +2167,38 @@ int stm_get_stats(TXPARAMS const char *name, void *val)
     *(unsigned long *)val = tx->max_retries;
     return 1;
   }
+  if (strcmp("nb_cm_waits", name) == 0) {
+    *(unsigned long *)val = tx->cm_waits;
+    return 1;
+  }
+  if (strcmp("nb_serial_commits", name) == 0) {
+    *(unsigned long *)val = tx->cm_serial_commits;
+    return 1;
+  }
+  if (strcmp("retries", name) == 0) {
+    memcpy(val, tx->cm_retries, sizeof(tx->cm_retries));
+    return 1;
+  }
+  if (strcmp("nb_read_lookups", name) == 0) {
+    *(unsigned long *)val = tx->read_lookups;
+    return 1;
+  }
+  if (strcmp("nb_read_skipped", name) == 0) {
+    *(unsigned long *)val = tx->read_skipped;
+    return 1;
+  }
+  if (strcmp("nb_read_duplicates", name) == 0) {
+    *(unsigned long *)val = tx->read_duplicates;
+    return 1;
+  }
+  if (strcmp("nb_ro_commits", name) == 0) {
+    *(unsigned long *)val = tx->ro_commits;
+    return 1;
+  }
+  if (strcmp("nb_ro_fallbacks", name) == 0) {
+    *(unsigned long *)val = tx->ro_fallbacks;
+    return 1;
+  }
   return 0;
 }
 
@@ -1571,13 +2208,21 @@ int stm_get_stats(TXPARAMS const char *name, void *val)
 int stm_get_parameter(const char *name, void *val)
 {
   if (strcmp("contention_manager", name) == 0) {
-    *(const char **)val = 0;
+    *(const char **)val = cm_names[cm_policy];
+    return 1;
+  }
+  if (strcmp("cm_serial", name) == 0) {
+    *(int *)val = cm_serial_retries;
     return 1;
   }
   if (strcmp("design", name) == 0) {
     *(const char **)val = 0;
     return 1;
   }
+  if (strcmp("clock", name) == 0) {
+    *(const char **)val = clock_names[clock_mode];
+    return 1;
+  }
   if (strcmp("initial_rw_set_size", name) == 0) {
     *(int *)val = RW_SET_SIZE;
     return 1;
@@ -1596,6 +2241,23 @@ int stm_get_parameter(const char *name, void *val)
  */
 int stm_set_parameter(const char *name, void *val)
 {
+  if (strcmp("clock", name) == 0) {
+    /* Only before the threads start */
+    if (tx_count != 0)
+      return 0;
+    return clock_select((const char *)val);
+  }
+  if (strcmp("cm", name) == 0 || strcmp("contention_manager", name) == 0) {
+    if (tx_count != 0)
+      return 0;
+    return cm_select((const char *)val);
+  }
+  if (strcmp("cm_serial", name) == 0) {
+    if (tx_count != 0 || *(int *)val < 0)
+      return 0;
+    cm_serial_retries = *(int *)val;
+    return 1;
+  }
   return 0;
 }
 
@@ -1685,7 +2347,7 @@ int stm_register(void (*on_thread_init)(TXPARAMS void *arg),
  */
 stm_word_t stm_get_clock()
 {
-  return GET_CLOCK;
+  return clock_get();
 }
 
 /*
@@ -0,0 +1,136 @@
+/*
+ * File:
+ *   norec.h
+ * Description:
+ *   NOrec STM functions.
+ *
+ *   NOrec (Dalessandro, Spear and Scott, PPoPP 2010) has no ownership
+ *   records: all transactions share a single sequence lock, which is odd
+ *   while a transaction writes back its updates. A transaction logs the
+ *   values it reads and buffers its writes. When it observes that the
+ *   sequence lock has changed, it revalidates by checking that the
+ *   memory still holds the logged values (value-based validation) and
+ *   moves its snapshot to the new sequence number. An update transaction
+ *   commits by acquiring the sequence lock with a CAS from its snapshot,
+ *   so commits are serialized but read-only transactions commit without
+ *   any write to shared memory.
+ *
+ * norec.h is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _NOREC_H_
+# define _NOREC_H_
+
+# include <setjmp.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/* Transaction types of TX_START: NOrec has no elastic transactions and
+ * needs the read log of read-only transactions to revalidate, so all
+ * types run as normal transactions */
+# define EL                             0
+# define NL                             1
+# define RO                             2
+
+/**
+ * Size of a word (accessible atomically) on the target architecture.
+ */
+typedef uintptr_t stm_word_t;
+
+/**
+ * Initialize the STM library. Must be called once, before any other
+ * function of the library.
+ */
+void stm_init();
+
+/**
+ * Clean up the STM library, freeing the memory retired by the threads
+ * that have exited.
+ */
+void stm_exit();
+
+/**
+ * Initialize the calling thread. Must be called once by each thread
+ * before it starts a transaction.
+ */
+void stm_init_thread();
+
+/**
+ * Clean up the calling thread and accumulate its statistics.
+ */
+void stm_exit_thread();
+
+/**
+ * Environment to be used with sigsetjmp() before stm_start(), or NULL
+ * inside a transaction (nesting is flattened).
+ */
+sigjmp_buf *stm_get_env();
+
+/**
+ * Start a transaction of the given type (EL, NL or RO).
+ */
+void stm_start(sigjmp_buf *env, int type);
+
+/**
+ * Commit the current transaction. On failure, the transaction is
+ * restarted from the environment given to stm_start().
+ */
+int stm_commit();
+
+/**
+ * Abort and restart the current transaction.
+ */
+void stm_abort();
+
+/**
+ * Transactional load of a word.
+ */
+stm_word_t stm_load(volatile stm_word_t *addr);
+
+/**
+ * Transactional store of a word, buffered until commit.
+ */
+void stm_store(volatile stm_word_t *addr, stm_word_t value);
+
+/**
+ * Allocate memory within a transaction (freed if the transaction
+ * aborts).
+ */
+void *stm_malloc(size_t size);
+
+/**
+ * Free memory within a transaction. The memory is retired if the
+ * transaction commits, and freed once no running transaction can still
+ * read it.
+ */
+void stm_free(void *addr, size_t size);
+
+/**
+ * Get a statistic of the calling thread ("nb_commits", "nb_aborts",
+ * "nb_aborts_validate_read", "nb_aborts_validate_commit", "max_retries",
+ * "nb_validations") or the total over the threads that have exited
+ * ("global_nb_commits", "global_nb_aborts", "global_nb_validations",
+ * "global_nb_retired"). Return 0 if the statistic is unknown.
+ */
+int stm_get_stats(const char *name, void *val);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _NOREC_H_ */
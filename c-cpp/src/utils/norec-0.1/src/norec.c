@@ -0,0 +1,648 @@
+/*
+ * File:
+ *   norec.c
+ * Description:
+ *   NOrec STM functions: a single global sequence lock, value-based
+ *   validation and no ownership records (see norec.h).
+ *
+ *   Memory freed by a committed transaction is retired with the sequence
+ *   number of its commit and freed once every running transaction has a
+ *   snapshot at least as recent: a transaction that started earlier may
+ *   still hold a pointer to it, even though its next validation will
+ *   fail. A transaction without writes does not commit a sequence number
+ *   and retires its memory with the next one. Each thread publishes its
+ *   snapshot in a padded slot for that purpose.
+ *
+ * norec.c is part of Synchrobench
+ *
+ * Synchrobench is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic_ops.h>
+
+#include "norec.h"
+
+/* ################################################################### *
+ * DEFINES
+ * ################################################################### */
+
+#ifndef RW_SET_SIZE
+# define RW_SET_SIZE                    1024                /* Initial size of read log and write set */
+#endif /* ! RW_SET_SIZE */
+
+#define NOREC_THREADS                   1024                /* Maximum number of threads */
+#define NOREC_GC_SCAN                   64                  /* Blocks retired between two reclamations */
+#define NOREC_SPIN                      128                 /* Spins on the sequence lock before yielding */
+#define NOREC_IDLE                      (~(stm_word_t)0)    /* Snapshot of a thread outside transactions */
+
+/* Bit of the write filter of an address */
+#define W_FILTER(addr)                  ((stm_word_t)1 << (((uintptr_t)(addr) >> 3) & (sizeof(stm_word_t) * 8 - 1)))
+
+#define ATOMIC_CAS_FULL(a, e, v)        (AO_compare_and_swap_full((volatile AO_t *)(a), (AO_t)(e), (AO_t)(v)))
+#define ATOMIC_FETCH_INC_FULL(a)        (AO_fetch_and_add1_full((volatile AO_t *)(a)))
+#define ATOMIC_FETCH_ADD_FULL(a, v)     (AO_fetch_and_add_full((volatile AO_t *)(a), (AO_t)(v)))
+#define ATOMIC_LOAD_ACQ(a)              (AO_load_acquire_read((volatile AO_t *)(a)))
+#define ATOMIC_LOAD(a)                  (*((volatile AO_t *)(a)))
+#define ATOMIC_STORE_REL(a, v)          (AO_store_release((volatile AO_t *)(a), (AO_t)(v)))
+#define ATOMIC_STORE(a, v)              (*((volatile AO_t *)(a)) = (AO_t)(v))
+#define ATOMIC_MB_FULL                  AO_nop_full()
+
+/* ################################################################### *
+ * TYPES
+ * ################################################################### */
+
+enum {                                  /* Transaction status */
+  TX_IDLE = 0,
+  TX_ACTIVE = 1
+};
+
+typedef struct entry {                  /* Read log or write set entry */
+  volatile stm_word_t *addr;            /* Address */
+  stm_word_t value;                     /* Value read or to be written */
+} entry_t;
+
+typedef struct block {                  /* Retired memory block */
+  void *addr;                           /* Address of the block */
+  stm_word_t ts;                        /* Commit that retired it */
+} block_t;
+
+typedef struct slot {                   /* Published snapshot of a thread */
+  volatile stm_word_t snapshot;
+  char padding[64 - sizeof(stm_word_t)];
+} slot_t;
+
+typedef struct stm_tx {                 /* Transaction descriptor */
+  sigjmp_buf env;                       /* Environment for setjmp/longjmp */
+  sigjmp_buf *jmp;                      /* Pointer to environment */
+  int status;                           /* Transaction status */
+  int nesting;                          /* Nesting level */
+  stm_word_t snapshot;                  /* Sequence number the reads are consistent with */
+  slot_t *slot;                         /* Published snapshot */
+  entry_t *r_log;                       /* Read log */
+  int r_nb, r_size;
+  entry_t *w_set;                       /* Write set */
+  int w_nb, w_size;
+  stm_word_t w_filter;                  /* Bloom filter of the written addresses */
+  void **allocated;                     /* Memory allocated by this transaction (freed upon abort) */
+  int a_nb, a_size;
+  void **freed;                         /* Memory freed by this transaction (retired upon commit) */
+  int f_nb, f_size;
+  block_t *retired;                     /* Memory retired by this thread, not freed yet */
+  int rt_nb, rt_size, rt_scan;
+  unsigned long retries;                /* Number of consecutive aborts (retries) */
+  unsigned long commits;                /* Total number of commits (cumulative) */
+  unsigned long aborts;                 /* Total number of aborts (cumulative) */
+  unsigned long aborts_validate_read;   /* Aborts due to failed validation upon read (cumulative) */
+  unsigned long aborts_validate_commit; /* Aborts due to failed validation upon commit (cumulative) */
+  unsigned long max_retries;            /* Maximum number of consecutive aborts (retries) */
+  unsigned long validations;            /* Successful validations (cumulative) */
+  unsigned long nb_retired;             /* Blocks retired (cumulative) */
+} stm_tx_t;
+
+/* ################################################################### *
+ * GLOBALS
+ * ################################################################### */
+
+static volatile stm_word_t seqlock[64 / sizeof(stm_word_t)] __attribute__((aligned(64)));
+static slot_t slots[NOREC_THREADS] __attribute__((aligned(64)));
+static volatile stm_word_t nb_ids = 0;  /* Number of thread indexes handed out */
+
+/* Blocks retired by the threads that have exited, freed by stm_exit() */
+static pthread_mutex_t orphans_mutex = PTHREAD_MUTEX_INITIALIZER;
+static block_t *orphans;
+static int orphans_nb, orphans_size;
+
+static volatile unsigned long global_commits;
+static volatile unsigned long global_aborts;
+static volatile unsigned long global_validations;
+static volatile unsigned long global_retired;
+
+#ifdef TLS
+static __thread stm_tx_t* thread_tx;
+#else /* ! TLS */
+static pthread_key_t thread_tx;
+#endif /* ! TLS */
+
+/* ################################################################### *
+ * STATIC
+ * ################################################################### */
+
+/*
+ * Returns the transaction descriptor for the CURRENT thread.
+ */
+static inline stm_tx_t *stm_get_tx()
+{
+#ifdef TLS
+  return thread_tx;
+#else /* ! TLS */
+  return (stm_tx_t *)pthread_getspecific(thread_tx);
+#endif /* ! TLS */
+}
+
+/*
+ * Make room for one more element in a growing array.
+ */
+static inline void *stm_grow(void *array, int nb, int *size, size_t elt)
+{
+  if (nb < *size)
+    return array;
+  *size = (*size == 0 ? RW_SET_SIZE : *size * 2);
+  if ((array = realloc(array, *size * elt)) == NULL) {
+    perror("realloc");
+    exit(1);
+  }
+  return array;
+}
+
+/*
+ * Wait until no transaction is writing back and return the sequence number.
+ */
+static inline stm_word_t stm_wait_even()
+{
+  stm_word_t s;
+  int spin = 0;
+
+  while ((s = ATOMIC_LOAD_ACQ(&seqlock[0])) & 1) {
+    /* The writer may have been preempted */
+    if (++spin % NOREC_SPIN == 0)
+      sched_yield();
+  }
+  return s;
+}
+
+/*
+ * Set the snapshot of the transaction and publish it for reclamation.
+ */
+static inline void stm_publish(stm_tx_t *tx, stm_word_t s)
+{
+  tx->snapshot = s;
+  ATOMIC_STORE(&tx->slot->snapshot, s);
+}
+
+/*
+ * Check that the values of the read log are unchanged and move the
+ * snapshot to the current sequence number (return 0 if a value changed).
+ */
+static inline int stm_validate(stm_tx_t *tx)
+{
+  entry_t *r;
+  stm_word_t s;
+  int i;
+
+  while (1) {
+    s = stm_wait_even();
+    for (i = tx->r_nb, r = tx->r_log; i > 0; i--, r++) {
+      if (ATOMIC_LOAD_ACQ(r->addr) != r->value)
+        return 0;
+    }
+    /* No commit during the check: the log is consistent with s */
+    if (ATOMIC_LOAD_ACQ(&seqlock[0]) == s) {
+      stm_publish(tx, s);
+      tx->validations++;
+      return 1;
+    }
+  }
+}
+
+/*
+ * Free the retired blocks that no running transaction can read.
+ */
+static void stm_reclaim(stm_tx_t *tx)
+{
+  stm_word_t min, s;
+  int i, j, n;
+
+  /* Order the commits that retired the blocks before the scan */
+  ATOMIC_MB_FULL;
+  min = NOREC_IDLE;
+  n = (int)ATOMIC_LOAD(&nb_ids);
+  for (i = 0; i < n; i++) {
+    s = ATOMIC_LOAD(&slots[i].snapshot);
+    if (s < min)
+      min = s;
+  }
+  for (i = j = 0; i < tx->rt_nb; i++) {
+    if (tx->retired[i].ts <= min)
+      free(tx->retired[i].addr);
+    else
+      tx->retired[j++] = tx->retired[i];
+  }
+  tx->rt_nb = j;
+  tx->rt_scan = j + NOREC_GC_SCAN;
+}
+
+/*
+ * Reset the logs of the transaction.
+ */
+static inline void stm_reset(stm_tx_t *tx)
+{
+  tx->r_nb = 0;
+  tx->w_nb = 0;
+  tx->w_filter = 0;
+  tx->a_nb = 0;
+  tx->f_nb = 0;
+}
+
+/*
+ * Start a new attempt of the transaction.
+ */
+static inline void stm_begin(stm_tx_t *tx)
+{
+  stm_reset(tx);
+  stm_publish(tx, stm_wait_even());
+  /* Publish before the first read: a block retired meanwhile has a later
+   * sequence number, which the first load will notice */
+  ATOMIC_MB_FULL;
+}
+
+/*
+ * Undo the current attempt and restart the transaction.
+ */
+static void stm_rollback(stm_tx_t *tx)
+{
+  int i;
+
+  assert(tx->status == TX_ACTIVE);
+
+  /* The allocated memory was never published */
+  for (i = 0; i < tx->a_nb; i++)
+    free(tx->allocated[i]);
+  stm_reset(tx);
+
+  tx->retries++;
+  tx->aborts++;
+  if (tx->max_retries < tx->retries)
+    tx->max_retries = tx->retries;
+
+  ATOMIC_STORE_REL(&tx->slot->snapshot, NOREC_IDLE);
+  tx->status = TX_IDLE;
+  tx->nesting = 0;
+
+  assert(tx->jmp != NULL);
+  siglongjmp(*tx->jmp, 1);
+}
+
+/* ################################################################### *
+ * STM FUNCTIONS
+ * ################################################################### */
+
+/*
+ * Called once (from main) to initialize STM infrastructure.
+ */
+void stm_init()
+{
+  int i;
+
+  seqlock[0] = 0;
+  for (i = 0; i < NOREC_THREADS; i++)
+    slots[i].snapshot = NOREC_IDLE;
+#ifndef TLS
+  if (pthread_key_create(&thread_tx, NULL) != 0) {
+    fprintf(stderr, "Error creating thread local\n");
+    exit(1);
+  }
+#endif /* ! TLS */
+}
+
+/*
+ * Called once (from main) to clean up STM infrastructure.
+ */
+void stm_exit()
+{
+  int i;
+
+#ifndef TLS
+  pthread_key_delete(thread_tx);
+#endif /* ! TLS */
+  for (i = 0; i < orphans_nb; i++)
+    free(orphans[i].addr);
+  free(orphans);
+  orphans = NULL;
+  orphans_nb = orphans_size = 0;
+}
+
+/*
+ * Called by the CURRENT thread to initialize thread-local STM data.
+ */
+void stm_init_thread()
+{
+  stm_tx_t *tx;
+  int id;
+
+  if ((tx = stm_get_tx()) != NULL)
+    return;
+  if ((tx = (stm_tx_t *)calloc(1, sizeof(stm_tx_t))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  id = (int)ATOMIC_FETCH_INC_FULL(&nb_ids);
+  if (id >= NOREC_THREADS) {
+    fprintf(stderr, "Error: more than %d transactional threads\n", NOREC_THREADS);
+    exit(1);
+  }
+  tx->slot = &slots[id];
+  tx->status = TX_IDLE;
+  tx->rt_scan = NOREC_GC_SCAN;
+  tx->r_log = (entry_t *)stm_grow(NULL, 0, &tx->r_size, sizeof(entry_t));
+  tx->w_set = (entry_t *)stm_grow(NULL, 0, &tx->w_size, sizeof(entry_t));
+#ifdef TLS
+  thread_tx = tx;
+#else /* ! TLS */
+  pthread_setspecific(thread_tx, tx);
+#endif /* ! TLS */
+}
+
+/*
+ * Called by the CURRENT thread to clean up thread-local STM data.
+ */
+void stm_exit_thread()
+{
+  stm_tx_t *tx = stm_get_tx();
+
+  if (tx == NULL)
+    return;
+
+  ATOMIC_FETCH_ADD_FULL(&global_commits, tx->commits);
+  ATOMIC_FETCH_ADD_FULL(&global_aborts, tx->aborts);
+  ATOMIC_FETCH_ADD_FULL(&global_validations, tx->validations);
+  ATOMIC_FETCH_ADD_FULL(&global_retired, tx->nb_retired);
+
+  /* Leave the blocks that are still readable to stm_exit() */
+  stm_reclaim(tx);
+  pthread_mutex_lock(&orphans_mutex);
+  while (tx->rt_nb > 0) {
+    orphans = (block_t *)stm_grow(orphans, orphans_nb, &orphans_size, sizeof(block_t));
+    orphans[orphans_nb++] = tx->retired[--tx->rt_nb];
+  }
+  pthread_mutex_unlock(&orphans_mutex);
+
+  free(tx->r_log);
+  free(tx->w_set);
+  free(tx->allocated);
+  free(tx->freed);
+  free(tx->retired);
+  free(tx);
+#ifdef TLS
+  thread_tx = NULL;
+#else /* ! TLS */
+  pthread_setspecific(thread_tx, NULL);
+#endif /* ! TLS */
+}
+
+/*
+ * Called by the CURRENT thread to obtain an environment for setjmp/longjmp.
+ */
+sigjmp_buf *stm_get_env()
+{
+  stm_tx_t *tx = stm_get_tx();
+
+  /* Only return environment for top-level transaction */
+  return tx->nesting == 0 ? &tx->env : NULL;
+}
+
+/*
+ * Called by the CURRENT thread to start a transaction.
+ */
+void stm_start(sigjmp_buf *env, int type)
+{
+  stm_tx_t *tx = stm_get_tx();
+
+  /* Flat nesting */
+  if (tx->nesting++ > 0)
+    return;
+
+  tx->jmp = env;
+  tx->status = TX_ACTIVE;
+  stm_begin(tx);
+}
+
+/*
+ * Called by the CURRENT thread to commit a transaction.
+ */
+int stm_commit()
+{
+  stm_tx_t *tx = stm_get_tx();
+  entry_t *w;
+  stm_word_t t;
+  int i;
+
+  assert(tx->status == TX_ACTIVE);
+
+  if (--tx->nesting > 0)
+    return 1;
+
+  if (tx->w_nb > 0) {
+    /* Take the sequence lock, revalidating after each concurrent commit */
+    while (!ATOMIC_CAS_FULL(&seqlock[0], tx->snapshot, tx->snapshot + 1)) {
+      if (!stm_validate(tx)) {
+        tx->aborts_validate_commit++;
+        stm_rollback(tx);
+        return 0;
+      }
+    }
+    for (i = tx->w_nb, w = tx->w_set; i > 0; i--, w++)
+      ATOMIC_STORE(w->addr, w->value);
+    t = tx->snapshot + 2;
+    ATOMIC_STORE_REL(&seqlock[0], t);
+  } else {
+    /* A read-only transaction was consistent at its last read. What it
+     * freed is kept until the transactions running now, whose snapshots
+     * are at most the current sequence number, are done */
+    t = (ATOMIC_LOAD_ACQ(&seqlock[0]) | 1) + 1;
+  }
+
+  /* Nobody can reach the freed memory from a snapshot >= t */
+  for (i = 0; i < tx->f_nb; i++) {
+    tx->retired = (block_t *)stm_grow(tx->retired, tx->rt_nb, &tx->rt_size, sizeof(block_t));
+    tx->retired[tx->rt_nb].addr = tx->freed[i];
+    tx->retired[tx->rt_nb++].ts = t;
+  }
+  tx->nb_retired += tx->f_nb;
+
+  ATOMIC_STORE_REL(&tx->slot->snapshot, NOREC_IDLE);
+  tx->status = TX_IDLE;
+  tx->commits++;
+  tx->retries = 0;
+  stm_reset(tx);
+
+  if (tx->rt_nb >= tx->rt_scan)
+    stm_reclaim(tx);
+
+  return 1;
+}
+
+/*
+ * Called by the CURRENT thread to abort a transaction.
+ */
+void stm_abort()
+{
+  stm_rollback(stm_get_tx());
+}
+
+/*
+ * Called by the CURRENT thread to load a word-sized value.
+ */
+stm_word_t stm_load(volatile stm_word_t *addr)
+{
+  stm_tx_t *tx = stm_get_tx();
+  stm_word_t value;
+  entry_t *w;
+  int i;
+
+  assert(tx->status == TX_ACTIVE);
+
+  /* Read after write */
+  if ((tx->w_filter & W_FILTER(addr)) != 0) {
+    for (i = tx->w_nb - 1, w = tx->w_set + i; i >= 0; i--, w--) {
+      if (w->addr == addr)
+        return w->value;
+    }
+  }
+
+  value = ATOMIC_LOAD_ACQ(addr);
+  while (ATOMIC_LOAD_ACQ(&seqlock[0]) != tx->snapshot) {
+    /* A transaction has committed since the snapshot */
+    if (!stm_validate(tx)) {
+      tx->aborts_validate_read++;
+      stm_rollback(tx);
+      return 0;
+    }
+    value = ATOMIC_LOAD_ACQ(addr);
+  }
+
+  tx->r_log = (entry_t *)stm_grow(tx->r_log, tx->r_nb, &tx->r_size, sizeof(entry_t));
+  tx->r_log[tx->r_nb].addr = addr;
+  tx->r_log[tx->r_nb++].value = value;
+
+  return value;
+}
+
+/*
+ * Called by the CURRENT thread to store a word-sized value.
+ */
+void stm_store(volatile stm_word_t *addr, stm_word_t value)
+{
+  stm_tx_t *tx = stm_get_tx();
+  entry_t *w;
+  int i;
+
+  assert(tx->status == TX_ACTIVE);
+
+  /* Write after write: keep the last value only */
+  if ((tx->w_filter & W_FILTER(addr)) != 0) {
+    for (i = tx->w_nb - 1, w = tx->w_set + i; i >= 0; i--, w--) {
+      if (w->addr == addr) {
+        w->value = value;
+        return;
+      }
+    }
+  }
+
+  tx->w_set = (entry_t *)stm_grow(tx->w_set, tx->w_nb, &tx->w_size, sizeof(entry_t));
+  tx->w_set[tx->w_nb].addr = addr;
+  tx->w_set[tx->w_nb++].value = value;
+  tx->w_filter |= W_FILTER(addr);
+}
+
+/*
+ * Called by the CURRENT thread to allocate memory within a transaction.
+ */
+void *stm_malloc(size_t size)
+{
+  stm_tx_t *tx = stm_get_tx();
+  void *addr;
+
+  if ((addr = malloc(size)) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if (tx != NULL && tx->status == TX_ACTIVE) {
+    tx->allocated = (void **)stm_grow(tx->allocated, tx->a_nb, &tx->a_size, sizeof(void *));
+    tx->allocated[tx->a_nb++] = addr;
+  }
+  return addr;
+}
+
+/*
+ * Called by the CURRENT thread to free memory within a transaction.
+ */
+void stm_free(void *addr, size_t size)
+{
+  stm_tx_t *tx = stm_get_tx();
+
+  if (tx == NULL || tx->status != TX_ACTIVE) {
+    /* Outside transactions, the caller owns the memory */
+    free(addr);
+    return;
+  }
+  tx->freed = (void **)stm_grow(tx->freed, tx->f_nb, &tx->f_size, sizeof(void *));
+  tx->freed[tx->f_nb++] = addr;
+}
+
+/*
+ * Called by the CURRENT thread to obtain statistics.
+ */
+int stm_get_stats(const char *name, void *val)
+{
+  stm_tx_t *tx = stm_get_tx();
+
+  /* Totals over the threads that have exited */
+  if (strcmp("global_nb_commits", name) == 0) {
+    *(unsigned long *)val = global_commits;
+    return 1;
+  }
+  if (strcmp("global_nb_aborts", name) == 0) {
+    *(unsigned long *)val = global_aborts;
+    return 1;
+  }
+  if (strcmp("global_nb_validations", name) == 0) {
+    *(unsigned long *)val = global_validations;
+    return 1;
+  }
+  if (strcmp("global_nb_retired", name) == 0) {
+    *(unsigned long *)val = global_retired;
+    return 1;
+  }
+
+  if (tx == NULL)
+    return 0;
+  if (strcmp("nb_commits", name) == 0) {
+    *(unsigned long *)val = tx->commits;
+    return 1;
+  }
+  if (strcmp("nb_aborts", name) == 0) {
+    *(unsigned long *)val = tx->aborts;
+    return 1;
+  }
+  if (strcmp("nb_aborts_validate_read", name) == 0) {
+    *(unsigned long *)val = tx->aborts_validate_read;
+    return 1;
+  }
+  if (strcmp("nb_aborts_validate_commit", name) == 0) {
+    *(unsigned long *)val = tx->aborts_validate_commit;
+    return 1;
+  }
+  if (strcmp("max_retries", name) == 0) {
+    *(unsigned long *)val = tx->max_retries;
+    return 1;
+  }
+  if (strcmp("nb_validations", name) == 0) {
+    *(unsigned long *)val = tx->validations;
+    return 1;
+  }
+  return 0;
+}